@@ -1,76 +1,1016 @@
+#include "config.h"
+
 #include "slp.hpp"
+#if SLP_AUTH
+#include "slp_auth.hpp"
+#endif
+#include "slp_cache.hpp"
+#if SLP_DA
+#include "slp_da.hpp"
+#endif
+#include "slp_filter.hpp"
+#include "slp_lifetime.hpp"
+#include "slp_log.hpp"
 #include "slp_meta.hpp"
+#include "slp_netns.hpp"
+#include "slp_receive_queue.hpp"
+#if SLP_SA
+#include "slp_sa.hpp"
+#endif
+#include "slp_scheduler.hpp"
 #include "slp_server.hpp"
+#include "slp_task.hpp"
+#include "slp_text.hpp"
+#include "slp_trace.hpp"
 #include "sock_channel.hpp"
 
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <algorithm>
-#include <iomanip>
+#include <memory>
+#include <random>
 
-/* Call Back for the sd event loop */
-static int requestHandler(sd_event_source* /*es*/, int fd, uint32_t /*revents*/,
-                          void* /*userdata*/)
+/* Delay of the reply to a multicast request, random within the
+ * configured window so that all the agents on the subnet do not answer
+ * the requester at the same moment */
+static uint64_t replyDelay()
+{
+    constexpr uint64_t window = MCAST_REPLY_WINDOW * 1000ULL;
+    static std::minstd_rand generator{std::random_device{}()};
+
+    return std::uniform_int_distribution<uint64_t>(0, window)(generator);
+}
+
+/* XID of a request for the probes, before it is parsed */
+static uint16_t requestXid(const std::vector<uint8_t>& buf)
+{
+    constexpr auto offset = slp::header::OFFSET_XID;
+    return buf.size() >= offset + slp::header::SIZE_XID
+               ? (buf[offset] << 8) | buf[offset + 1]
+               : 0;
+}
+
+/* Function id of a request for the probes, before it is parsed */
+static uint8_t requestFunction(const std::vector<uint8_t>& buf)
+{
+    return buf.size() > slp::header::OFFSET_FUNCTION
+               ? buf[slp::header::OFFSET_FUNCTION]
+               : 0;
+}
+
+/* Requests waiting to be served, and the source serving them */
+static slp::udp::Scheduler scheduler;
+static sd_event_source* schedulerSource = nullptr;
+
+/* Datagrams read from a socket per event, so that reading and serving
+ * take turns under load */
+constexpr size_t READ_BATCH = 16;
+
+/* When the kernel received a datagram, as a steady clock time */
+static std::chrono::steady_clock::time_point receivedAt(const timespec& ts)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (ts.tv_sec == 0 && ts.tv_nsec == 0)
+    {
+        return now;
+    }
+
+    timespec realtime{};
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    auto age = std::chrono::seconds(realtime.tv_sec - ts.tv_sec) +
+               std::chrono::nanoseconds(realtime.tv_nsec - ts.tv_nsec);
+    return now - std::max<std::chrono::nanoseconds>(age, {});
+}
+
+#if SLP_SA
+/* The socket of each namespace, learnt from the datagrams it receives,
+ * for the registrations sent to the directory agents heard there */
+static std::vector<int> namespaceSockets;
+#endif
+
+/* The receive queue of each namespace socket, created with its first
+ * datagram */
+static std::vector<std::unique_ptr<slp::udp::ReceiveQueue>> receiveQueues;
+
+/* Drop malformed datagrams before they reach the socket of each
+ * namespace */
+static std::vector<std::unique_ptr<slp::udp::Filter>> socketFilters;
+
+/* The datagrams the socket filter of a namespace dropped, zero without
+ * a filter and UNCOUNTED when the classic filter is attached */
+static uint64_t filteredDrops(size_t ns)
+{
+    if (ns >= socketFilters.size() || !socketFilters[ns])
+    {
+        return 0;
+    }
+
+    auto [rc, drops] = socketFilters[ns]->drops();
+    if (rc < 0)
+    {
+        return slp::udp::ReceiveQueue::UNCOUNTED;
+    }
+    uint64_t total = 0;
+    for (auto count : drops)
+    {
+        total += count;
+    }
+    return total;
+}
+
+/* Account for the datagrams the socket dropped before a request,
+ * warning of them at most every WARN_INTERVAL */
+static void accountDrops(const slp::udp::Scheduler::Request& request,
+                         uint32_t overflow)
+{
+    if (receiveQueues.size() <= request.ns)
+    {
+        receiveQueues.resize(request.ns + 1);
+    }
+    auto& queue = receiveQueues[request.ns];
+    if (!queue)
+    {
+        queue = std::make_unique<slp::udp::ReceiveQueue>(request.fd,
+                                                         SOCKET_BUFFER_MAX);
+    }
+
+    // The filter is only asked when the count moved
+    uint64_t filtered =
+        overflow != queue->overflowCount() ? filteredDrops(request.ns) : 0;
+    queue->received(overflow, filtered, request.received);
+
+    uint64_t drops = queue->warnDrops(std::chrono::steady_clock::now());
+    if (drops > 0)
+    {
+        SLP_LOG_ERROR("SLP socket%s%s dropped %llu datagrams for want of "
+                      "buffer space, %zu bytes for bursts of %zu",
+                      request.ns ? " of " : "",
+                      slp::netns::name(request.ns).c_str(),
+                      static_cast<unsigned long long>(drops),
+                      queue->bufferSize(), queue->peakBurst());
+    }
+}
+
+/* Queue a request and make sure it gets served */
+static void queueRequest(slp::udp::Scheduler::Request&& request,
+                         uint32_t overflow)
 {
-    int rc = slp::SUCCESS;
+#if SLP_SA
+    if (namespaceSockets.size() <= request.ns)
+    {
+        namespaceSockets.resize(request.ns + 1, -1);
+    }
+    namespaceSockets[request.ns] = request.fd;
+#endif
+    accountDrops(request, overflow);
+
+    auto cls = scheduler.classify(&request.peer.sockAddr, request.multicast);
+    if (scheduler.push(cls, std::move(request)))
+    {
+        (void)sd_event_source_set_enabled(schedulerSource, SD_EVENT_ONESHOT);
+    }
+}
+
+/* Call Back for the sd event loop, queues the waiting datagrams */
+static int requestHandler(sd_event_source* /*es*/, int fd,
+                          uint32_t /*revents*/, void* userdata)
+{
+    // The server passes the network namespace of the socket
+    auto ns = static_cast<size_t>(reinterpret_cast<intptr_t>(userdata));
     timeval tv{slp::TIMEOUT, 0};
-    udpsocket::Channel channel(fd, tv);
-    std::vector<uint8_t> recvBuff;
-    slp::Message req;
+
+    for (size_t i = 0; i < READ_BATCH; i++)
+    {
+        udpsocket::Channel channel(fd, tv);
+        slp::udp::Scheduler::Request request;
+        int rc = slp::SUCCESS;
+
+        SLP_PROBE(request_start, 0, 0);
+        std::tie(rc, request.data) = channel.read();
+        if (rc == -EAGAIN || rc == -EWOULDBLOCK)
+        {
+            break;
+        }
+        if (rc < 0)
+        {
+            SLP_LOG_ERROR("SLP Error in Read : %x", rc);
+            return rc;
+        }
+        SLP_PROBE(read_done, requestXid(request.data),
+                  requestFunction(request.data));
+
+        request.ns = ns;
+        request.fd = fd;
+        request.peer = channel.getPeer();
+        request.multicast = channel.isMulticast();
+        request.received = receivedAt(channel.getTimestamp());
+        queueRequest(std::move(request), channel.getOverflow());
+    }
+    return slp::SUCCESS;
+}
+
+#if SLP_IO_URING
+/* Call Back for the datagrams received through io_uring */
+static void packetHandler(slp::udp::Ring& ring,
+                          const slp::udp::Ring::Packet& packet, void* userdata)
+{
+    slp::udp::Scheduler::Request request;
+    SLP_PROBE(request_start, 0, 0);
+
+    // The kernel has already read the datagram into the ring
+    request.data.assign(packet.data.begin(), packet.data.end());
+    SLP_PROBE(read_done, requestXid(request.data),
+              requestFunction(request.data));
+
+    request.ns = static_cast<size_t>(reinterpret_cast<intptr_t>(userdata));
+    request.fd = ring.fd();
+    request.ring = &ring;
+    request.peer.addrSize =
+        std::min<socklen_t>(packet.peerLen, sizeof(request.peer.inAddr));
+    memcpy(&request.peer.sockAddr, packet.peer, request.peer.addrSize);
+    request.multicast = packet.multicast;
+    request.received = receivedAt(packet.timestamp);
+    queueRequest(std::move(request), packet.overflow);
+}
+#endif
+
+/* Send the reply to a request, through the ring it came from if any */
+static void sendReply(slp::udp::Scheduler::Request& request,
+                      std::vector<uint8_t>& resp)
+{
+#if SLP_IO_URING
+    if (request.ring)
+    {
+        int rc = request.ring->send(&request.peer.sockAddr,
+                                    request.peer.addrSize, std::move(resp));
+        if (rc < 0)
+        {
+            SLP_LOG_ERROR("SLP Error in Send : %s", strerror(-rc));
+        }
+        return;
+    }
+#endif
+    timeval tv{slp::TIMEOUT, 0};
+    udpsocket::Channel channel(request.fd, tv, &request.peer.sockAddr,
+                               request.peer.addrSize);
+    channel.write(resp);
+}
+
+/* Serve a queued request, as a task so that the requests served after
+ * it do not wait on what it waits for */
+static slp::task::Task serveQueued(sd_event* event,
+                                   slp::udp::Scheduler::Request request)
+{
+    auto& recvBuff = request.data;
     std::vector<uint8_t> resp;
-    // Read the packet
-    std::tie(rc, recvBuff) = channel.read();
+    bool multicast = false;
 
-    if (rc < 0)
+    slp::trace::begin(request.received);
+    slp::trace::mark(slp::trace::Stage::READ);
+
+    if (!slp::handler::serveRequest(recvBuff, request.multicast, resp,
+                                    multicast, request.ns))
+    {
+        slp::trace::end();
+        co_return;
+    }
+
+    bool delayed = multicast && MCAST_REPLY_WINDOW > 0;
+    if (!delayed)
+    {
+        sendReply(request, resp);
+    }
+    SLP_PROBE(write_done, requestXid(recvBuff), requestFunction(recvBuff));
+    slp::trace::mark(slp::trace::Stage::WRITE);
+    slp::trace::end();
+    if (!delayed)
+    {
+        co_return;
+    }
+
+    // Sent at once if the timer cannot be set
+    co_await slp::task::sleep(event, replyDelay());
+    sendReply(request, resp);
+}
+
+#if SLP_SA
+/* Sends the registrations with the directory agents */
+static sd_event_source* registrarSource = nullptr;
+
+/* Wake up when the registrar has something to send next */
+static void armRegistrations()
+{
+    auto next = slp::sa::registrar().next();
+    if (next == slp::sa::Registrar::NEVER)
+    {
+        (void)sd_event_source_set_enabled(registrarSource, SD_EVENT_OFF);
+        return;
+    }
+    (void)sd_event_source_set_time(registrarSource, next * 1000);
+    (void)sd_event_source_set_enabled(registrarSource, SD_EVENT_ONESHOT);
+}
+
+/* Call Back for the registrar timer, sends the SrvRegs that are due */
+static int sendRegistrations(sd_event_source* /*es*/, uint64_t /*usec*/,
+                             void* /*userdata*/)
+{
+    for (auto& reg : slp::sa::registrar().due(slp::sa::now()))
+    {
+        int fd = reg.ns < namespaceSockets.size() ? namespaceSockets[reg.ns]
+                                                   : -1;
+        if (fd < 0 ||
+            sendto(fd, reg.message.data(), reg.message.size(), 0,
+                   reinterpret_cast<sockaddr*>(&reg.addr),
+                   sizeof(reg.addr)) < 0)
+        {
+            SLP_LOG_ERROR("Unable to send the SrvReg: %s",
+                          strerror(fd < 0 ? EBADF : errno));
+        }
+    }
+    armRegistrations();
+    return slp::SUCCESS;
+}
+
+/* Hand the services of every namespace to the registrar */
+static void updateRegistrations()
+{
+    auto registry = slp::handler::internal::getServiceRegistry();
+    for (size_t ns = 0; ns < slp::netns::count(); ns++)
+    {
+        slp::sa::registrar().setServices(
+            ns, slp::handler::internal::serviceRegistrations(*registry, ns),
+            slp::sa::now());
+    }
+}
+#endif
+
+/* Reload the service registry, and the registrations along with it */
+static void reloadRegistry(bool force = false)
+{
+    if (!slp::handler::internal::reloadServiceRegistry(force))
+    {
+        return;
+    }
+#if SLP_SA
+    if (slp::sa::enabled())
+    {
+        updateRegistrations();
+        armRegistrations();
+    }
+#endif
+}
+
+#if SLP_IO_URING
+/* Rings holding back the replies served until the queues drain */
+static std::vector<slp::udp::Ring*> heldRings;
+#endif
+
+/* Submit the replies the rings held back */
+static void flushReplies()
+{
+#if SLP_IO_URING
+    for (auto* ring : heldRings)
+    {
+        int r = ring->flush();
+        if (r < 0)
+        {
+            SLP_LOG_ERROR("SLP io_uring submit failed: %s", strerror(-r));
+        }
+    }
+    heldRings.clear();
+#endif
+}
+
+/* Call Back for the scheduler, serves one weighted round of requests and
+ * lets the sockets be read again before the next */
+static int serveRequests(sd_event_source* es, void* /*userdata*/)
+{
+    slp::udp::Scheduler::Request request;
+
+    // Requests past their maximum age are dropped before they are parsed
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0;
+         i <= slp::udp::Scheduler::WEIGHT && scheduler.pop(request, now); i++)
+    {
+#if SLP_IO_URING
+        // The replies of a burst go out in one io_uring_enter per ring
+        if (request.ring && request.ring->hold())
+        {
+            heldRings.push_back(request.ring);
+        }
+#endif
+        serveQueued(sd_event_source_get_event(es), std::move(request));
+    }
+#if SLP_SA
+    // DAAdverts and SrvAcks change what the registrar sends next
+    if (slp::sa::enabled())
+    {
+        armRegistrations();
+    }
+#endif
+    if (!scheduler.empty())
+    {
+        return sd_event_source_set_enabled(es, SD_EVENT_ONESHOT);
+    }
+    // Until then a ring also submits them along with its completions
+    flushReplies();
+    return slp::SUCCESS;
+}
+
+#if SLP_DA
+/* Multicast an unsolicited DAAdvert so that agents find the DA */
+static void advertiseDA(int fd)
+{
+    slp::Message req;
+    req.header.version = slp::VERSION_2;
+    req.header.langtag = "en";
+
+    auto advert = slp::da::prepareDAAdvert(req);
+
+    struct sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(slp::PORT);
+    inet_pton(AF_INET6,
+              (std::string("::ffff:") + slp::MULTICAST_ADDR).c_str(),
+              &addr.sin6_addr);
+
+    if (sendto(fd, advert.data(), advert.size(), 0, (struct sockaddr*)&addr,
+               sizeof(addr)) < 0)
+    {
+        SLP_LOG_ERROR("Unable to send the DAAdvert: %s", strerror(errno));
+    }
+}
+
+/* Call Back for the DAAdvert heartbeat timer */
+static int daHeartbeat(sd_event_source* es, uint64_t usec, void* userdata)
+{
+    advertiseDA(static_cast<int>(reinterpret_cast<intptr_t>(userdata)));
+
+    sd_event_source_set_time(es, usec + slp::DA_BEAT * 1000000ULL);
+    return sd_event_source_set_enabled(es, SD_EVENT_ONESHOT);
+}
+
+/* Call Back for the timer dropping expired registrations */
+static int daExpire(sd_event_source* es, uint64_t usec, void* /*userdata*/)
+{
+    slp::da::store().expire(slp::da::now());
+
+    sd_event_source_set_time(es, usec + 1000000ULL);
+    return sd_event_source_set_enabled(es, SD_EVENT_ONESHOT);
+}
+
+/* Start hook of the server in directory agent mode */
+static int startDA(sd_event* event, int fd)
+{
+    uint64_t now = 0;
+    auto userdata = reinterpret_cast<void*>(static_cast<intptr_t>(fd));
+
+    int r = sd_event_now(event, CLOCK_MONOTONIC, &now);
+    if (r < 0)
+    {
+        return r;
+    }
+
+    // RFC 2608 section 12.2, advertise on startup and every DA_BEAT
+    advertiseDA(fd);
+
+    r = sd_event_add_time(event, nullptr, CLOCK_MONOTONIC,
+                          now + slp::DA_BEAT * 1000000ULL, 0, daHeartbeat,
+                          userdata);
+    if (r < 0)
     {
-        std::cerr << "SLP Error in Read : " << std::hex << rc << "\n";
-        return rc;
+        return r;
     }
 
-    // This code currently assume a maximum of 255 bytes in a receive
-    // or response message. Enforce that here.
-    if (recvBuff.size() > slp::MAX_LEN)
+    return sd_event_add_time(event, nullptr, CLOCK_MONOTONIC, now + 1000000ULL,
+                             0, daExpire, nullptr);
+}
+#endif
+
+#if SLP_SA
+/* Start hook of the server registering with the directory agents */
+static int startSA(sd_event* event, int fd)
+{
+    if (namespaceSockets.empty())
     {
-        std::cerr << "Message size exceeds maximum allowed: " << recvBuff.size()
-                  << " / " << slp::MAX_LEN << std::endl;
+        namespaceSockets.push_back(fd);
+    }
 
-        rc = static_cast<uint8_t>(slp::Error::PARSE_ERROR);
+    int r = sd_event_add_time(event, &registrarSource, CLOCK_MONOTONIC,
+                              slp::sa::Registrar::NEVER, 1000,
+                              sendRegistrations, nullptr);
+    if (r < 0)
+    {
+        return r;
     }
-    else
+    (void)sd_event_source_set_enabled(registrarSource, SD_EVENT_OFF);
+    updateRegistrations();
+
+    // RFC 2608 section 12.2.1, ask for the DAs rather than wait up to
+    // DA_BEAT for their next DAAdvert
+    auto discovery = slp::sa::prepareDADiscovery(
+        static_cast<uint16_t>(std::random_device{}()));
+
+    struct sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(slp::PORT);
+    inet_pton(AF_INET6,
+              (std::string("::ffff:") + slp::MULTICAST_ADDR).c_str(),
+              &addr.sin6_addr);
+
+    if (sendto(fd, discovery.data(), discovery.size(), 0,
+               (struct sockaddr*)&addr, sizeof(addr)) < 0)
     {
-        switch (recvBuff[0])
+        SLP_LOG_ERROR("Unable to look for the directory agents: %s",
+                      strerror(errno));
+    }
+    return slp::SUCCESS;
+}
+#endif
+
+/* Pick up an announced registry change, the advertised lifetimes only
+ * need to be cut short well ahead of it */
+static void checkPlannedChange()
+{
+    int r = slp::lifetime::readPlannedChange(slp::lifetime::policy(),
+                                             slp::PLANNED_CHANGE);
+    if (r < 0)
+    {
+        SLP_LOG_ERROR("Unable to read %s: %s", slp::PLANNED_CHANGE,
+                      strerror(-r));
+    }
+}
+
+#if !SLP_BUILTIN_SERVICES
+/* Call Back for changes in the service directory */
+static int registryChanged(sd_event_source* /*es*/,
+                           const struct inotify_event* /*event*/,
+                           void* /*userdata*/)
+{
+    checkPlannedChange();
+    reloadRegistry(true);
+    return slp::SUCCESS;
+}
+#endif
+
+/* Call Back for the timer checking the interface addresses */
+static int addressRecheck(sd_event_source* es, uint64_t usec,
+                          void* /*userdata*/)
+{
+    checkPlannedChange();
+    reloadRegistry();
+
+    sd_event_source_set_time(es, usec + slp::ADDRESS_RECHECK * 1000000ULL);
+    return sd_event_source_set_enabled(es, SD_EVENT_ONESHOT);
+}
+
+/* Call Back for the netlink address and link events, the registry and
+ * its own address set are rebuilt once the queued events are read */
+static int addressChanged(sd_event_source* /*es*/, int fd,
+                          uint32_t /*revents*/, void* /*userdata*/)
+{
+    char buf[4096];
+    ssize_t len = 0;
+
+    while ((len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0 ||
+           (len < 0 && errno == ENOBUFS))
+    {
+        // Events lost to an overrun still mean something changed
+    }
+    reloadRegistry();
+    return slp::SUCCESS;
+}
+
+/* Follow the interface address changes of a namespace, the periodic
+ * check remains for when netlink is not available */
+static void followAddresses(sd_event* event, size_t ns)
+{
+    int fd = -1;
+    {
+        // The netlink socket reports the namespace it is created in
+        slp::netns::Enter enter(ns);
+        fd = enter.error();
+        if (fd >= 0)
         {
-            case slp::VERSION_2:
+            fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        NETLINK_ROUTE);
+            if (fd < 0)
             {
-                // Parse the buffer and construct the req object
-                std::tie(rc, req) = slp::parser::parseBuffer(recvBuff);
-                if (!rc)
-                {
-                    // Passing the req object to handler to serve it
-                    std::tie(rc, resp) = slp::handler::processRequest(req);
-                }
-                break;
+                fd = -errno;
             }
-            default:
-                std::cout << "SLP Unsupported Request Version="
-                          << (int)recvBuff[0] << "\n";
+        }
+    }
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
 
-                rc = static_cast<uint8_t>(slp::Error::VER_NOT_SUPPORTED);
-                break;
+    int r = fd < 0 ? fd : 0;
+    if (!r && bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        r = -errno;
+    }
+    if (!r)
+    {
+        // The socket lives as long as slpd
+        r = sd_event_add_io(event, nullptr, fd, EPOLLIN, addressChanged,
+                            nullptr);
+    }
+    if (r < 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
         }
+        SLP_LOG_ERROR("Unable to follow the address changes%s%s: %s",
+                      ns ? " of " : "", slp::netns::name(ns).c_str(),
+                      strerror(-r));
     }
+}
+
+/* Time the stages of every Nth request, 0 disables */
+static unsigned traceSample = 0;
 
-    // if there was error during Parsing of request
-    // or processing of request then handle the error.
-    if (rc)
+/* Log what the socket filters dropped */
+static void logDrops()
+{
+    for (size_t ns = 0; ns < socketFilters.size(); ns++)
     {
-        resp = slp::handler::processError(req, rc);
+        if (!socketFilters[ns])
+        {
+            continue;
+        }
+
+        const char* of = ns ? " of " : "";
+        const auto& name = slp::netns::name(ns);
+        auto [rc, drops] = socketFilters[ns]->drops();
+        if (rc < 0)
+        {
+            SLP_LOG_INFO("SLP socket filter%s%s drops not counted: %s", of,
+                         name.c_str(), strerror(-rc));
+            continue;
+        }
+
+        for (size_t reason = 0; reason < drops.size(); reason++)
+        {
+            SLP_LOG_INFO("SLP socket filter%s%s dropped %s: %llu", of,
+                         name.c_str(), slp::udp::Filter::reasonName(reason),
+                         static_cast<unsigned long long>(drops[reason]));
+        }
     }
+}
 
-    channel.write(resp);
+/* Log the datagrams the sockets dropped and their buffer sizes */
+static void logReceiveQueues()
+{
+    for (size_t ns = 0; ns < receiveQueues.size(); ns++)
+    {
+        const auto& queue = receiveQueues[ns];
+        if (!queue)
+        {
+            continue;
+        }
+        SLP_LOG_INFO("SLP socket%s%s: %llu dropped, %llu dropped or "
+                     "filtered, %zu byte buffers, bursts of up to %zu",
+                     ns ? " of " : "", slp::netns::name(ns).c_str(),
+                     static_cast<unsigned long long>(queue->drops()),
+                     static_cast<unsigned long long>(queue->unknownDrops()),
+                     queue->bufferSize(), queue->peakBurst());
+    }
+}
+
+/* Log the queue delays and the requests shed by the scheduler */
+static void logQueues()
+{
+    using Class = slp::udp::Scheduler::Class;
+    for (auto [cls, name] :
+         {std::pair{Class::URGENT, "urgent"}, std::pair{Class::BULK, "bulk"}})
+    {
+        const auto& h = scheduler.queueDelay(cls);
+        SLP_LOG_INFO("SLP %s queue: %llu requests, p50 %lluns, p99 %lluns, "
+                     "max %lluns, %llu shed, %llu stale",
+                     name, static_cast<unsigned long long>(h.count()),
+                     static_cast<unsigned long long>(h.percentile(0.5)),
+                     static_cast<unsigned long long>(h.percentile(0.99)),
+                     static_cast<unsigned long long>(h.max()),
+                     static_cast<unsigned long long>(scheduler.shed(cls)),
+                     static_cast<unsigned long long>(scheduler.stale(cls)));
+    }
+}
+
+/* Log the durations of the sampled request stages */
+static void logStages()
+{
+    if (traceSample == 0)
+    {
+        return;
+    }
+
+    for (size_t stage = 0; stage < slp::trace::STAGES; stage++)
+    {
+        const auto& h = slp::trace::histogram(slp::trace::Stage(stage));
+        SLP_LOG_INFO("SLP stage %s: %llu samples, p50 %lluns, p99 %lluns, "
+                     "max %lluns",
+                     slp::trace::stageName(stage),
+                     static_cast<unsigned long long>(h.count()),
+                     static_cast<unsigned long long>(h.percentile(0.5)),
+                     static_cast<unsigned long long>(h.percentile(0.99)),
+                     static_cast<unsigned long long>(h.max()));
+    }
+}
+
+/* Log the hit rate and the memory use of the response cache */
+static void logCache()
+{
+    const auto& cache = slp::cache::responses();
+    if (cache.capacity() == 0)
+    {
+        return;
+    }
+
+    auto lookups = cache.hits() + cache.misses();
+    SLP_LOG_INFO("SLP response cache: %llu hits, %llu misses, %llu%% hit "
+                 "rate, %zu of %zu entries, %zu bytes",
+                 static_cast<unsigned long long>(cache.hits()),
+                 static_cast<unsigned long long>(cache.misses()),
+                 static_cast<unsigned long long>(
+                     lookups ? cache.hits() * 100 / lookups : 0),
+                 cache.size(), cache.capacity(), cache.bytes());
+}
+
+/* Log the request tasks and where their frames came from */
+static void logTasks()
+{
+    const auto& pool = slp::task::frames();
+    SLP_LOG_INFO("SLP request tasks: %zu waiting, at most %zu, %llu frames "
+                 "of %zu from the heap",
+                 pool.inUse(), pool.peak(),
+                 static_cast<unsigned long long>(pool.heapFrames()),
+                 pool.capacity());
+}
+
+/* Call Back for SIGUSR1, logs the filter, socket, queue, task, cache
+ * and stage statistics */
+static int logStats(sd_event_source* /*es*/,
+                    const struct signalfd_siginfo* /*si*/, void* /*userdata*/)
+{
+    logDrops();
+    logReceiveQueues();
+    logQueues();
+    logTasks();
+    logCache();
+    logStages();
     return slp::SUCCESS;
 }
 
-int main()
+/* Log the statistics on SIGUSR1 */
+static int startStats(sd_event* event)
+{
+    sigset_t ss;
+    if (sigemptyset(&ss) < 0 || sigaddset(&ss, SIGUSR1) < 0 ||
+        sigprocmask(SIG_BLOCK, &ss, nullptr) < 0)
+    {
+        return -errno;
+    }
+    return sd_event_add_signal(event, nullptr, SIGUSR1, logStats, nullptr);
+}
+
+/* Socket hook of the server, attaches the socket filter to the socket
+ * of each namespace */
+static void startFilter(size_t ns, int fd)
+{
+    if (socketFilters.size() <= ns)
+    {
+        socketFilters.resize(ns + 1);
+    }
+
+    int r = 0;
+    std::tie(r, socketFilters[ns]) = slp::udp::Filter::attach(fd);
+    if (r < 0)
+    {
+        // Malformed datagrams are still rejected after the read
+        SLP_LOG_ERROR("Unable to attach the socket filter%s%s: %s",
+                      ns ? " of " : "", slp::netns::name(ns).c_str(),
+                      strerror(-r));
+    }
+}
+
+/* Serve the queued requests from the event loop, at the priority of
+ * the sockets so that reading and serving take turns */
+static int startScheduler(sd_event* event)
 {
+    int r = sd_event_add_defer(event, &schedulerSource, serveRequests,
+                               nullptr);
+    if (r < 0)
+    {
+        return r;
+    }
+    r = sd_event_source_set_priority(schedulerSource,
+                                     SD_EVENT_PRIORITY_NORMAL);
+    if (r < 0)
+    {
+        return r;
+    }
+    return sd_event_source_set_enabled(schedulerSource, SD_EVENT_OFF);
+}
+
+/* Start hook of the server, registry reloads are done from the event
+ * loop so that requests only ever read the published registry */
+static int startServer(sd_event* event, [[maybe_unused]] int fd)
+{
+    uint64_t now = 0;
+
+    int r = startScheduler(event);
+    if (r < 0)
+    {
+        return r;
+    }
+
+    // Builtin builds have no service files to watch
+#if !SLP_BUILTIN_SERVICES
+    r = sd_event_add_inotify(event, nullptr, slp::SERVICE_DIR,
+                                 IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                                     IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR,
+                                 registryChanged, nullptr);
+    if (r < 0)
+    {
+        SLP_LOG_ERROR("Unable to watch %s: %s", slp::SERVICE_DIR,
+                      strerror(-r));
+    }
+#endif
+
+    r = sd_event_now(event, CLOCK_MONOTONIC, &now);
+    if (r < 0)
+    {
+        return r;
+    }
+
+    r = sd_event_add_time(event, nullptr, CLOCK_MONOTONIC,
+                          now + slp::ADDRESS_RECHECK * 1000000ULL, 0,
+                          addressRecheck, nullptr);
+    if (r < 0)
+    {
+        return r;
+    }
+
+    checkPlannedChange();
+    for (size_t ns = 0; ns < slp::netns::count(); ns++)
+    {
+        followAddresses(event, ns);
+    }
+    r = startStats(event);
+    if (r < 0)
+    {
+        return r;
+    }
+
+#if SLP_DA
+    if (slp::da::enabled())
+    {
+        return startDA(event, fd);
+    }
+#endif
+#if SLP_SA
+    if (slp::sa::enabled())
+    {
+        return startSA(event, fd);
+    }
+#endif
+    return slp::SUCCESS;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+#if SLP_DA
+            "  -d, --directory-agent   Run as a directory agent\n"
+            "  -s, --scopes=LIST       Scopes served by the directory agent\n"
+#endif
+#if SLP_SA
+            "  -r, --register          Register the services with the\n"
+            "                          directory agents found\n"
+#endif
+            "  -n, --netns=LIST        Also serve these named network\n"
+            "                          namespaces\n"
+            "  -m, --management=LIST   Serve requests from these subnets\n"
+            "                          first, even when multicast\n"
+            "  -t, --trace-sample=N    Time the stages of every Nth request,\n"
+            "                          logged on SIGUSR1\n"
+            "  -h, --help              Show this help\n",
+            name);
+}
+
+int main(int argc, char* argv[])
+{
+    static const option options[] = {
+        {"directory-agent", no_argument, nullptr, 'd'},
+        {"scopes", required_argument, nullptr, 's'},
+        {"register", no_argument, nullptr, 'r'},
+        {"netns", required_argument, nullptr, 'n'},
+        {"management", required_argument, nullptr, 'm'},
+        {"trace-sample", required_argument, nullptr, 't'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    bool directoryAgent = false;
+    bool registerServices = false;
+    std::string scopes = "DEFAULT";
+    std::vector<std::string> namespaces;
+    std::vector<std::string> subnets;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "ds:rn:m:t:h", options, nullptr)) !=
+           -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                directoryAgent = true;
+                break;
+            case 's':
+                scopes = optarg;
+                break;
+            case 'r':
+                registerServices = true;
+                break;
+            case 'n':
+                slp::text::splitList(optarg, [&](std::string_view name) {
+                    namespaces.emplace_back(name);
+                });
+                break;
+            case 'm':
+                slp::text::splitList(optarg, [&](std::string_view subnet) {
+                    subnets.emplace_back(subnet);
+                });
+                break;
+            case 't':
+                traceSample = strtoul(optarg, nullptr, 10);
+                break;
+            case 'h':
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    slp::trace::setSampleInterval(traceSample);
+    if (slp::netns::open(namespaces) < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (scheduler.setManagementSubnets(subnets) < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    scheduler.maxAge = std::chrono::milliseconds(MAX_QUEUE_AGE);
+#if SLP_AUTH
+    // Requests listing an SPI are answered with URL entries signed by it
+    slp::auth::setKeys(slp::auth::loadKeys(slp::AUTH_KEY_DIR));
+#endif
+
     slp::udp::Server svr(slp::PORT, requestHandler);
+    svr.idleTimeout = std::chrono::seconds(IDLE_EXIT_TIMEOUT);
+    svr.onStart = startServer;
+    svr.onSocket = startFilter;
+#if SLP_IO_URING
+    svr.onPacket = packetHandler;
+#endif
+
+    if (directoryAgent)
+    {
+#if SLP_DA
+        slp::da::enable(scopes);
+        // The registrations only live in memory
+        svr.idleTimeout = std::chrono::seconds(0);
+#else
+        SLP_LOG_ERROR("slpd is built without the directory agent");
+        return EXIT_FAILURE;
+#endif
+    }
+    else if (registerServices)
+    {
+#if SLP_SA
+        slp::sa::enable();
+        // The registrations need refreshing before they expire
+        svr.idleTimeout = std::chrono::seconds(0);
+#else
+        SLP_LOG_ERROR("slpd is built without the registrar");
+        return EXIT_FAILURE;
+#endif
+    }
+
     return svr.run();
 }
@@ -1,15 +1,22 @@
 #pragma once
 
+#include "slp_builtin.hpp"
+#include "slp_cache.hpp"
+#include "slp_meta.hpp"
+#include "slp_registry_image.hpp"
+#include "slp_service_index.hpp"
 #include "slp_service_info.hpp"
+#include "slp_snapshot.hpp"
 
 #include <stdio.h>
+#include <time.h>
 
 #include <array>
-#include <functional>
-#include <list>
 #include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <vector>
 
@@ -18,8 +25,21 @@ namespace slp
 
 using buffer = std::vector<uint8_t>;
 
-template <typename T>
-using deleted_unique_ptr = std::unique_ptr<T, std::function<void(T*)>>;
+/** Deleter calling a C release function, e.g. closedir.
+ *  It carries no state so the owning unique_ptr is pointer sized.
+ */
+template <auto release>
+struct Releaser
+{
+    template <typename T>
+    void operator()(T* ptr) const
+    {
+        release(ptr);
+    }
+};
+
+template <typename T, auto release>
+using deleted_unique_ptr = std::unique_ptr<T, Releaser<release>>;
 
 namespace request
 {
@@ -49,6 +69,68 @@ struct Service
     std::string predicate;
     std::string spistr;
 };
+
+/*
+ * @struct URLEntry
+ *
+ * SLP URL Entry carried by registrations, without the auth blocks.
+ */
+struct URLEntry
+{
+    uint16_t lifetime = 0;
+    std::string url;
+};
+
+/*
+ * @struct ServiceRegistration
+ *
+ * SLP Message structure for Service Registration.
+ */
+struct ServiceRegistration
+{
+    URLEntry urlEntry;
+    std::string srvType;
+    std::string scopeList;
+    std::string attrList;
+};
+
+/*
+ * @struct ServiceDeregistration
+ *
+ * SLP Message structure for Service Deregistration.
+ */
+struct ServiceDeregistration
+{
+    std::string scopeList;
+    URLEntry urlEntry;
+    std::string tagList;
+};
+
+/*
+ * @struct DirectoryAgentAdvert
+ *
+ * SLP Message structure for DA Advertisement, heard by the service
+ * agent registering with the directory agents.
+ */
+struct DirectoryAgentAdvert
+{
+    uint16_t errorCode = 0;
+    uint32_t bootTimestamp = 0;
+    std::string url;
+    std::string scopeList;
+    std::string attrList;
+    std::string spiList;
+};
+
+/*
+ * @struct ServiceAcknowledgement
+ *
+ * SLP Message structure for Service Acknowledgement.
+ */
+struct ServiceAcknowledgement
+{
+    uint16_t errorCode = 0;
+};
 } // namespace request
 
 /*
@@ -60,8 +142,12 @@ enum class FunctionType : uint8_t
 {
     SRVRQST = 0x01,
     SRVRPLY = 0x02,
+    SRVREG = 0x03,
+    SRVDEREG = 0x04,
+    SRVACK = 0x05,
     ATTRRQST = 0x06,
     ATTRRPLY = 0x07,
+    DAADVERT = 0x08,
     SRVTYPERQST = 0x09,
     SRVTYPERPLY = 0x0A,
     SAADV = 0x0B,
@@ -109,13 +195,19 @@ struct Header
 /*
  * @struct Payload
  * This is a payload of the SLP Message currently
- * we are supporting two request.
+ * we are supporting two request, plus the registrations
+ * accepted in directory agent mode and the replies of the
+ * directory agents slpd registers with.
  *
  */
 struct Payload
 {
     request::ServiceType srvtyperqst;
     request::Service srvrqst;
+    request::ServiceRegistration srvreg;
+    request::ServiceDeregistration srvdereg;
+    request::DirectoryAgentAdvert daadvert;
+    request::ServiceAcknowledgement srvack;
 };
 
 /*
@@ -127,6 +219,8 @@ struct Message
 {
     Header header;
     Payload body;
+    /* The network namespace the request arrived in, see slp::netns */
+    size_t ns = 0;
 };
 
 namespace parser
@@ -182,6 +276,54 @@ int parseSrvTypeRqst(const buffer& buf, Message& req);
 
 int parseSrvRqst(const buffer& buf, Message& req);
 
+/** Parse a service registration.
+ *
+ * @param[in] buffer - The buffer from which data should be parsed.
+ *
+ * @return Zero on success,and fills the body object inside message.
+ *         non-zero on failure and empty msg object.
+ *
+ * @internal
+ */
+
+int parseSrvReg(const buffer& buf, Message& req);
+
+/** Parse a service deregistration.
+ *
+ * @param[in] buffer - The buffer from which data should be parsed.
+ *
+ * @return Zero on success,and fills the body object inside message.
+ *         non-zero on failure and empty msg object.
+ *
+ * @internal
+ */
+
+int parseSrvDeReg(const buffer& buf, Message& req);
+
+/** Parse a DA advertisement.
+ *
+ * @param[in] buffer - The buffer from which data should be parsed.
+ *
+ * @return Zero on success,and fills the body object inside message.
+ *         non-zero on failure and empty msg object.
+ *
+ * @internal
+ */
+
+int parseDAAdvert(const buffer& buf, Message& req);
+
+/** Parse a service acknowledgement.
+ *
+ * @param[in] buffer - The buffer from which data should be parsed.
+ *
+ * @return Zero on success,and fills the body object inside message.
+ *         non-zero on failure and empty msg object.
+ *
+ * @internal
+ */
+
+int parseSrvAck(const buffer& buf, Message& req);
+
 } // namespace internal
 } // namespace parser
 
@@ -209,10 +351,109 @@ std::tuple<int, buffer> processRequest(const Message& msg);
  */
 
 buffer processError(const Message& req, const uint8_t err);
+
+/** Serve a received datagram: parse it, process the request and turn
+ *  failures into error replies.
+ *
+ * @param[in] request - The datagram.
+ * @param[in] multicastDest - The datagram was sent to a multicast group.
+ * @param[out] resp - The reply.
+ * @param[out] multicast - The reply answers a multicast request.
+ * @param[in] ns - The network namespace the datagram arrived in.
+ *
+ * @return false if the request gets no reply
+ */
+bool serveRequest(const buffer& request, bool multicastDest, buffer& resp,
+                  bool& multicast, size_t ns = 0);
 namespace internal
 {
 
-using ServiceList = std::map<std::string, slp::ConfigData>;
+/** The services sorted by case folded name, several instances of one
+ *  service type are kept next to each other. */
+using ServiceList = std::vector<slp::ConfigData>;
+
+/*
+ * @struct AddressTable
+ *
+ * The interface addresses of one network namespace and the URL entries
+ * of the services on them, see slp::netns.
+ */
+struct AddressTable
+{
+    std::vector<std::string> addresses;
+    /* The same addresses sorted, to look up the previous responders */
+    std::vector<std::string> ownAddresses;
+    /* The URL entries of each service on every address */
+    std::vector<buffer> urlEntries;
+    /* The same URL entries with an authentication block, for each SPI
+     * there is a local key for */
+    std::map<std::string, std::vector<buffer>, std::less<>> signedEntries;
+
+    /** The signed URL entries for the first SPI of a comma separated
+     *  list there is a local key for, null if there is none. */
+    const std::vector<buffer>* signedURLEntries(std::string_view spiList) const;
+
+    /** Whether a previous responder list, comma separated, holds one
+     *  of the interface addresses. */
+    bool answeredBefore(std::string_view prList) const;
+};
+
+/*
+ * @struct ServiceRegistry
+ *
+ * The services offered, and for every network namespace served the
+ * interface addresses and the reply parts encoded from those. The
+ * services come from the compiled registry image when there is an up to
+ * date one, used in place, else from the service files, and are shared
+ * by all the namespaces. Builds with the builtin-services option use
+ * their compiled table instead. A registry is never modified once published.
+ */
+struct ServiceRegistry
+{
+    /* Read from the service files when there is no image */
+    ServiceList services;
+    slp::ServiceIndex index;
+    std::string serviceTypes;
+    buffer serviceTypesEntry;
+
+    /* The mapped registry image */
+    std::shared_ptr<const slp::RegistryImage> image;
+
+    /* The table compiled in, see slp::builtin */
+    const slp::builtin::Registry* builtin = nullptr;
+
+    /* Indexed by namespace, slpd's own first */
+    std::vector<AddressTable> tables;
+    /* When the signatures of the signed URL entries expire */
+    time_t authExpiry = 0;
+    /* Modification times of the service files and the image */
+    struct timespec mtime{};
+    struct timespec imageMtime{};
+    /* Counts the published registries, replies made from an older one
+     * are not served from the cache */
+    uint64_t generation = 0;
+
+    /** Number of services. */
+    size_t size() const;
+
+    /** Configured lifetime of the service at a position. */
+    uint16_t lifetime(size_t pos) const;
+
+    /** Positions of the services of an abstract or concrete type. */
+    std::span<const uint32_t> find(std::string_view type) const;
+
+    /** The service type list, as sent in the SrvTypeRply. */
+    std::string_view typeList() const;
+    std::span<const uint8_t> typeListEntry() const;
+
+    /** The address table of a namespace, slpd's own one for a namespace
+     *  that is not served. */
+    const AddressTable& table(size_t ns) const;
+};
+
+/** Read side handle on the published service registry. */
+using RegistryReader = slp::Snapshot<ServiceRegistry>::Reader;
+
 /** Handle the  SrvRequest message.
  *
  * @param[in] msg - The message to process
@@ -226,6 +467,19 @@ using ServiceList = std::map<std::string, slp::ConfigData>;
 
 std::tuple<int, buffer> processSrvRequest(const Message& msg);
 
+/** Prepare the reply to a SrvRequest message, the URL entries with the
+ *  configured lifetimes of their services, as the cache keeps it.
+ *
+ * @param[in] msg - The message to process
+ *
+ * @return In case of success, the reply and return code 0.
+ *         In case of error, nonzero code and an empty reply.
+ *
+ * @internal
+ */
+
+std::tuple<int, cache::Reply> prepareSrvReply(const Message& msg);
+
 /** Handle the  SrvTypeRequest message.
  *
  * @param[in] msg - The message to process
@@ -242,16 +496,110 @@ std::tuple<int, buffer> processSrvTypeRequest(const Message& msg);
 
 /**  Read the SLPinfo from the configuration.
  *
- * @param[in] filename - Name of the conf file
+ * @param[in] dirPath - The directory holding the service files
  *
  * @return the list of the services
  *
  * @internal
  *
  */
-ServiceList readSLPServiceInfo();
+ServiceList readSLPServiceInfo(const char* dirPath = slp::SERVICE_DIR);
+
+/**  Get the service registry.
+ *
+ * The registry is built on first use, later changes are picked up
+ * by reloadServiceRegistry. The registry stays valid as long as the
+ * returned reader lives, reloads in the meantime do not affect it.
+ *
+ * @return a reader on the current service registry
+ *
+ * @internal
+ *
+ */
+RegistryReader getServiceRegistry();
+
+/**  Rebuild the service registry if the service directory or the
+ *   interface addresses changed.
+ *
+ * The new registry is built aside and published in one step, request
+ * handling keeps using the previous one until then. Must not be called
+ * while holding a reader on the registry.
+ *
+ * @param[in] force - Rebuild even if nothing seems to have changed,
+ *                    files edited in place keep the directory mtime.
+ *
+ * @return true if a new registry was published
+ *
+ * @internal
+ *
+ */
+bool reloadServiceRegistry(bool force = false);
+
+/**  Build a service registry from a service list.
+ *
+ * @param[in] services - The services, sorted as readSLPServiceInfo
+ *                       returns them.
+ * @param[in] addresses - The interface addresses of slpd's own
+ *                        namespace to offer them on.
+ *
+ * @return the registry, ready to be published once the other
+ *         namespaces are added, see addAddressTable
+ *
+ * @internal
+ *
+ */
+std::unique_ptr<ServiceRegistry>
+    makeServiceRegistry(ServiceList services,
+                        std::vector<std::string> addresses);
+
+/**  Offer the services of a registry in one more network namespace.
+ *
+ * @param[in] registry - The registry, before it is published.
+ * @param[in] addresses - The interface addresses of the namespace.
+ *
+ * @internal
+ *
+ */
+void addAddressTable(ServiceRegistry& registry,
+                     std::vector<std::string> addresses);
 
-/**  Get all the interface address
+/**  The registrations of the services of a registry, one for each
+ *   service on every interface address of a namespace, as sent to the
+ *   directory agents.
+ *
+ * @param[in] registry - The registry.
+ * @param[in] ns - The network namespace.
+ *
+ * @return the registrations, in the DEFAULT scope.
+ *
+ * @internal
+ *
+ */
+std::vector<request::ServiceRegistration>
+    serviceRegistrations(const ServiceRegistry& registry, size_t ns);
+
+/**  Sign the URL entries of a registry with every local key, see
+ *   slp::auth::keys. Nothing is signed without keys or when slpd is
+ *   built without authentication.
+ *
+ * @param[in] registry - The registry, before it is published.
+ *
+ * @internal
+ *
+ */
+void signServiceRegistry(ServiceRegistry& registry);
+
+/**  Publish a service registry, requests are answered from it from now
+ *   on. Must not be called while holding a reader on the registry.
+ *
+ * @param[in] registry - The new registry.
+ *
+ * @internal
+ *
+ */
+void publishServiceRegistry(std::unique_ptr<ServiceRegistry> registry);
+
+/**  Get all the interface address of the current network namespace
  *
  * @return the list of the interface address.
  *
@@ -259,7 +607,7 @@ ServiceList readSLPServiceInfo();
  *
  */
 
-std::list<std::string> getIntfAddrs();
+std::vector<std::string> getIntfAddrs();
 
 /** Fill the buffer with the header data from the request object
  *
@@ -271,6 +619,16 @@ std::list<std::string> getIntfAddrs();
  */
 buffer prepareHeader(const Message& req);
 
+/** Get the function id of the reply to a request
+ *
+ * @param[in] functionID - Function id of the request
+ *
+ * @return the function id of the reply
+ *
+ * @internal
+ */
+uint8_t replyFunction(uint8_t functionID);
+
 } // namespace internal
 } // namespace handler
 } // namespace slp
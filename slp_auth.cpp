@@ -0,0 +1,197 @@
+#include "slp_auth.hpp"
+
+#include "endian.hpp"
+#include "slp_log.hpp"
+
+#include <dirent.h>
+#include <errno.h>
+#include <openssl/pem.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace slp
+{
+
+namespace auth
+{
+
+namespace
+{
+
+constexpr std::string_view KEY_SUFFIX = ".pem";
+
+void appendUint16(buffer& buff, uint16_t value)
+{
+    value = endian::to_network(value);
+    auto bytes = (const uint8_t*)&value;
+    buff.insert(buff.end(), bytes, bytes + sizeof(value));
+}
+
+void appendUint32(buffer& buff, uint32_t value)
+{
+    value = endian::to_network(value);
+    auto bytes = (const uint8_t*)&value;
+    buff.insert(buff.end(), bytes, bytes + sizeof(value));
+}
+
+void appendString(buffer& buff, std::string_view str)
+{
+    appendUint16(buff, str.size());
+    buff.insert(buff.end(), str.begin(), str.end());
+}
+
+std::vector<Key>& localKeys()
+{
+    static std::vector<Key> keys;
+    return keys;
+}
+
+} // namespace
+
+std::tuple<int, Key> Key::load(const char* path, std::string spi)
+{
+    Key key;
+
+    slp::deleted_unique_ptr<FILE, fclose> file(fopen(path, "re"));
+    if (!file)
+    {
+        return std::make_tuple(-errno, std::move(key));
+    }
+
+    key.pkey.reset(
+        PEM_read_PrivateKey(file.get(), nullptr, nullptr, nullptr));
+    // RFC 2608 only defines DSA signatures
+    if (!key.pkey || EVP_PKEY_get_base_id(key.pkey.get()) != EVP_PKEY_DSA)
+    {
+        key.pkey.reset();
+        return std::make_tuple(-EINVAL, std::move(key));
+    }
+
+    key.name = std::move(spi);
+    return std::make_tuple(0, std::move(key));
+}
+
+std::tuple<int, buffer> Key::sign(std::span<const uint8_t> data) const
+{
+    buffer signature;
+    slp::deleted_unique_ptr<EVP_MD_CTX, EVP_MD_CTX_free> ctx(
+        EVP_MD_CTX_new());
+    size_t length = 0;
+
+    if (!pkey || !ctx ||
+        EVP_DigestSignInit(ctx.get(), nullptr, EVP_sha1(), nullptr,
+                           pkey.get()) != 1 ||
+        EVP_DigestSign(ctx.get(), nullptr, &length, data.data(),
+                       data.size()) != 1)
+    {
+        return std::make_tuple(-EIO, std::move(signature));
+    }
+
+    signature.resize(length);
+    if (EVP_DigestSign(ctx.get(), signature.data(), &length, data.data(),
+                       data.size()) != 1)
+    {
+        signature.clear();
+        return std::make_tuple(-EIO, std::move(signature));
+    }
+    signature.resize(length);
+    return std::make_tuple(0, std::move(signature));
+}
+
+std::vector<Key> loadKeys(const char* dirPath)
+{
+    std::vector<Key> keys;
+    slp::deleted_unique_ptr<DIR, closedir> dir(opendir(dirPath));
+    struct dirent* dent = nullptr;
+
+    if (!dir)
+    {
+        return keys;
+    }
+
+    while ((dent = readdir(dir.get())) != nullptr)
+    {
+        std::string_view name = dent->d_name;
+        if (dent->d_type != DT_REG || name.size() <= KEY_SUFFIX.size() ||
+            !name.ends_with(KEY_SUFFIX))
+        {
+            continue;
+        }
+
+        auto path = std::string(dirPath) + '/' + dent->d_name;
+        auto [rc, key] = Key::load(
+            path.c_str(),
+            std::string(name.substr(0, name.size() - KEY_SUFFIX.size())));
+        if (rc < 0)
+        {
+            SLP_LOG_ERROR("SLP unable to load the key %s: %s", path.c_str(),
+                          strerror(-rc));
+            continue;
+        }
+        keys.push_back(std::move(key));
+    }
+    return keys;
+}
+
+void setKeys(std::vector<Key> keys)
+{
+    localKeys() = std::move(keys);
+}
+
+const std::vector<Key>& keys()
+{
+    return localKeys();
+}
+
+buffer urlSignedData(std::string_view spi, std::string_view url,
+                     uint32_t timestamp)
+{
+    buffer data;
+    appendString(data, spi);
+    appendString(data, url);
+    appendUint32(data, timestamp);
+    return data;
+}
+
+std::tuple<int, buffer> urlAuthBlock(const Key& key, std::string_view url,
+                                     uint32_t timestamp)
+{
+    /*
+         Authentication Block
+          0                   1                   2                   3
+          0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+         |  Block Structure Descriptor   |  Authentication Block Length  |
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+         |                           Timestamp                           |
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+         |     SLP SPI String Length     |         SLP SPI String        \
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+         |              Structured Authentication Block ...              \
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    */
+
+    buffer block;
+    auto [rc, signature] =
+        key.sign(urlSignedData(key.spi(), url, timestamp));
+    if (rc < 0)
+    {
+        return std::make_tuple(rc, std::move(block));
+    }
+
+    size_t length = 2 + 2 + 4 + 2 + key.spi().size() + signature.size();
+    if (length > UINT16_MAX)
+    {
+        return std::make_tuple(-EMSGSIZE, std::move(block));
+    }
+
+    appendUint16(block, BSD_DSA_SHA1);
+    appendUint16(block, length);
+    appendUint32(block, timestamp);
+    appendString(block, key.spi());
+    block.insert(block.end(), signature.begin(), signature.end());
+    return std::make_tuple(0, std::move(block));
+}
+
+} // namespace auth
+} // namespace slp
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "slp.hpp"
+
+#include <openssl/evp.h>
+#include <stdint.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace slp
+{
+
+namespace auth
+{
+
+/** @brief Block Structure Descriptor of DSA with SHA-1, RFC 2608 9.2 */
+constexpr uint16_t BSD_DSA_SHA1 = 0x0002;
+
+/** @class Key
+ *
+ *  @brief A local private key and the SLP Security Parameter Index
+ *         naming it.
+ */
+class Key
+{
+  public:
+    /** @brief Load a PEM private key.
+     *
+     *  @param[in] path - The key file.
+     *  @param[in] spi - The SPI of the key.
+     *
+     *  @return Zero and the key on success, else -EINVAL when the file
+     *          holds no DSA private key or a negative errno.
+     */
+    static std::tuple<int, Key> load(const char* path, std::string spi);
+
+    const std::string& spi() const
+    {
+        return name;
+    }
+
+    /** @brief Sign data with the key, DER encoded DSA signature */
+    std::tuple<int, buffer> sign(std::span<const uint8_t> data) const;
+
+  private:
+    std::string name;
+    deleted_unique_ptr<EVP_PKEY, EVP_PKEY_free> pkey;
+};
+
+/** @brief Load the keys of a directory, each file <SPI>.pem holds the
+ *         private key of that SPI. Unusable files are logged and
+ *         skipped, a missing directory has no keys.
+ */
+std::vector<Key> loadKeys(const char* dirPath);
+
+/** @brief Make the keys the local keys used to sign replies */
+void setKeys(std::vector<Key> keys);
+
+/** @brief The local keys */
+const std::vector<Key>& keys();
+
+/** @brief Authentication block of a URL, RFC 2608 9.2.1.
+ *
+ *  @param[in] key - The key to sign with.
+ *  @param[in] url - The URL.
+ *  @param[in] timestamp - Seconds since the epoch at which the
+ *                         signature expires.
+ *
+ *  @return Zero and the block on success, else a negative errno.
+ */
+std::tuple<int, buffer> urlAuthBlock(const Key& key, std::string_view url,
+                                     uint32_t timestamp);
+
+/** @brief The data signed for a URL, exposed for verification */
+buffer urlSignedData(std::string_view spi, std::string_view url,
+                     uint32_t timestamp);
+
+} // namespace auth
+} // namespace slp
@@ -0,0 +1,348 @@
+#pragma once
+
+#include "slp_service_index.hpp"
+#include "slp_service_info.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace slp
+{
+
+/** Service tables compiled into slpd.
+ *
+ *  A firmware image whose services never change can build them in with
+ *  the builtin-services meson option. The compiler parses the service
+ *  lines, sorts them as the service files would be, lays out their URLs,
+ *  finds a perfect hash of their case folded types and encodes the
+ *  service type list of the SrvTypeRply; slpd then reads no service file
+ *  nor registry image at all.
+ */
+namespace builtin
+{
+
+/* A string in the pool */
+struct Ref
+{
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+struct Service
+{
+    Ref name;
+    /* The URL is urlPrefix, the address and urlSuffix */
+    Ref urlPrefix;
+    Ref urlSuffix;
+    uint16_t lifetime = 0;
+};
+
+/* A slot of the perfect hash, free when it has no matches */
+struct Slot
+{
+    Ref folded;
+    uint32_t firstMatch = 0;
+    uint32_t matchCount = 0;
+};
+
+/** @class Registry
+ *
+ *  @brief A compiled service table, a view on the arrays of a Table.
+ *
+ *  Every folded service type, and the abstract type of every concrete
+ *  one, has a slot of its own under the hash seeded with seed, so a
+ *  lookup hashes the type once and compares one key.
+ */
+class Registry
+{
+  public:
+    constexpr Registry(std::string_view strings,
+                       std::span<const Service> services,
+                       std::span<const Slot> slots,
+                       std::span<const uint32_t> matches, uint32_t seed,
+                       Ref typeList, Ref typeListEntry) :
+        strings(strings), services(services), slots(slots),
+        matches(matches), seed(seed), typeListRef(typeList),
+        typeListEntryRef(typeListEntry)
+    {}
+
+    /** @brief Seeded FNV-1a of a folded type */
+    static constexpr uint32_t hash(std::string_view folded, uint32_t seed)
+    {
+        uint32_t h = 0x811c9dc5 ^ seed;
+        for (char c : folded)
+        {
+            h = (h ^ static_cast<uint8_t>(c)) * 0x01000193;
+        }
+        return h ^ (h >> 16);
+    }
+
+    /** @brief Number of services */
+    constexpr size_t size() const
+    {
+        return services.size();
+    }
+
+    /** @brief A service of the table */
+    constexpr const Service& service(size_t pos) const
+    {
+        return services[pos];
+    }
+
+    /** @brief A string of the table */
+    constexpr std::string_view string(Ref ref) const
+    {
+        return strings.substr(ref.offset, ref.length);
+    }
+
+    /** @brief Find the services of a type.
+     *
+     *  @param[in] folded - The case folded service type.
+     *
+     *  @return the positions of the matching services, empty if none.
+     */
+    constexpr std::span<const uint32_t> find(std::string_view folded) const
+    {
+        const auto& slot = slots[hash(folded, seed) & (slots.size() - 1)];
+        if (slot.matchCount == 0 || string(slot.folded) != folded)
+        {
+            return {};
+        }
+        return matches.subspan(slot.firstMatch, slot.matchCount);
+    }
+
+    /** @brief The comma separated service type list */
+    constexpr std::string_view typeList() const
+    {
+        return string(typeListRef);
+    }
+
+    /** @brief The service type list as encoded in the SrvTypeRply */
+    std::span<const uint8_t> typeListEntry() const
+    {
+        auto entry = string(typeListEntryRef);
+        return {reinterpret_cast<const uint8_t*>(entry.data()), entry.size()};
+    }
+
+  private:
+    std::string_view strings;
+    std::span<const Service> services;
+    std::span<const Slot> slots;
+    std::span<const uint32_t> matches;
+    uint32_t seed;
+    Ref typeListRef;
+    Ref typeListEntryRef;
+};
+
+namespace internal
+{
+
+/* Seeds tried for a number of slots before it is doubled */
+constexpr uint32_t SEEDS = 64;
+
+/* A table laid out in growable containers, before its size is known */
+struct Build
+{
+    std::string strings;
+    std::vector<Service> services;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> matches;
+    uint32_t seed = 0;
+    Ref typeList;
+    Ref typeListEntry;
+};
+
+constexpr Ref addString(std::string& strings, std::string_view item)
+{
+    Ref ref{static_cast<uint32_t>(strings.size()),
+            static_cast<uint32_t>(item.size())};
+    strings.append(item);
+    return ref;
+}
+
+/* The service lines, separated by ';', as the service files read */
+constexpr std::vector<ConfigData> parseServices(std::string_view list)
+{
+    std::vector<ConfigData> services;
+
+    while (!list.empty())
+    {
+        auto end = list.find(';');
+        auto line = list.substr(0, end);
+        list.remove_prefix(end == std::string_view::npos ? list.size()
+                                                         : end + 1);
+        if (line.find_first_not_of(' ') == std::string_view::npos)
+        {
+            continue;
+        }
+
+        ConfigData service;
+        if (!service.parse(line))
+        {
+            // Fails the build, the line is not a service
+            throw std::invalid_argument("invalid builtin service");
+        }
+        service.name = "service:" + service.name;
+        services.push_back(std::move(service));
+    }
+    sortServices(services);
+    return services;
+}
+
+/* Pick the slots and the seed under which every key has a slot of its
+ * own, the keys hold the positions of their services */
+constexpr void placeKeys(
+    Build& table,
+    const std::vector<std::pair<std::string, std::vector<uint32_t>>>& keys)
+{
+    size_t size = 1;
+    while (size < keys.size() * 2)
+    {
+        size *= 2;
+    }
+
+    for (;; size *= 2)
+    {
+        for (uint32_t seed = 0; seed < SEEDS; seed++)
+        {
+            std::vector<uint8_t> used(size);
+            bool perfect = true;
+            for (const auto& [folded, positions] : keys)
+            {
+                auto& slot = used[Registry::hash(folded, seed) & (size - 1)];
+                perfect = perfect && !slot;
+                slot = 1;
+            }
+            if (!perfect)
+            {
+                continue;
+            }
+
+            table.seed = seed;
+            table.slots.resize(size);
+            for (const auto& [folded, positions] : keys)
+            {
+                auto& slot =
+                    table.slots[Registry::hash(folded, seed) & (size - 1)];
+                slot.folded = addString(table.strings, folded);
+                slot.firstMatch = table.matches.size();
+                slot.matchCount = positions.size();
+                table.matches.insert(table.matches.end(), positions.begin(),
+                                     positions.end());
+            }
+            return;
+        }
+    }
+}
+
+constexpr Build build(std::string_view list)
+{
+    auto services = parseServices(list);
+    Build table;
+
+    // Indexed as slp::ServiceIndex does, by folded and abstract type
+    std::vector<std::pair<std::string, std::vector<uint32_t>>> keys;
+    auto add = [&keys](std::string_view folded, uint32_t pos) {
+        auto key = std::ranges::find_if(
+            keys, [folded](const auto& key) { return key.first == folded; });
+        if (key == keys.end())
+        {
+            key = keys.insert(keys.end(), {std::string(folded), {}});
+        }
+        if (key->second.empty() || key->second.back() != pos)
+        {
+            key->second.push_back(pos);
+        }
+    };
+
+    for (uint32_t pos = 0; pos < services.size(); pos++)
+    {
+        const auto& svc = services[pos];
+        auto& service = table.services.emplace_back();
+        service.name = addString(table.strings, svc.name);
+        service.urlPrefix = addString(table.strings, svc.urlPrefix());
+        service.urlSuffix = addString(table.strings, svc.urlSuffix());
+        service.lifetime = svc.lifetime;
+
+        auto folded = fold(svc.name);
+        add(folded, pos);
+        auto abstract = abstractType(folded);
+        if (!abstract.empty())
+        {
+            add(abstract, pos);
+        }
+    }
+
+    // The SrvTypeRply carries the list after its 2 byte length
+    auto typeList = listServiceTypes(services);
+    table.typeList = addString(table.strings, typeList);
+    std::string entry{static_cast<char>(typeList.size() >> 8),
+                      static_cast<char>(typeList.size() & 0xff)};
+    table.typeListEntry = addString(table.strings, entry + typeList);
+
+    placeKeys(table, keys);
+    return table;
+}
+
+} // namespace internal
+
+/* The arrays of a compiled table, sized for it */
+template <size_t Strings, size_t Services, size_t Slots, size_t Matches>
+struct Table
+{
+    std::array<char, Strings> strings{};
+    std::array<Service, Services> services{};
+    std::array<Slot, Slots> slots{};
+    std::array<uint32_t, Matches> matches{};
+    uint32_t seed = 0;
+    Ref typeList;
+    Ref typeListEntry;
+
+    constexpr Registry registry() const
+    {
+        return Registry({strings.data(), strings.size()}, services, slots,
+                        matches, seed, typeList, typeListEntry);
+    }
+};
+
+/** @brief Compile a service list.
+ *
+ *  @param[in] source - A callable without captures returning the service
+ *                      lines, "ServiceName serviceType Port [Lifetime]"
+ *                      separated by ';'.
+ *
+ *  @return the table, a line that is not a service fails the build.
+ */
+template <typename Source>
+consteval auto compile(Source source)
+{
+    constexpr auto sizes = [] {
+        auto table = internal::build(Source{}());
+        return std::array<size_t, 4>{
+            table.strings.size(), table.services.size(), table.slots.size(),
+            table.matches.size()};
+    }();
+
+    auto built = internal::build(source());
+    Table<sizes[0], sizes[1], sizes[2], sizes[3]> table;
+    std::ranges::copy(built.strings, table.strings.begin());
+    std::ranges::copy(built.services, table.services.begin());
+    std::ranges::copy(built.slots, table.slots.begin());
+    std::ranges::copy(built.matches, table.matches.begin());
+    table.seed = built.seed;
+    table.typeList = built.typeList;
+    table.typeListEntry = built.typeListEntry;
+    return table;
+}
+
+} // namespace builtin
+} // namespace slp
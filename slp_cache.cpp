@@ -0,0 +1,148 @@
+#include "config.h"
+
+#include "slp_cache.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace slp
+{
+namespace cache
+{
+
+namespace
+{
+
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325;
+constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+/* The bytes of two requests are the same but for their XIDs */
+bool sameRequest(std::span<const uint8_t> a, std::span<const uint8_t> b)
+{
+    constexpr size_t xidEnd = slp::header::OFFSET_XID + slp::header::SIZE_XID;
+
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    if (a.size() < xidEnd)
+    {
+        return std::ranges::equal(a, b);
+    }
+    return memcmp(a.data(), b.data(), slp::header::OFFSET_XID) == 0 &&
+           memcmp(a.data() + xidEnd, b.data() + xidEnd, a.size() - xidEnd) ==
+               0;
+}
+
+} // namespace
+
+uint64_t ResponseCache::fingerprint(std::span<const uint8_t> request,
+                                    size_t ns, bool multicastDest)
+{
+    // FNV-1a, with the XID hashed as zeroes
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < request.size(); i++)
+    {
+        bool xid = i >= slp::header::OFFSET_XID &&
+                   i < slp::header::OFFSET_XID + slp::header::SIZE_XID;
+        hash = (hash ^ (xid ? 0 : request[i])) * FNV_PRIME;
+    }
+    hash = (hash ^ ns) * FNV_PRIME;
+    return (hash ^ (multicastDest ? 1 : 0)) * FNV_PRIME;
+}
+
+size_t ResponseCache::slot(uint64_t fingerprint) const
+{
+    // The pair an entry belongs to, a lone last entry pairs with itself
+    return (fingerprint % entries.size()) & ~size_t(1);
+}
+
+const Entry* ResponseCache::find(std::span<const uint8_t> request, size_t ns,
+                                 bool multicastDest, uint64_t generation)
+{
+    if (entries.empty())
+    {
+        return nullptr;
+    }
+
+    auto hash = fingerprint(request, ns, multicastDest);
+    size_t first = slot(hash);
+    size_t last = std::min(first + 2, entries.size());
+    for (size_t i = first; i < last; i++)
+    {
+        auto& entry = entries[i];
+        if (entry.generation == generation && entry.fingerprint == hash &&
+            entry.ns == ns && entry.multicastDest == multicastDest &&
+            sameRequest(std::span(entry.request).first(entry.requestLength),
+                        request))
+        {
+            entry.used = ++clock;
+            hitCount++;
+            return &entry;
+        }
+    }
+    missCount++;
+    return nullptr;
+}
+
+void ResponseCache::insert(std::span<const uint8_t> request, size_t ns,
+                           bool multicastDest, uint64_t generation,
+                           bool answered, bool multicast, const Reply& reply)
+{
+    if (entries.empty() || request.size() > slp::MAX_LEN ||
+        reply.message.size() > slp::MAX_LEN)
+    {
+        return;
+    }
+
+    auto hash = fingerprint(request, ns, multicastDest);
+    size_t first = slot(hash);
+    size_t last = std::min(first + 2, entries.size());
+
+    // A reply made from an older registry is as good as a free entry
+    auto age = [generation](const Entry& entry) {
+        return entry.generation == generation ? entry.used : 0;
+    };
+    auto* entry = &entries[first];
+    for (size_t i = first + 1; i < last; i++)
+    {
+        if (age(entries[i]) < age(*entry))
+        {
+            entry = &entries[i];
+        }
+    }
+
+    entry->fingerprint = hash;
+    entry->generation = generation;
+    entry->used = ++clock;
+    entry->ns = ns;
+    entry->until = reply.until;
+    entry->multicastDest = multicastDest;
+    entry->answered = answered;
+    entry->multicast = multicast;
+    entry->requestLength = request.size();
+    std::ranges::copy(request, entry->request.begin());
+    entry->replyLength = answered ? reply.message.size() : 0;
+    std::ranges::copy(std::span(reply.message).first(entry->replyLength),
+                      entry->reply.begin());
+    entry->urlEntries = answered ? reply.urlEntries : 0;
+}
+
+size_t ResponseCache::size() const
+{
+    return std::ranges::count_if(entries, [](const Entry& entry) {
+        return entry.generation != 0;
+    });
+}
+
+ResponseCache& responses()
+{
+    // Allocated with the first request rather than held in .bss
+    static std::vector<Entry> storage(RESPONSE_CACHE);
+    static ResponseCache cache(storage);
+    return cache;
+}
+
+} // namespace cache
+} // namespace slp
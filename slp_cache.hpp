@@ -0,0 +1,163 @@
+#pragma once
+
+#include "slp_meta.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace slp
+{
+namespace cache
+{
+
+/** A reply as the cache keeps it.
+ *
+ *  The URL entries carry the configured lifetimes of their services,
+ *  the advertised ones are only set when the reply is sent, see
+ *  slp::lifetime.
+ */
+struct Reply
+{
+    std::vector<uint8_t> message;
+    /* Offset of the URL entries in the message, 0 when there are none */
+    size_t urlEntries = 0;
+    /* When the URL entries stop being valid, 0 if they do not */
+    time_t until = 0;
+};
+
+/* The outcome of a request, kept in place so that neither storing nor
+ * finding it allocates */
+struct Entry
+{
+    uint64_t fingerprint = 0;
+    /* Registry generation the reply was made from, 0 when free */
+    uint64_t generation = 0;
+    /* Last use, of the two candidate entries the older one is replaced */
+    uint64_t used = 0;
+    size_t ns = 0;
+    time_t until = 0;
+    bool multicastDest = false;
+    /* Whether the request gets a reply, and if it answers a multicast */
+    bool answered = false;
+    bool multicast = false;
+    uint8_t requestLength = 0;
+    uint8_t replyLength = 0;
+    uint8_t urlEntries = 0;
+    std::array<uint8_t, slp::MAX_LEN> request{};
+    std::array<uint8_t, slp::MAX_LEN> reply{};
+
+    std::span<const uint8_t> message() const
+    {
+        return std::span(reply).first(replyLength);
+    }
+};
+
+/** @class ResponseCache
+ *
+ *  @brief Replies of the requests seen before, by request fingerprint.
+ *
+ *  Most queries repeat byte for byte apart from their XID, so a request
+ *  is looked up by a hash of its bytes with the XID masked out, along
+ *  with the namespace it arrived in and whether it was multicast. A hit
+ *  is compared in full, then answered without being parsed. Every
+ *  reply is tagged with the generation of the registry it was made
+ *  from, a registry reload, be it for the services or the interface
+ *  addresses, leaves the older replies to be replaced.
+ *
+ *  A request hashes to two neighbouring entries, the least recently
+ *  used of which is replaced.
+ */
+class ResponseCache
+{
+  public:
+    /** @brief Constructor
+     *
+     *  @param[in] storage - The entries, none disables the cache.
+     */
+    constexpr explicit ResponseCache(std::span<Entry> storage) :
+        entries(storage)
+    {}
+
+    /** @brief Hash of a request, its XID left out.
+     *
+     *  @param[in] request - The datagram.
+     *  @param[in] ns - The network namespace it arrived in.
+     *  @param[in] multicastDest - It was sent to a multicast group.
+     */
+    static uint64_t fingerprint(std::span<const uint8_t> request, size_t ns,
+                                bool multicastDest);
+
+    /** @brief Find the outcome of a request.
+     *
+     *  @param[in] request - The datagram, at most slp::MAX_LEN bytes.
+     *  @param[in] ns - The network namespace it arrived in.
+     *  @param[in] multicastDest - It was sent to a multicast group.
+     *  @param[in] generation - The generation of the current registry.
+     *
+     *  @return the entry, null on a miss.
+     */
+    const Entry* find(std::span<const uint8_t> request, size_t ns,
+                      bool multicastDest, uint64_t generation);
+
+    /** @brief Keep the outcome of a request.
+     *
+     *  @param[in] request - The datagram, at most slp::MAX_LEN bytes.
+     *  @param[in] ns - The network namespace it arrived in.
+     *  @param[in] multicastDest - It was sent to a multicast group.
+     *  @param[in] generation - The generation of the registry the reply
+     *                          was made from.
+     *  @param[in] answered - Whether the request gets a reply.
+     *  @param[in] multicast - The reply answers a multicast request.
+     *  @param[in] reply - The reply, if answered.
+     */
+    void insert(std::span<const uint8_t> request, size_t ns,
+                bool multicastDest, uint64_t generation, bool answered,
+                bool multicast, const Reply& reply);
+
+    /** @brief Number of entries */
+    size_t capacity() const
+    {
+        return entries.size();
+    }
+
+    /** @brief Number of entries holding a reply */
+    size_t size() const;
+
+    /** @brief Memory taken by the entries, in bytes */
+    size_t bytes() const
+    {
+        return entries.size_bytes();
+    }
+
+    /** @brief Number of requests answered from the cache */
+    uint64_t hits() const
+    {
+        return hitCount;
+    }
+
+    /** @brief Number of requests looked up in vain */
+    uint64_t misses() const
+    {
+        return missCount;
+    }
+
+  private:
+    /** @brief The first of the two entries a fingerprint maps to */
+    size_t slot(uint64_t fingerprint) const;
+
+    std::span<Entry> entries;
+    uint64_t clock = 0;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+/** @brief The cache of the served replies, RESPONSE_CACHE entries */
+ResponseCache& responses();
+
+} // namespace cache
+} // namespace slp
@@ -0,0 +1,653 @@
+#include "slp_da.hpp"
+
+#include "endian.hpp"
+#include "slp_log.hpp"
+#include "slp_meta.hpp"
+#include "slp_service_index.hpp"
+#include "slp_text.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+
+namespace slp
+{
+namespace da
+{
+
+namespace
+{
+
+constexpr auto DA_SERVICE_TYPE = "service:directory-agent";
+
+/* The naming authority of "service:printer.acme:lpr" is "acme" */
+std::string_view namingAuthority(std::string_view type)
+{
+    auto abstract = abstractType(type);
+    if (abstract.empty())
+    {
+        abstract = type;
+    }
+
+    auto dot = abstract.rfind('.');
+    if (dot == std::string_view::npos)
+    {
+        return {};
+    }
+    return abstract.substr(dot + 1);
+}
+
+std::string bucketKey(std::string_view scope, std::string_view type)
+{
+    std::string key(scope);
+    key += '\0';
+    key += type;
+    return key;
+}
+
+/* Split an attribute list, commas inside a value list do not count */
+std::vector<std::string_view> splitAttrs(std::string_view attrList)
+{
+    std::vector<std::string_view> attrs;
+    size_t start = 0;
+    int depth = 0;
+
+    for (size_t i = 0; i < attrList.size(); i++)
+    {
+        if (attrList[i] == '(')
+        {
+            depth++;
+        }
+        else if (attrList[i] == ')' && depth > 0)
+        {
+            depth--;
+        }
+        else if (attrList[i] == ',' && depth == 0)
+        {
+            attrs.emplace_back(attrList.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    if (start < attrList.size())
+    {
+        attrs.emplace_back(attrList.substr(start));
+    }
+    return attrs;
+}
+
+/* Tag of "(tag=value)" or of the keyword "tag" */
+std::string attrTag(std::string_view attr)
+{
+    if (attr.starts_with('('))
+    {
+        attr.remove_prefix(1);
+        attr = attr.substr(0, attr.find_first_of("=)"));
+    }
+    return fold(attr);
+}
+
+/* Drop the attributes with any of the given tags from the list */
+std::string removeTags(std::string_view attrList,
+                       const std::vector<std::string>& tags)
+{
+    std::string result;
+    for (auto attr : splitAttrs(attrList))
+    {
+        if (std::find(tags.begin(), tags.end(), attrTag(attr)) != tags.end())
+        {
+            continue;
+        }
+        if (!result.empty())
+        {
+            result += ',';
+        }
+        result += attr;
+    }
+    return result;
+}
+
+std::vector<std::string> attrTags(std::string_view attrList)
+{
+    std::vector<std::string> tags;
+    for (auto attr : splitAttrs(attrList))
+    {
+        tags.emplace_back(attrTag(attr));
+    }
+    return tags;
+}
+
+void appendUint16(buffer& buff, uint16_t value)
+{
+    value = endian::to_network(value);
+    auto bytes = (const uint8_t*)&value;
+    buff.insert(buff.end(), bytes, bytes + sizeof(value));
+}
+
+void appendUint32(buffer& buff, uint32_t value)
+{
+    value = endian::to_network(value);
+    auto bytes = (const uint8_t*)&value;
+    buff.insert(buff.end(), bytes, bytes + sizeof(value));
+}
+
+void appendString(buffer& buff, std::string_view str)
+{
+    appendUint16(buff, str.size());
+    buff.insert(buff.end(), str.begin(), str.end());
+}
+
+void setLength(buffer& buff)
+{
+    uint8_t length = buff.size();
+    std::copy_n(&length, slp::header::SIZE_LENGTH,
+                buff.data() + slp::header::OFFSET_LENGTH);
+}
+
+void setOverflow(buffer& buff)
+{
+    uint16_t flags;
+    std::copy_n(buff.data() + slp::header::OFFSET_FLAGS,
+                slp::header::SIZE_FLAGS, (uint8_t*)&flags);
+    flags = endian::to_network(static_cast<uint16_t>(
+        endian::from_network(flags) | slp::header::FLAG_OVERFLOW));
+    std::copy_n((uint8_t*)&flags, slp::header::SIZE_FLAGS,
+                buff.data() + slp::header::OFFSET_FLAGS);
+}
+
+bool daEnabled = false;
+uint32_t bootTimestamp = 0;
+
+} // namespace
+
+RegistrationStore::RegistrationStore(std::string_view scopeList,
+                                     uint64_t now) :
+    scopeList(scopeList), served(slp::text::splitScopes(scopeList)),
+    wheel(now)
+{}
+
+bool RegistrationStore::supported(const std::vector<std::string>& scopes) const
+{
+    return std::all_of(scopes.begin(), scopes.end(), [this](const auto& s) {
+        return std::find(served.begin(), served.end(), s) != served.end();
+    });
+}
+
+void RegistrationStore::index(uint32_t id)
+{
+    auto& slot = slots[id];
+    auto type = fold(slot.reg.srvType);
+    auto abstract = abstractType(type);
+
+    for (const auto& scope : slot.scopes)
+    {
+        for (auto key : {std::string_view(type), abstract})
+        {
+            if (key.empty())
+            {
+                continue;
+            }
+            auto& entry = *buckets.try_emplace(bucketKey(scope, key)).first;
+            slot.memberOf.emplace_back(&entry, entry.second.size());
+            entry.second.push_back(id);
+        }
+        types[scope][type]++;
+    }
+}
+
+void RegistrationStore::unindex(uint32_t id)
+{
+    auto& slot = slots[id];
+
+    for (auto [entry, pos] : slot.memberOf)
+    {
+        // Move the last one into the hole and tell it where it went, a
+        // slot is in a bucket once so an emptied one can go
+        auto& bucket = entry->second;
+        uint32_t last = bucket.back();
+        bucket.pop_back();
+        if (bucket.empty())
+        {
+            buckets.erase(entry->first);
+            continue;
+        }
+        if (last == id)
+        {
+            continue;
+        }
+        bucket[pos] = last;
+        for (auto& member : slots[last].memberOf)
+        {
+            if (member.first == entry)
+            {
+                member.second = pos;
+                break;
+            }
+        }
+    }
+    slot.memberOf.clear();
+
+    auto type = fold(slot.reg.srvType);
+    for (const auto& scope : slot.scopes)
+    {
+        auto& counts = types[scope];
+        auto it = counts.find(type);
+        if (it != counts.end() && --it->second == 0)
+        {
+            counts.erase(it);
+        }
+    }
+}
+
+void RegistrationStore::release(uint32_t id)
+{
+    auto& slot = slots[id];
+
+    unindex(id);
+    wheel.cancel(id);
+    byUrl.erase(slot.reg.url);
+    slot = Slot{};
+    freeSlots.push_back(id);
+}
+
+int RegistrationStore::add(const request::ServiceRegistration& reg,
+                           bool fresh, uint64_t now)
+{
+    if (reg.urlEntry.url.empty() || reg.urlEntry.lifetime == 0 ||
+        reg.srvType.empty())
+    {
+        return (int)slp::Error::INVALID_REGISTRATION;
+    }
+
+    auto scopes = slp::text::splitScopes(reg.scopeList);
+    if (!supported(scopes))
+    {
+        return (int)slp::Error::SCOPE_NOT_SUPPORTED;
+    }
+
+    expire(now);
+
+    uint64_t expiry = now + reg.urlEntry.lifetime;
+    auto it = byUrl.find(reg.urlEntry.url);
+
+    // An incremental registration only updates attributes and lifetime
+    if (!fresh)
+    {
+        if (it == byUrl.end())
+        {
+            return (int)slp::Error::INVALID_UPDATE;
+        }
+
+        auto& slot = slots[it->second];
+        if (fold(slot.reg.srvType) != fold(reg.srvType) ||
+            slot.scopes != scopes)
+        {
+            return (int)slp::Error::INVALID_UPDATE;
+        }
+
+        auto attrs = removeTags(slot.reg.attrList, attrTags(reg.attrList));
+        if (!attrs.empty() && !reg.attrList.empty())
+        {
+            attrs += ',';
+        }
+        attrs += reg.attrList;
+        slot.reg.attrList = std::move(attrs);
+        slot.reg.expiry = expiry;
+        wheel.schedule(it->second, expiry);
+        return slp::SUCCESS;
+    }
+
+    uint32_t id;
+    if (it != byUrl.end())
+    {
+        id = it->second;
+        unindex(id);
+    }
+    else
+    {
+        if (freeSlots.empty())
+        {
+            id = slots.size();
+            slots.emplace_back();
+        }
+        else
+        {
+            id = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        byUrl.emplace(reg.urlEntry.url, id);
+    }
+
+    auto& slot = slots[id];
+    slot.reg.url = reg.urlEntry.url;
+    slot.reg.srvType = reg.srvType;
+    slot.reg.scopeList = reg.scopeList;
+    slot.reg.attrList = reg.attrList;
+    slot.reg.expiry = expiry;
+    slot.scopes = std::move(scopes);
+
+    index(id);
+    wheel.schedule(id, expiry);
+    return slp::SUCCESS;
+}
+
+int RegistrationStore::remove(const request::ServiceDeregistration& dereg)
+{
+    auto it = byUrl.find(dereg.urlEntry.url);
+    if (it == byUrl.end())
+    {
+        return (int)slp::Error::INVALID_REGISTRATION;
+    }
+
+    uint32_t id = it->second;
+    auto& slot = slots[id];
+    if (slp::text::splitScopes(dereg.scopeList) != slot.scopes)
+    {
+        return (int)slp::Error::SCOPE_NOT_SUPPORTED;
+    }
+
+    if (!dereg.tagList.empty())
+    {
+        slot.reg.attrList = removeTags(slot.reg.attrList,
+                                       attrTags(dereg.tagList));
+        return slp::SUCCESS;
+    }
+
+    release(id);
+    return slp::SUCCESS;
+}
+
+void RegistrationStore::expire(uint64_t now)
+{
+    wheel.advance(now, [this](uint32_t id) { release(id); });
+}
+
+int RegistrationStore::find(std::string_view srvType,
+                            std::string_view scopeList,
+                            std::vector<const Registration*>& found) const
+{
+    auto scopes = slp::text::splitScopes(scopeList);
+    auto type = fold(srvType);
+    size_t searched = 0;
+
+    found.clear();
+    for (const auto& scope : scopes)
+    {
+        if (std::find(served.begin(), served.end(), scope) == served.end())
+        {
+            continue;
+        }
+        searched++;
+
+        auto it = buckets.find(bucketKey(scope, type));
+        if (it == buckets.end())
+        {
+            continue;
+        }
+        for (auto id : it->second)
+        {
+            found.push_back(&slots[id].reg);
+        }
+    }
+
+    if (searched == 0)
+    {
+        return (int)slp::Error::SCOPE_NOT_SUPPORTED;
+    }
+
+    // A registration in several of the requested scopes shows up once
+    if (searched > 1)
+    {
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+    }
+    return slp::SUCCESS;
+}
+
+int RegistrationStore::findTypes(std::string_view namingAuth,
+                                 std::string_view scopeList,
+                                 std::vector<std::string>& found) const
+{
+    auto scopes = slp::text::splitScopes(scopeList);
+    auto authority = fold(namingAuth);
+    size_t searched = 0;
+
+    found.clear();
+    for (const auto& scope : scopes)
+    {
+        if (std::find(served.begin(), served.end(), scope) == served.end())
+        {
+            continue;
+        }
+        searched++;
+
+        auto it = types.find(scope);
+        if (it == types.end())
+        {
+            continue;
+        }
+        for (const auto& [type, count] : it->second)
+        {
+            if (authority.empty() || namingAuthority(type) == authority)
+            {
+                found.push_back(type);
+            }
+        }
+    }
+
+    if (searched == 0)
+    {
+        return (int)slp::Error::SCOPE_NOT_SUPPORTED;
+    }
+
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    return slp::SUCCESS;
+}
+
+void enable(std::string_view scopeList)
+{
+    store() = RegistrationStore(scopeList, now());
+    bootTimestamp = time(nullptr);
+    daEnabled = true;
+}
+
+bool enabled()
+{
+    return daEnabled;
+}
+
+RegistrationStore& store()
+{
+    static RegistrationStore registrations;
+    return registrations;
+}
+
+uint64_t now()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+std::tuple<int, buffer> processSrvReg(const Message& req)
+{
+    buffer buff;
+
+    int rc = store().add(req.body.srvreg,
+                         req.header.flags & slp::header::FLAG_FRESH, now());
+    if (rc)
+    {
+        SLP_LOG_ERROR("SLP unable to register url=%s error=%d",
+                      req.body.srvreg.urlEntry.url.c_str(), rc);
+        return std::make_tuple(rc, buff);
+    }
+
+    // The SrvAck is just the header and a zero error code
+    buff = slp::handler::internal::prepareHeader(req);
+    return std::make_tuple(slp::SUCCESS, std::move(buff));
+}
+
+std::tuple<int, buffer> processSrvDeReg(const Message& req)
+{
+    buffer buff;
+
+    store().expire(now());
+    int rc = store().remove(req.body.srvdereg);
+    if (rc)
+    {
+        SLP_LOG_ERROR("SLP unable to deregister url=%s error=%d",
+                      req.body.srvdereg.urlEntry.url.c_str(), rc);
+        return std::make_tuple(rc, buff);
+    }
+
+    buff = slp::handler::internal::prepareHeader(req);
+    return std::make_tuple(slp::SUCCESS, std::move(buff));
+}
+
+std::tuple<int, buffer> processSrvRequest(const Message& req)
+{
+    buffer buff;
+    auto current = now();
+
+    if (fold(req.body.srvrqst.srvType) == DA_SERVICE_TYPE)
+    {
+        return std::make_tuple(slp::SUCCESS, prepareDAAdvert(req));
+    }
+
+    store().expire(current);
+
+    std::vector<const RegistrationStore::Registration*> found;
+    int rc = store().find(req.body.srvrqst.srvType,
+                          req.body.srvrqst.scopeList, found);
+    if (rc)
+    {
+        return std::make_tuple(rc, buff);
+    }
+
+    // Multicast requests nothing matched are not answered
+    if (found.empty() && (req.header.flags & slp::header::FLAG_MCAST))
+    {
+        return std::make_tuple((int)slp::Error::INTERNAL_ERROR, buff);
+    }
+
+    buff = slp::handler::internal::prepareHeader(req);
+    auto countPos = buff.size();
+    appendUint16(buff, 0);
+
+    uint16_t urlCount = 0;
+    for (const auto* reg : found)
+    {
+        if (buff.size() + slp::response::SIZE_URL_ENTRY + reg->url.size() >
+            slp::MAX_LEN)
+        {
+            setOverflow(buff);
+            break;
+        }
+
+        uint16_t lifetime =
+            std::min<uint64_t>(reg->expiry - current, UINT16_MAX);
+        buff.push_back(0); // reserved
+        appendUint16(buff, lifetime);
+        appendString(buff, reg->url);
+        buff.push_back(0); // no URL auth blocks
+        urlCount++;
+    }
+
+    urlCount = endian::to_network(urlCount);
+    std::copy_n((uint8_t*)&urlCount, slp::response::SIZE_URL_COUNT,
+                buff.data() + countPos);
+    setLength(buff);
+
+    return std::make_tuple(slp::SUCCESS, std::move(buff));
+}
+
+std::tuple<int, buffer> processSrvTypeRequest(const Message& req)
+{
+    buffer buff;
+
+    store().expire(now());
+
+    std::vector<std::string> types;
+    int rc = store().findTypes(req.body.srvtyperqst.namingAuth,
+                               req.body.srvtyperqst.scopeList, types);
+    if (rc)
+    {
+        return std::make_tuple(rc, buff);
+    }
+
+    buff = slp::handler::internal::prepareHeader(req);
+
+    bool overflow = false;
+    std::string typeList;
+    for (const auto& type : types)
+    {
+        if (buff.size() + slp::response::SIZE_SERVICE + typeList.size() +
+                type.size() + 1 >
+            slp::MAX_LEN)
+        {
+            overflow = true;
+            break;
+        }
+        if (!typeList.empty())
+        {
+            typeList += ',';
+        }
+        typeList += type;
+    }
+
+    appendString(buff, typeList);
+    if (overflow)
+    {
+        setOverflow(buff);
+    }
+    setLength(buff);
+
+    return std::make_tuple(slp::SUCCESS, std::move(buff));
+}
+
+buffer prepareDAAdvert(const Message& req)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |        Service Location header (function = DAAdvert = 8)      |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |          Error Code           |  DA Stateless Boot Timestamp  |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |DA Stateless Boot Time,, contd.|         Length of URL         |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       \                              URL                              \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |     Length of <scope-list>    |         <scope-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |     Length of <attr-list>     |          <attr-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |    Length of <SLP SPI List>   |     <SLP SPI List> String     \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       | # Auth Blocks |         Authentication block (if any)         \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    buffer buff = slp::handler::internal::prepareHeader(req);
+    buff[slp::header::OFFSET_FUNCTION] =
+        static_cast<uint8_t>(slp::FunctionType::DAADVERT);
+
+    std::string url = std::string(DA_SERVICE_TYPE) + "://";
+    auto addrs = slp::handler::internal::getIntfAddrs();
+    if (!addrs.empty())
+    {
+        url += addrs.front();
+    }
+
+    appendUint32(buff, bootTimestamp);
+    appendString(buff, url);
+    appendString(buff, store().scopes());
+    appendString(buff, "");  // attr-list
+    appendString(buff, "");  // SLP SPI list
+    buff.push_back(0);       // no auth blocks
+    setLength(buff);
+
+    return buff;
+}
+
+} // namespace da
+} // namespace slp
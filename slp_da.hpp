@@ -0,0 +1,214 @@
+#pragma once
+
+#include "slp.hpp"
+#include "slp_timer_wheel.hpp"
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace slp
+{
+namespace da
+{
+
+/** @class RegistrationStore
+ *
+ *  @brief Registrations accepted by the directory agent.
+ *
+ *  Registrations are kept in a slot vector keyed by URL and indexed by
+ *  scope and service type, both case folded. Concrete types are also
+ *  indexed under their abstract type so that "service:printer" finds
+ *  "service:printer:lpr". Lifetimes are tracked with a timer wheel
+ *  ticking in seconds, so neither lookups nor expiry walk the whole
+ *  store.
+ */
+class RegistrationStore
+{
+  public:
+    struct Registration
+    {
+        std::string url;
+        std::string srvType;
+        std::string scopeList;
+        std::string attrList;
+        uint64_t expiry = 0;
+    };
+
+    /** @brief Constructor
+     *
+     *  @param[in] scopeList - Scopes served by the directory agent.
+     *  @param[in] now - Current time in seconds.
+     */
+    explicit RegistrationStore(std::string_view scopeList = "DEFAULT",
+                               uint64_t now = 0);
+
+    /** @brief Add or update a registration.
+     *
+     *  @param[in] reg - The registration.
+     *  @param[in] fresh - The FRESH flag, unset for an incremental update.
+     *  @param[in] now - Current time in seconds.
+     *
+     *  @return Zero on success, else the SLP error code.
+     */
+    int add(const request::ServiceRegistration& reg, bool fresh,
+            uint64_t now);
+
+    /** @brief Remove a registration, or some of its attributes.
+     *
+     *  @param[in] dereg - The deregistration, a non empty tag list
+     *                     only removes those attributes.
+     *
+     *  @return Zero on success, else the SLP error code.
+     */
+    int remove(const request::ServiceDeregistration& dereg);
+
+    /** @brief Drop the registrations whose lifetime has passed.
+     *
+     *  @param[in] now - Current time in seconds.
+     */
+    void expire(uint64_t now);
+
+    /** @brief Find the registrations of a service type.
+     *
+     *  @param[in] srvType - Abstract or concrete service type.
+     *  @param[in] scopeList - Scopes to look in, empty for DEFAULT.
+     *  @param[out] found - Matching registrations, each listed once.
+     *
+     *  @return Zero on success, else the SLP error code.
+     */
+    int find(std::string_view srvType, std::string_view scopeList,
+             std::vector<const Registration*>& found) const;
+
+    /** @brief Find the registered service types.
+     *
+     *  @param[in] namingAuth - Naming authority, empty for all of them.
+     *  @param[in] scopeList - Scopes to look in, empty for DEFAULT.
+     *  @param[out] types - The case folded service types, sorted.
+     *
+     *  @return Zero on success, else the SLP error code.
+     */
+    int findTypes(std::string_view namingAuth, std::string_view scopeList,
+                  std::vector<std::string>& types) const;
+
+    /** @brief Scopes served by the directory agent */
+    const std::string& scopes() const
+    {
+        return scopeList;
+    }
+
+    /** @brief Number of registrations */
+    size_t size() const
+    {
+        return byUrl.size();
+    }
+
+    /** @brief Number of index buckets */
+    size_t bucketCount() const
+    {
+        return buckets.size();
+    }
+
+  private:
+    using Bucket = std::vector<uint32_t>;
+    /* Keyed by scope and service type separated by a NUL */
+    using Buckets = std::unordered_map<std::string, Bucket>;
+
+    struct Slot
+    {
+        Registration reg;
+        /* Index buckets holding this slot and the position in each */
+        std::vector<std::pair<Buckets::value_type*, uint32_t>> memberOf;
+        std::vector<std::string> scopes;
+    };
+
+    /** @brief Check that all the scopes are served here */
+    bool supported(const std::vector<std::string>& scopes) const;
+
+    void index(uint32_t id);
+    void unindex(uint32_t id);
+    void release(uint32_t id);
+
+    std::string scopeList;
+    std::vector<std::string> served;
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<std::string, uint32_t> byUrl;
+
+    Buckets buckets;
+    /* Reference counted concrete service types of each scope */
+    std::unordered_map<std::string, std::map<std::string, uint32_t>> types;
+
+    TimerWheel wheel;
+};
+
+/** Turn on directory agent mode.
+ *
+ * @param[in] scopeList - Scopes served by the directory agent.
+ */
+void enable(std::string_view scopeList);
+
+/** Check if directory agent mode is on. */
+bool enabled();
+
+/** The registrations of the directory agent. */
+RegistrationStore& store();
+
+/** Current time in seconds on the clock the store runs on. */
+uint64_t now();
+
+/** Handle the SrvReg message.
+ *
+ * @param[in] req - The message to process.
+ *
+ * @return In case of success, the vector is populated with the SrvAck
+ *         and return code is 0.
+ *         In case of error, nonzero code and vector is set to size 0.
+ */
+std::tuple<int, buffer> processSrvReg(const Message& req);
+
+/** Handle the SrvDeReg message.
+ *
+ * @param[in] req - The message to process.
+ *
+ * @return In case of success, the vector is populated with the SrvAck
+ *         and return code is 0.
+ *         In case of error, nonzero code and vector is set to size 0.
+ */
+std::tuple<int, buffer> processSrvDeReg(const Message& req);
+
+/** Handle the SrvRqst message from the registrations.
+ *
+ * @param[in] req - The message to process.
+ *
+ * @return In case of success, the vector is populated with the reply
+ *         and return code is 0.
+ *         In case of error, nonzero code and vector is set to size 0.
+ */
+std::tuple<int, buffer> processSrvRequest(const Message& req);
+
+/** Handle the SrvTypeRqst message from the registrations.
+ *
+ * @param[in] req - The message to process.
+ *
+ * @return In case of success, the vector is populated with the reply
+ *         and return code is 0.
+ *         In case of error, nonzero code and vector is set to size 0.
+ */
+std::tuple<int, buffer> processSrvTypeRequest(const Message& req);
+
+/** Build a DAAdvert.
+ *
+ * @param[in] req - The request being answered, for unsolicited adverts
+ *                  a message with just the version set.
+ *
+ * @return the vector populated with the DAAdvert.
+ */
+buffer prepareDAAdvert(const Message& req);
+
+} // namespace da
+} // namespace slp
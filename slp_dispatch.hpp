@@ -0,0 +1,38 @@
+#pragma once
+
+#include "slp.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+namespace slp
+{
+
+/** Dispatch of the messages by function id.
+ *
+ *  The parser and the handler each keep a constexpr table of what they
+ *  do for every message type, indexed by function id. A lookup is a
+ *  bounds check and an index, whatever the number of types, and adding
+ *  a type is an entry in each table. Ids without an entry, and those
+ *  past the table, are not supported.
+ */
+namespace dispatch
+{
+
+/** @brief Number of function ids, RFC 2608 defines 1 to 11 */
+constexpr size_t FUNCTIONS = (size_t)slp::FunctionType::SAADV + 1;
+
+template <typename Entry>
+using Table = std::array<Entry, FUNCTIONS>;
+
+/** @brief The entry of a function id, null past the table */
+template <typename Entry>
+constexpr const Entry* find(const Table<Entry>& table, uint8_t functionID)
+{
+    return functionID < table.size() ? &table[functionID] : nullptr;
+}
+
+} // namespace dispatch
+} // namespace slp
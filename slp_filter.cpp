@@ -0,0 +1,261 @@
+#include "slp_filter.hpp"
+
+#include "slp.hpp"
+#include "slp_meta.hpp"
+
+#include <errno.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace slp
+{
+
+namespace udp
+{
+
+namespace
+{
+
+/* Socket filters see the datagram from the UDP header on */
+constexpr uint32_t UDP_HEADER = 8;
+
+constexpr uint32_t MIN_LEN = UDP_HEADER + slp::header::MIN_LEN;
+constexpr uint32_t MAX_LEN = UDP_HEADER + slp::MAX_LEN;
+constexpr uint32_t OFFSET_VERSION = UDP_HEADER + slp::header::OFFSET_VERSION;
+constexpr uint32_t OFFSET_FUNCTION = UDP_HEADER + slp::header::OFFSET_FUNCTION;
+constexpr uint32_t FIRST_FUNCTION = (uint32_t)slp::FunctionType::SRVRQST;
+constexpr uint32_t LAST_FUNCTION = (uint32_t)slp::FunctionType::SAADV;
+
+/* Keep the whole datagram */
+constexpr int32_t ACCEPT = -1;
+constexpr int32_t DROP = 0;
+
+int bpf(int cmd, bpf_attr& attr)
+{
+    return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+/* eBPF instructions, as the kernel's own BPF_* instruction macros */
+
+constexpr bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off,
+                        int32_t imm)
+{
+    return bpf_insn{code, dst, src, off, imm};
+}
+
+constexpr bpf_insn movReg(uint8_t dst, uint8_t src)
+{
+    return insn(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0);
+}
+
+constexpr bpf_insn movImm(uint8_t dst, int32_t imm)
+{
+    return insn(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm);
+}
+
+constexpr bpf_insn addImm(uint8_t dst, int32_t imm)
+{
+    return insn(BPF_ALU64 | BPF_ADD | BPF_K, dst, 0, 0, imm);
+}
+
+constexpr bpf_insn loadWord(uint8_t dst, uint8_t src, int16_t off)
+{
+    return insn(BPF_LDX | BPF_MEM | BPF_W, dst, src, off, 0);
+}
+
+constexpr bpf_insn storeWord(uint8_t dst, uint8_t src, int16_t off)
+{
+    return insn(BPF_STX | BPF_MEM | BPF_W, dst, src, off, 0);
+}
+
+/* Load a packet byte into R0, the packet has to be in R6 */
+constexpr bpf_insn loadPacketByte(int32_t off)
+{
+    return insn(BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, off);
+}
+
+constexpr bpf_insn jumpImm(uint8_t op, uint8_t dst, int32_t imm, int16_t off)
+{
+    return insn(BPF_JMP | op | BPF_K, dst, 0, off, imm);
+}
+
+constexpr bpf_insn atomicAdd(uint8_t dst, uint8_t src, int16_t off)
+{
+    return insn(BPF_STX | BPF_ATOMIC | BPF_DW, dst, src, off, BPF_ADD);
+}
+
+constexpr bpf_insn call(int32_t func)
+{
+    return insn(BPF_JMP | BPF_CALL, 0, 0, 0, func);
+}
+
+constexpr bpf_insn exitInsn()
+{
+    return insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+}
+
+} // namespace
+
+Filter::~Filter()
+{
+    if (progFd >= 0)
+    {
+        close(progFd);
+    }
+    if (mapFd >= 0)
+    {
+        close(mapFd);
+    }
+}
+
+int Filter::attachCounting(int fd)
+{
+    bpf_attr attr{};
+    attr.map_type = BPF_MAP_TYPE_ARRAY;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint64_t);
+    attr.max_entries = REASONS;
+    mapFd = bpf(BPF_MAP_CREATE, attr);
+    if (mapFd < 0)
+    {
+        return -errno;
+    }
+
+    // R6 holds the packet, R7 its length and R8 the reason of a drop.
+    // Every check jumps to the counting block at COUNT with the reason
+    // set, the offsets are relative to the next instruction.
+    constexpr int16_t COUNT = 15;
+    const bpf_insn prog[] = {
+        /* 0 */ movReg(BPF_REG_6, BPF_REG_1),
+        /* 1 */ loadWord(BPF_REG_7, BPF_REG_6, offsetof(__sk_buff, len)),
+        /* 2 */ movImm(BPF_REG_8, (int32_t)Reason::RUNT),
+        /* 3 */ jumpImm(BPF_JLT, BPF_REG_7, MIN_LEN, COUNT - 4),
+        /* 4 */ movImm(BPF_REG_8, (int32_t)Reason::OVERSIZE),
+        /* 5 */ jumpImm(BPF_JGT, BPF_REG_7, MAX_LEN, COUNT - 6),
+        /* 6 */ movImm(BPF_REG_8, (int32_t)Reason::VERSION),
+        /* 7 */ loadPacketByte(OFFSET_VERSION),
+        /* 8 */ jumpImm(BPF_JNE, BPF_REG_0, slp::VERSION_2, COUNT - 9),
+        /* 9 */ movImm(BPF_REG_8, (int32_t)Reason::FUNCTION),
+        /* 10 */ loadPacketByte(OFFSET_FUNCTION),
+        /* 11 */ jumpImm(BPF_JLT, BPF_REG_0, FIRST_FUNCTION, COUNT - 12),
+        /* 12 */ jumpImm(BPF_JGT, BPF_REG_0, LAST_FUNCTION, COUNT - 13),
+        /* 13 */ movImm(BPF_REG_0, ACCEPT),
+        /* 14 */ exitInsn(),
+        /* 15 COUNT, drops[R8]++ */
+        storeWord(BPF_REG_10, BPF_REG_8, -4),
+        /* 16 */ insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD,
+                      0, mapFd),
+        /* 17 */ insn(0, 0, 0, 0, 0),
+        /* 18 */ movReg(BPF_REG_2, BPF_REG_10),
+        /* 19 */ addImm(BPF_REG_2, -4),
+        /* 20 */ call(BPF_FUNC_map_lookup_elem),
+        /* 21 */ jumpImm(BPF_JEQ, BPF_REG_0, 0, 2),
+        /* 22 */ movImm(BPF_REG_1, 1),
+        /* 23 */ atomicAdd(BPF_REG_0, BPF_REG_1, 0),
+        /* 24 */ movImm(BPF_REG_0, DROP),
+        /* 25 */ exitInsn(),
+    };
+
+    attr = {};
+    attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+    attr.insns = reinterpret_cast<uintptr_t>(prog);
+    attr.insn_cnt = std::size(prog);
+    attr.license = reinterpret_cast<uintptr_t>("Apache-2.0");
+    progFd = bpf(BPF_PROG_LOAD, attr);
+    if (progFd < 0)
+    {
+        return -errno;
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_BPF, &progFd, sizeof(progFd)) <
+        0)
+    {
+        return -errno;
+    }
+    return 0;
+}
+
+int Filter::attachClassic(int fd)
+{
+    // Same checks, drops jump to the last instruction
+    sock_filter prog[] = {
+        /* 0 */ BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+        /* 1 */ BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, MIN_LEN, 0, 7),
+        /* 2 */ BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, MAX_LEN, 6, 0),
+        /* 3 */ BPF_STMT(BPF_LD | BPF_B | BPF_ABS, OFFSET_VERSION),
+        /* 4 */ BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, slp::VERSION_2, 0, 4),
+        /* 5 */ BPF_STMT(BPF_LD | BPF_B | BPF_ABS, OFFSET_FUNCTION),
+        /* 6 */ BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, FIRST_FUNCTION, 0, 2),
+        /* 7 */ BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, LAST_FUNCTION, 1, 0),
+        /* 8 */ BPF_STMT(BPF_RET | BPF_K, (uint32_t)ACCEPT),
+        /* 9 */ BPF_STMT(BPF_RET | BPF_K, DROP),
+    };
+    sock_fprog fprog{std::size(prog), prog};
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) <
+        0)
+    {
+        return -errno;
+    }
+    return 0;
+}
+
+std::tuple<int, std::unique_ptr<Filter>> Filter::attach(int fd)
+{
+    std::unique_ptr<Filter> filter(new Filter());
+
+    if (filter->attachCounting(fd) == 0)
+    {
+        return std::make_tuple(0, std::move(filter));
+    }
+
+    filter.reset(new Filter());
+    int r = attachClassic(fd);
+    if (r < 0)
+    {
+        return std::make_tuple(r, nullptr);
+    }
+    return std::make_tuple(0, std::move(filter));
+}
+
+std::tuple<int, Filter::Drops> Filter::drops() const
+{
+    Drops drops{};
+
+    if (mapFd < 0)
+    {
+        return std::make_tuple(-EOPNOTSUPP, drops);
+    }
+
+    for (uint32_t reason = 0; reason < REASONS; reason++)
+    {
+        bpf_attr attr{};
+        attr.map_fd = mapFd;
+        attr.key = reinterpret_cast<uintptr_t>(&reason);
+        attr.value = reinterpret_cast<uintptr_t>(&drops[reason]);
+        if (bpf(BPF_MAP_LOOKUP_ELEM, attr) < 0)
+        {
+            return std::make_tuple(-errno, drops);
+        }
+    }
+    return std::make_tuple(0, drops);
+}
+
+const char* Filter::reasonName(size_t reason)
+{
+    static constexpr const char* names[REASONS] = {
+        "runt",
+        "oversize",
+        "version",
+        "function",
+    };
+    return reason < REASONS ? names[reason] : "unknown";
+}
+
+} // namespace udp
+} // namespace slp
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <memory>
+#include <tuple>
+
+namespace slp
+{
+
+namespace udp
+{
+
+/** @class Filter
+ *
+ *  @brief Socket filter dropping malformed SLP datagrams in the kernel.
+ *
+ *  Datagrams too short for an SLP header, longer than MAX_LEN, of
+ *  another SLP version or with an unknown function id never reach the
+ *  socket queue, so a flood of junk does not wake slpd. The filter is
+ *  an eBPF program counting the drops per reason in an array map; when
+ *  the kernel does not allow loading it, e.g. without CAP_BPF, a
+ *  classic BPF program with the same checks is attached instead and no
+ *  drops are counted.
+ */
+class Filter
+{
+  public:
+    enum class Reason : uint32_t
+    {
+        RUNT,
+        OVERSIZE,
+        VERSION,
+        FUNCTION,
+    };
+    static constexpr size_t REASONS = 4;
+
+    using Drops = std::array<uint64_t, REASONS>;
+
+    ~Filter();
+
+    Filter(const Filter&) = delete;
+    Filter& operator=(const Filter&) = delete;
+
+    /** @brief Attach the filter to a socket.
+     *
+     *  @param[in] fd - The server socket.
+     *
+     *  @return Zero and the filter on success, else a negative errno and
+     *          nullptr.
+     */
+    static std::tuple<int, std::unique_ptr<Filter>> attach(int fd);
+
+    /** @brief Read the drop counters.
+     *
+     *  @return Zero and the drops indexed by Reason, -EOPNOTSUPP if the
+     *          classic filter is attached.
+     */
+    std::tuple<int, Drops> drops() const;
+
+    /** @brief Name of a drop reason, for logging */
+    static const char* reasonName(size_t reason);
+
+  private:
+    Filter() = default;
+
+    /** @brief Load the counting eBPF program and attach it. */
+    int attachCounting(int fd);
+
+    /** @brief Attach the classic BPF program. */
+    static int attachClassic(int fd);
+
+    int mapFd = -1;
+    int progFd = -1;
+};
+
+} // namespace udp
+} // namespace slp
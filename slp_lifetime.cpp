@@ -0,0 +1,120 @@
+#include "slp_lifetime.hpp"
+
+#include "slp_log.hpp"
+#include "slp_meta.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <charconv>
+
+namespace slp
+{
+namespace lifetime
+{
+
+void Policy::countQuery(time_t now)
+{
+    if (windowStart == 0)
+    {
+        windowStart = now;
+    }
+
+    time_t elapsed = now - windowStart;
+    if (elapsed >= slp::RATE_WINDOW)
+    {
+        uint64_t queries = windowQueries;
+        uint64_t target = uint64_t(slp::QUERY_RATE) * elapsed;
+
+        if (queries > target && factor * slp::LIFETIME < slp::LIFETIME_MAX)
+        {
+            factor *= 2;
+            scaled = now;
+            longest = 0;
+            SLP_LOG_INFO("SLP lifetimes scaled up by %u at %llu queries in "
+                         "%llds",
+                         factor, (unsigned long long)queries,
+                         (long long)elapsed);
+        }
+        else if (queries * 4 < target && factor > 1 &&
+                 now - scaled >= longest)
+        {
+            factor /= 2;
+            scaled = now;
+            longest = 0;
+            SLP_LOG_INFO("SLP lifetimes scaled down to %u at %llu queries "
+                         "in %llds",
+                         factor, (unsigned long long)queries,
+                         (long long)elapsed);
+        }
+        windowStart = now;
+        windowQueries = 0;
+    }
+    windowQueries++;
+}
+
+uint16_t Policy::advertised(uint16_t configured, time_t now, time_t until)
+{
+    // Scaling never goes past LIFETIME_MAX, nor below the configuration
+    uint32_t lifetime =
+        std::min<uint32_t>(uint32_t(configured) * factor,
+                           std::max<uint32_t>(configured, slp::LIFETIME_MAX));
+
+    for (time_t end : {changeAt, until})
+    {
+        if (end > now)
+        {
+            lifetime = std::min<uint32_t>(lifetime, end - now);
+        }
+    }
+    lifetime = std::max<uint32_t>(lifetime, 1);
+
+    if (lifetime > configured)
+    {
+        longest = std::max<uint16_t>(longest, lifetime);
+    }
+    return lifetime;
+}
+
+Policy& policy()
+{
+    static Policy served;
+    return served;
+}
+
+int readPlannedChange(Policy& policy, const char* path)
+{
+    FILE* file = fopen(path, "re");
+    if (!file)
+    {
+        if (errno != ENOENT)
+        {
+            return -errno;
+        }
+        policy.planChange(0);
+        return 0;
+    }
+
+    char buf[32];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+
+    long long at = 0;
+    auto [end, ec] = std::from_chars(buf, buf + len, at);
+    if (ec != std::errc() || at < 0 ||
+        (end != buf + len && *end != '\n' && *end != ' '))
+    {
+        return -EBADMSG;
+    }
+
+    if (at != policy.plannedChange())
+    {
+        SLP_LOG_INFO("SLP registry change planned at %lld", at);
+    }
+    policy.planChange(at);
+    return 0;
+}
+
+} // namespace lifetime
+} // namespace slp
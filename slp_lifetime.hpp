@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+namespace slp
+{
+
+/** Lifetimes advertised in the URL entries.
+ *
+ *  Every service is advertised with its configured lifetime, scaled up
+ *  when it is queried often so that the clients caching the entries
+ *  query less, and cut short before a planned registry change so that
+ *  no client holds an entry past it.
+ */
+namespace lifetime
+{
+
+/** @class Policy
+ *
+ *  @brief Scale of the advertised lifetimes, driven by the query rate.
+ *
+ *  The rate is measured over windows of at least RATE_WINDOW seconds.
+ *  A window above QUERY_RATE doubles the scale, one below a quarter of
+ *  it halves the scale again, but only once the longest lifetime it
+ *  raised since the last change has passed; the band between the two
+ *  keeps the clients' reaction to a change from undoing it.
+ */
+class Policy
+{
+  public:
+    /** @brief Count a query, at now in seconds */
+    void countQuery(time_t now);
+
+    /** @brief Lifetime to advertise for a service.
+     *
+     *  @param[in] configured - The lifetime of the service.
+     *  @param[in] now - The current time in seconds.
+     *  @param[in] until - When the entry stops being valid, such as the
+     *                     expiry of its signature, 0 when it does not.
+     *
+     *  @return the lifetime, at least one second.
+     */
+    uint16_t advertised(uint16_t configured, time_t now, time_t until = 0);
+
+    /** @brief Announce a registry change at a time, 0 cancels it */
+    void planChange(time_t at)
+    {
+        changeAt = at;
+    }
+
+    /** @brief When the announced registry change happens, 0 if none */
+    time_t plannedChange() const
+    {
+        return changeAt;
+    }
+
+    /** @brief Current factor of the configured lifetimes */
+    unsigned scale() const
+    {
+        return factor;
+    }
+
+  private:
+    time_t windowStart = 0;
+    unsigned windowQueries = 0;
+    unsigned factor = 1;
+    /* When the scale last changed, and the longest lifetime it raised
+     * since */
+    time_t scaled = 0;
+    uint16_t longest = 0;
+    time_t changeAt = 0;
+};
+
+/** @brief The policy of the served URL entries */
+Policy& policy();
+
+/** @brief Read the planned registry change into a policy.
+ *
+ *  @param[in] policy - The policy.
+ *  @param[in] path - A file holding the time of the change, in seconds
+ *                    since the epoch. A missing file cancels the change.
+ *
+ *  @return Zero on success, else a negative errno and the policy is left
+ *          unchanged, -EBADMSG if the file holds no time.
+ */
+int readPlannedChange(Policy& policy, const char* path);
+
+} // namespace lifetime
+} // namespace slp
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+
+/** Logging for slpd.
+ *
+ *  Messages go straight to stdio so that no translation unit needs the
+ *  iostream machinery. Errors are always logged, informational messages
+ *  are compiled out of minimal builds while their arguments are still
+ *  type checked.
+ */
+#define SLP_LOG_ERROR(fmt, ...)                                                \
+    fprintf(stderr, fmt "\n" __VA_OPT__(, ) __VA_ARGS__)
+
+#ifdef SLP_MINIMAL
+#define SLP_LOG_INFO(fmt, ...)                                                 \
+    do                                                                         \
+    {                                                                          \
+        if (false)                                                             \
+        {                                                                      \
+            printf(fmt "\n" __VA_OPT__(, ) __VA_ARGS__);                       \
+        }                                                                      \
+    } while (0)
+#else
+#define SLP_LOG_INFO(fmt, ...) printf(fmt "\n" __VA_OPT__(, ) __VA_ARGS__)
+#endif
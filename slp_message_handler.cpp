@@ -1,15 +1,35 @@
+#include "config.h"
+
 #include "endian.hpp"
 #include "slp.hpp"
+#include "slp_dispatch.hpp"
+#include "slp_lifetime.hpp"
+#include "slp_log.hpp"
 #include "slp_meta.hpp"
+#include "slp_netns.hpp"
+#include "slp_text.hpp"
+#include "slp_trace.hpp"
+
+#if SLP_AUTH
+#include "slp_auth.hpp"
+#endif
+#if SLP_DA
+#include "slp_da.hpp"
+#endif
+#if SLP_SA
+#include "slp_sa.hpp"
+#endif
 
 #include <arpa/inet.h>
 #include <dirent.h>
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <algorithm>
-#include <bitset>
+#include <chrono>
+#include <functional>
 
 namespace slp
 {
@@ -19,7 +39,19 @@ namespace handler
 namespace internal
 {
 
-static constexpr auto SERVICE_DIR = "/etc/slp/services/";
+uint8_t replyFunction(uint8_t functionID)
+{
+    // Registrations are acknowledged, everything else is answered by
+    // the function id following the request
+    switch (functionID)
+    {
+        case (uint8_t)slp::FunctionType::SRVREG:
+        case (uint8_t)slp::FunctionType::SRVDEREG:
+            return (uint8_t)slp::FunctionType::SRVACK;
+        default:
+            return functionID + 1;
+    }
+}
 
 buffer prepareHeader(const Message& req)
 {
@@ -28,12 +60,14 @@ buffer prepareHeader(const Message& req)
         req.header.langtag.length() + /* Actual length of lang tag */
         slp::response::SIZE_ERROR;    /*  2 bytes for error code */
 
-    buffer buff(length, 0);
+    // Room for the whole reply up front, the body is appended
+    buffer buff;
+    buff.reserve(slp::MAX_LEN);
+    buff.resize(length, 0);
 
     buff[slp::header::OFFSET_VERSION] = req.header.version;
 
-    // will increment the function id from 1 as reply
-    buff[slp::header::OFFSET_FUNCTION] = req.header.functionID + 1;
+    buff[slp::header::OFFSET_FUNCTION] = replyFunction(req.header.functionID);
 
     std::copy_n(&length, slp::header::SIZE_LENGTH,
                 buff.data() + slp::header::OFFSET_LENGTH);
@@ -78,79 +112,93 @@ std::tuple<int, buffer> processSrvTypeRequest(const Message& req)
 
     buffer buff;
 
-    // read the slp service info from conf and create the service type string
-    slp::handler::internal::ServiceList svcList =
-        slp::handler::internal::readSLPServiceInfo();
-    if (svcList.size() <= 0)
+    // the service type list is encoded along with the registry
+    auto registry = slp::handler::internal::getServiceRegistry();
+    if (registry->size() <= 0)
     {
         buff.resize(0);
-        std::cerr << "SLP unable to read the service info\n";
+        SLP_LOG_ERROR("SLP unable to read the service info");
         return std::make_tuple((int)slp::Error::INTERNAL_ERROR, buff);
     }
 
-    std::string service;
-    bool firstIteration = true;
-    for_each(svcList.cbegin(), svcList.cend(),
-             [&service, &firstIteration](const auto& svc) {
-                 if (firstIteration == true)
-                 {
-                     service = svc.first;
-                     firstIteration = false;
-                 }
-                 else
-                 {
-                     service += ",";
-                     service += svc.first;
-                 }
-             });
-
     buff = prepareHeader(req);
 
-    /* Need to modify the length and the function type field of the header
-     * as it is dependent on the handler of the service */
-
-    std::cout << "service=" << service.c_str() << "\n";
+    auto typeList = registry->typeList();
+    SLP_LOG_INFO("service=%.*s", (int)typeList.size(), typeList.data());
 
     // See if total response size exceeds our max
+    auto entry = registry->typeListEntry();
     uint32_t totalLength =
-        buff.size() +                 /* 14 bytes header + length of langtag */
-        slp::response::SIZE_ERROR +   /* 2 byte err code */
-        slp::response::SIZE_SERVICE + /* 2 byte srvtype len */
-        service.length();
+        buff.size() + /* header, langtag and 2 byte err code */
+        entry.size();
     if (totalLength > slp::MAX_LEN)
     {
-        std::cerr << "Message response size exceeds maximum allowed: "
-                  << totalLength << " / " << slp::MAX_LEN << std::endl;
+        SLP_LOG_ERROR("Message response size exceeds maximum allowed: %u / %zu",
+                      totalLength, slp::MAX_LEN);
         buff.resize(0);
         return std::make_tuple((int)slp::Error::PARSE_ERROR, buff);
     }
 
-    uint8_t length = buff.size() + /* 14 bytes header + length of langtag */
-                     slp::response::SIZE_ERROR +   /* 2 byte err code */
-                     slp::response::SIZE_SERVICE + /* 2 byte srvtype len */
-                     service.length();
-
-    buff.resize(length);
+    /* error code is already set to 0, append the service type list */
+    buff.insert(buff.end(), entry.begin(), entry.end());
 
+    uint8_t length = buff.size();
     std::copy_n(&length, slp::header::SIZE_LENGTH,
                 buff.data() + slp::header::OFFSET_LENGTH);
 
-    /* error code is already set to 0 moving to service type len */
+    return std::make_tuple(slp::SUCCESS, std::move(buff));
+}
 
-    uint16_t serviceTypeLen = service.length();
-    serviceTypeLen = endian::to_network(serviceTypeLen);
+/* Replace the configured lifetime of every URL entry in encoded entries
+ * with the one advertised now, see appendURLEntry for the layout. The
+ * entries count as one query of the lifetime policy. */
+static void advertiseLifetimes(std::span<uint8_t> entries, time_t until)
+{
+    auto& policy = slp::lifetime::policy();
+    time_t now = time(nullptr);
+    policy.countQuery(now);
 
-    std::copy_n((uint8_t*)&serviceTypeLen, slp::response::SIZE_SERVICE,
-                buff.data() + slp::response::OFFSET_SERVICE_LEN);
+    size_t pos = 0;
+    while (pos + slp::response::SIZE_URL_ENTRY <= entries.size())
+    {
+        uint16_t configured = 0;
+        auto* lifetimeField =
+            entries.data() + pos + slp::response::SIZE_RESERVED;
+        std::copy_n(lifetimeField, slp::response::SIZE_LIFETIME,
+                    (uint8_t*)&configured);
+        configured = endian::from_network(configured);
+        auto lifetime = policy.advertised(configured, now, until);
+        if (lifetime != configured)
+        {
+            lifetime = endian::to_network(lifetime);
+            std::copy_n((uint8_t*)&lifetime, slp::response::SIZE_LIFETIME,
+                        lifetimeField);
+        }
 
-    /* service type data */
-    std::copy_n((uint8_t*)service.c_str(), service.length(),
-                (buff.data() + slp::response::OFFSET_SERVICE));
+        uint16_t urlLength = 0;
+        std::copy_n(entries.data() + pos + slp::response::SIZE_RESERVED +
+                        slp::response::SIZE_LIFETIME,
+                    slp::response::SIZE_URLLENGTH, (uint8_t*)&urlLength);
+        pos += slp::response::SIZE_RESERVED + slp::response::SIZE_LIFETIME +
+               slp::response::SIZE_URLLENGTH +
+               endian::from_network(urlLength);
 
-    return std::make_tuple(slp::SUCCESS, buff);
+        // Each authentication block starts with its BSD and its length
+        uint8_t auths = entries[pos];
+        pos += slp::response::SIZE_AUTH;
+        for (; auths > 0 &&
+               pos + slp::request::SIZE_AUTH_HEADER <= entries.size();
+             auths--)
+        {
+            uint16_t blockLength = 0;
+            std::copy_n(entries.data() + pos + sizeof(uint16_t),
+                        sizeof(blockLength), (uint8_t*)&blockLength);
+            pos += endian::from_network(blockLength);
+        }
+    }
 }
 
-std::tuple<int, buffer> processSrvRequest(const Message& req)
+std::tuple<int, cache::Reply> prepareSrvReply(const Message& req)
 {
     /*
           Service Reply
@@ -163,122 +211,103 @@ std::tuple<int, buffer> processSrvRequest(const Message& req)
          +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
          |       <URL Entry 1>          ...       <URL Entry N>          \
          +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-
-         URL Entry
-          0                   1                   2                   3
-          0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-         |   Reserved    |          Lifetime             |   URL Length  |
-         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-         |URL len, contd.|            URL (variable length)              \
-         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-         |# of URL auths |            Auth. blocks (if any)              \
-         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
     */
 
-    buffer buff;
+    cache::Reply reply;
+    auto& buff = reply.message;
     // Get all the services which are registered
-    slp::handler::internal::ServiceList svcList =
-        slp::handler::internal::readSLPServiceInfo();
-    if (svcList.size() <= 0)
+    auto registry = slp::handler::internal::getServiceRegistry();
+    if (registry->size() <= 0)
     {
-        buff.resize(0);
-        std::cerr << "SLP unable to read the service info\n";
-        return std::make_tuple((int)slp::Error::INTERNAL_ERROR, buff);
+        SLP_LOG_ERROR("SLP unable to read the service info");
+        return std::make_tuple((int)slp::Error::INTERNAL_ERROR, reply);
     }
 
     // return error if service type doesn't match
     auto& svcName = req.body.srvrqst.srvType;
-    auto svcIt = svcList.find(svcName);
-    if (svcIt == svcList.end())
+    auto matches = registry->find(svcName);
+    if (matches.empty())
     {
-        buff.resize(0);
-        std::cerr << "SLP unable to find the service=" << svcName << "\n";
-        return std::make_tuple((int)slp::Error::INTERNAL_ERROR, buff);
+        SLP_LOG_ERROR("SLP unable to find the service=%s", svcName.c_str());
+        return std::make_tuple((int)slp::Error::INTERNAL_ERROR, reply);
     }
-    // Get all the interface address
-    auto ifaddrList = slp::handler::internal::getIntfAddrs();
-    if (ifaddrList.size() <= 0)
+
+    const auto& table = registry->table(req.ns);
+    if (table.addresses.size() <= 0)
     {
-        buff.resize(0);
-        std::cerr << "SLP unable to read the interface address\n";
-        return std::make_tuple((int)slp::Error::INTERNAL_ERROR, buff);
+        SLP_LOG_ERROR("SLP unable to read the interface address");
+        return std::make_tuple((int)slp::Error::INTERNAL_ERROR, reply);
     }
 
-    buff = prepareHeader(req);
-    // Calculate the length and resize the buffer
-    uint8_t length = buff.size() + /* 14 bytes header + length of langtag */
-                     slp::response::SIZE_ERROR +    /* 2 bytes error code */
-                     slp::response::SIZE_URL_COUNT; /* 2 bytes srvtype len */
-
-    buff.resize(length);
-
-    // Populate the url count
-    uint16_t urlCount = ifaddrList.size();
-    urlCount = endian::to_network(urlCount);
-
-    std::copy_n((uint8_t*)&urlCount, slp::response::SIZE_URL_COUNT,
-                buff.data() + slp::response::OFFSET_URL_ENTRY);
-
-    // Find the service
-    const slp::ConfigData& svc = svcIt->second;
-    // Populate the URL Entries
-    auto pos = slp::response::OFFSET_URL_ENTRY + slp::response::SIZE_URL_COUNT;
-    for (const auto& addr : ifaddrList)
+    // RFC 2608 section 9.2, a request listing SPIs is answered with URL
+    // entries signed by one of them, signed when the registry is loaded
+    const auto* urlEntries = &table.urlEntries;
+    auto& spiList = req.body.srvrqst.spistr;
+    if (!spiList.empty())
     {
-        std::string url =
-            svc.name + ':' + svc.type + "//" + addr + ',' + svc.port;
-
-        // See if total response size exceeds our max
-        uint32_t totalLength =
-            buff.size() + slp::response::SIZE_URL_ENTRY + url.length();
-        if (totalLength > slp::MAX_LEN)
+        urlEntries = table.signedURLEntries(spiList);
+        if (!urlEntries)
         {
-            std::cerr << "Message response size exceeds maximum allowed: "
-                      << totalLength << " / " << slp::MAX_LEN << std::endl;
-            buff.resize(0);
-            return std::make_tuple((int)slp::Error::PARSE_ERROR, buff);
+            SLP_LOG_ERROR("SLP no key for the SPIs=%s", spiList.c_str());
+            return std::make_tuple((int)slp::Error::AUTHENTICATION_UNKNOWN,
+                                   reply);
         }
+    }
 
-        buff.resize(buff.size() + slp::response::SIZE_URL_ENTRY + url.length());
-
-        uint8_t reserved = 0;
-        uint16_t auth = 0;
-        uint16_t lifetime = endian::to_network<uint16_t>(slp::LIFETIME);
-        uint16_t urlLength = url.length();
-
-        std::copy_n((uint8_t*)&reserved, slp::response::SIZE_RESERVED,
-                    buff.data() + pos);
-
-        pos += slp::response::SIZE_RESERVED;
-
-        std::copy_n((uint8_t*)&lifetime, slp::response::SIZE_LIFETIME,
-                    buff.data() + pos);
-
-        pos += slp::response::SIZE_LIFETIME;
-
-        urlLength = endian::to_network(urlLength);
-        std::copy_n((uint8_t*)&urlLength, slp::response::SIZE_URLLENGTH,
-                    buff.data() + pos);
-        pos += slp::response::SIZE_URLLENGTH;
+    buff = prepareHeader(req);
 
-        std::copy_n((uint8_t*)url.c_str(), url.length(), buff.data() + pos);
-        pos += url.length();
+    // See if total response size exceeds our max
+    uint32_t totalLength = buff.size() + slp::response::SIZE_URL_COUNT;
+    for (auto pos : matches)
+    {
+        totalLength += (*urlEntries)[pos].size();
+    }
+    if (totalLength > slp::MAX_LEN)
+    {
+        SLP_LOG_ERROR("Message response size exceeds maximum allowed: %u / %zu",
+                      totalLength, slp::MAX_LEN);
+        buff.resize(0);
+        return std::make_tuple((int)slp::Error::PARSE_ERROR, reply);
+    }
 
-        std::copy_n((uint8_t*)&auth, slp::response::SIZE_AUTH,
-                    buff.data() + pos);
-        pos += slp::response::SIZE_AUTH;
+    // Populate the url count, every instance is offered on every address
+    uint16_t urlCount = endian::to_network<uint16_t>(
+        matches.size() * table.addresses.size());
+    buff.insert(buff.end(), (uint8_t*)&urlCount,
+                (uint8_t*)&urlCount + slp::response::SIZE_URL_COUNT);
+
+    // The URL entries are encoded when the registry is loaded, with the
+    // configured lifetimes, signed ones are not valid past their expiry
+    reply.urlEntries = buff.size();
+    reply.until = urlEntries == &table.urlEntries ? 0 : registry->authExpiry;
+    for (auto pos : matches)
+    {
+        const auto& entries = (*urlEntries)[pos];
+        buff.insert(buff.end(), entries.begin(), entries.end());
     }
+
     uint8_t packetLength = buff.size();
-    std::copy_n((uint8_t*)&packetLength, slp::header::SIZE_VERSION,
+    std::copy_n((uint8_t*)&packetLength, slp::header::SIZE_LENGTH,
                 buff.data() + slp::header::OFFSET_LENGTH);
 
-    return std::make_tuple((int)slp::SUCCESS, buff);
+    return std::make_tuple((int)slp::SUCCESS, std::move(reply));
+}
+
+std::tuple<int, buffer> processSrvRequest(const Message& req)
+{
+    auto [rc, reply] = prepareSrvReply(req);
+    if (rc == slp::SUCCESS)
+    {
+        advertiseLifetimes(std::span(reply.message).subspan(reply.urlEntries),
+                           reply.until);
+    }
+    return std::make_tuple(rc, std::move(reply.message));
 }
 
-std::list<std::string> getIntfAddrs()
+
+std::vector<std::string> getIntfAddrs()
 {
-    std::list<std::string> addrList;
+    std::vector<std::string> addrList;
 
     struct ifaddrs* ifaddr;
     // attempt to fill struct with ifaddrs
@@ -287,9 +316,7 @@ std::list<std::string> getIntfAddrs()
         return addrList;
     }
 
-    slp::deleted_unique_ptr<ifaddrs> ifaddrPtr(ifaddr, [](ifaddrs* addr) {
-        freeifaddrs(addr);
-    });
+    slp::deleted_unique_ptr<ifaddrs, freeifaddrs> ifaddrPtr(ifaddr);
 
     ifaddr = nullptr;
 
@@ -323,24 +350,18 @@ std::list<std::string> getIntfAddrs()
     return addrList;
 }
 
-slp::handler::internal::ServiceList readSLPServiceInfo()
+slp::handler::internal::ServiceList readSLPServiceInfo(const char* dirPath)
 {
     using namespace std::string_literals;
     slp::handler::internal::ServiceList svcLst;
-    slp::ConfigData service;
     struct dirent* dent = nullptr;
 
     // Open the services dir and get the service info
     // from service files.
     // Service File format would be "ServiceName serviceType Port"
-    DIR* dir = opendir(SERVICE_DIR);
+    DIR* dir = opendir(dirPath);
     // wrap the pointer into smart pointer.
-    slp::deleted_unique_ptr<DIR> dirPtr(dir, [](DIR* dir) {
-        if (!dir)
-        {
-            closedir(dir);
-        }
-    });
+    slp::deleted_unique_ptr<DIR, closedir> dirPtr(dir);
     dir = nullptr;
 
     if (dirPtr.get())
@@ -349,46 +370,664 @@ slp::handler::internal::ServiceList readSLPServiceInfo()
         {
             if (dent->d_type == DT_REG) // regular file
             {
-                auto absFileName = std::string(SERVICE_DIR) + dent->d_name;
-                std::ifstream readFile(absFileName);
-                readFile >> service;
+                auto absFileName = std::string(dirPath) + '/' + dent->d_name;
+                slp::deleted_unique_ptr<FILE, fclose> file(
+                    fopen(absFileName.c_str(), "re"));
+                if (!file)
+                {
+                    continue;
+                }
+
+                // Only the first line of the file is used
+                char* line = nullptr;
+                size_t lineSize = 0;
+                ssize_t lineLen = getline(&line, &lineSize, file.get());
+                slp::deleted_unique_ptr<char, free> linePtr(line);
+
+                slp::ConfigData service;
+                if (lineLen <= 0 ||
+                    !service.parse(std::string_view(line, lineLen)
+                                       .substr(0, strcspn(line, "\r\n"))))
+                {
+                    continue;
+                }
                 service.name = "service:"s + service.name;
-                svcLst.emplace(service.name, service);
+                svcLst.push_back(std::move(service));
             }
         }
     }
+
+    slp::sortServices(svcLst);
     return svcLst;
 }
+
+size_t ServiceRegistry::size() const
+{
+    if (builtin)
+    {
+        return builtin->size();
+    }
+    return image ? image->size() : services.size();
+}
+
+uint16_t ServiceRegistry::lifetime(size_t pos) const
+{
+    if (builtin)
+    {
+        return builtin->service(pos).lifetime;
+    }
+    return image ? image->service(pos).lifetime : services[pos].lifetime;
+}
+
+std::span<const uint32_t> ServiceRegistry::find(std::string_view type) const
+{
+    if (builtin || image)
+    {
+        std::array<char, slp::MAX_LEN> buf;
+        if (type.size() > buf.size())
+        {
+            return {};
+        }
+        auto folded = slp::fold(type, buf);
+        return builtin ? builtin->find(folded) : image->find(folded);
+    }
+
+    const auto* matches = index.find(type);
+    if (!matches)
+    {
+        return {};
+    }
+    return *matches;
+}
+
+std::string_view ServiceRegistry::typeList() const
+{
+    if (builtin)
+    {
+        return builtin->typeList();
+    }
+    return image ? image->typeList() : std::string_view(serviceTypes);
+}
+
+std::span<const uint8_t> ServiceRegistry::typeListEntry() const
+{
+    if (builtin)
+    {
+        return builtin->typeListEntry();
+    }
+    return image ? image->typeListEntry()
+                 : std::span<const uint8_t>(serviceTypesEntry);
+}
+
+/* A list item without the spaces around it */
+static std::string_view trimSpaces(std::string_view item)
+{
+    item.remove_prefix(std::min(item.find_first_not_of(' '), item.size()));
+    item.remove_suffix(item.size() -
+                       std::min(item.find_last_not_of(' ') + 1, item.size()));
+    return item;
+}
+
+const AddressTable& ServiceRegistry::table(size_t ns) const
+{
+    return tables[ns < tables.size() ? ns : 0];
+}
+
+const std::vector<buffer>*
+    AddressTable::signedURLEntries(std::string_view spiList) const
+{
+    const std::vector<buffer>* entries = nullptr;
+
+    slp::text::splitList(spiList, [&](std::string_view spi) {
+        auto it = signedEntries.find(trimSpaces(spi));
+        if (!entries && it != signedEntries.end())
+        {
+            entries = &it->second;
+        }
+    });
+    return entries;
+}
+
+bool AddressTable::answeredBefore(std::string_view prList) const
+{
+    bool found = false;
+
+    slp::text::splitList(prList, [&](std::string_view addr) {
+        found = found || std::binary_search(ownAddresses.begin(),
+                                            ownAddresses.end(),
+                                            trimSpaces(addr), std::less<>());
+    });
+    return found;
+}
+
+slp::Snapshot<ServiceRegistry>& registrySnapshot()
+{
+    static slp::Snapshot<ServiceRegistry> snapshot;
+    return snapshot;
+}
+
+/* Append a URL entry, with an authentication block if one is given */
+static void appendURLEntry(buffer& buff, std::string_view url,
+                           uint16_t lifetime,
+                           std::span<const uint8_t> authBlock = {})
+{
+    /*
+         URL Entry
+          0                   1                   2                   3
+          0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+         |   Reserved    |          Lifetime             |   URL Length  |
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+         |URL len, contd.|            URL (variable length)              \
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+         |# of URL auths |            Auth. blocks (if any)              \
+         +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    */
+
+    uint8_t reserved = 0;
+    uint8_t auths = authBlock.empty() ? 0 : 1;
+    lifetime = endian::to_network(lifetime);
+    uint16_t urlLength = endian::to_network<uint16_t>(url.size());
+
+    buff.push_back(reserved);
+    buff.insert(buff.end(), (uint8_t*)&lifetime,
+                (uint8_t*)&lifetime + slp::response::SIZE_LIFETIME);
+    buff.insert(buff.end(), (uint8_t*)&urlLength,
+                (uint8_t*)&urlLength + slp::response::SIZE_URLLENGTH);
+    buff.insert(buff.end(), url.begin(), url.end());
+    buff.push_back(auths);
+    buff.insert(buff.end(), authBlock.begin(), authBlock.end());
+}
+
+/* Encode the URL entries of a service on every address */
+static buffer encodeURLEntries(std::string_view urlPrefix,
+                               std::string_view urlSuffix, uint16_t lifetime,
+                               const std::vector<std::string>& addresses)
+{
+    buffer buff;
+    std::string url;
+
+    for (const auto& addr : addresses)
+    {
+        url.assign(urlPrefix).append(addr).append(urlSuffix);
+        appendURLEntry(buff, url, lifetime);
+    }
+    return buff;
+}
+
+/* The URL of a service, split around the address */
+static std::pair<std::string, std::string>
+    urlParts(const ServiceRegistry& registry, size_t pos)
+{
+    if (registry.builtin)
+    {
+        const auto& table = *registry.builtin;
+        const auto& svc = table.service(pos);
+        return {std::string(table.string(svc.urlPrefix)),
+                std::string(table.string(svc.urlSuffix))};
+    }
+    if (registry.image)
+    {
+        const auto& img = *registry.image;
+        const auto& svc = img.service(pos);
+        return {std::string(img.string(svc.urlPrefix)),
+                std::string(img.string(svc.urlSuffix))};
+    }
+    const auto& svc = registry.services[pos];
+    return {svc.urlPrefix(), svc.urlSuffix()};
+}
+
+std::vector<slp::request::ServiceRegistration>
+    serviceRegistrations(const ServiceRegistry& registry, size_t ns)
+{
+    std::vector<slp::request::ServiceRegistration> registrations;
+
+    for (size_t pos = 0; pos < registry.size(); pos++)
+    {
+        auto [urlPrefix, urlSuffix] = urlParts(registry, pos);
+        std::string srvType;
+        if (registry.builtin)
+        {
+            srvType = registry.builtin->string(
+                registry.builtin->service(pos).name);
+        }
+        else if (registry.image)
+        {
+            srvType =
+                registry.image->string(registry.image->service(pos).name);
+        }
+        else
+        {
+            srvType = registry.services[pos].name;
+        }
+
+        for (const auto& addr : registry.table(ns).addresses)
+        {
+            auto& reg = registrations.emplace_back();
+            reg.urlEntry.lifetime = registry.lifetime(pos);
+            reg.urlEntry.url = urlPrefix + addr + urlSuffix;
+            reg.srvType = srvType;
+            reg.scopeList = "DEFAULT";
+        }
+    }
+    return registrations;
+}
+
+void addAddressTable(ServiceRegistry& registry,
+                     std::vector<std::string> addresses)
+{
+    AddressTable table;
+    table.ownAddresses = addresses;
+    std::sort(table.ownAddresses.begin(), table.ownAddresses.end());
+    table.addresses = std::move(addresses);
+
+    for (size_t pos = 0; pos < registry.size(); pos++)
+    {
+        auto [urlPrefix, urlSuffix] = urlParts(registry, pos);
+        table.urlEntries.push_back(encodeURLEntries(
+            urlPrefix, urlSuffix, registry.lifetime(pos), table.addresses));
+    }
+    registry.tables.push_back(std::move(table));
+}
+
+#if SLP_AUTH
+/* Sign the URL entries of every service on the addresses of a table */
+static std::tuple<int, std::vector<buffer>>
+    signURLEntries(const ServiceRegistry& registry, const AddressTable& table,
+                   const slp::auth::Key& key)
+{
+    std::vector<buffer> entries;
+    std::string url;
+
+    for (size_t pos = 0; pos < registry.size(); pos++)
+    {
+        auto [urlPrefix, urlSuffix] = urlParts(registry, pos);
+        buffer buff;
+        for (const auto& addr : table.addresses)
+        {
+            url.assign(urlPrefix).append(addr).append(urlSuffix);
+            auto [rc, block] =
+                slp::auth::urlAuthBlock(key, url, registry.authExpiry);
+            if (rc < 0)
+            {
+                return std::make_tuple(rc, std::vector<buffer>());
+            }
+            appendURLEntry(buff, url, registry.lifetime(pos), block);
+        }
+        entries.push_back(std::move(buff));
+    }
+    return std::make_tuple(0, std::move(entries));
+}
+#endif
+
+void signServiceRegistry([[maybe_unused]] ServiceRegistry& registry)
+{
+#if SLP_AUTH
+    const auto& keys = slp::auth::keys();
+    if (keys.empty())
+    {
+        return;
+    }
+
+    registry.authExpiry = time(nullptr) + slp::AUTH_LIFETIME;
+    for (auto& table : registry.tables)
+    {
+        for (const auto& key : keys)
+        {
+            auto [rc, entries] = signURLEntries(registry, table, key);
+            if (rc < 0)
+            {
+                SLP_LOG_ERROR("SLP unable to sign with the key of SPI %s: %s",
+                              key.spi().c_str(), strerror(-rc));
+                continue;
+            }
+            table.signedEntries.emplace(key.spi(), std::move(entries));
+        }
+    }
+#endif
+}
+
+/* The signed URL entries are due to be signed again */
+static bool authExpiring(const ServiceRegistry& registry)
+{
+    return std::ranges::any_of(registry.tables,
+                               [](const AddressTable& table) {
+                                   return !table.signedEntries.empty();
+                               }) &&
+           registry.authExpiry < time(nullptr) + slp::AUTH_REFRESH;
+}
+
+/* The interface addresses of every namespace served, slpd's own first */
+static std::vector<std::vector<std::string>> namespaceAddrs()
+{
+    std::vector<std::vector<std::string>> addresses(slp::netns::count());
+    addresses[0] = getIntfAddrs();
+    for (size_t ns = 1; ns < addresses.size(); ns++)
+    {
+        slp::netns::Enter enter(ns);
+        if (enter.error() < 0)
+        {
+            SLP_LOG_ERROR("SLP unable to enter the network namespace %s: %s",
+                          slp::netns::name(ns).c_str(),
+                          strerror(-enter.error()));
+            continue;
+        }
+        addresses[ns] = getIntfAddrs();
+    }
+    return addresses;
+}
+
+static bool sameAddresses(const ServiceRegistry& registry,
+                          const std::vector<std::vector<std::string>>& addrs)
+{
+    return std::ranges::equal(registry.tables, addrs,
+                              [](const AddressTable& table,
+                                 const std::vector<std::string>& addresses) {
+                                  return table.addresses == addresses;
+                              });
+}
+
+static bool sameTime(const struct timespec& a, const struct timespec& b)
+{
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+#if SLP_BUILTIN_SERVICES
+/* The services of the builtin-services meson option */
+static constexpr auto builtinTable =
+    slp::builtin::compile([] { return std::string_view(BUILTIN_SERVICES); });
+static constexpr auto builtinServices = builtinTable.registry();
+#else
+static bool before(const struct timespec& a, const struct timespec& b)
+{
+    return a.tv_sec < b.tv_sec ||
+           (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+/* Latest change to the service files, editing a file in place does not
+ * touch the directory */
+static bool servicesMtime(const char* dirPath, struct timespec& mtime)
+{
+    struct stat st{};
+    if (stat(dirPath, &st) < 0)
+    {
+        return false;
+    }
+    mtime = st.st_mtim;
+
+    slp::deleted_unique_ptr<DIR, closedir> dir(opendir(dirPath));
+    if (!dir)
+    {
+        return true;
+    }
+
+    struct dirent* dent = nullptr;
+    while ((dent = readdir(dir.get())) != nullptr)
+    {
+        if (dent->d_type == DT_REG &&
+            fstatat(dirfd(dir.get()), dent->d_name, &st, 0) == 0 &&
+            before(mtime, st.st_mtim))
+        {
+            mtime = st.st_mtim;
+        }
+    }
+    return true;
+}
+
+/* Map the registry image unless it is older than the service files */
+static std::shared_ptr<const slp::RegistryImage>
+    openImage(const struct timespec& imageMtime,
+              const struct timespec& dirMtime)
+{
+    if (before(imageMtime, dirMtime))
+    {
+        SLP_LOG_INFO("SLP registry image %s is out of date, ignored",
+                     slp::REGISTRY_IMAGE);
+        return nullptr;
+    }
+
+    auto [rc, image] = slp::RegistryImage::open(slp::REGISTRY_IMAGE);
+    if (rc < 0)
+    {
+        SLP_LOG_ERROR("SLP unable to load the registry image %s: %s",
+                      slp::REGISTRY_IMAGE, strerror(-rc));
+    }
+    return image;
+}
+#endif
+
+std::unique_ptr<ServiceRegistry>
+    makeServiceRegistry(ServiceList services,
+                        std::vector<std::string> addresses)
+{
+    auto registry = std::make_unique<ServiceRegistry>();
+    registry->services = std::move(services);
+    registry->index.build(registry->services);
+    registry->serviceTypes = slp::listServiceTypes(registry->services);
+    addAddressTable(*registry, std::move(addresses));
+
+    auto& entry = registry->serviceTypesEntry;
+    uint16_t serviceTypeLen =
+        endian::to_network<uint16_t>(registry->serviceTypes.length());
+    entry.insert(entry.end(), (uint8_t*)&serviceTypeLen,
+                 (uint8_t*)&serviceTypeLen + slp::response::SIZE_SERVICE);
+    entry.insert(entry.end(), registry->serviceTypes.begin(),
+                 registry->serviceTypes.end());
+    return registry;
+}
+
+void publishServiceRegistry(std::unique_ptr<ServiceRegistry> registry)
+{
+    static uint64_t generation = 0;
+    registry->generation = ++generation;
+    registrySnapshot().publish(std::move(registry));
+}
+
+bool reloadServiceRegistry(bool force)
+{
+    struct timespec mtime{};
+    struct stat imageSt{};
+#if SLP_BUILTIN_SERVICES
+    // The services are compiled in, only the addresses change
+    bool haveDir = false;
+    bool haveImage = false;
+#else
+    bool haveDir = servicesMtime(SERVICE_DIR, mtime);
+    bool haveImage = stat(REGISTRY_IMAGE, &imageSt) == 0;
+#endif
+    auto addressesStart = std::chrono::steady_clock::now();
+    auto addresses = namespaceAddrs();
+    SLP_PROBE(addresses_done, 0, 0);
+    slp::trace::record(slp::trace::Stage::ADDRESSES,
+                       std::chrono::steady_clock::now() - addressesStart);
+
+    {
+        auto current = registrySnapshot().read();
+        if (current && !force && sameAddresses(*current, addresses) &&
+            !authExpiring(*current) &&
+            ((!haveDir && !haveImage) ||
+             (sameTime(mtime, current->mtime) &&
+              sameTime(imageSt.st_mtim, current->imageMtime))))
+        {
+            // Nothing changed, or nothing to reload from
+            return false;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<ServiceRegistry> registry;
+#if SLP_BUILTIN_SERVICES
+    registry = std::make_unique<ServiceRegistry>();
+    registry->builtin = &builtinServices;
+    addAddressTable(*registry, std::move(addresses[0]));
+#else
+    std::shared_ptr<const slp::RegistryImage> image;
+    if (haveImage)
+    {
+        image = openImage(imageSt.st_mtim, mtime);
+    }
+
+    if (image)
+    {
+        registry = std::make_unique<ServiceRegistry>();
+        registry->image = std::move(image);
+        addAddressTable(*registry, std::move(addresses[0]));
+    }
+    else
+    {
+        registry = makeServiceRegistry(readSLPServiceInfo(),
+                                       std::move(addresses[0]));
+    }
+#endif
+    for (size_t ns = 1; ns < addresses.size(); ns++)
+    {
+        addAddressTable(*registry, std::move(addresses[ns]));
+    }
+    signServiceRegistry(*registry);
+    SLP_PROBE(services_done, 0, 0);
+    slp::trace::record(slp::trace::Stage::SERVICES,
+                       std::chrono::steady_clock::now() - start);
+    registry->mtime = mtime;
+    registry->imageMtime = imageSt.st_mtim;
+
+    size_t count = registry->size();
+    const char* source = registry->builtin ? "builtin table"
+                         : registry->image ? "image"
+                                           : "files";
+    publishServiceRegistry(std::move(registry));
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    SLP_LOG_INFO("SLP service registry loaded from %s: %zu services in %lldus",
+                 source, count,
+                 static_cast<long long>(elapsed.count()));
+
+    return true;
+}
+
+RegistryReader getServiceRegistry()
+{
+    {
+        auto registry = registrySnapshot().read();
+        if (registry)
+        {
+            return registry;
+        }
+    }
+
+    reloadServiceRegistry();
+    return registrySnapshot().read();
+}
 } // namespace internal
 
+/* Who answers a message type, as a service agent and as a directory
+ * agent that answers from the registrations it accepted */
+struct MessageHandler
+{
+    std::tuple<int, buffer> (*sa)(const Message& msg) = nullptr;
+    std::tuple<int, buffer> (*da)(const Message& msg) = nullptr;
+    /* The previous responder list of the requests carrying one */
+    std::string_view (*prList)(const Message& msg) = nullptr;
+    /* The reply as a service agent, for the requests answered from the
+     * registry alone, whose replies can be cached */
+    std::tuple<int, cache::Reply> (*prepare)(const Message& msg) = nullptr;
+};
+
+#if !SLP_SA
+/* Replies to the registrations of a registrar that is not built in */
+static std::tuple<int, buffer> ignoreReply(const Message& /*msg*/)
+{
+    return std::make_tuple(slp::SUCCESS, buffer());
+}
+#endif
+
+static constexpr slp::dispatch::Table<MessageHandler> handlers = [] {
+    slp::dispatch::Table<MessageHandler> table{};
+
+    table[(uint8_t)slp::FunctionType::SRVRQST] = {
+        internal::processSrvRequest, nullptr,
+        [](const Message& msg) -> std::string_view {
+            return msg.body.srvrqst.prList;
+        },
+        internal::prepareSrvReply};
+    // Replies to the registrations slpd sends are never answered
+#if SLP_SA
+    table[(uint8_t)slp::FunctionType::SRVACK] = {slp::sa::processSrvAck,
+                                                 slp::sa::processSrvAck};
+    table[(uint8_t)slp::FunctionType::DAADVERT] = {slp::sa::processDAAdvert,
+                                                   slp::sa::processDAAdvert};
+#else
+    table[(uint8_t)slp::FunctionType::SRVACK] = {ignoreReply, ignoreReply};
+    table[(uint8_t)slp::FunctionType::DAADVERT] = {ignoreReply, ignoreReply};
+#endif
+    table[(uint8_t)slp::FunctionType::SRVTYPERQST] = {
+        internal::processSrvTypeRequest, nullptr,
+        [](const Message& msg) -> std::string_view {
+            return msg.body.srvtyperqst.prList;
+        },
+        [](const Message& msg) -> std::tuple<int, cache::Reply> {
+            auto [rc, message] = internal::processSrvTypeRequest(msg);
+            return std::make_tuple(rc, cache::Reply{std::move(message)});
+        }};
+#if SLP_DA
+    table[(uint8_t)slp::FunctionType::SRVRQST].da = slp::da::processSrvRequest;
+    table[(uint8_t)slp::FunctionType::SRVREG].da = slp::da::processSrvReg;
+    table[(uint8_t)slp::FunctionType::SRVDEREG].da = slp::da::processSrvDeReg;
+    table[(uint8_t)slp::FunctionType::SRVTYPERQST].da =
+        slp::da::processSrvTypeRequest;
+#endif
+    return table;
+}();
+
+/* Whether slpd runs as a directory agent, never without the DA built in */
+static bool directoryAgent()
+{
+#if SLP_DA
+    return slp::da::enabled();
+#else
+    return false;
+#endif
+}
+
+/* RFC 2608 section 6.3, an agent listed as a previous responder does not
+ * answer the retransmissions of a request */
+static bool answeredBefore(const Message& req)
+{
+    const auto* type = slp::dispatch::find(handlers, req.header.functionID);
+    if (!type || !type->prList)
+    {
+        return false;
+    }
+    auto prList = type->prList(req);
+    if (prList.empty())
+    {
+        return false;
+    }
+    auto registry = internal::getServiceRegistry();
+    return registry->table(req.ns).answeredBefore(prList);
+}
+
 std::tuple<int, buffer> processRequest(const Message& msg)
 {
-    int rc = slp::SUCCESS;
-    buffer resp;
-    std::cout << "SLP Processing Request="
-              << std::bitset<8>(msg.header.functionID) << "\n";
-
-    switch (msg.header.functionID)
-    {
-        case (uint8_t)slp::FunctionType::SRVTYPERQST:
-            std::tie(rc, resp) =
-                slp::handler::internal::processSrvTypeRequest(msg);
-            break;
-        case (uint8_t)slp::FunctionType::SRVRQST:
-            std::tie(rc, resp) = slp::handler::internal::processSrvRequest(msg);
-            break;
-        default:
-            rc = (uint8_t)slp::Error::MSG_NOT_SUPPORTED;
+    SLP_LOG_INFO("SLP Processing Request=0x%02x", msg.header.functionID);
+
+    const auto* type = slp::dispatch::find(handlers, msg.header.functionID);
+    auto handler =
+        !type ? nullptr : directoryAgent() ? type->da : type->sa;
+    if (!handler)
+    {
+        return std::make_tuple((int)slp::Error::MSG_NOT_SUPPORTED, buffer());
     }
-    return std::make_tuple(rc, resp);
+    return handler(msg);
 }
 
 buffer processError(const Message& req, uint8_t err)
 {
     if (req.header.functionID != 0)
     {
-        std::cout << "Processing Error for function: "
-                  << std::bitset<8>(req.header.functionID) << std::endl;
+        SLP_LOG_INFO("Processing Error for function: 0x%02x",
+                     req.header.functionID);
     }
 
     /*  0                   1                   2                   3
@@ -414,8 +1053,8 @@ buffer processError(const Message& req, uint8_t err)
 
     buff[slp::header::OFFSET_VERSION] = req.header.version;
 
-    // will increment the function id from 1 as reply
-    buff[slp::header::OFFSET_FUNCTION] = req.header.functionID + 1;
+    buff[slp::header::OFFSET_FUNCTION] =
+        internal::replyFunction(req.header.functionID);
 
     std::copy_n(&length, slp::header::SIZE_LENGTH,
                 buff.data() + slp::header::OFFSET_LENGTH);
@@ -444,5 +1083,169 @@ buffer processError(const Message& req, uint8_t err)
 
     return buff;
 }
+
+/* Process a request, the reply as the cache keeps it */
+static std::tuple<int, cache::Reply> prepareReply(const Message& msg)
+{
+    const auto* type = slp::dispatch::find(handlers, msg.header.functionID);
+    if (!type || !type->prepare || directoryAgent())
+    {
+        auto [rc, message] = processRequest(msg);
+        return std::make_tuple(rc, cache::Reply{std::move(message)});
+    }
+
+    SLP_LOG_INFO("SLP Processing Request=0x%02x", msg.header.functionID);
+    return type->prepare(msg);
+}
+
+/* Whether the outcome of a datagram can be cached, judged from its
+ * header: a request a service agent answers from the registry alone */
+static bool cacheable(const buffer& request)
+{
+    if (slp::cache::responses().capacity() == 0 || directoryAgent() ||
+        request.size() < slp::header::MIN_LEN ||
+        request.size() > slp::MAX_LEN ||
+        request[slp::header::OFFSET_VERSION] != slp::VERSION_2)
+    {
+        return false;
+    }
+
+    const auto* type = slp::dispatch::find(
+        handlers, request[slp::header::OFFSET_FUNCTION]);
+    return type && type->prepare;
+}
+
+/* Answer a request from the outcome of an identical one */
+static bool answerCached(const cache::Entry& entry, const buffer& request,
+                         buffer& resp, bool& multicast)
+{
+    SLP_PROBE(cache_hit,
+              (request[slp::header::OFFSET_XID] << 8) |
+                  request[slp::header::OFFSET_XID + 1],
+              request[slp::header::OFFSET_FUNCTION]);
+    multicast = entry.multicast;
+    if (!entry.answered)
+    {
+        return false;
+    }
+
+    // Only the XID of the reply differs, and the lifetimes advertised
+    auto message = entry.message();
+    resp.assign(message.begin(), message.end());
+    std::copy_n(request.data() + slp::header::OFFSET_XID,
+                slp::header::SIZE_XID, resp.data() + slp::header::OFFSET_XID);
+    if (entry.urlEntries != 0)
+    {
+        internal::advertiseLifetimes(
+            std::span(resp).subspan(entry.urlEntries), entry.until);
+    }
+    slp::trace::mark(slp::trace::Stage::PROCESS);
+    return true;
+}
+
+/* Parse and process a datagram, the reply as the cache keeps it. Only
+ * the outcome of a request that parsed follows from its bytes and the
+ * registry alone. */
+static bool respond(const buffer& request, bool multicastDest,
+                    cache::Reply& reply, bool& multicast, bool& parsed,
+                    size_t ns)
+{
+    int rc = slp::SUCCESS;
+    Message req;
+
+    // This code currently assume a maximum of 255 bytes in a receive
+    // or response message. Enforce that here.
+    if (request.size() > slp::MAX_LEN)
+    {
+        SLP_LOG_ERROR("Message size exceeds maximum allowed: %zu / %zu",
+                      request.size(), slp::MAX_LEN);
+
+        rc = static_cast<uint8_t>(slp::Error::PARSE_ERROR);
+    }
+    // An empty datagram is left to the parser, which rejects it
+    else if (!request.empty() && request[0] != slp::VERSION_2)
+    {
+        SLP_LOG_INFO("SLP Unsupported Request Version=%d", (int)request[0]);
+
+        rc = static_cast<uint8_t>(slp::Error::VER_NOT_SUPPORTED);
+    }
+    else
+    {
+        // Parse the buffer and construct the req object
+        std::tie(rc, req) = slp::parser::parseBuffer(request);
+        req.ns = ns;
+        parsed = !rc;
+        SLP_PROBE(parse_done, req.header.xid, req.header.functionID);
+        slp::trace::mark(slp::trace::Stage::PARSE);
+        if (!rc && answeredBefore(req))
+        {
+            SLP_PROBE(answered_before, req.header.xid, req.header.functionID);
+            return false;
+        }
+        if (!rc)
+        {
+            // Passing the req object to handler to serve it
+            std::tie(rc, reply) = prepareReply(req);
+        }
+        if (!rc && reply.message.empty())
+        {
+            // A reply, consumed without answering it
+            SLP_PROBE(process_done, req.header.xid, req.header.functionID);
+            return false;
+        }
+    }
+
+    multicast = multicastDest || (req.header.flags & slp::header::FLAG_MCAST);
+
+    // if there was error during Parsing of request
+    // or processing of request then handle the error.
+    if (rc)
+    {
+        // RFC 2608 section 6.1, no error replies to multicast requests
+        if (multicast)
+        {
+            return false;
+        }
+        reply = cache::Reply{processError(req, rc)};
+    }
+    SLP_PROBE(process_done, req.header.xid, req.header.functionID);
+    slp::trace::mark(slp::trace::Stage::PROCESS);
+    return true;
+}
+
+bool serveRequest(const buffer& request, bool multicastDest, buffer& resp,
+                  bool& multicast, size_t ns)
+{
+    // Repeated requests are answered from the cache, unparsed
+    auto& cache = slp::cache::responses();
+    bool cached = cacheable(request);
+    uint64_t generation = 0;
+    if (cached)
+    {
+        generation = internal::getServiceRegistry()->generation;
+        const auto* entry = cache.find(request, ns, multicastDest, generation);
+        if (entry)
+        {
+            return answerCached(*entry, request, resp, multicast);
+        }
+    }
+
+    cache::Reply reply;
+    bool parsed = false;
+    bool answered =
+        respond(request, multicastDest, reply, multicast, parsed, ns);
+    if (cached && parsed)
+    {
+        cache.insert(request, ns, multicastDest, generation, answered,
+                     multicast, reply);
+    }
+    if (answered && reply.urlEntries != 0)
+    {
+        internal::advertiseLifetimes(
+            std::span(reply.message).subspan(reply.urlEntries), reply.until);
+    }
+    resp = std::move(reply.message);
+    return answered;
+}
 } // namespace handler
 } // namespace slp
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace slp
 {
 /** @brief SLP Version */
@@ -7,10 +10,40 @@ constexpr size_t VERSION_2 = 2;
 constexpr auto SUCCESS = 0;
 /** @brief SLP Port */
 constexpr auto PORT = 427;
+/** @brief SLP administratively scoped multicast group */
+constexpr auto MULTICAST_ADDR = "239.255.255.253";
 
 constexpr auto TIMEOUT = 30;
-/** @brief SLP service lifetime */
+/** @brief SLP service lifetime, unless the service file sets one */
 constexpr auto LIFETIME = 5;
+/** @brief Longest lifetime the query rate scales a lifetime up to */
+constexpr auto LIFETIME_MAX = 3600;
+/** @brief Queries per second above which the lifetimes are scaled up */
+constexpr auto QUERY_RATE = 2;
+/** @brief Shortest period, in seconds, the query rate is measured over */
+constexpr auto RATE_WINDOW = 10;
+/** @brief Holds the time of a planned registry change, seconds since the
+ *  epoch, the lifetimes are cut short to end by then */
+constexpr auto PLANNED_CHANGE = "/run/slpd/planned-change";
+/** @brief Seconds between unsolicited DAAdverts, CONFIG_DA_BEAT */
+constexpr auto DA_BEAT = 10800;
+/** @brief Lifetime of the registrations with a directory agent */
+constexpr auto REG_LIFETIME = 3600;
+/** @brief Directory holding one file per offered service */
+constexpr auto SERVICE_DIR = "/etc/slp/services/";
+/** @brief Registry compiled from SERVICE_DIR by slp-registry-compile */
+constexpr auto REGISTRY_IMAGE = "/var/lib/slpd/registry.img";
+/** @brief Directory of the named network namespaces, see ip-netns(8) */
+constexpr auto NETNS_DIR = "/run/netns/";
+/** @brief Seconds between checks of the interface addresses */
+constexpr auto ADDRESS_RECHECK = 30;
+/** @brief Directory holding the local private keys, <SPI>.pem each */
+constexpr auto AUTH_KEY_DIR = "/etc/slp/keys/";
+/** @brief Seconds a signed URL entry is valid for */
+constexpr auto AUTH_LIFETIME = 3600;
+/** @brief Sign again this many seconds before the signatures expire,
+ *  more than ADDRESS_RECHECK so that a check always catches it */
+constexpr auto AUTH_REFRESH = 300;
 
 /** @brief Largest input or output buffer allowed */
 constexpr size_t MAX_LEN = 255;
@@ -38,6 +71,11 @@ constexpr size_t OFFSET_LANG_LEN = 12;
 constexpr size_t OFFSET_LANG = 14;
 
 constexpr size_t MIN_LEN = 14;
+
+/** @brief Header flags, in host order */
+constexpr uint16_t FLAG_OVERFLOW = 0x8000;
+constexpr uint16_t FLAG_FRESH = 0x4000;
+constexpr uint16_t FLAG_MCAST = 0x2000;
 } // namespace header
 
 /** @brief Defines the constants for slp response.
@@ -70,6 +108,10 @@ namespace request
 
 constexpr size_t MIN_SRVTYPE_LEN = 22;
 constexpr size_t MIN_SRV_LEN = 24;
+constexpr size_t MIN_SRVREG_LEN = 27;
+constexpr size_t MIN_SRVDEREG_LEN = 24;
+constexpr size_t MIN_DAADVERT_LEN = 29;
+constexpr size_t MIN_SRVACK_LEN = 16;
 
 constexpr size_t SIZE_PRLIST = 2;
 constexpr size_t SIZE_NAMING = 2;
@@ -82,5 +124,14 @@ constexpr size_t OFFSET_PR_LEN = 16;
 constexpr size_t OFFSET_PR = 18;
 constexpr size_t OFFSET_SERVICE = 20;
 
+constexpr size_t SIZE_URL_ENTRY = 5;
+constexpr size_t SIZE_URL_AUTHS = 1;
+constexpr size_t SIZE_ATTR = 2;
+constexpr size_t SIZE_ATTR_AUTHS = 1;
+constexpr size_t SIZE_TAG = 2;
+constexpr size_t SIZE_AUTH_HEADER = 4;
+constexpr size_t SIZE_ERROR = 2;
+constexpr size_t SIZE_BOOT_TIMESTAMP = 4;
+
 } // namespace request
 } // namespace slp
@@ -0,0 +1,129 @@
+#include "slp_netns.hpp"
+
+#include "slp_log.hpp"
+#include "slp_meta.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace slp
+{
+namespace netns
+{
+
+namespace
+{
+
+struct Namespace
+{
+    std::string name;
+    int fd = -1;
+};
+
+/* slpd's own namespace first, opened along with the named ones */
+std::vector<Namespace> namespaces(1);
+
+void closeAll()
+{
+    for (auto& ns : namespaces)
+    {
+        if (ns.fd >= 0)
+        {
+            ::close(ns.fd);
+        }
+    }
+    namespaces.resize(1);
+    namespaces[0].fd = -1;
+}
+
+} // namespace
+
+int open(const std::vector<std::string>& names)
+{
+    closeAll();
+    if (names.empty())
+    {
+        return 0;
+    }
+
+    namespaces[0].fd = ::open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (namespaces[0].fd < 0)
+    {
+        int rc = -errno;
+        SLP_LOG_ERROR("Unable to open the own network namespace: %s",
+                      strerror(-rc));
+        return rc;
+    }
+
+    for (const auto& name : names)
+    {
+        if (name.empty() || name.find('/') != std::string::npos)
+        {
+            SLP_LOG_ERROR("Invalid network namespace name: %s", name.c_str());
+            closeAll();
+            return -EINVAL;
+        }
+
+        auto path = std::string(slp::NETNS_DIR) + name;
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            int rc = -errno;
+            SLP_LOG_ERROR("Unable to open the network namespace %s: %s",
+                          path.c_str(), strerror(-rc));
+            closeAll();
+            return rc;
+        }
+        namespaces.push_back({name, fd});
+    }
+    return 0;
+}
+
+size_t count()
+{
+    return namespaces.size();
+}
+
+const std::string& name(size_t ns)
+{
+    return namespaces[ns < namespaces.size() ? ns : 0].name;
+}
+
+Enter::Enter(size_t ns) : ns(ns)
+{
+    if (ns == 0)
+    {
+        return;
+    }
+    if (ns >= namespaces.size())
+    {
+        rc = -EINVAL;
+        return;
+    }
+    if (setns(namespaces[ns].fd, CLONE_NEWNET) < 0)
+    {
+        rc = -errno;
+    }
+}
+
+Enter::~Enter()
+{
+    if (ns == 0 || rc < 0)
+    {
+        return;
+    }
+    if (setns(namespaces[0].fd, CLONE_NEWNET) < 0)
+    {
+        // Carrying on in the wrong namespace would serve it twice
+        SLP_LOG_ERROR("Unable to return to the own network namespace: %s",
+                      strerror(errno));
+        abort();
+    }
+}
+
+} // namespace netns
+} // namespace slp
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+namespace slp
+{
+
+/** Network namespaces served by one slpd.
+ *
+ *  Namespace 0 is the one slpd started in, the named namespaces opened
+ *  with open() follow it in order. Sockets are tied to the namespace
+ *  they are created in, so the server enters each namespace only to
+ *  create its socket, join the multicast group and read its interface
+ *  addresses, and serves all of them from one event loop. slpd is single
+ *  threaded, entering a namespace switches the whole process.
+ */
+namespace netns
+{
+
+/** @brief Open named network namespaces, as created by ip netns.
+ *
+ *  @param[in] names - The names, files in NETNS_DIR.
+ *
+ *  @return Zero on success, else a negative errno and no namespace
+ *          beyond slpd's own is served.
+ */
+int open(const std::vector<std::string>& names);
+
+/** @brief Number of namespaces served, slpd's own included */
+size_t count();
+
+/** @brief Name of a namespace, empty for slpd's own */
+const std::string& name(size_t ns);
+
+/** @class Enter
+ *
+ *  @brief Switch to a namespace for the lifetime of the object, and
+ *         back to slpd's own one afterwards.
+ */
+class Enter
+{
+  public:
+    explicit Enter(size_t ns);
+    ~Enter();
+
+    Enter(const Enter&) = delete;
+    Enter& operator=(const Enter&) = delete;
+
+    /** @brief Zero if the namespace was entered, else a negative errno */
+    int error() const
+    {
+        return rc;
+    }
+
+  private:
+    size_t ns;
+    int rc = 0;
+};
+
+} // namespace netns
+} // namespace slp
@@ -1,10 +1,14 @@
 #include "endian.hpp"
 #include "slp.hpp"
+#include "slp_dispatch.hpp"
+#include "slp_log.hpp"
 #include "slp_meta.hpp"
+#include "slp_text.hpp"
 
 #include <string.h>
 
 #include <algorithm>
+#include <initializer_list>
 #include <string>
 
 namespace slp
@@ -16,6 +20,130 @@ namespace parser
 namespace internal
 {
 
+namespace
+{
+
+/* Parse a string preceded by its 2 byte length and move past it. */
+int parseString(const buffer& buff, uint32_t& pos, std::string& out,
+                const char* field)
+{
+    uint16_t len;
+    if ((pos + sizeof(len)) > buff.size())
+    {
+        SLP_LOG_ERROR("%s length field is greater than input buffer: "
+                      "%zu / %zu",
+                      field, pos + sizeof(len), buff.size());
+        return (int)slp::Error::PARSE_ERROR;
+    }
+    std::copy_n(buff.data() + pos, sizeof(len), (uint8_t*)&len);
+
+    pos += sizeof(len);
+    len = endian::from_network(len);
+
+    if ((pos + len) > buff.size())
+    {
+        SLP_LOG_ERROR("Length of %s is greater than input buffer: %zu / %zu",
+                      field, static_cast<size_t>(pos + len), buff.size());
+        return (int)slp::Error::PARSE_ERROR;
+    }
+    out.assign((const char*)buff.data() + pos, len);
+
+    pos += len;
+    return slp::SUCCESS;
+}
+
+/* Check that strings are UTF-8, RFC 2608 section 4. */
+bool validText(std::initializer_list<std::string_view> strings)
+{
+    return std::all_of(strings.begin(), strings.end(),
+                       [](std::string_view str) {
+                           return slp::text::validUTF8(str);
+                       });
+}
+
+/* Move past a counted list of authentication blocks. */
+int skipAuthBlocks(const buffer& buff, uint32_t& pos)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |  Block Structure Descriptor   |  Authentication Block Length  |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                 ... rest of the block ...                     \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    if ((pos + slp::request::SIZE_URL_AUTHS) > buff.size())
+    {
+        SLP_LOG_ERROR("Auth block count is greater than input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_URL_AUTHS, buff.size());
+        return (int)slp::Error::PARSE_ERROR;
+    }
+    uint8_t count = buff[pos];
+    pos += slp::request::SIZE_URL_AUTHS;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint16_t blockLen;
+        if ((pos + slp::request::SIZE_AUTH_HEADER) > buff.size())
+        {
+            SLP_LOG_ERROR("Auth block header is greater than input buffer: "
+                          "%zu / %zu",
+                          pos + slp::request::SIZE_AUTH_HEADER, buff.size());
+            return (int)slp::Error::PARSE_ERROR;
+        }
+        std::copy_n(buff.data() + pos + sizeof(uint16_t), sizeof(blockLen),
+                    (uint8_t*)&blockLen);
+        blockLen = endian::from_network(blockLen);
+
+        if (blockLen < slp::request::SIZE_AUTH_HEADER ||
+            (pos + blockLen) > buff.size())
+        {
+            SLP_LOG_ERROR("Invalid auth block length: %u", blockLen);
+            return (int)slp::Error::PARSE_ERROR;
+        }
+        pos += blockLen;
+    }
+    return slp::SUCCESS;
+}
+
+/* Parse a URL entry and move past it. */
+int parseURLEntry(const buffer& buff, uint32_t& pos,
+                  slp::request::URLEntry& entry)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |   Reserved    |          Lifetime             |   URL Length  |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |URL len, contd.|            URL (variable length)              \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |# of URL auths |            Auth. blocks (if any)              \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    if ((pos + slp::request::SIZE_URL_ENTRY) > buff.size())
+    {
+        SLP_LOG_ERROR("URL entry is greater than input buffer: %zu / %zu",
+                      pos + slp::request::SIZE_URL_ENTRY, buff.size());
+        return (int)slp::Error::PARSE_ERROR;
+    }
+
+    pos += slp::response::SIZE_RESERVED;
+    std::copy_n(buff.data() + pos, slp::response::SIZE_LIFETIME,
+                (uint8_t*)&entry.lifetime);
+    entry.lifetime = endian::from_network(entry.lifetime);
+    pos += slp::response::SIZE_LIFETIME;
+
+    int rc = parseString(buff, pos, entry.url, "URL");
+    if (rc)
+    {
+        return rc;
+    }
+    return skipAuthBlocks(buff, pos);
+}
+
+} // namespace
+
 std::tuple<int, Message> parseHeader(const buffer& buff)
 {
     /*  0                   1                   2                   3
@@ -35,7 +163,7 @@ std::tuple<int, Message> parseHeader(const buffer& buff)
 
     if (buff.size() < slp::header::MIN_LEN)
     {
-        std::cerr << "Invalid msg size: " << buff.size() << std::endl;
+        SLP_LOG_ERROR("Invalid msg size: %zu", buff.size());
         rc = static_cast<int>(slp::Error::PARSE_ERROR);
     }
     else
@@ -71,8 +199,7 @@ std::tuple<int, Message> parseHeader(const buffer& buff)
         // Enforce language tag size limits
         if ((slp::header::OFFSET_LANG + langtagLen) > buff.size())
         {
-            std::cerr << "Invalid Language Tag Length: " << langtagLen
-                      << std::endl;
+            SLP_LOG_ERROR("Invalid Language Tag Length: %u", langtagLen);
             rc = static_cast<int>(slp::Error::PARSE_ERROR);
         }
         else
@@ -88,8 +215,7 @@ std::tuple<int, Message> parseHeader(const buffer& buff)
                 req.header.functionID >
                     static_cast<uint8_t>(slp::FunctionType::SAADV))
             {
-                std::cerr << "Invalid function ID: " << req.header.functionID
-                          << std::endl;
+                SLP_LOG_ERROR("Invalid function ID: %u", req.header.functionID);
                 rc = static_cast<int>(slp::Error::PARSE_ERROR);
             }
         }
@@ -121,9 +247,9 @@ int parseSrvTypeRqst(const buffer& buff, Message& req)
     uint32_t pos = slp::header::MIN_LEN + req.header.langtagLen;
     if ((pos + slp::request::SIZE_PRLIST) > buff.size())
     {
-        std::cerr << "PRList length field is greater than input buffer: "
-                  << (pos + slp::request::SIZE_PRLIST) << " / " << buff.size()
-                  << std::endl;
+        SLP_LOG_ERROR("PRList length field is greater than input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_PRLIST, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_PRLIST,
@@ -134,9 +260,9 @@ int parseSrvTypeRqst(const buffer& buff, Message& req)
 
     if ((pos + prListLen) > buff.size())
     {
-        std::cerr << "Length of PRList is greater than input buffer: "
-                  << (slp::request::OFFSET_PR + prListLen) << " / "
-                  << buff.size() << std::endl;
+        SLP_LOG_ERROR("Length of PRList is greater than input buffer: "
+                      "%zu / %zu",
+                      slp::request::OFFSET_PR + prListLen, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
 
@@ -149,9 +275,9 @@ int parseSrvTypeRqst(const buffer& buff, Message& req)
     uint16_t namingAuthLen;
     if ((pos + slp::request::SIZE_NAMING) > buff.size())
     {
-        std::cerr << "Naming auth length field is greater than input buffer: "
-                  << (pos + slp::request::SIZE_NAMING) << " / " << buff.size()
-                  << std::endl;
+        SLP_LOG_ERROR("Naming auth length field is greater than input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_NAMING, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_NAMING,
@@ -170,9 +296,10 @@ int parseSrvTypeRqst(const buffer& buff, Message& req)
     {
         if ((pos + namingAuthLen) > buff.size())
         {
-            std::cerr << "Length of Naming Size is greater than input buffer: "
-                      << (pos + namingAuthLen) << " / " << buff.size()
-                      << std::endl;
+            SLP_LOG_ERROR("Length of Naming Size is greater than input buffer: "
+                          "%zu / %zu",
+                          static_cast<size_t>(pos + namingAuthLen),
+                          buff.size());
             return (int)slp::Error::PARSE_ERROR;
         }
         req.body.srvtyperqst.namingAuth.insert(
@@ -185,9 +312,9 @@ int parseSrvTypeRqst(const buffer& buff, Message& req)
     uint16_t scopeListLen;
     if ((pos + slp::request::SIZE_SCOPE) > buff.size())
     {
-        std::cerr << "Length of Scope size is greater than input buffer: "
-                  << (pos + slp::request::SIZE_SCOPE) << " / " << buff.size()
-                  << std::endl;
+        SLP_LOG_ERROR("Length of Scope size is greater than input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_SCOPE, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_SCOPE,
@@ -198,8 +325,9 @@ int parseSrvTypeRqst(const buffer& buff, Message& req)
     scopeListLen = endian::from_network(scopeListLen);
     if ((pos + scopeListLen) > buff.size())
     {
-        std::cerr << "Length of Scope List is greater than input buffer: "
-                  << (pos + scopeListLen) << " / " << buff.size() << std::endl;
+        SLP_LOG_ERROR("Length of Scope List is greater than input buffer: "
+                      "%zu / %zu",
+                      static_cast<size_t>(pos + scopeListLen), buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
 
@@ -236,9 +364,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
     uint32_t pos = slp::header::MIN_LEN + req.header.langtagLen;
     if ((pos + slp::request::SIZE_PRLIST) > buff.size())
     {
-        std::cerr << "PRList length field is greater then input buffer: "
-                  << (pos + slp::request::SIZE_PRLIST) << " / " << buff.size()
-                  << std::endl;
+        SLP_LOG_ERROR("PRList length field is greater then input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_PRLIST, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_PRLIST,
@@ -249,9 +377,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
     prListLen = endian::from_network(prListLen);
     if ((pos + prListLen) > buff.size())
     {
-        std::cerr << "Length of PRList is greater then input buffer: "
-                  << (slp::request::OFFSET_PR + prListLen) << " / "
-                  << buff.size() << std::endl;
+        SLP_LOG_ERROR("Length of PRList is greater then input buffer: "
+                      "%zu / %zu",
+                      slp::request::OFFSET_PR + prListLen, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     req.body.srvrqst.prList.insert(0, (const char*)buff.data() + pos,
@@ -263,9 +391,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
     uint16_t srvTypeLen;
     if ((pos + slp::request::SIZE_SERVICE_TYPE) > buff.size())
     {
-        std::cerr << "SrvType length field is greater then input buffer: "
-                  << (pos + slp::request::SIZE_SERVICE_TYPE) << " / "
-                  << buff.size() << std::endl;
+        SLP_LOG_ERROR("SrvType length field is greater then input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_SERVICE_TYPE, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_SERVICE_TYPE,
@@ -277,8 +405,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
 
     if ((pos + srvTypeLen) > buff.size())
     {
-        std::cerr << "Length of SrvType is greater then input buffer: "
-                  << (pos + srvTypeLen) << " / " << buff.size() << std::endl;
+        SLP_LOG_ERROR("Length of SrvType is greater then input buffer: "
+                      "%zu / %zu",
+                      static_cast<size_t>(pos + srvTypeLen), buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     req.body.srvrqst.srvType.insert(0, (const char*)buff.data() + pos,
@@ -290,9 +419,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
     uint16_t scopeListLen;
     if ((pos + slp::request::SIZE_SCOPE) > buff.size())
     {
-        std::cerr << "Scope List length field is greater then input buffer: "
-                  << (pos + slp::request::SIZE_SCOPE) << " / " << buff.size()
-                  << std::endl;
+        SLP_LOG_ERROR("Scope List length field is greater then input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_SCOPE, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_SCOPE,
@@ -304,8 +433,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
 
     if ((pos + scopeListLen) > buff.size())
     {
-        std::cerr << "Length of Scope List is greater then input buffer: "
-                  << (pos + scopeListLen) << " / " << buff.size() << std::endl;
+        SLP_LOG_ERROR("Length of Scope List is greater then input buffer: "
+                      "%zu / %zu",
+                      static_cast<size_t>(pos + scopeListLen), buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     req.body.srvrqst.scopeList.insert(0, (const char*)buff.data() + pos,
@@ -317,9 +447,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
     uint16_t predicateLen;
     if ((pos + slp::request::SIZE_PREDICATE) > buff.size())
     {
-        std::cerr << "Predicate length field is greater then input buffer: "
-                  << (pos + slp::request::SIZE_PREDICATE) << " / "
-                  << buff.size() << std::endl;
+        SLP_LOG_ERROR("Predicate length field is greater then input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_PREDICATE, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_PREDICATE,
@@ -330,8 +460,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
 
     if ((pos + predicateLen) > buff.size())
     {
-        std::cerr << "Length of Predicate is greater then input buffer: "
-                  << (pos + predicateLen) << " / " << buff.size() << std::endl;
+        SLP_LOG_ERROR("Length of Predicate is greater then input buffer: "
+                      "%zu / %zu",
+                      static_cast<size_t>(pos + predicateLen), buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     req.body.srvrqst.predicate.insert(0, (const char*)buff.data() + pos,
@@ -343,9 +474,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
     uint16_t spistrLen;
     if ((pos + slp::request::SIZE_SLPI) > buff.size())
     {
-        std::cerr << "SLP SPI length field is greater then input buffer: "
-                  << (pos + slp::request::SIZE_SLPI) << " / " << buff.size()
-                  << std::endl;
+        SLP_LOG_ERROR("SLP SPI length field is greater then input buffer: "
+                      "%zu / %zu",
+                      pos + slp::request::SIZE_SLPI, buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     std::copy_n(buff.data() + pos, slp::request::SIZE_SLPI,
@@ -356,8 +487,9 @@ int parseSrvRqst(const buffer& buff, Message& req)
 
     if ((pos + spistrLen) > buff.size())
     {
-        std::cerr << "Length of SLP SPI is greater then input buffer: "
-                  << (pos + spistrLen) << " / " << buff.size() << std::endl;
+        SLP_LOG_ERROR("Length of SLP SPI is greater then input buffer: "
+                      "%zu / %zu",
+                      static_cast<size_t>(pos + spistrLen), buff.size());
         return (int)slp::Error::PARSE_ERROR;
     }
     req.body.srvrqst.spistr.insert(0, (const char*)buff.data() + pos,
@@ -365,28 +497,251 @@ int parseSrvRqst(const buffer& buff, Message& req)
 
     return slp::SUCCESS;
 }
+
+int parseSrvReg(const buffer& buff, Message& req)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                          <URL-Entry>                          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       | length of service type string |        <service-type>         \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |     length of <scope-list>    |         <scope-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |  length of attr-list string   |          <attr-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |# of AttrAuths |(if present) Attribute Authentication Blocks...\
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    auto& reg = req.body.srvreg;
+    uint32_t pos = slp::header::MIN_LEN + req.header.langtagLen;
+
+    int rc = parseURLEntry(buff, pos, reg.urlEntry);
+    if (!rc)
+    {
+        rc = parseString(buff, pos, reg.srvType, "SrvType");
+    }
+    if (!rc)
+    {
+        rc = parseString(buff, pos, reg.scopeList, "Scope List");
+    }
+    if (!rc)
+    {
+        rc = parseString(buff, pos, reg.attrList, "Attr List");
+    }
+    if (!rc)
+    {
+        rc = skipAuthBlocks(buff, pos);
+    }
+    return rc;
+}
+
+int parseSrvDeReg(const buffer& buff, Message& req)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |    Length of <scope-list>     |         <scope-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                           URL Entry                           \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |      Length of <tag-list>     |            <tag-list>         \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    auto& dereg = req.body.srvdereg;
+    uint32_t pos = slp::header::MIN_LEN + req.header.langtagLen;
+
+    int rc = parseString(buff, pos, dereg.scopeList, "Scope List");
+    if (!rc)
+    {
+        rc = parseURLEntry(buff, pos, dereg.urlEntry);
+    }
+    if (!rc)
+    {
+        rc = parseString(buff, pos, dereg.tagList, "Tag List");
+    }
+    return rc;
+}
+
+int parseDAAdvert(const buffer& buff, Message& req)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |          Error Code           |  DA Stateless Boot Timestamp  |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |DA Stateless Boot Time,, contd.|         Length of URL         |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       \                              URL                              \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |     Length of <scope-list>    |         <scope-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |     Length of <attr-list>     |          <attr-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |    Length of <SLP SPI List>   |     <SLP SPI List> String     \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       | # Auth Blocks |         Authentication block (if any)         \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    auto& advert = req.body.daadvert;
+    uint32_t pos = slp::header::MIN_LEN + req.header.langtagLen;
+
+    if ((pos + slp::request::SIZE_ERROR + slp::request::SIZE_BOOT_TIMESTAMP) >
+        buff.size())
+    {
+        SLP_LOG_ERROR("DAAdvert is greater than input buffer: %zu / %zu",
+                      pos + slp::request::SIZE_ERROR +
+                          slp::request::SIZE_BOOT_TIMESTAMP,
+                      buff.size());
+        return (int)slp::Error::PARSE_ERROR;
+    }
+    std::copy_n(buff.data() + pos, slp::request::SIZE_ERROR,
+                (uint8_t*)&advert.errorCode);
+    advert.errorCode = endian::from_network(advert.errorCode);
+    pos += slp::request::SIZE_ERROR;
+    std::copy_n(buff.data() + pos, slp::request::SIZE_BOOT_TIMESTAMP,
+                (uint8_t*)&advert.bootTimestamp);
+    advert.bootTimestamp = endian::from_network(advert.bootTimestamp);
+    pos += slp::request::SIZE_BOOT_TIMESTAMP;
+
+    int rc = parseString(buff, pos, advert.url, "URL");
+    if (!rc)
+    {
+        rc = parseString(buff, pos, advert.scopeList, "Scope List");
+    }
+    if (!rc)
+    {
+        rc = parseString(buff, pos, advert.attrList, "Attr List");
+    }
+    if (!rc)
+    {
+        rc = parseString(buff, pos, advert.spiList, "SPI List");
+    }
+    if (!rc)
+    {
+        rc = skipAuthBlocks(buff, pos);
+    }
+    return rc;
+}
+
+int parseSrvAck(const buffer& buff, Message& req)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |          Error Code           |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    auto& ack = req.body.srvack;
+    uint32_t pos = slp::header::MIN_LEN + req.header.langtagLen;
+
+    if ((pos + slp::request::SIZE_ERROR) > buff.size())
+    {
+        SLP_LOG_ERROR("SrvAck is greater than input buffer: %zu / %zu",
+                      pos + slp::request::SIZE_ERROR, buff.size());
+        return (int)slp::Error::PARSE_ERROR;
+    }
+    std::copy_n(buff.data() + pos, slp::request::SIZE_ERROR,
+                (uint8_t*)&ack.errorCode);
+    ack.errorCode = endian::from_network(ack.errorCode);
+    return slp::SUCCESS;
+}
 } // namespace internal
 
+namespace
+{
+
+/* How a message type is parsed */
+struct MessageParser
+{
+    int (*parse)(const buffer& buff, Message& req) = nullptr;
+    /* Shortest message of the type */
+    size_t minLen = 0;
+    /* Check the strings of the parsed message */
+    bool (*validText)(const Message& req) = nullptr;
+};
+
+constexpr slp::dispatch::Table<MessageParser> parsers = [] {
+    using internal::validText;
+    slp::dispatch::Table<MessageParser> table{};
+
+    table[(uint8_t)slp::FunctionType::SRVRQST] = {
+        internal::parseSrvRqst, slp::request::MIN_SRV_LEN,
+        [](const Message& req) {
+            const auto& rqst = req.body.srvrqst;
+            return validText({req.header.langtag, rqst.prList, rqst.srvType,
+                              rqst.scopeList, rqst.predicate, rqst.spistr});
+        }};
+    table[(uint8_t)slp::FunctionType::SRVREG] = {
+        internal::parseSrvReg, slp::request::MIN_SRVREG_LEN,
+        [](const Message& req) {
+            const auto& reg = req.body.srvreg;
+            return validText({req.header.langtag, reg.urlEntry.url,
+                              reg.srvType, reg.scopeList, reg.attrList});
+        }};
+    table[(uint8_t)slp::FunctionType::SRVDEREG] = {
+        internal::parseSrvDeReg, slp::request::MIN_SRVDEREG_LEN,
+        [](const Message& req) {
+            const auto& dereg = req.body.srvdereg;
+            return validText({req.header.langtag, dereg.scopeList,
+                              dereg.urlEntry.url, dereg.tagList});
+        }};
+    table[(uint8_t)slp::FunctionType::DAADVERT] = {
+        internal::parseDAAdvert, slp::request::MIN_DAADVERT_LEN,
+        [](const Message& req) {
+            const auto& advert = req.body.daadvert;
+            return validText({req.header.langtag, advert.url,
+                              advert.scopeList, advert.attrList,
+                              advert.spiList});
+        }};
+    table[(uint8_t)slp::FunctionType::SRVACK] = {
+        internal::parseSrvAck, slp::request::MIN_SRVACK_LEN,
+        [](const Message& req) { return validText({req.header.langtag}); }};
+    table[(uint8_t)slp::FunctionType::SRVTYPERQST] = {
+        internal::parseSrvTypeRqst, slp::request::MIN_SRVTYPE_LEN,
+        [](const Message& req) {
+            const auto& rqst = req.body.srvtyperqst;
+            return validText({req.header.langtag, rqst.prList,
+                              rqst.namingAuth, rqst.scopeList});
+        }};
+    return table;
+}();
+
+} // namespace
+
 std::tuple<int, Message> parseBuffer(const buffer& buff)
 {
     Message req;
     int rc = slp::SUCCESS;
     /* parse the header first */
     std::tie(rc, req) = internal::parseHeader(buff);
-    if (!rc)
+    if (rc)
     {
-        /* switch on the function id to parse the body */
-        switch (req.header.functionID)
-        {
-            case (uint8_t)slp::FunctionType::SRVTYPERQST:
-                rc = internal::parseSrvTypeRqst(buff, req);
-                break;
-            case (uint8_t)slp::FunctionType::SRVRQST:
-                rc = internal::parseSrvRqst(buff, req);
-                break;
-            default:
-                rc = (int)slp::Error::MSG_NOT_SUPPORTED;
-        }
+        return std::make_tuple(rc, std::move(req));
+    }
+
+    /* then the body, as its function id says */
+    const auto* type = slp::dispatch::find(parsers, req.header.functionID);
+    if (!type || !type->parse)
+    {
+        rc = (int)slp::Error::MSG_NOT_SUPPORTED;
+    }
+    else if (buff.size() < type->minLen)
+    {
+        SLP_LOG_ERROR("SLP message too short for function 0x%02x: %zu / %zu",
+                      req.header.functionID, buff.size(), type->minLen);
+        rc = (int)slp::Error::PARSE_ERROR;
+    }
+    else
+    {
+        rc = type->parse(buff, req);
+    }
+
+    if (!rc && !type->validText(req))
+    {
+        SLP_LOG_ERROR("SLP request with a string that is not UTF-8");
+        rc = (int)slp::Error::PARSE_ERROR;
     }
     return std::make_tuple(rc, std::move(req));
 }
@@ -0,0 +1,467 @@
+#include "slp_pcap.hpp"
+
+#include "slp.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace slp
+{
+
+namespace pcap
+{
+
+namespace
+{
+
+constexpr uint32_t PCAP_MAGIC_MICRO = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NANO = 0xa1b23c4d;
+constexpr size_t PCAP_HEADER = 24;
+constexpr size_t PCAP_RECORD = 16;
+
+constexpr uint32_t NG_SECTION = 0x0a0d0d0a;
+constexpr uint32_t NG_BYTE_ORDER = 0x1a2b3c4d;
+constexpr uint32_t NG_INTERFACE = 1;
+constexpr uint32_t NG_SIMPLE_PACKET = 3;
+constexpr uint32_t NG_ENHANCED_PACKET = 6;
+constexpr uint16_t NG_OPT_END = 0;
+constexpr uint16_t NG_OPT_TSRESOL = 9;
+
+constexpr uint32_t LINK_NULL = 0;
+constexpr uint32_t LINK_ETHERNET = 1;
+constexpr uint32_t LINK_RAW_OPENBSD = 12;
+constexpr uint32_t LINK_RAW_BSDOS = 14;
+constexpr uint32_t LINK_RAW = 101;
+constexpr uint32_t LINK_LINUX_SLL = 113;
+constexpr uint32_t LINK_IPV4 = 228;
+constexpr uint32_t LINK_IPV6 = 229;
+constexpr uint32_t LINK_LINUX_SLL2 = 276;
+
+constexpr uint16_t ETHERTYPE_IPV4 = 0x0800;
+constexpr uint16_t ETHERTYPE_IPV6 = 0x86dd;
+constexpr uint16_t ETHERTYPE_VLAN = 0x8100;
+constexpr uint16_t ETHERTYPE_QINQ = 0x88a8;
+
+constexpr uint8_t PROTO_UDP = 17;
+constexpr uint8_t IPV6_HOP_BY_HOP = 0;
+constexpr uint8_t IPV6_ROUTING = 43;
+constexpr uint8_t IPV6_FRAGMENT = 44;
+constexpr uint8_t IPV6_DEST_OPTS = 60;
+constexpr size_t UDP_HEADER = 8;
+
+/* Integers in the byte order of the capture */
+struct Reader
+{
+    std::span<const uint8_t> data;
+    bool swap = false;
+
+    bool has(size_t offset, size_t size) const
+    {
+        return offset <= data.size() && size <= data.size() - offset;
+    }
+
+    uint16_t u16(size_t offset) const
+    {
+        uint16_t value;
+        memcpy(&value, data.data() + offset, sizeof(value));
+        return swap ? __builtin_bswap16(value) : value;
+    }
+
+    uint32_t u32(size_t offset) const
+    {
+        uint32_t value;
+        memcpy(&value, data.data() + offset, sizeof(value));
+        return swap ? __builtin_bswap32(value) : value;
+    }
+};
+
+/* Integers in network byte order */
+uint16_t be16(std::span<const uint8_t> data, size_t offset)
+{
+    return (data[offset] << 8) | data[offset + 1];
+}
+
+std::string addressText(int family, const uint8_t* addr)
+{
+    char text[INET6_ADDRSTRLEN] = {};
+    inet_ntop(family, addr, text, sizeof(text));
+    return text;
+}
+
+void decodeUdp(std::span<const uint8_t> data, Datagram& datagram,
+               std::vector<Datagram>& out)
+{
+    if (data.size() < UDP_HEADER)
+    {
+        return;
+    }
+
+    size_t length = be16(data, 4);
+    if (length < UDP_HEADER)
+    {
+        return;
+    }
+    length = std::min(length, data.size());
+
+    datagram.srcPort = be16(data, 0);
+    datagram.dstPort = be16(data, 2);
+    datagram.payload.assign(data.begin() + UDP_HEADER,
+                            data.begin() + length);
+    out.push_back(std::move(datagram));
+}
+
+void decodeIPv4(std::span<const uint8_t> data, Datagram& datagram,
+                std::vector<Datagram>& out)
+{
+    if (data.size() < 20 || (data[0] >> 4) != 4)
+    {
+        return;
+    }
+
+    size_t headerLen = (data[0] & 0x0f) * 4;
+    size_t totalLen = std::min<size_t>(be16(data, 2), data.size());
+    bool fragment = be16(data, 6) & 0x3fff;
+    if (headerLen < 20 || totalLen < headerLen || fragment ||
+        data[9] != PROTO_UDP)
+    {
+        return;
+    }
+
+    datagram.src = addressText(AF_INET, &data[12]);
+    datagram.dst = addressText(AF_INET, &data[16]);
+    datagram.multicast = (data[16] & 0xf0) == 0xe0;
+    decodeUdp(data.subspan(headerLen, totalLen - headerLen), datagram, out);
+}
+
+void decodeIPv6(std::span<const uint8_t> data, Datagram& datagram,
+                std::vector<Datagram>& out)
+{
+    constexpr size_t HEADER = 40;
+    if (data.size() < HEADER || (data[0] >> 4) != 6)
+    {
+        return;
+    }
+
+    size_t end = std::min(HEADER + be16(data, 4), data.size());
+    uint8_t next = data[6];
+    size_t offset = HEADER;
+
+    while (next == IPV6_HOP_BY_HOP || next == IPV6_ROUTING ||
+           next == IPV6_DEST_OPTS)
+    {
+        if (offset + 2 > end)
+        {
+            return;
+        }
+        next = data[offset];
+        offset += (data[offset + 1] + 1) * 8;
+    }
+    // Fragments are not reassembled
+    if (next == IPV6_FRAGMENT || next != PROTO_UDP || offset > end)
+    {
+        return;
+    }
+
+    datagram.src = addressText(AF_INET6, &data[8]);
+    datagram.dst = addressText(AF_INET6, &data[24]);
+    datagram.multicast = data[24] == 0xff;
+    decodeUdp(data.subspan(offset, end - offset), datagram, out);
+}
+
+void decodeIP(uint16_t etherType, std::span<const uint8_t> data,
+              Datagram& datagram, std::vector<Datagram>& out)
+{
+    if (etherType == ETHERTYPE_IPV4)
+    {
+        decodeIPv4(data, datagram, out);
+    }
+    else if (etherType == ETHERTYPE_IPV6)
+    {
+        decodeIPv6(data, datagram, out);
+    }
+}
+
+/* The ethertype of a raw IP packet, from its version */
+uint16_t rawType(std::span<const uint8_t> frame)
+{
+    if (frame.empty())
+    {
+        return 0;
+    }
+    return (frame[0] >> 4) == 6 ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4;
+}
+
+void decodeFrame(uint32_t linkType, std::span<const uint8_t> frame,
+                 uint64_t timestamp, std::vector<Datagram>& out)
+{
+    Datagram datagram;
+    datagram.timestamp = timestamp;
+    uint16_t etherType = 0;
+    size_t offset = 0;
+
+    switch (linkType)
+    {
+        case LINK_ETHERNET:
+            if (frame.size() < 14)
+            {
+                return;
+            }
+            etherType = be16(frame, 12);
+            offset = 14;
+            while ((etherType == ETHERTYPE_VLAN ||
+                    etherType == ETHERTYPE_QINQ) &&
+                   frame.size() >= offset + 4)
+            {
+                etherType = be16(frame, offset + 2);
+                offset += 4;
+            }
+            break;
+        case LINK_LINUX_SLL:
+            if (frame.size() < 16)
+            {
+                return;
+            }
+            etherType = be16(frame, 14);
+            offset = 16;
+            break;
+        case LINK_LINUX_SLL2:
+            if (frame.size() < 20)
+            {
+                return;
+            }
+            etherType = be16(frame, 0);
+            offset = 20;
+            break;
+        case LINK_NULL:
+            // Address family in the byte order of the capturing host
+            if (frame.size() < 4)
+            {
+                return;
+            }
+            offset = 4;
+            etherType = rawType(frame.subspan(offset));
+            break;
+        case LINK_RAW:
+        case LINK_RAW_OPENBSD:
+        case LINK_RAW_BSDOS:
+        case LINK_IPV4:
+        case LINK_IPV6:
+            etherType = rawType(frame);
+            break;
+        default:
+            return;
+    }
+
+    if (offset > frame.size())
+    {
+        return;
+    }
+    decodeIP(etherType, frame.subspan(offset), datagram, out);
+}
+
+std::tuple<int, std::vector<Datagram>> parsePcap(Reader reader)
+{
+    std::vector<Datagram> out;
+
+    uint32_t magic = reader.u32(0);
+    if (magic != PCAP_MAGIC_MICRO && magic != PCAP_MAGIC_NANO)
+    {
+        reader.swap = true;
+        magic = reader.u32(0);
+    }
+    if ((magic != PCAP_MAGIC_MICRO && magic != PCAP_MAGIC_NANO) ||
+        !reader.has(0, PCAP_HEADER))
+    {
+        return std::make_tuple(-EBADMSG, std::move(out));
+    }
+
+    uint64_t fraction = magic == PCAP_MAGIC_NANO ? 1 : 1000;
+    // The upper bits may carry the FCS length
+    uint32_t linkType = reader.u32(20) & 0xffff;
+
+    size_t offset = PCAP_HEADER;
+    while (reader.has(offset, PCAP_RECORD))
+    {
+        uint64_t seconds = reader.u32(offset);
+        uint64_t fractions = reader.u32(offset + 4);
+        uint32_t captured = reader.u32(offset + 8);
+        offset += PCAP_RECORD;
+        if (!reader.has(offset, captured))
+        {
+            break;
+        }
+
+        decodeFrame(linkType, reader.data.subspan(offset, captured),
+                    seconds * 1000000000ULL + fractions * fraction, out);
+        offset += captured;
+    }
+    return std::make_tuple(0, std::move(out));
+}
+
+/* Link type and timestamp resolution of a pcapng interface */
+struct Interface
+{
+    uint32_t linkType = 0;
+    uint8_t tsresol = 6;
+};
+
+uint64_t toNanoseconds(uint64_t ticks, uint8_t tsresol)
+{
+    if (tsresol & 0x80)
+    {
+        return std::ldexp(static_cast<double>(ticks), -(tsresol & 0x7f)) *
+               1e9;
+    }
+    if (tsresol <= 9)
+    {
+        return ticks * std::pow(10, 9 - tsresol);
+    }
+    return ticks / std::pow(10, tsresol - 9);
+}
+
+Interface parseInterface(const Reader& reader, size_t offset, size_t end)
+{
+    Interface iface;
+    iface.linkType = reader.u16(offset + 8);
+
+    // Options follow the link type, reserved bytes and snap length
+    for (size_t opt = offset + 16; opt + 4 <= end;)
+    {
+        uint16_t code = reader.u16(opt);
+        uint16_t length = reader.u16(opt + 2);
+        if (code == NG_OPT_END || opt + 4 + length > end)
+        {
+            break;
+        }
+        if (code == NG_OPT_TSRESOL && length >= 1)
+        {
+            iface.tsresol = reader.data[opt + 4];
+        }
+        opt += 4 + ((length + 3) & ~3);
+    }
+    return iface;
+}
+
+std::tuple<int, std::vector<Datagram>> parsePcapng(Reader reader)
+{
+    std::vector<Datagram> out;
+    std::vector<Interface> interfaces;
+    bool section = false;
+
+    size_t offset = 0;
+    while (reader.has(offset, 12))
+    {
+        uint32_t type = reader.u32(offset);
+        if (type == NG_SECTION)
+        {
+            // Every section sets its own byte order
+            reader.swap = false;
+            if (reader.u32(offset + 8) != NG_BYTE_ORDER)
+            {
+                reader.swap = true;
+                if (reader.u32(offset + 8) != NG_BYTE_ORDER)
+                {
+                    break;
+                }
+            }
+            section = true;
+            interfaces.clear();
+        }
+        else if (!section)
+        {
+            break;
+        }
+
+        uint32_t length = reader.u32(offset + 4);
+        if (length < 12 || length % 4 || !reader.has(offset, length))
+        {
+            break;
+        }
+        size_t end = offset + length - 4;
+
+        if (type == NG_INTERFACE && offset + 16 <= end)
+        {
+            interfaces.push_back(parseInterface(reader, offset, end));
+        }
+        else if (type == NG_ENHANCED_PACKET && offset + 28 <= end)
+        {
+            uint32_t id = reader.u32(offset + 8);
+            uint64_t ticks =
+                (uint64_t(reader.u32(offset + 12)) << 32) |
+                reader.u32(offset + 16);
+            uint32_t captured = reader.u32(offset + 20);
+            if (id < interfaces.size() && captured <= end - offset - 28)
+            {
+                decodeFrame(interfaces[id].linkType,
+                            reader.data.subspan(offset + 28, captured),
+                            toNanoseconds(ticks, interfaces[id].tsresol),
+                            out);
+            }
+        }
+        else if (type == NG_SIMPLE_PACKET && offset + 12 <= end &&
+                 !interfaces.empty())
+        {
+            uint32_t captured =
+                std::min<size_t>(reader.u32(offset + 8), end - offset - 12);
+            decodeFrame(interfaces[0].linkType,
+                        reader.data.subspan(offset + 12, captured), 0, out);
+        }
+
+        offset += length;
+    }
+
+    if (!section)
+    {
+        return std::make_tuple(-EBADMSG, std::move(out));
+    }
+    return std::make_tuple(0, std::move(out));
+}
+
+} // namespace
+
+std::tuple<int, std::vector<Datagram>>
+    parseCapture(std::span<const uint8_t> capture)
+{
+    Reader reader{capture};
+
+    if (!reader.has(0, 4))
+    {
+        return std::make_tuple(-EBADMSG, std::vector<Datagram>());
+    }
+    if (reader.u32(0) == NG_SECTION)
+    {
+        return parsePcapng(reader);
+    }
+    return parsePcap(reader);
+}
+
+std::tuple<int, std::vector<Datagram>> readCapture(const char* path)
+{
+    slp::deleted_unique_ptr<FILE, fclose> file(fopen(path, "re"));
+    if (!file)
+    {
+        return std::make_tuple(-errno, std::vector<Datagram>());
+    }
+
+    std::vector<uint8_t> capture;
+    uint8_t chunk[65536];
+    size_t n = 0;
+    while ((n = fread(chunk, 1, sizeof(chunk), file.get())) > 0)
+    {
+        capture.insert(capture.end(), chunk, chunk + n);
+    }
+    if (ferror(file.get()))
+    {
+        return std::make_tuple(-EIO, std::vector<Datagram>());
+    }
+
+    return parseCapture(capture);
+}
+
+} // namespace pcap
+} // namespace slp
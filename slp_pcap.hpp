@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace slp
+{
+
+namespace pcap
+{
+
+/* A UDP datagram read from a capture */
+struct Datagram
+{
+    /* Capture time in nanoseconds */
+    uint64_t timestamp = 0;
+    /* Addresses as text, IPv4 in dotted form */
+    std::string src;
+    std::string dst;
+    uint16_t srcPort = 0;
+    uint16_t dstPort = 0;
+    /* Sent to a multicast group */
+    bool multicast = false;
+    std::vector<uint8_t> payload;
+};
+
+/** Extract the UDP datagrams of a capture.
+ *
+ * Reads pcap, with either timestamp resolution, and pcapng captures in
+ * either byte order, from Ethernet (with VLAN tags), Linux cooked, raw
+ * IP and loopback links. IP fragments are skipped. A capture cut off in
+ * the middle of a packet, as left by an interrupted capture, yields the
+ * datagrams before the cut.
+ *
+ * @param[in] capture - The capture file contents.
+ *
+ * @return Zero and the datagrams in capture order on success, else
+ *         -EBADMSG if this is not a capture.
+ */
+std::tuple<int, std::vector<Datagram>>
+    parseCapture(std::span<const uint8_t> capture);
+
+/** Read a capture file, see parseCapture.
+ *
+ * @param[in] path - The capture file.
+ *
+ * @return Zero and the datagrams on success, else a negative errno.
+ */
+std::tuple<int, std::vector<Datagram>> readCapture(const char* path);
+
+} // namespace pcap
+} // namespace slp
@@ -0,0 +1,137 @@
+#include "slp_receive_queue.hpp"
+
+#include "slp_log.hpp"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace slp
+{
+
+namespace udp
+{
+
+int enableDropCount(int fd)
+{
+    int on = 1;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
+    {
+        return -errno;
+    }
+    return 0;
+}
+
+int setBuffers(int fd, size_t bytes)
+{
+    int size = static_cast<int>(std::min<size_t>(bytes, INT_MAX / 2));
+
+    for (auto [force, option] : {std::pair{SO_RCVBUFFORCE, SO_RCVBUF},
+                                 std::pair{SO_SNDBUFFORCE, SO_SNDBUF}})
+    {
+        if (setsockopt(fd, SOL_SOCKET, force, &size, sizeof(size)) < 0 &&
+            setsockopt(fd, SOL_SOCKET, option, &size, sizeof(size)) < 0)
+        {
+            return -errno;
+        }
+    }
+    return 0;
+}
+
+size_t bufferSize(int fd)
+{
+    int size = 0;
+    socklen_t len = sizeof(size);
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0)
+    {
+        return 0;
+    }
+    // The kernel reports the size it doubled
+    return size / 2;
+}
+
+ReceiveQueue::ReceiveQueue(int fd, size_t maxBuffer) :
+    fd(fd), maxBuffer(maxBuffer), buffer(slp::udp::bufferSize(fd))
+{}
+
+uint32_t ReceiveQueue::received(uint32_t count, uint64_t filtered,
+                                std::chrono::steady_clock::time_point received)
+{
+    // The count wraps around, and holds the datagrams the socket filter
+    // rejected as well
+    uint32_t counted = count - overflow;
+    overflow = count;
+
+    // A flood of junk is neither warned of nor grows the buffers
+    uint32_t dropped = 0;
+    if (filtered == UNCOUNTED)
+    {
+        unknownCount += counted;
+    }
+    else
+    {
+        uint64_t rejected = filtered > filteredCount
+                                ? filtered - filteredCount
+                                : 0;
+        filteredCount = std::max(filteredCount, filtered);
+        dropped = counted - std::min<uint64_t>(rejected, counted);
+    }
+    dropCount += dropped;
+    unwarned += dropped;
+
+    if (burst > 0 && received - last > BURST_GAP)
+    {
+        burst = 0;
+    }
+    burst += 1 + dropped;
+    last = received;
+    if (burst > peak)
+    {
+        peak = burst;
+        grow();
+    }
+    return dropped;
+}
+
+uint64_t ReceiveQueue::warnDrops(std::chrono::steady_clock::time_point now)
+{
+    if (unwarned == 0 ||
+        (warned != std::chrono::steady_clock::time_point{} &&
+         now - warned < WARN_INTERVAL))
+    {
+        return 0;
+    }
+
+    warned = now;
+    return std::exchange(unwarned, 0);
+}
+
+void ReceiveQueue::grow()
+{
+    size_t wanted = std::min(2 * peak * DATAGRAM_CHARGE, maxBuffer);
+    if (wanted <= buffer)
+    {
+        return;
+    }
+
+    int r = setBuffers(fd, wanted);
+    if (r < 0)
+    {
+        SLP_LOG_ERROR("Unable to grow the socket buffers to %zu bytes: %s",
+                      wanted, strerror(-r));
+        return;
+    }
+    // Without CAP_NET_ADMIN the sysctl limits may have kept it smaller
+    buffer = std::max(slp::udp::bufferSize(fd), buffer);
+    SLP_LOG_INFO("SLP socket buffers of %zu bytes for bursts of %zu "
+                 "datagrams",
+                 buffer, peak);
+}
+
+} // namespace udp
+} // namespace slp
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+
+namespace slp
+{
+
+namespace udp
+{
+
+/** @brief Ask for the count of datagrams a socket dropped, see
+ *         ReceiveQueue.
+ *
+ *  @param[in] fd - The socket.
+ *
+ *  @return Zero, or a negative errno.
+ */
+int enableDropCount(int fd);
+
+/** @brief Set the receive and send buffers of a socket.
+ *
+ *  The limit of net.core.rmem_max and wmem_max is bypassed when slpd
+ *  has CAP_NET_ADMIN.
+ *
+ *  @param[in] fd - The socket.
+ *  @param[in] bytes - The size asked for, the kernel doubles it for its
+ *                     bookkeeping.
+ *
+ *  @return Zero, or a negative errno.
+ */
+int setBuffers(int fd, size_t bytes);
+
+/** @brief The receive buffer size of a socket, as it was set.
+ *
+ *  @param[in] fd - The socket.
+ *
+ *  @return the size in bytes, zero when unknown.
+ */
+size_t bufferSize(int fd);
+
+/** @class ReceiveQueue
+ *
+ *  @brief Datagrams dropped by the receive queue of a socket, and the
+ *         size of its buffers.
+ *
+ *  With SO_RXQ_OVFL the kernel attaches to a datagram the count of the
+ *  datagrams the socket dropped so far for want of buffer space. The
+ *  count only grows, the drops since the previous datagram are the
+ *  difference; drops are learnt of with the next datagram let through.
+ *  The count holds the datagrams the socket filter rejected as well,
+ *  when the filter does not count them the difference is left unknown.
+ *
+ *  Datagrams the kernel received less than BURST_GAP apart make a
+ *  burst, along with the datagrams dropped meanwhile. Both buffers grow
+ *  to hold twice the largest burst seen, up to the maximum, and never
+ *  shrink.
+ */
+class ReceiveQueue
+{
+  public:
+    /* Memory the kernel charges a datagram of a request, skb included */
+    static constexpr size_t DATAGRAM_CHARGE = 1024;
+    /* Datagrams further apart are not of one burst */
+    static constexpr std::chrono::milliseconds BURST_GAP{10};
+    /* Least time between two warnings of drops */
+    static constexpr std::chrono::seconds WARN_INTERVAL{10};
+    /* The socket filter drops datagrams without counting them */
+    static constexpr uint64_t UNCOUNTED = UINT64_MAX;
+
+    /** @brief Constructor
+     *
+     *  @param[in] fd - The socket, with enableDropCount called on it.
+     *  @param[in] maxBuffer - The largest buffers to grow to, in bytes.
+     */
+    ReceiveQueue(int fd, size_t maxBuffer);
+
+    /** @brief Account for a received datagram.
+     *
+     *  @param[in] overflow - Its SO_RXQ_OVFL count.
+     *  @param[in] filtered - The datagrams the socket filter dropped so
+     *                        far, which the kernel counts too; zero
+     *                        without a filter, UNCOUNTED when it does
+     *                        not count them.
+     *  @param[in] received - When the kernel received it.
+     *
+     *  @return the datagrams dropped since the previous one.
+     */
+    uint32_t received(uint32_t overflow, uint64_t filtered,
+                      std::chrono::steady_clock::time_point received);
+
+    /** @brief Drops to warn of, rate limited.
+     *
+     *  @param[in] now - The current time.
+     *
+     *  @return the drops since the last warning, once WARN_INTERVAL has
+     *          passed since it, else zero.
+     */
+    uint64_t warnDrops(std::chrono::steady_clock::time_point now);
+
+    /** @brief Datagrams dropped */
+    uint64_t drops() const
+    {
+        return dropCount;
+    }
+
+    /** @brief Datagrams either dropped or filtered, not told apart */
+    uint64_t unknownDrops() const
+    {
+        return unknownCount;
+    }
+
+    /** @brief The SO_RXQ_OVFL count of the last datagram */
+    uint32_t overflowCount() const
+    {
+        return overflow;
+    }
+
+    /** @brief Largest burst seen, in datagrams */
+    size_t peakBurst() const
+    {
+        return peak;
+    }
+
+    /** @brief The receive buffer size, as set */
+    size_t bufferSize() const
+    {
+        return buffer;
+    }
+
+  private:
+    /** @brief Grow the buffers for the peak burst. */
+    void grow();
+
+    int fd;
+    size_t maxBuffer;
+    size_t buffer = 0;
+    uint32_t overflow = 0;
+    uint64_t filteredCount = 0;
+    uint64_t dropCount = 0;
+    uint64_t unknownCount = 0;
+    uint64_t unwarned = 0;
+    size_t burst = 0;
+    size_t peak = 0;
+    std::chrono::steady_clock::time_point last{};
+    std::chrono::steady_clock::time_point warned{};
+};
+
+} // namespace udp
+} // namespace slp
@@ -0,0 +1,63 @@
+#include "slp.hpp"
+#include "slp_meta.hpp"
+#include "slp_registry_image.hpp"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Compiles the service files into the image slpd maps at startup */
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -d, --directory=DIR     Service files, default %s\n"
+            "  -o, --output=FILE       Registry image, default %s\n"
+            "  -h, --help              Show this help\n",
+            name, slp::SERVICE_DIR, slp::REGISTRY_IMAGE);
+}
+
+int main(int argc, char* argv[])
+{
+    static const option options[] = {
+        {"directory", required_argument, nullptr, 'd'},
+        {"output", required_argument, nullptr, 'o'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    const char* dir = slp::SERVICE_DIR;
+    const char* output = slp::REGISTRY_IMAGE;
+    int opt = 0;
+    while ((opt = getopt_long(argc, argv, "d:o:h", options, nullptr)) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                dir = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'h':
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    auto services = slp::handler::internal::readSLPServiceInfo(dir);
+    int r = slp::RegistryImage::write(services, output);
+    if (r < 0)
+    {
+        fprintf(stderr, "Unable to write %s: %s\n", output, strerror(-r));
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu services compiled into %s\n", services.size(), output);
+    return EXIT_SUCCESS;
+}
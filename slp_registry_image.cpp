@@ -0,0 +1,296 @@
+#include "slp_registry_image.hpp"
+
+#include "endian.hpp"
+#include "slp_service_index.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+namespace slp
+{
+
+namespace
+{
+
+/* Appends strings to the pool of an image being compiled */
+class StringPool
+{
+  public:
+    RegistryImage::Ref add(std::string_view str)
+    {
+        RegistryImage::Ref ref{static_cast<uint32_t>(pool.size()),
+                               static_cast<uint32_t>(str.size())};
+        pool.append(str);
+        return ref;
+    }
+
+    const std::string& data() const
+    {
+        return pool;
+    }
+
+  private:
+    std::string pool;
+};
+
+template <typename T>
+void append(std::vector<uint8_t>& image, const T* items, size_t count)
+{
+    auto bytes = reinterpret_cast<const uint8_t*>(items);
+    image.insert(image.end(), bytes, bytes + count * sizeof(T));
+}
+
+} // namespace
+
+RegistryImage::RegistryImage(void* data, size_t length) :
+    data(data), length(length), header(static_cast<const Header*>(data))
+{}
+
+RegistryImage::~RegistryImage()
+{
+    munmap(data, length);
+}
+
+bool RegistryImage::validate()
+{
+    if (length < sizeof(Header) ||
+        memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header->version != VERSION || header->byteOrder != ENDIAN_MARK ||
+        header->size != length)
+    {
+        return false;
+    }
+
+    // Sizes are added up in 64 bits, a crafted count can not wrap them
+    uint64_t servicesOffset = sizeof(Header);
+    uint64_t typesOffset =
+        servicesOffset + uint64_t(header->serviceCount) * sizeof(Service);
+    uint64_t matchesOffset =
+        typesOffset + uint64_t(header->typeCount) * sizeof(Type);
+    uint64_t stringsOffset =
+        matchesOffset + uint64_t(header->matchCount) * sizeof(uint32_t);
+    if (stringsOffset + header->stringsSize != length)
+    {
+        return false;
+    }
+
+    auto base = static_cast<const uint8_t*>(data);
+    services = reinterpret_cast<const Service*>(base + servicesOffset);
+    types = reinterpret_cast<const Type*>(base + typesOffset);
+    matches = reinterpret_cast<const uint32_t*>(base + matchesOffset);
+    strings = reinterpret_cast<const char*>(base + stringsOffset);
+
+    auto inPool = [this](Ref ref) {
+        return uint64_t(ref.offset) + ref.length <= header->stringsSize;
+    };
+
+    if (!inPool(header->typeList) || !inPool(header->typeListEntry))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < header->serviceCount; i++)
+    {
+        const auto& svc = services[i];
+        if (!inPool(svc.name) || !inPool(svc.type) || !inPool(svc.port) ||
+            !inPool(svc.urlPrefix) || !inPool(svc.urlSuffix) ||
+            svc.lifetime == 0 || svc.lifetime > UINT16_MAX)
+        {
+            return false;
+        }
+    }
+
+    // Lookups are binary searches, the types have to be sorted
+    for (size_t i = 0; i < header->typeCount; i++)
+    {
+        const auto& type = types[i];
+        if (!inPool(type.folded) ||
+            uint64_t(type.firstMatch) + type.matchCount > header->matchCount ||
+            (i > 0 && string(types[i - 1].folded) >= string(type.folded)))
+        {
+            return false;
+        }
+    }
+
+    return std::all_of(matches, matches + header->matchCount,
+                       [this](uint32_t pos) {
+                           return pos < header->serviceCount;
+                       });
+}
+
+std::tuple<int, std::shared_ptr<const RegistryImage>>
+    RegistryImage::open(const char* path)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return std::make_tuple(-errno, nullptr);
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0)
+    {
+        int r = -errno;
+        close(fd);
+        return std::make_tuple(r, nullptr);
+    }
+    if (st.st_size < static_cast<off_t>(sizeof(Header)))
+    {
+        close(fd);
+        return std::make_tuple(-EBADMSG, nullptr);
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    int r = -errno;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return std::make_tuple(r, nullptr);
+    }
+
+    std::shared_ptr<RegistryImage> image(new RegistryImage(data, st.st_size));
+    if (!image->validate())
+    {
+        return std::make_tuple(-EBADMSG, nullptr);
+    }
+    return std::make_tuple(0, std::move(image));
+}
+
+std::span<const uint32_t> RegistryImage::find(std::string_view folded) const
+{
+    auto end = types + header->typeCount;
+    auto it = std::lower_bound(types, end, folded,
+                               [this](const Type& type, std::string_view key) {
+                                   return string(type.folded) < key;
+                               });
+    if (it == end || string(it->folded) != folded)
+    {
+        return {};
+    }
+    return {matches + it->firstMatch, it->matchCount};
+}
+
+std::vector<uint8_t>
+    RegistryImage::compile(const std::vector<ConfigData>& services)
+{
+    StringPool pool;
+    std::vector<Service> records;
+
+    // Same keys as ServiceIndex, kept sorted for the binary search
+    std::map<std::string, std::vector<uint32_t>> index;
+
+    for (uint32_t pos = 0; pos < services.size(); pos++)
+    {
+        const auto& svc = services[pos];
+        records.push_back({pool.add(svc.name), pool.add(svc.type),
+                           pool.add(svc.port), pool.add(svc.urlPrefix()),
+                           pool.add(svc.urlSuffix()), svc.lifetime});
+
+        auto folded = fold(svc.name);
+        auto abstract = abstractType(folded);
+        if (!abstract.empty())
+        {
+            index[std::string(abstract)].push_back(pos);
+        }
+        index[folded].push_back(pos);
+    }
+
+    std::vector<Type> types;
+    std::vector<uint32_t> matches;
+    for (const auto& [folded, positions] : index)
+    {
+        types.push_back({pool.add(folded),
+                         static_cast<uint32_t>(matches.size()),
+                         static_cast<uint32_t>(positions.size())});
+        matches.insert(matches.end(), positions.begin(), positions.end());
+    }
+
+    Header header{};
+    std::copy_n(MAGIC, sizeof(MAGIC), header.magic);
+    header.version = VERSION;
+    header.byteOrder = ENDIAN_MARK;
+    header.serviceCount = records.size();
+    header.typeCount = types.size();
+    header.matchCount = matches.size();
+
+    auto typeList = listServiceTypes(services);
+    header.typeList = pool.add(typeList);
+
+    // The SrvTypeRply carries the list after its length in network order
+    uint16_t typeListLen = endian::to_network<uint16_t>(typeList.size());
+    std::string entry((const char*)&typeListLen, sizeof(typeListLen));
+    entry += typeList;
+    header.typeListEntry = pool.add(entry);
+
+    header.stringsSize = pool.data().size();
+    header.size = sizeof(Header) + records.size() * sizeof(Service) +
+                  types.size() * sizeof(Type) +
+                  matches.size() * sizeof(uint32_t) + header.stringsSize;
+
+    std::vector<uint8_t> image;
+    image.reserve(header.size);
+    append(image, &header, 1);
+    append(image, records.data(), records.size());
+    append(image, types.data(), types.size());
+    append(image, matches.data(), matches.size());
+    append(image, pool.data().data(), pool.data().size());
+    return image;
+}
+
+int RegistryImage::write(const std::vector<ConfigData>& services,
+                         const char* path)
+{
+    auto image = compile(services);
+    std::string tmpPath = std::string(path) + ".tmp";
+
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+
+    size_t written = 0;
+    while (written < image.size())
+    {
+        ssize_t n = ::write(fd, image.data() + written, image.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            int r = -errno;
+            close(fd);
+            unlink(tmpPath.c_str());
+            return r;
+        }
+        written += n;
+    }
+
+    // Readers map the file, only ever show them a complete image
+    int r = fsync(fd) < 0 ? -errno : 0;
+    if (close(fd) < 0 && r == 0)
+    {
+        r = -errno;
+    }
+    if (r == 0 && rename(tmpPath.c_str(), path) < 0)
+    {
+        r = -errno;
+    }
+    if (r < 0)
+    {
+        unlink(tmpPath.c_str());
+    }
+    return r;
+}
+
+} // namespace slp
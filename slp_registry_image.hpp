@@ -0,0 +1,174 @@
+#pragma once
+
+#include "slp_service_info.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace slp
+{
+
+/** @class RegistryImage
+ *
+ *  @brief Compiled service registry, mapped read only and used in place.
+ *
+ *  The image holds every service with its URL split around the address,
+ *  the case folded service type index and the encoded service type list
+ *  of the SrvTypeRply, so loading it costs one mmap and a bounds check
+ *  of the tables. The layout is in host byte order, the image is meant
+ *  to be compiled on the machine that uses it.
+ *
+ *  Layout, every table 4 byte aligned:
+ *
+ *      Header
+ *      Service[serviceCount]
+ *      Type[typeCount]        sorted by folded type
+ *      uint32_t[matchCount]   positions of the services of each type
+ *      char[stringsSize]      string pool, the Ref offsets point here
+ */
+class RegistryImage
+{
+  public:
+    static constexpr char MAGIC[8] = {'S', 'L', 'P', 'R',
+                                      'E', 'G', '\0', '\0'};
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t ENDIAN_MARK = 0x01020304;
+
+    /* A string in the pool */
+    struct Ref
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t size;
+        uint32_t serviceCount;
+        uint32_t typeCount;
+        uint32_t matchCount;
+        uint32_t stringsSize;
+        Ref typeList;
+        Ref typeListEntry;
+    };
+
+    struct Service
+    {
+        Ref name;
+        Ref type;
+        Ref port;
+        /* The URL is urlPrefix, the address and urlSuffix */
+        Ref urlPrefix;
+        Ref urlSuffix;
+        uint32_t lifetime;
+    };
+
+    struct Type
+    {
+        Ref folded;
+        uint32_t firstMatch;
+        uint32_t matchCount;
+    };
+
+    ~RegistryImage();
+
+    RegistryImage(const RegistryImage&) = delete;
+    RegistryImage& operator=(const RegistryImage&) = delete;
+
+    /** @brief Map and validate an image.
+     *
+     *  @param[in] path - The image file.
+     *
+     *  @return Zero and the image on success, else a negative errno and
+     *          nullptr, -EBADMSG if the file is not a valid image.
+     */
+    static std::tuple<int, std::shared_ptr<const RegistryImage>>
+        open(const char* path);
+
+    /** @brief Encode an image of a service list.
+     *
+     *  @param[in] services - The services, sorted as readSLPServiceInfo
+     *                        returns them.
+     *
+     *  @return the image.
+     */
+    static std::vector<uint8_t>
+        compile(const std::vector<ConfigData>& services);
+
+    /** @brief Compile an image and replace the file atomically.
+     *
+     *  @param[in] services - The services.
+     *  @param[in] path - The image file.
+     *
+     *  @return Zero on success, else a negative errno.
+     */
+    static int write(const std::vector<ConfigData>& services,
+                     const char* path);
+
+    /** @brief Number of services */
+    size_t size() const
+    {
+        return header->serviceCount;
+    }
+
+    /** @brief A service of the image */
+    const Service& service(size_t pos) const
+    {
+        return services[pos];
+    }
+
+    /** @brief A string of the image */
+    std::string_view string(Ref ref) const
+    {
+        return {strings + ref.offset, ref.length};
+    }
+
+    /** @brief Find the services of a type.
+     *
+     *  @param[in] folded - The case folded service type.
+     *
+     *  @return the positions of the matching services, empty if none.
+     */
+    std::span<const uint32_t> find(std::string_view folded) const;
+
+    /** @brief The comma separated service type list */
+    std::string_view typeList() const
+    {
+        return string(header->typeList);
+    }
+
+    /** @brief The service type list as encoded in the SrvTypeRply */
+    std::span<const uint8_t> typeListEntry() const
+    {
+        auto entry = string(header->typeListEntry);
+        return {(const uint8_t*)entry.data(), entry.size()};
+    }
+
+  private:
+    RegistryImage(void* data, size_t length);
+
+    /** @brief Check every table and string reference and locate the
+     *         tables.
+     */
+    bool validate();
+
+    void* data;
+    size_t length;
+
+    const Header* header;
+    const Service* services = nullptr;
+    const Type* types = nullptr;
+    const uint32_t* matches = nullptr;
+    const char* strings = nullptr;
+};
+
+} // namespace slp
@@ -0,0 +1,374 @@
+#include "slp.hpp"
+#include "slp_meta.hpp"
+#include "slp_pcap.hpp"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/* Replays captured SLP requests through the parser and the handler,
+ * against a registry built from a service directory instead of the
+ * running system, and compares the replies to the recorded ones. */
+
+namespace
+{
+
+using slp::pcap::Datagram;
+
+/* A captured request and the reply recorded for it, if any */
+struct Exchange
+{
+    const Datagram* request;
+    const Datagram* recorded = nullptr;
+};
+
+constexpr size_t FUNCTIONS = 256;
+
+const char* functionName(uint8_t id)
+{
+    static constexpr std::array<const char*, 12> names = {
+        "Unknown",  "SrvRqst",     "SrvRply",     "SrvReg",
+        "SrvDeReg", "SrvAck",      "AttrRqst",    "AttrRply",
+        "DAAdvert", "SrvTypeRqst", "SrvTypeRply", "SAAdvert",
+    };
+    return id < names.size() ? names[id] : names[0];
+}
+
+uint8_t functionOf(const std::vector<uint8_t>& msg)
+{
+    return msg.size() > slp::header::OFFSET_FUNCTION
+               ? msg[slp::header::OFFSET_FUNCTION]
+               : 0;
+}
+
+uint16_t xidOf(const std::vector<uint8_t>& msg)
+{
+    constexpr auto offset = slp::header::OFFSET_XID;
+    return msg.size() >= offset + slp::header::SIZE_XID
+               ? (msg[offset] << 8) | msg[offset + 1]
+               : 0;
+}
+
+/* Pair every request with the first reply sent back to its source
+ * port with the same XID */
+std::vector<Exchange> pairExchanges(const std::vector<Datagram>& datagrams,
+                                    uint16_t port)
+{
+    using Key = std::tuple<std::string, uint16_t, uint16_t>;
+    std::vector<Exchange> exchanges;
+    std::map<Key, size_t> pending;
+
+    for (const auto& datagram : datagrams)
+    {
+        if (datagram.payload.empty())
+        {
+            continue;
+        }
+        if (datagram.dstPort == port)
+        {
+            pending[{datagram.src, datagram.srcPort,
+                     xidOf(datagram.payload)}] = exchanges.size();
+            exchanges.push_back({&datagram});
+        }
+        else if (datagram.srcPort == port)
+        {
+            auto it = pending.find(
+                {datagram.dst, datagram.dstPort, xidOf(datagram.payload)});
+            if (it != pending.end() && !exchanges[it->second].recorded)
+            {
+                exchanges[it->second].recorded = &datagram;
+            }
+        }
+    }
+    return exchanges;
+}
+
+/* Silences the per request logging of the handler while replaying */
+class QuietLogs
+{
+  public:
+    QuietLogs()
+    {
+        fflush(stdout);
+        fflush(stderr);
+        savedOut = dup(STDOUT_FILENO);
+        savedErr = dup(STDERR_FILENO);
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0)
+        {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    ~QuietLogs()
+    {
+        fflush(stdout);
+        fflush(stderr);
+        if (savedOut >= 0)
+        {
+            dup2(savedOut, STDOUT_FILENO);
+            close(savedOut);
+        }
+        if (savedErr >= 0)
+        {
+            dup2(savedErr, STDERR_FILENO);
+            close(savedErr);
+        }
+    }
+
+  private:
+    int savedOut = -1;
+    int savedErr = -1;
+};
+
+struct Difference
+{
+    const Exchange* exchange;
+    /* Offset of the first differing byte, or the shorter length */
+    size_t offset;
+    bool answered;
+};
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double q)
+{
+    size_t pos = std::min(sorted.size() - 1,
+                          static_cast<size_t>(q * sorted.size()));
+    return sorted[pos];
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] CAPTURE...\n"
+            "  -d, --directory=DIR     Service files, default %s\n"
+            "  -a, --address=ADDR      Interface address, may be repeated,\n"
+            "                          default the unicast request targets\n"
+            "  -p, --port=PORT         SLP port, default %d\n"
+            "  -n, --iterations=N      Replay the requests N times\n"
+            "  -v, --verbose           List every reply difference\n"
+            "  -h, --help              Show this help\n",
+            name, slp::SERVICE_DIR, slp::PORT);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    static const option options[] = {
+        {"directory", required_argument, nullptr, 'd'},
+        {"address", required_argument, nullptr, 'a'},
+        {"port", required_argument, nullptr, 'p'},
+        {"iterations", required_argument, nullptr, 'n'},
+        {"verbose", no_argument, nullptr, 'v'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    const char* dir = slp::SERVICE_DIR;
+    std::vector<std::string> addresses;
+    uint16_t port = slp::PORT;
+    unsigned long iterations = 1;
+    bool verbose = false;
+    int opt = 0;
+
+    while ((opt = getopt_long(argc, argv, "d:a:p:n:vh", options, nullptr)) !=
+           -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                dir = optarg;
+                break;
+            case 'a':
+                addresses.push_back(optarg);
+                break;
+            case 'p':
+                port = strtoul(optarg, nullptr, 10);
+                break;
+            case 'n':
+                iterations = std::max(1UL, strtoul(optarg, nullptr, 10));
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+                usage(argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Datagram> datagrams;
+    for (int i = optind; i < argc; i++)
+    {
+        auto [rc, read] = slp::pcap::readCapture(argv[i]);
+        if (rc < 0)
+        {
+            fprintf(stderr, "Unable to read %s: %s\n", argv[i], strerror(-rc));
+            return EXIT_FAILURE;
+        }
+        datagrams.insert(datagrams.end(),
+                         std::make_move_iterator(read.begin()),
+                         std::make_move_iterator(read.end()));
+    }
+
+    auto exchanges = pairExchanges(datagrams, port);
+    if (exchanges.empty())
+    {
+        fprintf(stderr, "No SLP requests to port %u in the captures\n", port);
+        return EXIT_FAILURE;
+    }
+
+    // Offer the services on the addresses the requests were sent to,
+    // so that the URLs match the recorded replies
+    if (addresses.empty())
+    {
+        std::set<std::string> targets;
+        for (const auto& exchange : exchanges)
+        {
+            if (!exchange.request->multicast)
+            {
+                targets.insert(exchange.request->dst);
+            }
+        }
+        addresses.assign(targets.begin(), targets.end());
+    }
+
+    auto services = slp::handler::internal::readSLPServiceInfo(dir);
+    size_t serviceCount = services.size();
+    slp::handler::internal::publishServiceRegistry(
+        slp::handler::internal::makeServiceRegistry(std::move(services),
+                                                    addresses));
+
+    std::vector<std::vector<uint64_t>> latencies(FUNCTIONS);
+    std::vector<Difference> differences;
+    size_t matched = 0;
+    size_t unrecorded = 0;
+    std::chrono::nanoseconds total{0};
+
+    {
+        QuietLogs quiet;
+        slp::buffer resp;
+
+        for (unsigned long iteration = 0; iteration < iterations;
+             iteration++)
+        {
+            for (const auto& exchange : exchanges)
+            {
+                const auto& request = exchange.request->payload;
+                bool multicast = false;
+                resp.clear();
+
+                auto start = std::chrono::steady_clock::now();
+                bool answered = slp::handler::serveRequest(
+                    request, exchange.request->multicast, resp, multicast);
+                auto elapsed = std::chrono::steady_clock::now() - start;
+
+                total += elapsed;
+                latencies[functionOf(request)].push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        elapsed)
+                        .count());
+
+                if (iteration > 0)
+                {
+                    continue;
+                }
+                if (!exchange.recorded)
+                {
+                    unrecorded++;
+                    continue;
+                }
+
+                const auto& recorded = exchange.recorded->payload;
+                if (answered && resp == recorded)
+                {
+                    matched++;
+                    continue;
+                }
+                auto mismatch = std::mismatch(resp.begin(), resp.end(),
+                                              recorded.begin(),
+                                              recorded.end());
+                differences.push_back(
+                    {&exchange,
+                     static_cast<size_t>(mismatch.first - resp.begin()),
+                     answered});
+            }
+        }
+    }
+
+    size_t replayed = exchanges.size() * iterations;
+    double seconds = std::chrono::duration<double>(total).count();
+    printf("%zu requests from %zu datagrams, %zu services on %zu "
+           "addresses\n",
+           exchanges.size(), datagrams.size(), serviceCount,
+           addresses.size());
+    printf("%zu requests replayed in %.3fms, %.0f messages/s\n", replayed,
+           seconds * 1e3, seconds > 0 ? replayed / seconds : 0.0);
+
+    printf("%-12s %10s %10s %10s %10s %10s\n", "function", "count", "mean us",
+           "p50 us", "p99 us", "max us");
+    for (size_t id = 0; id < FUNCTIONS; id++)
+    {
+        auto& samples = latencies[id];
+        if (samples.empty())
+        {
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        uint64_t sum = 0;
+        for (auto sample : samples)
+        {
+            sum += sample;
+        }
+        printf("%-12s %10zu %10.2f %10.2f %10.2f %10.2f\n",
+               functionName(id), samples.size(),
+               sum / 1e3 / samples.size(), percentile(samples, 0.5) / 1e3,
+               percentile(samples, 0.99) / 1e3, samples.back() / 1e3);
+    }
+
+    printf("replies: %zu match, %zu differ, %zu not recorded\n", matched,
+           differences.size(), unrecorded);
+    for (size_t i = 0; i < differences.size() && (verbose || i < 10); i++)
+    {
+        const auto& diff = differences[i];
+        const auto& request = *diff.exchange->request;
+        if (diff.answered)
+        {
+            printf("  %s xid %u from %s:%u differs at byte %zu\n",
+                   functionName(functionOf(request.payload)),
+                   xidOf(request.payload), request.src.c_str(),
+                   request.srcPort, diff.offset);
+        }
+        else
+        {
+            printf("  %s xid %u from %s:%u got no reply\n",
+                   functionName(functionOf(request.payload)),
+                   xidOf(request.payload), request.src.c_str(),
+                   request.srcPort);
+        }
+    }
+
+    return differences.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,535 @@
+#include "slp_sa.hpp"
+
+#include "endian.hpp"
+#include "slp_log.hpp"
+#include "slp_service_index.hpp"
+#include "slp_text.hpp"
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace slp
+{
+namespace sa
+{
+
+namespace
+{
+
+constexpr std::string_view DA_SERVICE_TYPE = "service:directory-agent";
+constexpr std::string_view LANGTAG = "en";
+
+void appendUint16(buffer& buff, uint16_t value)
+{
+    value = endian::to_network(value);
+    auto bytes = (const uint8_t*)&value;
+    buff.insert(buff.end(), bytes, bytes + sizeof(value));
+}
+
+void appendString(buffer& buff, std::string_view str)
+{
+    appendUint16(buff, str.size());
+    buff.insert(buff.end(), str.begin(), str.end());
+}
+
+/* The header of a request slpd sends, the length is set once the body
+ * is appended */
+buffer prepareRequestHeader(slp::FunctionType function, uint16_t flags,
+                            uint16_t xid)
+{
+    buffer buff;
+    buff.reserve(slp::MAX_LEN);
+    buff.resize(slp::header::MIN_LEN, 0);
+
+    buff[slp::header::OFFSET_VERSION] = slp::VERSION_2;
+    buff[slp::header::OFFSET_FUNCTION] = static_cast<uint8_t>(function);
+
+    flags = endian::to_network(flags);
+    std::copy_n((uint8_t*)&flags, slp::header::SIZE_FLAGS,
+                buff.data() + slp::header::OFFSET_FLAGS);
+    xid = endian::to_network(xid);
+    std::copy_n((uint8_t*)&xid, slp::header::SIZE_XID,
+                buff.data() + slp::header::OFFSET_XID);
+
+    buff.resize(slp::header::OFFSET_LANG_LEN);
+    appendString(buff, LANGTAG);
+    return buff;
+}
+
+/* Set the length of a request, false if it is too long to send */
+bool setLength(buffer& buff)
+{
+    if (buff.size() > slp::MAX_LEN)
+    {
+        return false;
+    }
+    buff[slp::header::OFFSET_LENGTH] = buff.size();
+    return true;
+}
+
+/* The address of "service:directory-agent://192.0.2.1", IPv4 addresses
+ * mapped to IPv6 as the sockets are */
+bool agentAddress(std::string_view url, sockaddr_in6& addr)
+{
+    constexpr std::string_view scheme = "://";
+    if (url.size() < DA_SERVICE_TYPE.size() + scheme.size() ||
+        slp::fold(url.substr(0, DA_SERVICE_TYPE.size())) != DA_SERVICE_TYPE ||
+        url.substr(DA_SERVICE_TYPE.size(), scheme.size()) != scheme)
+    {
+        return false;
+    }
+    auto host = url.substr(DA_SERVICE_TYPE.size() + scheme.size());
+    host = host.substr(0, host.find('/'));
+
+    // "[2001:db8::1]:427" and "192.0.2.1:427" name a port, always 427
+    std::string name(host);
+    if (host.starts_with('['))
+    {
+        name = host.substr(1, host.find(']') - 1);
+    }
+    else if (std::count(host.begin(), host.end(), ':') == 1)
+    {
+        name = host.substr(0, host.find(':'));
+    }
+
+    addr = {};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(slp::PORT);
+
+    in_addr v4{};
+    if (inet_pton(AF_INET, name.c_str(), &v4) == 1)
+    {
+        addr.sin6_addr.s6_addr[10] = 0xff;
+        addr.sin6_addr.s6_addr[11] = 0xff;
+        memcpy(&addr.sin6_addr.s6_addr[12], &v4, sizeof(v4));
+        return true;
+    }
+    return inet_pton(AF_INET6, name.c_str(), &addr.sin6_addr) == 1;
+}
+
+bool sameRegistration(const request::ServiceRegistration& a,
+                      const request::ServiceRegistration& b)
+{
+    return a.urlEntry.url == b.urlEntry.url && a.srvType == b.srvType &&
+           a.scopeList == b.scopeList && a.attrList == b.attrList;
+}
+
+/* Whether an agent serves every scope of a registration */
+bool inScopes(const std::vector<std::string>& served,
+              const request::ServiceRegistration& reg)
+{
+    auto scopes = slp::text::splitScopes(reg.scopeList);
+    return std::includes(served.begin(), served.end(), scopes.begin(),
+                         scopes.end());
+}
+
+bool saEnabled = false;
+
+} // namespace
+
+buffer prepareSrvReg(const request::ServiceRegistration& reg,
+                     uint16_t lifetime, uint16_t xid)
+{
+    /*  0                   1                   2                   3
+        0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |         Service Location header (function = SrvReg = 3)       |
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |                          <URL-Entry>                          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       | length of service type string |        <service-type>         \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |     length of <scope-list>    |         <scope-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |  length of attr-list string   |          <attr-list>          \
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+       |# of AttrAuths |(if present) Attribute Authentication Blocks...\
+       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ */
+
+    auto buff = prepareRequestHeader(slp::FunctionType::SRVREG,
+                                     slp::header::FLAG_FRESH, xid);
+
+    buff.push_back(0); // reserved
+    appendUint16(buff, lifetime);
+    appendString(buff, reg.urlEntry.url);
+    buff.push_back(0); // no URL auth blocks
+    appendString(buff, reg.srvType);
+    appendString(buff, reg.scopeList);
+    appendString(buff, reg.attrList);
+    buff.push_back(0); // no attribute auth blocks
+
+    if (!setLength(buff))
+    {
+        buff.clear();
+    }
+    return buff;
+}
+
+buffer prepareDADiscovery(uint16_t xid)
+{
+    auto buff = prepareRequestHeader(slp::FunctionType::SRVRQST,
+                                     slp::header::FLAG_MCAST, xid);
+
+    appendString(buff, "");              // PRList
+    appendString(buff, DA_SERVICE_TYPE); // service type
+    appendString(buff, "");              // any scope
+    appendString(buff, "");              // predicate
+    appendString(buff, "");              // SLP SPI
+    setLength(buff);
+    return buff;
+}
+
+Registrar::Registrar(uint32_t seed) : generator(seed)
+{
+    nextXid = std::uniform_int_distribution<uint16_t>(1, 0xffff)(generator);
+}
+
+uint64_t Registrar::random(uint64_t low, uint64_t high)
+{
+    return std::uniform_int_distribution<uint64_t>(low, high)(generator);
+}
+
+void Registrar::setServices(size_t ns,
+                            std::vector<request::ServiceRegistration> list,
+                            uint64_t now)
+{
+    std::erase_if(list, [this](const auto& reg) {
+        if (prepareSrvReg(reg, lifetime, 0).empty())
+        {
+            SLP_LOG_ERROR("SLP registration of %s exceeds %zu bytes",
+                          reg.urlEntry.url.c_str(), slp::MAX_LEN);
+            return true;
+        }
+        return false;
+    });
+
+    if (services.size() <= ns)
+    {
+        services.resize(ns + 1);
+    }
+    if (std::equal(list.begin(), list.end(), services[ns].begin(),
+                   services[ns].end(), sameRegistration))
+    {
+        return;
+    }
+    services[ns] = std::move(list);
+
+    for (auto& agent : directoryAgents)
+    {
+        if (agent.ns == ns)
+        {
+            agent.entries.assign(services[ns].size(), Entry());
+            scheduleRound(agent, now + random(0, START_WAIT));
+        }
+    }
+}
+
+void Registrar::heard(size_t ns, const request::DirectoryAgentAdvert& advert,
+                      uint64_t now)
+{
+    if (advert.errorCode)
+    {
+        return;
+    }
+
+    sockaddr_in6 addr{};
+    if (!agentAddress(advert.url, addr))
+    {
+        SLP_LOG_ERROR("SLP directory agent with an invalid URL: %s",
+                      advert.url.c_str());
+        return;
+    }
+
+    auto agent = std::find_if(
+        directoryAgents.begin(), directoryAgents.end(), [&](const auto& a) {
+            return a.ns == ns && memcmp(&a.addr.sin6_addr, &addr.sin6_addr,
+                                        sizeof(addr.sin6_addr)) == 0;
+        });
+
+    // RFC 2608 section 12.2.1, a DA going down advertises a zero timestamp
+    if (advert.bootTimestamp == 0)
+    {
+        if (agent != directoryAgents.end())
+        {
+            SLP_LOG_INFO("SLP directory agent %s went down",
+                         agent->url.c_str());
+            directoryAgents.erase(agent);
+        }
+        return;
+    }
+
+    auto scopes = slp::text::splitScopes(advert.scopeList);
+    if (agent == directoryAgents.end())
+    {
+        SLP_LOG_INFO("SLP directory agent %s found", advert.url.c_str());
+        agent = directoryAgents.emplace(directoryAgents.end());
+        agent->ns = ns;
+        agent->url = advert.url;
+        agent->addr = addr;
+    }
+    else if (agent->bootTimestamp == advert.bootTimestamp &&
+             agent->scopes == scopes)
+    {
+        return;
+    }
+
+    // New, rebooted and so without our registrations, or serving other
+    // scopes: register everything again
+    if (services.size() <= ns)
+    {
+        services.resize(ns + 1);
+    }
+    agent->bootTimestamp = advert.bootTimestamp;
+    agent->scopes = std::move(scopes);
+    agent->entries.assign(services[ns].size(), Entry());
+    agent->failures = 0;
+    scheduleRound(*agent, now + random(0, START_WAIT));
+}
+
+void Registrar::acknowledged(size_t ns, uint16_t xid, uint16_t errorCode,
+                             uint64_t now)
+{
+    for (auto& agent : directoryAgents)
+    {
+        if (agent.ns != ns)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < agent.entries.size(); i++)
+        {
+            auto& entry = agent.entries[i];
+            if (entry.state != State::SENT || entry.xid != xid)
+            {
+                continue;
+            }
+
+            if (errorCode == (uint16_t)slp::Error::DA_BUSY_NOW)
+            {
+                // Sent again once the retransmission is due
+                return;
+            }
+            entry.state = State::DONE;
+            entry.registered = errorCode == slp::SUCCESS;
+            if (errorCode)
+            {
+                SLP_LOG_ERROR("SLP directory agent %s rejected %s: %u",
+                              agent.url.c_str(),
+                              services[ns][i].urlEntry.url.c_str(),
+                              errorCode);
+            }
+            if (!pending(agent))
+            {
+                finishRound(agent, now);
+            }
+            return;
+        }
+    }
+}
+
+std::vector<Registrar::Outgoing> Registrar::due(uint64_t now)
+{
+    std::vector<Outgoing> out;
+
+    for (auto& agent : directoryAgents)
+    {
+        if (agent.roundAt <= now)
+        {
+            for (size_t i = 0; i < agent.entries.size(); i++)
+            {
+                auto& entry = agent.entries[i];
+                entry.state = inScopes(agent.scopes, services[agent.ns][i])
+                                  ? State::QUEUED
+                                  : State::DONE;
+                entry.attempts = 0;
+                entry.xid = nextXid++;
+                if (nextXid == 0)
+                {
+                    nextXid = 1;
+                }
+            }
+            agent.roundAt = NEVER;
+            agent.inRound = true;
+        }
+
+        for (auto& entry : agent.entries)
+        {
+            if (entry.state == State::SENT && entry.deadline <= now)
+            {
+                entry.state = entry.attempts < ATTEMPTS ? State::QUEUED
+                                                        : State::FAILED;
+            }
+        }
+    }
+
+    // Only a batch at a time, the rest follows PACE later
+    for (auto& agent : directoryAgents)
+    {
+        for (size_t i = 0;
+             now >= paceAt && i < agent.entries.size() && out.size() < BATCH;
+             i++)
+        {
+            auto& entry = agent.entries[i];
+            if (entry.state != State::QUEUED)
+            {
+                continue;
+            }
+            entry.state = State::SENT;
+            entry.deadline =
+                now + std::min(RETRY << entry.attempts, RETRY_MAX);
+            entry.attempts++;
+            out.push_back(
+                {agent.ns, agent.addr,
+                 prepareSrvReg(services[agent.ns][i], lifetime, entry.xid)});
+        }
+    }
+    if (!out.empty())
+    {
+        paceAt = now + PACE;
+    }
+
+    for (auto& agent : directoryAgents)
+    {
+        if (agent.inRound && !pending(agent))
+        {
+            finishRound(agent, now);
+        }
+    }
+    return out;
+}
+
+uint64_t Registrar::next() const
+{
+    uint64_t at = NEVER;
+
+    for (const auto& agent : directoryAgents)
+    {
+        at = std::min(at, agent.roundAt);
+        for (const auto& entry : agent.entries)
+        {
+            if (entry.state == State::SENT)
+            {
+                at = std::min(at, entry.deadline);
+            }
+            else if (entry.state == State::QUEUED)
+            {
+                at = std::min(at, paceAt);
+            }
+        }
+    }
+    return at;
+}
+
+size_t Registrar::registered() const
+{
+    size_t count = 0;
+    for (const auto& agent : directoryAgents)
+    {
+        count += std::count_if(agent.entries.begin(), agent.entries.end(),
+                               [](const auto& e) { return e.registered; });
+    }
+    return count;
+}
+
+bool Registrar::pending(const Agent& agent)
+{
+    return std::any_of(agent.entries.begin(), agent.entries.end(),
+                       [](const auto& e) {
+                           return e.state == State::QUEUED ||
+                                  e.state == State::SENT;
+                       });
+}
+
+void Registrar::scheduleRound(Agent& agent, uint64_t at)
+{
+    for (auto& entry : agent.entries)
+    {
+        entry.state = State::IDLE;
+    }
+    agent.inRound = false;
+    agent.roundAt = at;
+}
+
+void Registrar::finishRound(Agent& agent, uint64_t now)
+{
+    size_t failed = std::count_if(
+        agent.entries.begin(), agent.entries.end(),
+        [](const auto& e) { return e.state == State::FAILED; });
+    size_t registered =
+        std::count_if(agent.entries.begin(), agent.entries.end(),
+                      [](const auto& e) { return e.registered; });
+
+    for (auto& entry : agent.entries)
+    {
+        entry.state = State::IDLE;
+    }
+    agent.inRound = false;
+
+    if (failed)
+    {
+        uint64_t backoff = std::min(BACKOFF << std::min(agent.failures, 16U),
+                                    BACKOFF_MAX);
+        agent.failures++;
+        agent.roundAt = now + random(backoff / 2, backoff);
+        SLP_LOG_ERROR("SLP directory agent %s left %zu registrations "
+                      "unacknowledged, retrying in %llus",
+                      agent.url.c_str(), failed,
+                      (unsigned long long)(agent.roundAt - now) / 1000);
+        return;
+    }
+
+    // Refresh well before the registrations expire, at a random time so
+    // that the agents registered together drift apart
+    uint64_t refresh = uint64_t(lifetime) * 1000;
+    agent.failures = 0;
+    agent.roundAt = now + random(refresh / 2, refresh * 3 / 4);
+    SLP_LOG_INFO("SLP %zu services registered with %s", registered,
+                 agent.url.c_str());
+}
+
+void enable()
+{
+    saEnabled = true;
+}
+
+bool enabled()
+{
+    return saEnabled;
+}
+
+Registrar& registrar()
+{
+    static Registrar registrations;
+    return registrations;
+}
+
+uint64_t now()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+std::tuple<int, buffer> processDAAdvert(const Message& req)
+{
+    if (enabled())
+    {
+        registrar().heard(req.ns, req.body.daadvert, now());
+    }
+    return std::make_tuple(slp::SUCCESS, buffer());
+}
+
+std::tuple<int, buffer> processSrvAck(const Message& req)
+{
+    if (enabled())
+    {
+        registrar().acknowledged(req.ns, req.header.xid,
+                                 req.body.srvack.errorCode, now());
+    }
+    return std::make_tuple(slp::SUCCESS, buffer());
+}
+
+} // namespace sa
+} // namespace slp
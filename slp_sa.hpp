@@ -0,0 +1,232 @@
+#pragma once
+
+#include "slp.hpp"
+#include "slp_meta.hpp"
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace slp
+{
+namespace sa
+{
+
+/** @class Registrar
+ *
+ *  @brief Registrations of the offered services with directory agents.
+ *
+ *  Directory agents are learnt from their DAAdverts, each in the network
+ *  namespace it was heard in, and every service offered in that
+ *  namespace is registered with each agent serving its scopes. The
+ *  registrations of an agent are sent in rounds, BATCH SrvRegs at a time
+ *  PACE apart. A SrvReg is sent again after RETRY, doubling up to
+ *  RETRY_MAX, until it is acknowledged or ATTEMPTS were sent.
+ *
+ *  The rounds of a fleet of agents are spread out: the first one starts
+ *  at a random time within START_WAIT of hearing the directory agent, as
+ *  RFC 2608 section 12.2.2 asks, and the next at a random time between
+ *  half and three quarters of the registration lifetime. A round left
+ *  unacknowledged is tried again after a random backoff, doubling from
+ *  BACKOFF up to BACKOFF_MAX, so that the agents do not come back in
+ *  step once the directory agent does.
+ *
+ *  Times are in milliseconds of a monotonic clock.
+ */
+class Registrar
+{
+  public:
+    static constexpr size_t BATCH = 8;
+    static constexpr uint64_t PACE = 100;
+    static constexpr uint64_t START_WAIT = 3000;
+    /* CONFIG_RETRY and CONFIG_RETRY_MAX */
+    static constexpr uint64_t RETRY = 2000;
+    static constexpr uint64_t RETRY_MAX = 15000;
+    static constexpr unsigned ATTEMPTS = 4;
+    static constexpr uint64_t BACKOFF = 30000;
+    static constexpr uint64_t BACKOFF_MAX = 600000;
+    static constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+    /* A SrvReg to send, and where to */
+    struct Outgoing
+    {
+        size_t ns = 0;
+        sockaddr_in6 addr{};
+        buffer message;
+    };
+
+    /** Seconds the directory agents keep the registrations */
+    uint16_t lifetime = slp::REG_LIFETIME;
+
+    /** @brief Constructor
+     *
+     *  @param[in] seed - Seed of the random delays.
+     */
+    explicit Registrar(uint32_t seed = std::random_device{}());
+
+    /** @brief Set the services offered in a namespace, when they changed
+     *         they are registered again with its directory agents.
+     *
+     *  @param[in] ns - The network namespace, see slp::netns.
+     *  @param[in] services - The registrations, the lifetime of their
+     *                        URL entries is ignored.
+     *  @param[in] now - The current time.
+     */
+    void setServices(size_t ns,
+                     std::vector<request::ServiceRegistration> services,
+                     uint64_t now);
+
+    /** @brief Learn a directory agent from its DAAdvert. A new agent, or
+     *         one that rebooted, gets a round of registrations; one
+     *         advertising a zero boot timestamp is going down and is
+     *         forgotten.
+     *
+     *  @param[in] ns - The namespace the DAAdvert was heard in.
+     *  @param[in] advert - The DAAdvert.
+     *  @param[in] now - The current time.
+     */
+    void heard(size_t ns, const request::DirectoryAgentAdvert& advert,
+               uint64_t now);
+
+    /** @brief Handle the SrvAck of a registration.
+     *
+     *  @param[in] ns - The namespace the SrvAck arrived in.
+     *  @param[in] xid - The XID of the SrvAck.
+     *  @param[in] errorCode - Its error code, DA_BUSY_NOW gets the
+     *                         SrvReg sent again later.
+     *  @param[in] now - The current time.
+     */
+    void acknowledged(size_t ns, uint16_t xid, uint16_t errorCode,
+                      uint64_t now);
+
+    /** @brief Take the SrvRegs to send at a time, at most BATCH.
+     *
+     *  @param[in] now - The current time.
+     *
+     *  @return the SrvRegs.
+     */
+    std::vector<Outgoing> due(uint64_t now);
+
+    /** @brief When due has something to send next, NEVER if nothing */
+    uint64_t next() const;
+
+    /** @brief Number of directory agents known */
+    size_t agents() const
+    {
+        return directoryAgents.size();
+    }
+
+    /** @brief Number of registrations the directory agents acknowledged */
+    size_t registered() const;
+
+  private:
+    enum class State : uint8_t
+    {
+        IDLE,
+        QUEUED,
+        SENT,
+        DONE,
+        FAILED,
+    };
+
+    /* A service of the namespace, as registered with one agent */
+    struct Entry
+    {
+        State state = State::IDLE;
+        uint8_t attempts = 0;
+        uint16_t xid = 0;
+        uint64_t deadline = 0;
+        bool registered = false;
+    };
+
+    struct Agent
+    {
+        size_t ns = 0;
+        std::string url;
+        sockaddr_in6 addr{};
+        uint32_t bootTimestamp = 0;
+        std::vector<std::string> scopes;
+        std::vector<Entry> entries;
+        /* When the next round starts, NEVER during a round */
+        uint64_t roundAt = NEVER;
+        bool inRound = false;
+        unsigned failures = 0;
+    };
+
+    /** @brief Start a round of an agent at a time, replacing the one in
+     *         progress */
+    void scheduleRound(Agent& agent, uint64_t at);
+
+    /** @brief Schedule the next round of an agent once all of its
+     *         registrations are answered or have failed */
+    void finishRound(Agent& agent, uint64_t now);
+
+    /** @brief Whether registrations of an agent wait for their SrvAck,
+     *         or to be sent */
+    static bool pending(const Agent& agent);
+
+    /** @brief A random time between low and high */
+    uint64_t random(uint64_t low, uint64_t high);
+
+    std::vector<std::vector<request::ServiceRegistration>> services;
+    std::vector<Agent> directoryAgents;
+    std::minstd_rand generator;
+    uint16_t nextXid;
+    /* When the next batch may be sent */
+    uint64_t paceAt = 0;
+};
+
+/** @brief Encode a fresh SrvReg.
+ *
+ *  @param[in] reg - The registration.
+ *  @param[in] lifetime - Its lifetime in seconds.
+ *  @param[in] xid - The XID of the message.
+ *
+ *  @return the SrvReg, empty if it does not fit in slp::MAX_LEN.
+ */
+buffer prepareSrvReg(const request::ServiceRegistration& reg,
+                     uint16_t lifetime, uint16_t xid);
+
+/** @brief Encode the multicast SrvRqst that finds the directory agents,
+ *         RFC 2608 section 12.2.1.
+ *
+ *  @param[in] xid - The XID of the message.
+ */
+buffer prepareDADiscovery(uint16_t xid);
+
+/** Turn on the registrations with the directory agents. */
+void enable();
+
+/** Check if the registrations are on. */
+bool enabled();
+
+/** The registrations with the directory agents. */
+Registrar& registrar();
+
+/** Current time in milliseconds on the clock the registrar runs on. */
+uint64_t now();
+
+/** Handle the DAAdvert message, a reply so it is never answered.
+ *
+ * @param[in] req - The message to process.
+ *
+ * @return zero and an empty vector.
+ */
+std::tuple<int, buffer> processDAAdvert(const Message& req);
+
+/** Handle the SrvAck message, a reply so it is never answered.
+ *
+ * @param[in] req - The message to process.
+ *
+ * @return zero and an empty vector.
+ */
+std::tuple<int, buffer> processSrvAck(const Message& req);
+
+} // namespace sa
+} // namespace slp
@@ -0,0 +1,195 @@
+#include "slp_scheduler.hpp"
+
+#include "slp_log.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <charconv>
+
+namespace slp
+{
+namespace udp
+{
+
+namespace
+{
+
+/* An address as IPv6, IPv4 ones mapped */
+bool toIPv6(const sockaddr* addr, in6_addr& out)
+{
+    if (addr->sa_family == AF_INET6)
+    {
+        out = reinterpret_cast<const sockaddr_in6*>(addr)->sin6_addr;
+        return true;
+    }
+    if (addr->sa_family == AF_INET)
+    {
+        out = {};
+        out.s6_addr[10] = 0xff;
+        out.s6_addr[11] = 0xff;
+        memcpy(&out.s6_addr[12],
+               &reinterpret_cast<const sockaddr_in*>(addr)->sin_addr, 4);
+        return true;
+    }
+    return false;
+}
+
+bool inSubnet(const in6_addr& addr, const in6_addr& subnet, unsigned prefix)
+{
+    size_t bytes = prefix / 8;
+    if (memcmp(addr.s6_addr, subnet.s6_addr, bytes) != 0)
+    {
+        return false;
+    }
+    unsigned bits = prefix % 8;
+    if (bits == 0)
+    {
+        return true;
+    }
+    uint8_t mask = 0xff << (8 - bits);
+    return (addr.s6_addr[bytes] & mask) == (subnet.s6_addr[bytes] & mask);
+}
+
+} // namespace
+
+int Scheduler::setManagementSubnets(const std::vector<std::string>& list)
+{
+    std::vector<Subnet> parsed;
+
+    for (const auto& item : list)
+    {
+        auto slash = item.find('/');
+        auto address = item.substr(0, slash);
+
+        Subnet subnet{};
+        unsigned maxPrefix = 128;
+        in_addr v4{};
+        if (inet_pton(AF_INET, address.c_str(), &v4) == 1)
+        {
+            sockaddr_in sin{};
+            sin.sin_family = AF_INET;
+            sin.sin_addr = v4;
+            toIPv6(reinterpret_cast<const sockaddr*>(&sin), subnet.address);
+            maxPrefix = 32;
+        }
+        else if (inet_pton(AF_INET6, address.c_str(), &subnet.address) != 1)
+        {
+            SLP_LOG_ERROR("Invalid management subnet: %s", item.c_str());
+            return -EINVAL;
+        }
+
+        subnet.prefix = maxPrefix;
+        if (slash != std::string::npos)
+        {
+            const char* begin = item.data() + slash + 1;
+            const char* end = item.data() + item.size();
+            auto [ptr, ec] = std::from_chars(begin, end, subnet.prefix);
+            if (ec != std::errc() || ptr != end || begin == end ||
+                subnet.prefix > maxPrefix)
+            {
+                SLP_LOG_ERROR("Invalid management subnet: %s", item.c_str());
+                return -EINVAL;
+            }
+        }
+        subnet.prefix += 128 - maxPrefix;
+        parsed.push_back(subnet);
+    }
+
+    subnets = std::move(parsed);
+    return 0;
+}
+
+Scheduler::Class Scheduler::classify(const sockaddr* peer,
+                                     bool multicast) const
+{
+    if (!multicast)
+    {
+        return Class::URGENT;
+    }
+
+    in6_addr addr;
+    if (toIPv6(peer, addr))
+    {
+        for (const auto& subnet : subnets)
+        {
+            if (inSubnet(addr, subnet.address, subnet.prefix))
+            {
+                return Class::URGENT;
+            }
+        }
+    }
+    return Class::BULK;
+}
+
+bool Scheduler::push(Class cls, Request&& request)
+{
+    auto& urgent = queues[static_cast<size_t>(Class::URGENT)];
+    auto& bulk = queues[static_cast<size_t>(Class::BULK)];
+
+    if (cls == Class::URGENT)
+    {
+        if (urgent.size() >= URGENT_LIMIT)
+        {
+            dropped[static_cast<size_t>(Class::URGENT)]++;
+            return false;
+        }
+        urgent.push_back(std::move(request));
+        return true;
+    }
+
+    // Urgent work piling up, bulk work is the first to go
+    if (urgent.size() > URGENT_LIMIT / 2)
+    {
+        dropped[static_cast<size_t>(Class::BULK)]++;
+        return false;
+    }
+    if (bulk.size() >= BULK_LIMIT)
+    {
+        bulk.pop_front();
+        dropped[static_cast<size_t>(Class::BULK)]++;
+    }
+    bulk.push_back(std::move(request));
+    return true;
+}
+
+bool Scheduler::pop(Request& request,
+                    std::chrono::steady_clock::time_point now)
+{
+    auto& urgent = queues[static_cast<size_t>(Class::URGENT)];
+    auto& bulk = queues[static_cast<size_t>(Class::BULK)];
+
+    for (;;)
+    {
+        bool takeBulk = !bulk.empty() && (urgent.empty() || credit >= WEIGHT);
+        auto& queue = takeBulk ? bulk : urgent;
+        if (queue.empty())
+        {
+            return false;
+        }
+
+        auto cls =
+            static_cast<size_t>(takeBulk ? Class::BULK : Class::URGENT);
+        auto waited = std::max(now - queue.front().received,
+                               std::chrono::steady_clock::duration::zero());
+        delays[cls].record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(waited)
+                .count());
+        if (maxAge.count() > 0 && waited > maxAge)
+        {
+            queue.pop_front();
+            expired[cls]++;
+            continue;
+        }
+
+        request = std::move(queue.front());
+        queue.pop_front();
+        credit = takeBulk ? 0 : credit + 1;
+        return true;
+    }
+}
+
+} // namespace udp
+} // namespace slp
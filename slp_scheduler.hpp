@@ -0,0 +1,158 @@
+#pragma once
+
+#include "slp_trace.hpp"
+#include "sock_channel.hpp"
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace slp
+{
+
+namespace udp
+{
+
+class Ring;
+
+/** @class Scheduler
+ *
+ *  @brief Queues of the received requests, served by class.
+ *
+ *  Unicast requests, and any request from a management subnet, are
+ *  urgent; the other requests sent to the multicast group are bulk, a
+ *  multicast sweep from a scanner must not hold up the management
+ *  session waiting on a unicast reply. pop() takes up to WEIGHT urgent
+ *  requests for each bulk one, so bulk requests still make progress.
+ *
+ *  Both queues are bounded and bulk requests are shed first: one that
+ *  arrives while the urgent queue is over half full is dropped, and a
+ *  full bulk queue drops its oldest request, whose requester has most
+ *  likely retransmitted already. A full urgent queue drops the new
+ *  request.
+ *
+ *  A request is timed from when the kernel received it, so the wait in
+ *  the socket queue counts as well. One that has waited longer than
+ *  maxAge is dropped when its turn comes, as its requester has given up
+ *  on it or retransmitted, so that a backlog drains at the cost of a
+ *  pop instead of a reply nobody waits for.
+ */
+class Scheduler
+{
+  public:
+    enum class Class : size_t
+    {
+        URGENT,
+        BULK,
+    };
+    static constexpr size_t CLASSES = 2;
+
+    /* Urgent requests served for each bulk one */
+    static constexpr size_t WEIGHT = 4;
+    static constexpr size_t URGENT_LIMIT = 128;
+    static constexpr size_t BULK_LIMIT = 32;
+
+    /* A request waiting to be served, and where to reply */
+    struct Request
+    {
+        size_t ns = 0;
+        int fd = -1;
+        /* Reply through the ring the request came from, when set */
+        Ring* ring = nullptr;
+        udpsocket::Channel::SockAddr_t peer{};
+        bool multicast = false;
+        /* When the kernel received the request */
+        std::chrono::steady_clock::time_point received;
+        std::vector<uint8_t> data;
+    };
+
+    /** Drop the requests that waited longer, zero keeps them all. */
+    std::chrono::nanoseconds maxAge{0};
+
+    /** @brief Set the management subnets.
+     *
+     *  @param[in] subnets - IPv4 or IPv6 subnets, "address/prefix", a
+     *                       bare address is a single host.
+     *
+     *  @return Zero, or -EINVAL and the subnets are left unchanged when
+     *          one is invalid.
+     */
+    int setManagementSubnets(const std::vector<std::string>& subnets);
+
+    /** @brief Class of a request.
+     *
+     *  @param[in] peer - The address the request came from.
+     *  @param[in] multicast - The request was sent to a multicast group.
+     */
+    Class classify(const sockaddr* peer, bool multicast) const;
+
+    /** @brief Queue a request.
+     *
+     *  @return false if the request was shed.
+     */
+    bool push(Class cls, Request&& request);
+
+    /** @brief Take the next request to serve, dropping the ones that
+     *         waited past maxAge on the way.
+     *
+     *  @param[out] request - The request.
+     *  @param[in] now - The current time.
+     *
+     *  @return false when no request is waiting.
+     */
+    bool pop(Request& request, std::chrono::steady_clock::time_point now);
+
+    bool empty() const
+    {
+        return queues[0].empty() && queues[1].empty();
+    }
+
+    /** @brief Requests waiting in a class */
+    size_t size(Class cls) const
+    {
+        return queues[static_cast<size_t>(cls)].size();
+    }
+
+    /** @brief Requests of a class shed so far */
+    uint64_t shed(Class cls) const
+    {
+        return dropped[static_cast<size_t>(cls)];
+    }
+
+    /** @brief Requests of a class dropped for waiting past maxAge */
+    uint64_t stale(Class cls) const
+    {
+        return expired[static_cast<size_t>(cls)];
+    }
+
+    /** @brief Time the requests of a class waited, dropped ones included */
+    const slp::trace::Histogram& queueDelay(Class cls) const
+    {
+        return delays[static_cast<size_t>(cls)];
+    }
+
+  private:
+    /* IPv4 subnets are kept as IPv4 mapped IPv6 ones */
+    struct Subnet
+    {
+        in6_addr address;
+        unsigned prefix;
+    };
+
+    std::array<std::deque<Request>, CLASSES> queues;
+    std::array<uint64_t, CLASSES> dropped{};
+    std::array<uint64_t, CLASSES> expired{};
+    std::array<slp::trace::Histogram, CLASSES> delays;
+    /* Urgent requests served since the last bulk one */
+    size_t credit = 0;
+    std::vector<Subnet> subnets;
+};
+
+} // namespace udp
+} // namespace slp
@@ -1,7 +1,15 @@
+#include "config.h"
+
 #include "slp_server.hpp"
 
+#include "slp_log.hpp"
+#include "slp_netns.hpp"
+#include "slp_receive_queue.hpp"
 #include "sock_channel.hpp"
 
+#include <errno.h>
+#include <ifaddrs.h>
+#include <net/if.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +17,255 @@
 
 #include <memory>
 
+int slp::udp::Server::openSocket(bool& activated)
+{
+    activated = false;
+
+    int n = sd_listen_fds(1);
+    if (n < 0)
+    {
+        return n;
+    }
+    if (n > 1)
+    {
+        SLP_LOG_ERROR("Expected one socket from systemd, got %d", n);
+        return -EINVAL;
+    }
+    if (n == 1)
+    {
+        int fd = SD_LISTEN_FDS_START;
+        int r = sd_is_socket(fd, AF_UNSPEC, SOCK_DGRAM, -1);
+        if (r < 0)
+        {
+            return r;
+        }
+        if (r == 0)
+        {
+            SLP_LOG_ERROR("Socket passed by systemd is not a datagram socket");
+            return -EINVAL;
+        }
+        activated = true;
+        return fd;
+    }
+
+    return bindSocket();
+}
+
+int slp::udp::Server::bindSocket()
+{
+    struct sockaddr_in6 serverAddr{};
+
+    int fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+
+    serverAddr.sin6_family = AF_INET6;
+    serverAddr.sin6_port = htons(this->port);
+
+    if (bind(fd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0)
+    {
+        int r = -errno;
+        (void)close(fd);
+        return r;
+    }
+
+    return fd;
+}
+
+void slp::udp::Server::enableMulticast(int fd)
+{
+    int on = 1;
+
+    // The handler needs the destination to tell multicast requests apart
+    if (setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &on, sizeof(on)) < 0 ||
+        setsockopt(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on)) < 0)
+    {
+        SLP_LOG_ERROR("Unable to enable packet info: %s", strerror(errno));
+    }
+
+    struct ifaddrs* ifaddr;
+    if (getifaddrs(&ifaddr) == -1)
+    {
+        SLP_LOG_ERROR("Unable to read the interfaces: %s", strerror(errno));
+        return;
+    }
+    slp::deleted_unique_ptr<ifaddrs, freeifaddrs> ifaddrPtr(ifaddr);
+
+    for (ifaddrs* ifa = ifaddrPtr.get(); ifa != nullptr; ifa = ifa->ifa_next)
+    {
+        if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET ||
+            (ifa->ifa_flags & IFF_LOOPBACK) ||
+            !(ifa->ifa_flags & IFF_MULTICAST))
+        {
+            continue;
+        }
+
+        ip_mreqn mreq{};
+        inet_pton(AF_INET, slp::MULTICAST_ADDR, &mreq.imr_multiaddr);
+        mreq.imr_ifindex = if_nametoindex(ifa->ifa_name);
+
+        // Already joined when systemd set up the socket
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                       sizeof(mreq)) < 0 &&
+            errno != EADDRINUSE)
+        {
+            SLP_LOG_ERROR("Unable to join %s on %s: %s", slp::MULTICAST_ADDR,
+                          ifa->ifa_name, strerror(errno));
+        }
+    }
+}
+
+void slp::udp::Server::enableTimestamps(int fd)
+{
+    int on = 1;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+    {
+        SLP_LOG_ERROR("Unable to enable receive timestamps: %s",
+                      strerror(errno));
+    }
+}
+
+void slp::udp::Server::watchReceiveQueue(int fd)
+{
+    int r = slp::udp::enableDropCount(fd);
+    if (r < 0)
+    {
+        SLP_LOG_ERROR("Unable to count the dropped datagrams: %s",
+                      strerror(-r));
+    }
+
+    // Zero keeps the kernel default, the buffers grow with the bursts
+    size_t minBuffer = SOCKET_BUFFER_MIN;
+    if (slp::udp::bufferSize(fd) < minBuffer)
+    {
+        r = slp::udp::setBuffers(fd, minBuffer);
+        if (r < 0)
+        {
+            SLP_LOG_ERROR("Unable to set the socket buffers: %s",
+                          strerror(-r));
+        }
+    }
+}
+
+void slp::udp::Server::rearmIdleTimer()
+{
+    uint64_t now = 0;
+
+    if (!idleSource ||
+        sd_event_now(sd_event_source_get_event(idleSource), CLOCK_MONOTONIC,
+                     &now) < 0)
+    {
+        return;
+    }
+
+    auto timeout =
+        std::chrono::duration_cast<std::chrono::microseconds>(idleTimeout);
+    (void)sd_event_source_set_time(idleSource, now + timeout.count());
+}
+
+int slp::udp::Server::dispatch(sd_event_source* es, int fd, uint32_t revents,
+                               void* userdata)
+{
+    auto socket = static_cast<Socket*>(userdata);
+
+    socket->server->rearmIdleTimer();
+    return socket->server->callme(
+        es, fd, revents,
+        reinterpret_cast<void*>(static_cast<intptr_t>(socket->ns)));
+}
+
+void slp::udp::Server::dispatchPacket(Ring& ring, const Ring::Packet& packet,
+                                      void* userdata)
+{
+    auto socket = static_cast<Socket*>(userdata);
+
+    socket->server->rearmIdleTimer();
+    socket->server->onPacket(
+        ring, packet,
+        reinterpret_cast<void*>(static_cast<intptr_t>(socket->ns)));
+}
+
+void slp::udp::Server::RingDeleter::operator()(
+    [[maybe_unused]] Ring* ring) const
+{
+#if SLP_IO_URING
+    delete ring;
+#endif
+}
+
+int slp::udp::Server::addSocket(sd_event* event, size_t ns, int fd)
+{
+    if (onSocket)
+    {
+        onSocket(ns, fd);
+    }
+    sockets.push_back(std::make_unique<Socket>(this, ns, fd, nullptr));
+    auto socket = sockets.back().get();
+
+#if SLP_IO_URING
+    if (onPacket)
+    {
+        auto [r, ring] =
+            Ring::create(event, fd, &Server::dispatchPacket, socket);
+        socket->ring.reset(ring.release());
+        if (r < 0)
+        {
+            SLP_LOG_INFO("io_uring unavailable, using epoll: %s",
+                         strerror(-r));
+        }
+    }
+    if (socket->ring)
+    {
+        return 0;
+    }
+#endif
+    return sd_event_add_io(event, nullptr, fd, EPOLLIN, &Server::dispatch,
+                           socket);
+}
+
+void slp::udp::Server::addNamespaceSockets(sd_event* event)
+{
+    for (size_t ns = 1; ns < slp::netns::count(); ns++)
+    {
+        const auto& name = slp::netns::name(ns);
+        int fd = -1;
+        {
+            // The socket stays in the namespace it is created in
+            slp::netns::Enter enter(ns);
+            fd = enter.error() < 0 ? enter.error() : bindSocket();
+            if (fd >= 0)
+            {
+                enableMulticast(fd);
+                enableTimestamps(fd);
+                watchReceiveQueue(fd);
+            }
+        }
+        if (fd < 0)
+        {
+            SLP_LOG_ERROR("Unable to serve the network namespace %s: %s",
+                          name.c_str(), strerror(-fd));
+            continue;
+        }
+
+        int r = addSocket(event, ns, fd);
+        if (r < 0)
+        {
+            SLP_LOG_ERROR("Unable to serve the network namespace %s: %s",
+                          name.c_str(), strerror(-r));
+        }
+    }
+}
+
+int slp::udp::Server::idleExpired(sd_event_source* es, uint64_t /*usec*/,
+                                  void* /*userdata*/)
+{
+    SLP_LOG_INFO("No request received while idle, exiting");
+    return sd_event_exit(sd_event_source_get_event(es), 0);
+}
+
 /** General udp server which waits for the POLLIN event
     on the port and calls the call back once it gets the event.
     usage would be create the server with the port and the call back
@@ -16,18 +273,12 @@
  */
 int slp::udp::Server::run()
 {
-    struct sockaddr_in6 serverAddr{};
-
     sd_event* event = nullptr;
 
-    slp::deleted_unique_ptr<sd_event> eventPtr(event, [](sd_event* event) {
-        if (!event)
-        {
-            event = sd_event_unref(event);
-        }
-    });
+    slp::deleted_unique_ptr<sd_event, sd_event_unref> eventPtr(event);
 
     int fd = -1, r;
+    bool activated = false;
     sigset_t ss;
 
     r = sd_event_default(&event);
@@ -67,41 +318,80 @@ int slp::udp::Server::run()
         goto finish;
     }
 
-    fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    fd = openSocket(activated);
     if (fd < 0)
     {
-        r = -errno;
+        r = fd;
         goto finish;
     }
 
-    serverAddr.sin6_family = AF_INET6;
-    serverAddr.sin6_port = htons(this->port);
+    enableMulticast(fd);
+    enableTimestamps(fd);
+    watchReceiveQueue(fd);
 
-    if (bind(fd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0)
+    r = addSocket(eventPtr.get(), 0, fd);
+    if (r < 0)
     {
-        r = -errno;
         goto finish;
     }
+    addNamespaceSockets(eventPtr.get());
 
-    r = sd_event_add_io(eventPtr.get(), nullptr, fd, EPOLLIN, this->callme,
-                        nullptr);
-    if (r < 0)
+    // Only exit on idle when systemd holds the socket and can start us
+    // again, otherwise the service would just go away.
+    if (activated && idleTimeout.count() > 0)
     {
-        goto finish;
+        uint64_t now = 0;
+        auto timeout =
+            std::chrono::duration_cast<std::chrono::microseconds>(idleTimeout);
+
+        r = sd_event_now(eventPtr.get(), CLOCK_MONOTONIC, &now);
+        if (r < 0)
+        {
+            goto finish;
+        }
+
+        r = sd_event_add_time(eventPtr.get(), &idleSource, CLOCK_MONOTONIC,
+                              now + timeout.count(), 0, &Server::idleExpired,
+                              this);
+        if (r < 0)
+        {
+            goto finish;
+        }
+    }
+
+    if (onStart)
+    {
+        r = onStart(eventPtr.get(), fd);
+        if (r < 0)
+        {
+            goto finish;
+        }
     }
 
     r = sd_event_loop(eventPtr.get());
 
 finish:
 
-    if (fd >= 0)
+    if (idleSource)
+    {
+        idleSource = sd_event_source_unref(idleSource);
+    }
+
+    // Once added, the socket is closed along with the others
+    if (fd >= 0 && sockets.empty())
     {
         (void)close(fd);
     }
+    for (auto& socket : sockets)
+    {
+        socket->ring.reset();
+        (void)close(socket->fd);
+    }
+    sockets.clear();
 
     if (r < 0)
     {
-        fprintf(stderr, "Failure: %s\n", strerror(-r));
+        SLP_LOG_ERROR("Failure: %s", strerror(-r));
     }
 
     return r < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
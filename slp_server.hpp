@@ -2,14 +2,17 @@
 
 #include "slp.hpp"
 #include "slp_meta.hpp"
+#include "slp_uring.hpp"
 
 #include <sys/types.h>
 #include <systemd/sd-bus.h>
 #include <systemd/sd-daemon.h>
 #include <systemd/sd-event.h>
 
-#include <iostream>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace slp
 {
@@ -20,6 +23,19 @@ namespace udp
     on the port and calls the call back once it gets the event.
     usage would be create the server with the port and the call back
     and call the run method.
+
+    With onPacket set and slpd built with io_uring support, the socket
+    is served through an io_uring Ring instead of the POLLIN call back,
+    falling back to it when the kernel does not allow io_uring.
+
+    If the process was started through systemd socket activation the
+    passed datagram socket is used instead of binding a new one, and
+    with a non-zero idleTimeout the server exits after that long
+    without any request so that systemd can start it again on demand.
+
+    One more socket is bound in each network namespace opened with
+    slp::netns::open, all served from the same event loop. The call
+    backs get the namespace index of the socket as their userdata.
  */
 class Server
 {
@@ -36,7 +52,118 @@ class Server
     uint16_t port;
     sd_event_io_handler_t callme;
 
+    /** Exit after this period without requests, only honoured when
+     *  socket activated. Zero disables the idle exit.
+     */
+    std::chrono::seconds idleTimeout{0};
+
+    /** Called with the event loop and the server socket once the
+     *  socket is set up, before the loop runs. A negative return
+     *  value aborts the server.
+     */
+    using StartHandler = int (*)(sd_event* event, int fd);
+    StartHandler onStart = nullptr;
+
+    /** Called for every datagram when the socket is served through
+     *  io_uring, see Ring.
+     */
+    Ring::Handler onPacket = nullptr;
+
+    /** Called with every socket served, and the namespace it belongs
+     *  to, before it is served, e.g. to attach a socket filter.
+     */
+    using SocketHandler = void (*)(size_t ns, int fd);
+    SocketHandler onSocket = nullptr;
+
     int run();
+
+  private:
+    /** Get the socket passed by systemd, or create and bind one.
+     *
+     * @param[out] activated - set when the socket came from systemd.
+     *
+     * @return the socket descriptor, or negative errno on failure.
+     */
+    int openSocket(bool& activated);
+
+    /** Create a socket bound to the port in the current namespace.
+     *
+     * @return the socket descriptor, or negative errno on failure.
+     */
+    int bindSocket();
+
+    /** Serve a socket, through io_uring when onPacket is set and the
+     *  kernel allows it, else through the POLLIN call back.
+     *
+     * @param[in] event - The event loop.
+     * @param[in] ns - The namespace the socket belongs to.
+     * @param[in] fd - The socket, closed with the server.
+     *
+     * @return zero, or negative errno on failure.
+     */
+    int addSocket(sd_event* event, size_t ns, int fd);
+
+    /** Bind and serve a socket in every other namespace served, a
+     *  namespace that fails is left out. */
+    void addNamespaceSockets(sd_event* event);
+
+    /** Ask for the destination address of each packet and join the
+     *  SLP multicast group on every IPv4 interface.
+     *
+     * @param[in] fd - The server socket.
+     */
+    void enableMulticast(int fd);
+
+    /** Ask for the kernel receive time of each packet, so that requests
+     *  that waited too long can be dropped.
+     *
+     * @param[in] fd - The server socket.
+     */
+    void enableTimestamps(int fd);
+
+    /** Ask for the count of the datagrams the socket drops, and give it
+     *  buffers of at least SOCKET_BUFFER_MIN bytes, see ReceiveQueue.
+     *
+     * @param[in] fd - The server socket.
+     */
+    void watchReceiveQueue(int fd);
+
+    /** Call back for the sd event loop, re-arms the idle timer and
+     *  hands the event to the registered call back.
+     */
+    static int dispatch(sd_event_source* es, int fd, uint32_t revents,
+                        void* userdata);
+
+    /** Call back for the io_uring Ring, re-arms the idle timer and
+     *  hands the datagram to onPacket.
+     */
+    static void dispatchPacket(Ring& ring, const Ring::Packet& packet,
+                               void* userdata);
+
+    /** Call back for the idle timer, exits the event loop. */
+    static int idleExpired(sd_event_source* es, uint64_t usec,
+                           void* userdata);
+
+    /** Re-arm the idle timer relative to now. */
+    void rearmIdleTimer();
+
+    sd_event_source* idleSource = nullptr;
+
+    /* Deletes a Ring, which only exists when built with io_uring */
+    struct RingDeleter
+    {
+        void operator()(Ring* ring) const;
+    };
+
+    /* A socket served, and the namespace it belongs to */
+    struct Socket
+    {
+        Server* server;
+        size_t ns;
+        int fd;
+        std::unique_ptr<Ring, RingDeleter> ring;
+    };
+    std::vector<std::unique_ptr<Socket>> sockets;
 };
 } // namespace udp
 } // namespace slp
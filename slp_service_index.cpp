@@ -0,0 +1,92 @@
+#include "slp_service_index.hpp"
+
+#include <algorithm>
+
+namespace slp
+{
+
+namespace
+{
+
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325;
+constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+/* The two filter bits of a type, taken from both halves of its hash;
+ * FNV-1a as std::hash is only 32 bits wide on 32-bit targets */
+std::array<size_t, 2> filterBits(std::string_view folded, size_t bits)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (char c : folded)
+    {
+        hash = (hash ^ static_cast<uint8_t>(c)) * FNV_PRIME;
+    }
+    return {hash % bits, (hash >> 32) % bits};
+}
+
+} // namespace
+
+void ServiceIndex::add(std::string_view folded, uint32_t pos)
+{
+    for (auto bit : filterBits(folded, FILTER_BITS))
+    {
+        filter[bit / 64] |= 1ULL << (bit % 64);
+    }
+
+    auto& list = types[std::string(folded)];
+    if (list.empty() || list.back() != pos)
+    {
+        list.push_back(pos);
+    }
+}
+
+void ServiceIndex::build(const std::vector<ConfigData>& services)
+{
+    filter.fill(0);
+    types.clear();
+
+    for (uint32_t pos = 0; pos < services.size(); pos++)
+    {
+        auto folded = fold(services[pos].name);
+        add(folded, pos);
+
+        auto abstract = abstractType(folded);
+        if (!abstract.empty())
+        {
+            add(abstract, pos);
+        }
+    }
+}
+
+bool ServiceIndex::mayContain(std::string_view folded) const
+{
+    return std::ranges::all_of(filterBits(folded, FILTER_BITS),
+                               [this](size_t bit) {
+                                   return filter[bit / 64] &
+                                          (1ULL << (bit % 64));
+                               });
+}
+
+const std::vector<uint32_t>* ServiceIndex::find(std::string_view type) const
+{
+    // No request carries a longer type, nor could its reply carry a URL
+    std::array<char, slp::MAX_LEN> buf;
+    if (type.size() > buf.size())
+    {
+        return nullptr;
+    }
+
+    auto folded = fold(type, buf);
+    if (!mayContain(folded))
+    {
+        return nullptr;
+    }
+
+    auto it = types.find(folded);
+    if (it == types.end())
+    {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+} // namespace slp
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "slp_meta.hpp"
+#include "slp_service_info.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace slp
+{
+
+/* These are constexpr so that slp::builtin compiles a service table
+ * the same way the service files are read. */
+
+/** Fold into a caller buffer, so that lookups do not allocate.
+ *
+ * @param[in] item - The service type or scope.
+ * @param[out] out - Room for the folded string, at least item.size().
+ *
+ * @return the folded string, a view on out.
+ */
+constexpr std::string_view fold(std::string_view item, std::span<char> out)
+{
+    auto first = item.find_first_not_of(' ');
+    auto last = item.find_last_not_of(' ');
+    if (first == std::string_view::npos)
+    {
+        return {};
+    }
+
+    item = item.substr(first, last - first + 1);
+    std::transform(item.begin(), item.end(), out.begin(),
+                   [](unsigned char c) {
+                       return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+                   });
+    return {out.data(), item.size()};
+}
+
+/** Lower case a service type or scope and trim the spaces around it,
+ *  RFC 2608 compares them case insensitively.
+ *
+ * @param[in] item - The service type or scope.
+ *
+ * @return the folded string.
+ */
+constexpr std::string fold(std::string_view item)
+{
+    std::string folded(item.size(), '\0');
+    folded.resize(fold(item, folded).size());
+    return folded;
+}
+
+/** Get the abstract type of a concrete service type.
+ *
+ * @param[in] type - Service type, e.g. "service:printer:lpr".
+ *
+ * @return the abstract type, e.g. "service:printer", or an empty
+ *         view if the type is not a concrete one.
+ */
+constexpr std::string_view abstractType(std::string_view type)
+{
+    constexpr std::string_view prefix = "service:";
+    if (!type.starts_with(prefix))
+    {
+        return {};
+    }
+
+    auto colon = type.find(':', prefix.size());
+    if (colon == std::string_view::npos)
+    {
+        return {};
+    }
+    return type.substr(0, colon);
+}
+
+/** Sort services by case folded type, several files may offer one
+ *  service type, keep each instance once.
+ *
+ * @param[in,out] services - The services read.
+ */
+constexpr void sortServices(std::vector<ConfigData>& services)
+{
+    auto key = [](const ConfigData& svc) {
+        return std::make_tuple(fold(svc.name), std::cref(svc.type),
+                               std::cref(svc.port));
+    };
+    std::sort(services.begin(), services.end(),
+              [&key](const auto& a, const auto& b) { return key(a) < key(b); });
+    services.erase(std::unique(services.begin(), services.end(),
+                               [&key](const auto& a, const auto& b) {
+                                   return key(a) == key(b);
+                               }),
+                   services.end());
+}
+
+/** Build the service type list of the SrvTypeRply.
+ *
+ * @param[in] services - The services sorted by folded name.
+ *
+ * @return the comma separated names, several instances of one type
+ *         are listed once.
+ */
+constexpr std::string
+listServiceTypes(const std::vector<ConfigData>& services)
+{
+    std::string list;
+    std::string previous;
+
+    // Instances of one type are adjacent, list the type once
+    for (const auto& svc : services)
+    {
+        auto folded = fold(svc.name);
+        if (folded == previous)
+        {
+            continue;
+        }
+        if (!list.empty())
+        {
+            list += ',';
+        }
+        list += svc.name;
+        previous = std::move(folded);
+    }
+    return list;
+}
+
+/** @class ServiceIndex
+ *
+ *  @brief Case folded service type index over a service list.
+ *
+ *  Every service is indexed under its folded name and, when that names
+ *  a concrete type, under the abstract type as well, so one lookup
+ *  returns all the instances a SrvRqst matches. A small bloom filter in
+ *  front of the map turns most requests for types that are not offered
+ *  away without probing it.
+ */
+class ServiceIndex
+{
+  public:
+    /** @brief Index a service list.
+     *
+     *  @param[in] services - The services, positions in this list are
+     *                        what lookups return.
+     */
+    void build(const std::vector<ConfigData>& services);
+
+    /** @brief Find the services of a type.
+     *
+     *  @param[in] type - Abstract or concrete service type, in any case.
+     *
+     *  @return the positions of the matching services in the indexed
+     *          list, nullptr if there are none.
+     */
+    const std::vector<uint32_t>* find(std::string_view type) const;
+
+    /** @brief Check the negative filter for a folded type.
+     *
+     *  @param[in] folded - Folded service type.
+     *
+     *  @return false if the type is certainly not indexed.
+     */
+    bool mayContain(std::string_view folded) const;
+
+  private:
+    static constexpr size_t FILTER_BITS = 1024;
+
+    /* Lets the map be searched with a string_view */
+    struct TypeHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view type) const
+        {
+            return std::hash<std::string_view>{}(type);
+        }
+    };
+
+    void add(std::string_view folded, uint32_t pos);
+
+    std::array<uint64_t, FILTER_BITS / 64> filter{};
+    std::unordered_map<std::string, std::vector<uint32_t>, TypeHash,
+                       std::equal_to<>>
+        types;
+};
+
+} // namespace slp
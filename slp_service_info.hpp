@@ -1,10 +1,12 @@
 #pragma once
 
+#include "slp_meta.hpp"
+
+#include <stdint.h>
+
 #include <array>
-#include <fstream>
-#include <iostream>
-#include <sstream>
 #include <string>
+#include <string_view>
 
 namespace slp
 {
@@ -13,45 +15,85 @@ struct ConfigData
     std::string name;
     std::string type;
     std::string port;
+    /* Seconds the URL entries are advertised for */
+    uint16_t lifetime = slp::LIFETIME;
 
-    friend std::istream& operator>>(std::istream& str, ConfigData& data)
+    /** Fill the data from a service file line.
+     *
+     * The line format is "ServiceName serviceType Port [Lifetime]",
+     * the lifetime in seconds defaults to slp::LIFETIME.
+     *
+     * @param[in] line - The line to parse.
+     *
+     * @return true if all the fields were found and the lifetime is
+     *         valid, false otherwise.
+     */
+    constexpr bool parse(std::string_view line)
     {
-        std::string line;
-        constexpr auto DELIMITER = " ";
-        size_t delimtrPos = 0;
-        size_t delimtrPrevPos = 0;
-        std::array<std::string, 3> tokens;
-        std::getline(str, line);
+        constexpr auto DELIMITER = ' ';
+        std::array<std::string_view, 4> tokens;
         size_t count = 0;
 
-        delimtrPos = line.find(DELIMITER, delimtrPrevPos);
-        while (delimtrPos != std::string::npos)
+        while (!line.empty() && count < tokens.size())
         {
-            tokens[count] =
-                line.substr(delimtrPrevPos, (delimtrPos - delimtrPrevPos));
-            delimtrPrevPos = delimtrPos + 1;
-
-            delimtrPos = line.find(DELIMITER, delimtrPrevPos);
-            if (delimtrPos == std::string::npos &&
-                delimtrPrevPos < line.length())
+            auto delimtrPos = line.find(DELIMITER);
+            auto token = line.substr(0, delimtrPos);
+            if (!token.empty())
             {
-                delimtrPos = line.length();
+                tokens[count++] = token;
             }
-
-            count++;
+            if (delimtrPos == std::string_view::npos)
+            {
+                break;
+            }
+            line.remove_prefix(delimtrPos + 1);
         }
 
-        if (count > 2)
+        if (count < 3)
         {
-            data.name = tokens[0];
-            data.type = tokens[1];
-            data.port = tokens[2];
+            return false;
         }
-        else
+
+        lifetime = slp::LIFETIME;
+        if (count == 4)
         {
-            str.setstate(std::ios::failbit);
+            // Digits only, as std::from_chars takes them
+            uint32_t value = 0;
+            for (char c : tokens[3])
+            {
+                if (c < '0' || c > '9')
+                {
+                    return false;
+                }
+                value = value * 10 + (c - '0');
+                if (value > UINT16_MAX)
+                {
+                    return false;
+                }
+            }
+            if (value == 0)
+            {
+                return false;
+            }
+            lifetime = value;
         }
-        return str;
+
+        name = tokens[0];
+        type = tokens[1];
+        port = tokens[2];
+        return true;
+    }
+
+    /** The URL of the service up to the address. */
+    constexpr std::string urlPrefix() const
+    {
+        return name + ':' + type + "//";
+    }
+
+    /** The URL of the service after the address. */
+    constexpr std::string urlSuffix() const
+    {
+        return ',' + port;
     }
 };
 } // namespace slp
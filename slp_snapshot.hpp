@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace slp
+{
+
+/** @class Snapshot
+ *
+ *  @brief Immutable value published to lock free readers.
+ *
+ *  Readers enter a read side section by counting themselves against the
+ *  current epoch and then load the published pointer, neither step takes
+ *  a lock or allocates. A writer builds the next value on its own, swaps
+ *  it in with a single pointer store, flips the epoch and frees the old
+ *  value once the readers counted against the old epoch have left.
+ *
+ *  A thread must not publish while it holds a Reader of the same
+ *  snapshot, the publish would wait for itself.
+ */
+template <typename T>
+class Snapshot
+{
+  public:
+    /** @brief Read side section, the value stays valid while it lives */
+    class Reader
+    {
+      public:
+        explicit Reader(const Snapshot& snapshot) : snapshot(&snapshot)
+        {
+            while (true)
+            {
+                epoch = snapshot.epoch.load();
+                snapshot.readers[epoch & 1].fetch_add(1);
+                // A writer flipped the epoch in between, it may not wait
+                // for this counter any more
+                if (snapshot.epoch.load() == epoch)
+                {
+                    break;
+                }
+                snapshot.readers[epoch & 1].fetch_sub(1);
+            }
+            value = snapshot.current.load();
+        }
+
+        ~Reader()
+        {
+            if (snapshot)
+            {
+                snapshot->readers[epoch & 1].fetch_sub(1);
+            }
+        }
+
+        Reader(Reader&& other) noexcept :
+            snapshot(other.snapshot), value(other.value), epoch(other.epoch)
+        {
+            other.snapshot = nullptr;
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        Reader& operator=(Reader&&) = delete;
+
+        const T* get() const
+        {
+            return value;
+        }
+
+        const T& operator*() const
+        {
+            return *value;
+        }
+
+        const T* operator->() const
+        {
+            return value;
+        }
+
+        explicit operator bool() const
+        {
+            return value != nullptr;
+        }
+
+      private:
+        const Snapshot* snapshot;
+        const T* value = nullptr;
+        uint64_t epoch = 0;
+    };
+
+    Snapshot() = default;
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    ~Snapshot()
+    {
+        delete current.load();
+    }
+
+    /** @brief Enter a read side section. */
+    Reader read() const
+    {
+        return Reader(*this);
+    }
+
+    /** @brief Publish the next value and free the previous one.
+     *
+     *  @param[in] next - The value readers see from now on.
+     */
+    void publish(std::unique_ptr<const T> next)
+    {
+        std::lock_guard<std::mutex> lock(writer);
+
+        std::unique_ptr<const T> previous(current.exchange(next.release()));
+
+        // Readers entering from here on count against the new epoch and
+        // see the new value, wait for the ones that may hold the old one
+        uint64_t old = epoch.fetch_add(1);
+        while (readers[old & 1].load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+  private:
+    std::atomic<const T*> current{nullptr};
+    std::atomic<uint64_t> epoch{0};
+    mutable std::array<std::atomic<uint32_t>, 2> readers{};
+    /* Serialises the writers only */
+    std::mutex writer;
+};
+
+} // namespace slp
@@ -0,0 +1,145 @@
+#include "config.h"
+
+#include "slp_task.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <vector>
+
+namespace slp
+{
+namespace task
+{
+
+FramePool::FramePool(std::span<Block> storage) : blocks(storage)
+{
+    for (auto& block : blocks)
+    {
+        block.next = freeList;
+        freeList = &block;
+    }
+}
+
+void* FramePool::allocate(size_t size)
+{
+    used++;
+    peakUsed = std::max(peakUsed, used);
+
+    if (size > BLOCK_SIZE || !freeList)
+    {
+        heapCount++;
+        return ::operator new(size);
+    }
+
+    auto* block = freeList;
+    freeList = block->next;
+    return block->bytes;
+}
+
+void FramePool::deallocate(void* frame, size_t size)
+{
+    used--;
+
+    // std::less orders pointers into different objects as well
+    std::less<const void*> less;
+    if (blocks.empty() || less(frame, blocks.data()) ||
+        !less(frame, blocks.data() + blocks.size()))
+    {
+        ::operator delete(frame, size);
+        return;
+    }
+
+    auto* block = static_cast<Block*>(frame);
+    block->next = freeList;
+    freeList = block;
+}
+
+FramePool& frames()
+{
+    // Allocated with the first task rather than held in .bss
+    static std::vector<FramePool::Block> storage(TASK_FRAMES);
+    static FramePool pool(storage);
+    return pool;
+}
+
+bool Timer::await_suspend(std::coroutine_handle<> waiter) noexcept
+{
+    uint64_t now = 0;
+
+    handle = waiter;
+    result = sd_event_now(event, CLOCK_MONOTONIC, &now);
+    if (result < 0)
+    {
+        return false;
+    }
+
+    // Ask for millisecond accuracy, the default of 250ms would coalesce
+    // short delays away; the source is released when it fires
+    sd_event_source* source = nullptr;
+    result = sd_event_add_time(event, &source, CLOCK_MONOTONIC, now + usec,
+                               1000, &Timer::fired, this);
+    return result >= 0;
+}
+
+int Timer::fired(sd_event_source* es, uint64_t /*usec*/, void* userdata)
+{
+    auto* timer = static_cast<Timer*>(userdata);
+
+    // The frame, and the timer in it, may be gone once resumed
+    sd_event_source_unref(es);
+    timer->result = 0;
+    timer->handle.resume();
+    return 0;
+}
+
+bool Readiness::await_suspend(std::coroutine_handle<> waiter) noexcept
+{
+    handle = waiter;
+    // Released when it fires
+    sd_event_source* source = nullptr;
+    result = sd_event_add_io(event, &source, fd, events, &Readiness::fired,
+                             this);
+    return result >= 0;
+}
+
+int Readiness::fired(sd_event_source* es, int /*fd*/, uint32_t revents,
+                     void* userdata)
+{
+    auto* readiness = static_cast<Readiness*>(userdata);
+
+    sd_event_source_unref(es);
+    readiness->result = static_cast<int>(revents);
+    readiness->handle.resume();
+    return 0;
+}
+
+bool BusCall::await_suspend(std::coroutine_handle<> waiter) noexcept
+{
+    handle = waiter;
+    // A floating slot, released by sd-bus along with the reply
+    result = sd_bus_call_async(bus, nullptr, message, &BusCall::replied, this,
+                               usec);
+    return result >= 0;
+}
+
+int BusCall::replied(sd_bus_message* reply, void* userdata,
+                     sd_bus_error* /*error*/)
+{
+    auto* call = static_cast<BusCall*>(userdata);
+
+    if (sd_bus_message_is_method_error(reply, nullptr))
+    {
+        call->result = -sd_bus_message_get_errno(reply);
+    }
+    else
+    {
+        call->result = 0;
+        call->reply.reset(sd_bus_message_ref(reply));
+    }
+    call->handle.resume();
+    return 0;
+}
+
+} // namespace task
+} // namespace slp
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "slp.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <systemd/sd-bus.h>
+#include <systemd/sd-event.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <span>
+#include <tuple>
+
+namespace slp
+{
+
+/** Requests served as coroutines on the sd-event loop.
+ *
+ *  A request that has to wait, on a timer, on a socket or on a D-Bus
+ *  call, suspends its task and the loop serves other requests in the
+ *  meantime; the loop resumes the task from the call back of what it
+ *  waits for. Everything runs on the one thread of the loop.
+ */
+namespace task
+{
+
+/** @class FramePool
+ *
+ *  @brief Fixed size blocks for the frames of the tasks.
+ *
+ *  A task allocates its frame when it starts and frees it when it
+ *  returns, taking a block off a free list keeps that off the heap.
+ *  Frames larger than a block, or beyond the blocks there are, come
+ *  from the heap and are counted.
+ */
+class FramePool
+{
+  public:
+    static constexpr size_t BLOCK_SIZE = 1024;
+
+    union Block
+    {
+        Block* next;
+        alignas(std::max_align_t) std::byte bytes[BLOCK_SIZE];
+    };
+
+    /** @brief Constructor
+     *
+     *  @param[in] storage - The blocks, none sends every frame to the
+     *                       heap.
+     */
+    explicit FramePool(std::span<Block> storage);
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /** @brief Allocate a frame, from the heap when no block fits. */
+    void* allocate(size_t size);
+
+    /** @brief Free a frame of allocate(). */
+    void deallocate(void* frame, size_t size);
+
+    /** @brief Number of blocks */
+    size_t capacity() const
+    {
+        return blocks.size();
+    }
+
+    /** @brief Frames allocated and not yet freed */
+    size_t inUse() const
+    {
+        return used;
+    }
+
+    /** @brief Most frames allocated at once */
+    size_t peak() const
+    {
+        return peakUsed;
+    }
+
+    /** @brief Frames that came from the heap */
+    uint64_t heapFrames() const
+    {
+        return heapCount;
+    }
+
+  private:
+    std::span<Block> blocks;
+    Block* freeList = nullptr;
+    size_t used = 0;
+    size_t peakUsed = 0;
+    uint64_t heapCount = 0;
+};
+
+/** @brief The pool of the request tasks, TASK_FRAMES blocks */
+FramePool& frames();
+
+/** @class Task
+ *
+ *  @brief The coroutine type of a task.
+ *
+ *  A task starts at once and runs until it co_awaits something that is
+ *  not ready, its caller then carries on. Nothing waits on a task, its
+ *  frame is freed when it returns.
+ */
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+
+        static void* operator new(size_t size)
+        {
+            return frames().allocate(size);
+        }
+
+        static void operator delete(void* frame, size_t size)
+        {
+            frames().deallocate(frame, size);
+        }
+    };
+};
+
+/** @class Timer
+ *
+ *  @brief Awaits a delay on CLOCK_MONOTONIC, see sleep().
+ */
+class Timer
+{
+  public:
+    Timer(sd_event* event, uint64_t usec) : event(event), usec(usec) {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    /* Carries on at once when the timer cannot be set */
+    bool await_suspend(std::coroutine_handle<> waiter) noexcept;
+
+    int await_resume() const noexcept
+    {
+        return result;
+    }
+
+  private:
+    static int fired(sd_event_source* es, uint64_t usec, void* userdata);
+
+    sd_event* event;
+    uint64_t usec;
+    std::coroutine_handle<> handle;
+    int result = 0;
+};
+
+/** @class Readiness
+ *
+ *  @brief Awaits events on a descriptor, see readable().
+ */
+class Readiness
+{
+  public:
+    Readiness(sd_event* event, int fd, uint32_t events) :
+        event(event), fd(fd), events(events)
+    {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    /* Carries on at once when the descriptor cannot be watched */
+    bool await_suspend(std::coroutine_handle<> waiter) noexcept;
+
+    int await_resume() const noexcept
+    {
+        return result;
+    }
+
+  private:
+    static int fired(sd_event_source* es, int fd, uint32_t revents,
+                     void* userdata);
+
+    sd_event* event;
+    int fd;
+    uint32_t events;
+    std::coroutine_handle<> handle;
+    int result = 0;
+};
+
+using BusMessage = slp::deleted_unique_ptr<sd_bus_message,
+                                           sd_bus_message_unref>;
+
+/** @class BusCall
+ *
+ *  @brief Awaits the reply to a D-Bus method call, see call().
+ */
+class BusCall
+{
+  public:
+    BusCall(sd_bus* bus, sd_bus_message* message, uint64_t usec) :
+        bus(bus), message(message), usec(usec)
+    {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    /* Carries on at once when the call cannot be sent */
+    bool await_suspend(std::coroutine_handle<> waiter) noexcept;
+
+    std::tuple<int, BusMessage> await_resume() noexcept
+    {
+        return std::make_tuple(result, std::move(reply));
+    }
+
+  private:
+    static int replied(sd_bus_message* reply, void* userdata,
+                       sd_bus_error* error);
+
+    sd_bus* bus;
+    sd_bus_message* message;
+    uint64_t usec;
+    std::coroutine_handle<> handle;
+    int result = 0;
+    BusMessage reply;
+};
+
+/** @brief Wait for a delay.
+ *
+ *  @param[in] event - The event loop.
+ *  @param[in] usec - The delay in microseconds.
+ *
+ *  @return an awaitable giving zero once the delay is over, or a
+ *          negative errno at once if the timer could not be set.
+ */
+inline Timer sleep(sd_event* event, uint64_t usec)
+{
+    return Timer(event, usec);
+}
+
+/** @brief Wait for a descriptor to be readable.
+ *
+ *  @param[in] event - The event loop.
+ *  @param[in] fd - The descriptor.
+ *  @param[in] events - The epoll events to wait for.
+ *
+ *  @return an awaitable giving the epoll events that occurred, or a
+ *          negative errno at once if the descriptor cannot be watched.
+ */
+inline Readiness readable(sd_event* event, int fd, uint32_t events = EPOLLIN)
+{
+    return Readiness(event, fd, events);
+}
+
+/** @brief Call a D-Bus method.
+ *
+ *  @param[in] bus - The bus, attached to the event loop of the task.
+ *  @param[in] message - The method call.
+ *  @param[in] usec - The reply timeout, zero for the bus default.
+ *
+ *  @return an awaitable giving zero and the reply, or a negative errno
+ *          and no reply when the call failed or returned an error.
+ */
+inline BusCall call(sd_bus* bus, sd_bus_message* message, uint64_t usec = 0)
+{
+    return BusCall(bus, message, usec);
+}
+
+} // namespace task
+} // namespace slp
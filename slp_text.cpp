@@ -0,0 +1,350 @@
+#include "slp_text.hpp"
+
+#include "slp_service_index.hpp"
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace slp
+{
+
+namespace text
+{
+
+namespace
+{
+
+/* Length of the valid UTF-8 sequence at the start of s, 0 if it is
+ * invalid: truncated, overlong, a surrogate or above U+10FFFF */
+size_t sequenceLength(const uint8_t* s, size_t n)
+{
+    uint8_t lead = s[0];
+    size_t len = 0;
+    uint32_t cp = 0;
+    uint32_t min = 0;
+
+    if (lead < 0x80)
+    {
+        return 1;
+    }
+    else if ((lead & 0xe0) == 0xc0)
+    {
+        len = 2;
+        cp = lead & 0x1f;
+        min = 0x80;
+    }
+    else if ((lead & 0xf0) == 0xe0)
+    {
+        len = 3;
+        cp = lead & 0x0f;
+        min = 0x800;
+    }
+    else if ((lead & 0xf8) == 0xf0)
+    {
+        len = 4;
+        cp = lead & 0x07;
+        min = 0x10000;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (n < len)
+    {
+        return 0;
+    }
+    for (size_t i = 1; i < len; i++)
+    {
+        if ((s[i] & 0xc0) != 0x80)
+        {
+            return 0;
+        }
+        cp = (cp << 6) | (s[i] & 0x3f);
+    }
+    if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+    {
+        return 0;
+    }
+    return len;
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Decode the escape at the start of str into out */
+bool decodeEscape(std::string_view str, std::string& out)
+{
+    if (str.size() < 3)
+    {
+        return false;
+    }
+    int high = hexValue(str[1]);
+    int low = hexValue(str[2]);
+    if (high < 0 || low < 0)
+    {
+        return false;
+    }
+    out.push_back(static_cast<char>((high << 4) | low));
+    return true;
+}
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#define SLP_TEXT_VECTOR 1
+
+constexpr size_t WIDTH = 16;
+
+#if defined(__SSE2__)
+constexpr const char* KERNELS = "sse2";
+
+/* One bit per byte */
+using Mask = uint32_t;
+
+Mask equalMask(const uint8_t* p, uint8_t c)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+Mask highMask(const uint8_t* p)
+{
+    return _mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+size_t firstSet(Mask mask)
+{
+    return __builtin_ctz(mask);
+}
+#else
+constexpr const char* KERNELS = "neon";
+
+/* NEON has no movemask, narrowing the byte lanes by 4 bits leaves a
+ * nibble per byte instead */
+using Mask = uint64_t;
+
+Mask narrow(uint8x16_t lanes)
+{
+    return vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(lanes), 4)), 0);
+}
+
+Mask equalMask(const uint8_t* p, uint8_t c)
+{
+    return narrow(vceqq_u8(vld1q_u8(p), vdupq_n_u8(c)));
+}
+
+Mask highMask(const uint8_t* p)
+{
+    return narrow(vcgeq_u8(vld1q_u8(p), vdupq_n_u8(0x80)));
+}
+
+size_t firstSet(Mask mask)
+{
+    return __builtin_ctzll(mask) / 4;
+}
+#endif
+
+/* Number of ASCII bytes at the start of s */
+size_t asciiPrefix(const uint8_t* s, size_t n)
+{
+    size_t i = 0;
+    for (; i + WIDTH <= n; i += WIDTH)
+    {
+        Mask mask = highMask(s + i);
+        if (mask)
+        {
+            return i + firstSet(mask);
+        }
+    }
+    while (i < n && s[i] < 0x80)
+    {
+        i++;
+    }
+    return i;
+}
+#else
+constexpr const char* KERNELS = "scalar";
+#endif
+
+} // namespace
+
+namespace scalar
+{
+
+bool validUTF8(std::string_view str)
+{
+    auto s = reinterpret_cast<const uint8_t*>(str.data());
+    size_t i = 0;
+    while (i < str.size())
+    {
+        size_t len = sequenceLength(s + i, str.size() - i);
+        if (len == 0)
+        {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+size_t find(std::string_view str, char c, size_t pos)
+{
+    for (size_t i = pos; i < str.size(); i++)
+    {
+        if (str[i] == c)
+        {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+bool unescape(std::string_view str, std::string& out)
+{
+    out.clear();
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        if (str[i] != '\\')
+        {
+            out.push_back(str[i]);
+            continue;
+        }
+        if (!decodeEscape(str.substr(i), out))
+        {
+            return false;
+        }
+        i += 2;
+    }
+    return true;
+}
+
+} // namespace scalar
+
+const char* kernels()
+{
+    return KERNELS;
+}
+
+#ifdef SLP_TEXT_VECTOR
+bool validUTF8(std::string_view str)
+{
+    auto s = reinterpret_cast<const uint8_t*>(str.data());
+    size_t n = str.size();
+    size_t i = 0;
+
+    // Skip the ASCII runs 16 bytes at a time, decode the rest
+    while (i < n)
+    {
+        i += asciiPrefix(s + i, n - i);
+        if (i == n)
+        {
+            break;
+        }
+        size_t len = sequenceLength(s + i, n - i);
+        if (len == 0)
+        {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+size_t find(std::string_view str, char c, size_t pos)
+{
+    auto s = reinterpret_cast<const uint8_t*>(str.data());
+    size_t i = pos;
+    for (; i + WIDTH <= str.size(); i += WIDTH)
+    {
+        Mask mask = equalMask(s + i, c);
+        if (mask)
+        {
+            return i + firstSet(mask);
+        }
+    }
+    return scalar::find(str, c, i);
+}
+
+bool unescape(std::string_view str, std::string& out)
+{
+    out.clear();
+    size_t start = 0;
+    size_t escape = 0;
+
+    // Copy the runs between the escapes whole
+    while ((escape = find(str, '\\', start)) != std::string_view::npos)
+    {
+        out.append(str.substr(start, escape - start));
+        if (!decodeEscape(str.substr(escape), out))
+        {
+            return false;
+        }
+        start = escape + 3;
+    }
+    out.append(str.substr(start));
+    return true;
+}
+#else
+bool validUTF8(std::string_view str)
+{
+    return scalar::validUTF8(str);
+}
+
+size_t find(std::string_view str, char c, size_t pos)
+{
+    return scalar::find(str, c, pos);
+}
+
+bool unescape(std::string_view str, std::string& out)
+{
+    return scalar::unescape(str, out);
+}
+#endif
+
+std::vector<std::string> splitScopes(std::string_view scopeList)
+{
+    std::vector<std::string> scopes;
+    std::string decoded;
+
+    // Scopes compare unescaped, an invalid escape is kept as is
+    splitList(scopeList, [&](std::string_view item) {
+        auto scope = fold(unescape(item, decoded) ? decoded : item);
+        if (!scope.empty() &&
+            std::find(scopes.begin(), scopes.end(), scope) == scopes.end())
+        {
+            scopes.emplace_back(std::move(scope));
+        }
+    });
+
+    if (scopes.empty())
+    {
+        scopes.emplace_back("default");
+    }
+    std::sort(scopes.begin(), scopes.end());
+    return scopes;
+}
+
+} // namespace text
+} // namespace slp
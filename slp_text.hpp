@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace slp
+{
+
+/** String scanning kernels for the SLP text fields.
+ *
+ *  The kernels look at 16 bytes at a time with SSE2 on x86-64 and NEON on
+ *  ARM, and byte by byte elsewhere. The scalar versions are kept in
+ *  text::scalar for the tests and the benchmark.
+ */
+namespace text
+{
+
+/** @brief Name of the kernels compiled in, "sse2", "neon" or "scalar" */
+const char* kernels();
+
+/** @brief Check that a string is valid UTF-8, RFC 3629, as RFC 2608
+ *         requires of every string in a message.
+ */
+bool validUTF8(std::string_view str);
+
+/** @brief Position of the first c at or after pos, npos if none */
+size_t find(std::string_view str, char c, size_t pos = 0);
+
+/** @brief Decode the \\HH escapes of a list item, RFC 2608 5.
+ *
+ *  @param[in] str - The escaped string.
+ *  @param[out] out - The decoded string.
+ *
+ *  @return false if an escape is not followed by two hex digits.
+ */
+bool unescape(std::string_view str, std::string& out);
+
+/** @brief Call f with every item of a comma separated list, as is,
+ *         escapes included. An empty list has no items.
+ */
+template <typename F>
+void splitList(std::string_view list, F&& f)
+{
+    if (list.empty())
+    {
+        return;
+    }
+
+    size_t start = 0;
+    size_t comma = 0;
+    while ((comma = find(list, ',', start)) != std::string_view::npos)
+    {
+        f(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    f(list.substr(start));
+}
+
+/** @brief Split a scope list into its decoded and case folded scopes,
+ *         an empty list means DEFAULT.
+ *
+ *  @return the scopes, sorted and each listed once.
+ */
+std::vector<std::string> splitScopes(std::string_view scopeList);
+
+namespace scalar
+{
+
+bool validUTF8(std::string_view str);
+size_t find(std::string_view str, char c, size_t pos = 0);
+bool unescape(std::string_view str, std::string& out);
+
+} // namespace scalar
+
+} // namespace text
+} // namespace slp
@@ -0,0 +1,109 @@
+#include "slp_timer_wheel.hpp"
+
+namespace slp
+{
+
+TimerWheel::TimerWheel(uint64_t now) : now(now)
+{
+    heads.fill(NONE);
+}
+
+uint32_t TimerWheel::slotFor(uint64_t expiry) const
+{
+    uint64_t delta = expiry - now;
+
+    // Past the last level, park on it and look again when it cascades
+    if (delta >= SPAN)
+    {
+        expiry = now + SPAN - 1;
+        delta = SPAN - 1;
+    }
+
+    size_t level = 0;
+    while (delta >= (1ULL << (SLOT_BITS * (level + 1))))
+    {
+        level++;
+    }
+
+    return level * SLOTS + ((expiry >> (SLOT_BITS * level)) & (SLOTS - 1));
+}
+
+void TimerWheel::link(uint32_t id, uint32_t slot)
+{
+    auto& node = nodes[id];
+    node.slot = slot;
+    node.prev = NONE;
+    node.next = heads[slot];
+    if (node.next != NONE)
+    {
+        nodes[node.next].prev = id;
+    }
+    heads[slot] = id;
+    count++;
+}
+
+void TimerWheel::unlink(uint32_t id)
+{
+    auto& node = nodes[id];
+    if (node.prev != NONE)
+    {
+        nodes[node.prev].next = node.next;
+    }
+    else
+    {
+        heads[node.slot] = node.next;
+    }
+    if (node.next != NONE)
+    {
+        nodes[node.next].prev = node.prev;
+    }
+    node.prev = node.next = node.slot = NONE;
+    count--;
+}
+
+void TimerWheel::schedule(uint32_t id, uint64_t expiry)
+{
+    if (id >= nodes.size())
+    {
+        nodes.resize(id + 1);
+    }
+    if (nodes[id].slot != NONE)
+    {
+        unlink(id);
+    }
+    if (expiry <= now)
+    {
+        expiry = now + 1;
+    }
+
+    nodes[id].expiry = expiry;
+    link(id, slotFor(expiry));
+}
+
+void TimerWheel::cancel(uint32_t id)
+{
+    if (scheduled(id))
+    {
+        unlink(id);
+    }
+}
+
+void TimerWheel::cascade(size_t level)
+{
+    auto& head =
+        heads[level * SLOTS + ((now >> (SLOT_BITS * level)) & (SLOTS - 1))];
+
+    // Detach the whole list first, entries parked past the last level
+    // can land on a slot of the same level again
+    uint32_t id = head;
+    head = NONE;
+    while (id != NONE)
+    {
+        uint32_t next = nodes[id].next;
+        count--;
+        link(id, slotFor(nodes[id].expiry));
+        id = next;
+    }
+}
+
+} // namespace slp
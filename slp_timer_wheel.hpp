@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <vector>
+
+namespace slp
+{
+
+/** @class TimerWheel
+ *
+ *  @brief Hierarchical timing wheel expiring entries identified by small
+ *         integer ids at a one tick granularity.
+ *
+ *  Each level has 64 slots, the first level covers the next 64 ticks and
+ *  every further level 64 times the previous one. An entry is kept on the
+ *  coarsest level its remaining time needs and moves down a level each
+ *  time the finer level wraps, so scheduling and cancelling are O(1) no
+ *  matter how many entries there are.
+ */
+class TimerWheel
+{
+  public:
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = 1 << SLOT_BITS;
+    static constexpr size_t LEVELS = 3;
+
+    /** @brief Longest delay kept without re-scheduling on cascade */
+    static constexpr uint64_t SPAN = 1ULL << (SLOT_BITS * LEVELS);
+
+    explicit TimerWheel(uint64_t now = 0);
+
+    /** @brief Schedule, or re-schedule, an entry.
+     *
+     *  @param[in] id - Id of the entry.
+     *  @param[in] expiry - Tick at which the entry expires, an expiry
+     *                      in the past expires on the next tick.
+     */
+    void schedule(uint32_t id, uint64_t expiry);
+
+    /** @brief Cancel an entry, nothing happens if it is not scheduled.
+     *
+     *  @param[in] id - Id of the entry.
+     */
+    void cancel(uint32_t id);
+
+    /** @brief Check if an entry is scheduled.
+     *
+     *  @param[in] id - Id of the entry.
+     */
+    bool scheduled(uint32_t id) const
+    {
+        return id < nodes.size() && nodes[id].slot != NONE;
+    }
+
+    /** @brief Number of scheduled entries */
+    size_t size() const
+    {
+        return count;
+    }
+
+    /** @brief Current tick of the wheel */
+    uint64_t current() const
+    {
+        return now;
+    }
+
+    /** @brief Move the wheel forward, expiring the entries that are due.
+     *
+     *  @param[in] to - The tick to advance to.
+     *  @param[in] expired - Called with the id of each expired entry, the
+     *                       entry is no longer scheduled at that point.
+     */
+    template <typename Callback>
+    void advance(uint64_t to, Callback&& expired)
+    {
+        while (now < to)
+        {
+            if (count == 0)
+            {
+                now = to;
+                break;
+            }
+
+            now++;
+            for (size_t level = LEVELS - 1; level > 0; level--)
+            {
+                if ((now & ((1ULL << (SLOT_BITS * level)) - 1)) == 0)
+                {
+                    cascade(level);
+                }
+            }
+
+            auto& head = heads[now & (SLOTS - 1)];
+            while (head != NONE)
+            {
+                uint32_t id = head;
+                unlink(id);
+                expired(id);
+            }
+        }
+    }
+
+  private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node
+    {
+        uint32_t prev = NONE;
+        uint32_t next = NONE;
+        uint32_t slot = NONE;
+        uint64_t expiry = 0;
+    };
+
+    /** @brief Slot an expiry belongs to given the current tick */
+    uint32_t slotFor(uint64_t expiry) const;
+
+    void link(uint32_t id, uint32_t slot);
+    void unlink(uint32_t id);
+
+    /** @brief Move the entries of the current slot of a level down */
+    void cascade(size_t level);
+
+    std::vector<Node> nodes;
+    std::array<uint32_t, SLOTS * LEVELS> heads;
+    uint64_t now;
+    size_t count = 0;
+};
+
+} // namespace slp
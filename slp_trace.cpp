@@ -0,0 +1,63 @@
+#include "slp_trace.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace slp
+{
+
+namespace trace
+{
+
+void Histogram::record(uint64_t ns)
+{
+    size_t bucket = ns ? std::bit_width(ns) - 1 : 0;
+    buckets[std::min(bucket, BUCKETS - 1)]++;
+    total++;
+    longest = std::max(longest, ns);
+}
+
+uint64_t Histogram::percentile(double q) const
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the wanted duration, counting from 1
+    uint64_t rank = std::max<uint64_t>(1, q * total + 0.5);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        seen += buckets[bucket];
+        if (seen >= rank)
+        {
+            return std::min<uint64_t>(longest, (2ULL << bucket) - 1);
+        }
+    }
+    return longest;
+}
+
+void setSampleInterval(unsigned interval)
+{
+    auto& s = internal::sampler;
+    s.interval = interval;
+    s.countdown = interval;
+    s.active = false;
+}
+
+const Histogram& histogram(Stage stage)
+{
+    return internal::sampler.stages[static_cast<size_t>(stage)];
+}
+
+const char* stageName(size_t stage)
+{
+    static constexpr const char* names[STAGES] = {
+        "read", "parse", "process", "write", "addresses", "services",
+    };
+    return stage < STAGES ? names[stage] : "unknown";
+}
+
+} // namespace trace
+} // namespace slp
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <chrono>
+
+/** Tracing of the stages of a request.
+ *
+ *  SLP_PROBE places a USDT probe of the slpd provider, with the XID and
+ *  the function id of the request as arguments, when slpd is built with
+ *  sys/sdt.h. A probe is a nop until a tracer attaches to it, e.g.
+ *
+ *    bpftrace -e 'usdt:/usr/sbin/slpd:parse_done { @[arg1] = count(); }'
+ *
+ *  Without sys/sdt.h the probes, and their arguments, are compiled out.
+ */
+#if SLP_USDT
+#include <sys/sdt.h>
+#define SLP_PROBE(name, xid, function)                                         \
+    DTRACE_PROBE2(slpd, name, (unsigned)(xid), (unsigned)(function))
+#else
+#define SLP_PROBE(name, xid, function)                                         \
+    do                                                                         \
+    {                                                                          \
+        if (false)                                                             \
+        {                                                                      \
+            (void)(xid);                                                       \
+            (void)(function);                                                  \
+        }                                                                      \
+    } while (0)
+#endif
+
+namespace slp
+{
+
+namespace trace
+{
+
+/* Stages of a request, and of the registry reloads */
+enum class Stage : size_t
+{
+    /* Read, and queued until taken by the scheduler */
+    READ,
+    PARSE,
+    PROCESS,
+    WRITE,
+    ADDRESSES,
+    SERVICES,
+};
+
+constexpr size_t STAGES = 6;
+
+/** @class Histogram
+ *
+ *  @brief Durations in power of two nanosecond buckets, bucket n holds
+ *         the durations from 2^n up to 2^(n+1) nanoseconds.
+ */
+class Histogram
+{
+  public:
+    static constexpr size_t BUCKETS = 40;
+
+    void record(uint64_t ns);
+
+    /** @brief Number of recorded durations */
+    uint64_t count() const
+    {
+        return total;
+    }
+
+    /** @brief Upper bound, in nanoseconds, of the bucket holding the
+     *         given fraction of the recorded durations, 0 when empty.
+     */
+    uint64_t percentile(double q) const;
+
+    /** @brief Longest recorded duration in nanoseconds */
+    uint64_t max() const
+    {
+        return longest;
+    }
+
+  private:
+    std::array<uint64_t, BUCKETS> buckets{};
+    uint64_t total = 0;
+    uint64_t longest = 0;
+};
+
+namespace internal
+{
+
+/* State of the sampler, only touched from the event loop. A variable
+ * rather than a function so that an unsampled request costs one load
+ * and a branch per stage. */
+struct Sampler
+{
+    /* Time every interval-th request, 0 disables */
+    unsigned interval = 0;
+    unsigned countdown = 0;
+    /* The current request is being timed */
+    bool active = false;
+    std::chrono::steady_clock::time_point last;
+    std::array<Histogram, STAGES> stages;
+};
+
+inline Sampler sampler;
+
+} // namespace internal
+
+/** @brief Time the stages of one request out of every interval,
+ *         0 stops the timing.
+ */
+void setSampleInterval(unsigned interval);
+
+/** @brief Per stage durations of the sampled requests */
+const Histogram& histogram(Stage stage);
+
+/** @brief Name of a stage, for the logs */
+const char* stageName(size_t stage);
+
+/** @brief Start of a request, decides whether it is sampled */
+inline void begin()
+{
+    auto& s = internal::sampler;
+    if (s.interval == 0 || --s.countdown > 0)
+    {
+        return;
+    }
+    s.countdown = s.interval;
+    s.active = true;
+    s.last = std::chrono::steady_clock::now();
+}
+
+/** @brief Start of a request that was queued, its first stage is timed
+ *         from when it was received.
+ */
+inline void begin(std::chrono::steady_clock::time_point received)
+{
+    auto& s = internal::sampler;
+    if (s.interval == 0 || --s.countdown > 0)
+    {
+        return;
+    }
+    s.countdown = s.interval;
+    s.active = true;
+    s.last = received;
+}
+
+/** @brief End of a stage of a sampled request, records the time since
+ *         the previous stage ended.
+ */
+inline void mark(Stage stage)
+{
+    auto& s = internal::sampler;
+    if (!s.active)
+    {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    s.stages[static_cast<size_t>(stage)].record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - s.last)
+            .count());
+    s.last = now;
+}
+
+/** @brief End of a request */
+inline void end()
+{
+    internal::sampler.active = false;
+}
+
+/** @brief Record a stage outside of a request, such as a registry
+ *         reload, whenever sampling is on.
+ */
+inline void record(Stage stage, std::chrono::steady_clock::duration elapsed)
+{
+    auto& s = internal::sampler;
+    if (s.interval == 0)
+    {
+        return;
+    }
+    s.stages[static_cast<size_t>(stage)].record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+} // namespace trace
+} // namespace slp
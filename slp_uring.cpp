@@ -0,0 +1,456 @@
+#include "slp_uring.hpp"
+
+#include "slp_log.hpp"
+#include "sock_channel.hpp"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+namespace slp
+{
+
+namespace udp
+{
+
+namespace
+{
+
+constexpr unsigned QUEUE_ENTRIES = 64;
+
+/* Every buffer holds the recvmsg header, the peer address, the packet
+ * info, the receive time, the drop count and the datagram; larger
+ * datagrams are cut, which leaves them still over MAX_LEN and rejected as
+ * before. */
+constexpr uint16_t BUFFER_COUNT = 32;
+constexpr size_t BUFFER_SIZE = 1024;
+constexpr uint16_t BUFFER_GROUP = 0;
+
+/* Room for the packet info of either address family, the receive time
+ * and the drop count */
+constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(in6_pktinfo)) +
+                                CMSG_SPACE(sizeof(in_pktinfo)) +
+                                CMSG_SPACE(sizeof(timespec)) +
+                                CMSG_SPACE(sizeof(uint32_t));
+
+/* user_data of the receive, sends carry their request */
+constexpr uint64_t RECEIVE = 0;
+
+int setup(unsigned entries, io_uring_params* params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int enter(int fd, unsigned toSubmit)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, 0, 0, nullptr, 0);
+}
+
+int registerRing(int fd, unsigned opcode, void* arg, unsigned count)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+template <typename T>
+T loadAcquire(T* ptr)
+{
+    return std::atomic_ref<T>(*ptr).load(std::memory_order_acquire);
+}
+
+template <typename T>
+void storeRelease(T* ptr, T value)
+{
+    std::atomic_ref<T>(*ptr).store(value, std::memory_order_release);
+}
+
+} // namespace
+
+/* A send in flight, owns what the kernel reads */
+struct Ring::Send
+{
+    sockaddr_in6 peer{};
+    iovec iov{};
+    msghdr msg{};
+    std::vector<uint8_t> data;
+};
+
+Ring::~Ring()
+{
+    if (source)
+    {
+        sd_event_source_unref(source);
+    }
+
+    if (cqes)
+    {
+        // Free the sends still waiting for their completion
+        handler = nullptr;
+        reap();
+    }
+
+    if (ringFd >= 0)
+    {
+        close(ringFd);
+    }
+    if (sqes)
+    {
+        munmap(sqes, sqesSize);
+    }
+    if (queues)
+    {
+        munmap(queues, queuesSize);
+    }
+    if (bufRing)
+    {
+        munmap(bufRing, bufRingSize);
+    }
+}
+
+int Ring::setupQueues()
+{
+    io_uring_params params{};
+
+    ringFd = setup(QUEUE_ENTRIES, &params);
+    if (ringFd < 0)
+    {
+        return -errno;
+    }
+
+    // Both queues in one mapping, every kernel with multishot receive
+    // has it
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        return -EOPNOTSUPP;
+    }
+
+    queuesSize = std::max<size_t>(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    void* map = mmap(nullptr, queuesSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (map == MAP_FAILED)
+    {
+        return -errno;
+    }
+    queues = map;
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    map = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (map == MAP_FAILED)
+    {
+        return -errno;
+    }
+    sqes = static_cast<io_uring_sqe*>(map);
+
+    auto base = static_cast<uint8_t*>(queues);
+    sqEntries = params.sq_entries;
+    sqHeadPtr = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sqTailPtr = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    sqTail = *sqTailPtr;
+    cqHeadPtr = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cqTailPtr = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+    return 0;
+}
+
+int Ring::setupBuffers()
+{
+    bufRingSize = BUFFER_COUNT * sizeof(io_uring_buf);
+    void* map = mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        return -errno;
+    }
+    bufRing = static_cast<io_uring_buf_ring*>(map);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uintptr_t>(bufRing);
+    reg.ring_entries = BUFFER_COUNT;
+    reg.bgid = BUFFER_GROUP;
+    if (registerRing(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        return -errno;
+    }
+
+    buffers.resize(BUFFER_COUNT * BUFFER_SIZE);
+    for (uint16_t bid = 0; bid < BUFFER_COUNT; bid++)
+    {
+        recycle(bid);
+    }
+    return 0;
+}
+
+int Ring::armReceive()
+{
+    auto sqe = getSqe();
+    if (!sqe)
+    {
+        return -EBUSY;
+    }
+
+    recvMsg.msg_namelen = sizeof(sockaddr_in6);
+    recvMsg.msg_controllen = CONTROL_SIZE;
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sockFd;
+    sqe->addr = reinterpret_cast<uintptr_t>(&recvMsg);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = RECEIVE;
+    rearm = false;
+    return 0;
+}
+
+io_uring_sqe* Ring::getSqe()
+{
+    if (sqTail - loadAcquire(sqHeadPtr) >= sqEntries)
+    {
+        return nullptr;
+    }
+
+    unsigned index = sqTail & *sqMask;
+    auto sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    sqTail++;
+    return sqe;
+}
+
+int Ring::submit()
+{
+    storeRelease(sqTailPtr, sqTail);
+
+    unsigned pending = sqTail - loadAcquire(sqHeadPtr);
+    while (pending > 0)
+    {
+        int r = enter(ringFd, pending);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        pending = sqTail - loadAcquire(sqHeadPtr);
+    }
+    return 0;
+}
+
+void Ring::recycle(uint16_t bid)
+{
+    // In C++ the empty struct of __DECLARE_FLEX_ARRAY moves bufs off
+    // the start of the ring, index the entries from the ring itself
+    auto entries = reinterpret_cast<io_uring_buf*>(bufRing);
+    auto& buf = entries[bufTail & (BUFFER_COUNT - 1)];
+    buf.addr = reinterpret_cast<uintptr_t>(buffers.data() + bid * BUFFER_SIZE);
+    buf.len = BUFFER_SIZE;
+    buf.bid = bid;
+    storeRelease(&bufRing->tail, ++bufTail);
+}
+
+void Ring::receive(const io_uring_cqe& cqe)
+{
+    // The kernel ends the multishot receive on errors and when it runs
+    // out of buffers, it is queued again once these are handled
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+    {
+        rearm = true;
+    }
+
+    if (cqe.res < 0)
+    {
+        if (cqe.res != -ENOBUFS)
+        {
+            SLP_LOG_ERROR("SLP receive failed: %s", strerror(-cqe.res));
+        }
+        return;
+    }
+    if (!(cqe.flags & IORING_CQE_F_BUFFER))
+    {
+        return;
+    }
+
+    uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+    uint8_t* buf = buffers.data() + bid * BUFFER_SIZE;
+
+    // The buffer holds the header, then the address and control areas
+    // at the sizes asked for, then the datagram
+    io_uring_recvmsg_out out;
+    memcpy(&out, buf, sizeof(out));
+    size_t nameOffset = sizeof(out);
+    size_t controlOffset = nameOffset + recvMsg.msg_namelen;
+    size_t dataOffset = controlOffset + recvMsg.msg_controllen;
+    size_t received = cqe.res;
+
+    if (handler && received >= dataOffset)
+    {
+        msghdr msg{};
+        msg.msg_control = buf + controlOffset;
+        msg.msg_controllen = std::min<size_t>(out.controllen, CONTROL_SIZE);
+
+        Packet packet{};
+        packet.data = {buf + dataOffset,
+                       std::min<size_t>(out.payloadlen, received - dataOffset)};
+        packet.peer = reinterpret_cast<const sockaddr*>(buf + nameOffset);
+        packet.peerLen = std::min<socklen_t>(out.namelen, recvMsg.msg_namelen);
+        packet.multicast = udpsocket::isMulticastDestination(msg);
+        packet.timestamp = udpsocket::receiveTimestamp(msg);
+        packet.overflow = udpsocket::receiveOverflow(msg);
+
+        handler(*this, packet, userdata);
+    }
+
+    recycle(bid);
+}
+
+void Ring::reap()
+{
+    unsigned head = *cqHeadPtr;
+
+    for (;;)
+    {
+        unsigned tail = loadAcquire(cqTailPtr);
+        if (head == tail)
+        {
+            break;
+        }
+
+        for (; head != tail; head++)
+        {
+            const auto& cqe = cqes[head & *cqMask];
+            if (cqe.user_data == RECEIVE)
+            {
+                receive(cqe);
+                continue;
+            }
+
+            std::unique_ptr<Send> send(reinterpret_cast<Send*>(cqe.user_data));
+            if (cqe.res < 0)
+            {
+                SLP_LOG_ERROR("SLP send failed: %s", strerror(-cqe.res));
+            }
+        }
+        storeRelease(cqHeadPtr, head);
+    }
+}
+
+int Ring::dispatch(sd_event_source* /*es*/, int /*fd*/, uint32_t /*revents*/,
+                   void* userdata)
+{
+    auto ring = static_cast<Ring*>(userdata);
+
+    ring->dispatching = true;
+    ring->reap();
+    ring->dispatching = false;
+
+    if (ring->rearm && ring->armReceive() < 0)
+    {
+        SLP_LOG_ERROR("SLP unable to queue the receive");
+    }
+
+    // A failing callback would disable the source, log and go on
+    int r = ring->submit();
+    if (r < 0)
+    {
+        SLP_LOG_ERROR("SLP io_uring submit failed: %s", strerror(-r));
+    }
+    return 0;
+}
+
+int Ring::send(const sockaddr* peer, socklen_t peerLen,
+               std::vector<uint8_t> data)
+{
+    auto req = std::make_unique<Send>();
+    peerLen = std::min<socklen_t>(peerLen, sizeof(req->peer));
+    memcpy(&req->peer, peer, peerLen);
+    req->data = std::move(data);
+    req->iov = {req->data.data(), req->data.size()};
+    req->msg.msg_name = &req->peer;
+    req->msg.msg_namelen = peerLen;
+    req->msg.msg_iov = &req->iov;
+    req->msg.msg_iovlen = 1;
+
+    auto sqe = getSqe();
+    if (!sqe)
+    {
+        int r = submit();
+        if (r < 0)
+        {
+            return r;
+        }
+        sqe = getSqe();
+        if (!sqe)
+        {
+            return -EBUSY;
+        }
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = sockFd;
+    sqe->addr = reinterpret_cast<uintptr_t>(&req->msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uintptr_t>(req.release());
+
+    return dispatching || holding ? 0 : submit();
+}
+
+bool Ring::hold()
+{
+    return !std::exchange(holding, true);
+}
+
+int Ring::flush()
+{
+    holding = false;
+    return submit();
+}
+
+std::tuple<int, std::unique_ptr<Ring>>
+    Ring::create(sd_event* event, int fd, Handler handler, void* userdata)
+{
+    std::unique_ptr<Ring> ring(new Ring(fd, handler, userdata));
+
+    int r = ring->setupQueues();
+    if (r >= 0)
+    {
+        r = ring->setupBuffers();
+    }
+    if (r >= 0)
+    {
+        r = ring->armReceive();
+    }
+    if (r >= 0)
+    {
+        r = ring->submit();
+    }
+    if (r >= 0)
+    {
+        r = sd_event_add_io(event, &ring->source, ring->ringFd, EPOLLIN,
+                            &Ring::dispatch, ring.get());
+    }
+    if (r < 0)
+    {
+        return std::make_tuple(r, nullptr);
+    }
+    return std::make_tuple(0, std::move(ring));
+}
+
+} // namespace udp
+} // namespace slp
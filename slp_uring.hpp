@@ -0,0 +1,181 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <systemd/sd-event.h>
+#include <time.h>
+
+#include <memory>
+#include <span>
+#include <tuple>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace slp
+{
+
+namespace udp
+{
+
+/** @class Ring
+ *
+ *  @brief io_uring receive and send path of the server socket.
+ *
+ *  A single multishot recvmsg keeps receiving into a ring of provided
+ *  buffers, so a burst of requests costs no syscall per datagram. The
+ *  completions are handled from the sd-event loop, which polls the ring
+ *  descriptor, so signals, timers and inotify sources keep working as
+ *  with the plain socket. The replies queued by the handler go out
+ *  with the buffers handed back, in one io_uring_enter per wakeup.
+ */
+class Ring
+{
+  public:
+    /* A received datagram, only valid for the handler call */
+    struct Packet
+    {
+        std::span<const uint8_t> data;
+        const sockaddr* peer;
+        socklen_t peerLen;
+        /* Sent to a multicast group, needs IP_PKTINFO/IPV6_RECVPKTINFO */
+        bool multicast;
+        /* Receive time on CLOCK_REALTIME, needs SO_TIMESTAMPNS */
+        timespec timestamp;
+        /* Datagrams the socket dropped so far, needs SO_RXQ_OVFL */
+        uint32_t overflow;
+    };
+
+    using Handler = void (*)(Ring& ring, const Packet& packet,
+                             void* userdata);
+
+    ~Ring();
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    /** @brief Set up a ring receiving on a socket.
+     *
+     *  @param[in] event - The event loop handling the completions.
+     *  @param[in] fd - The datagram socket.
+     *  @param[in] handler - Called for every received datagram.
+     *  @param[in] userdata - Passed to the handler.
+     *
+     *  @return Zero and the ring on success, else a negative errno and
+     *          nullptr, e.g. when the kernel lacks io_uring or forbids it.
+     */
+    static std::tuple<int, std::unique_ptr<Ring>>
+        create(sd_event* event, int fd, Handler handler, void* userdata);
+
+    /** @brief Send a datagram.
+     *
+     *  Sends queued from the handler are submitted together once the
+     *  pending completions are handled, and sends queued between hold()
+     *  and flush() by flush().
+     *
+     *  @param[in] peer - The destination.
+     *  @param[in] peerLen - Size of the destination address.
+     *  @param[in] data - The datagram, kept until the send completes.
+     *
+     *  @return Zero on success, else a negative errno.
+     */
+    int send(const sockaddr* peer, socklen_t peerLen,
+             std::vector<uint8_t> data);
+
+    /** @brief Hold the sends back until flush().
+     *
+     *  @return false when they were held back already.
+     */
+    bool hold();
+
+    /** @brief Submit the sends held back since hold().
+     *
+     *  @return Zero on success, else a negative errno.
+     */
+    int flush();
+
+    /** @brief The socket the ring receives on */
+    int fd() const
+    {
+        return sockFd;
+    }
+
+    /** @brief The event loop handling the completions */
+    sd_event* event() const
+    {
+        return sd_event_source_get_event(source);
+    }
+
+  private:
+    struct Send;
+
+    Ring(int fd, Handler handler, void* userdata) :
+        sockFd(fd), handler(handler), userdata(userdata)
+    {}
+
+    /** @brief Create the ring and map its queues. */
+    int setupQueues();
+
+    /** @brief Register the provided buffer ring and fill it. */
+    int setupBuffers();
+
+    /** @brief Queue the multishot receive. */
+    int armReceive();
+
+    /** @brief Get a free submission entry, nullptr if the queue is full. */
+    io_uring_sqe* getSqe();
+
+    /** @brief Submit the queued entries. */
+    int submit();
+
+    /** @brief Hand a buffer back to the kernel. */
+    void recycle(uint16_t bid);
+
+    /** @brief Handle the completions posted so far. */
+    void reap();
+
+    /** @brief Handle a completion of the multishot receive. */
+    void receive(const io_uring_cqe& cqe);
+
+    /** Call back for the sd event loop when completions are posted */
+    static int dispatch(sd_event_source* es, int fd, uint32_t revents,
+                        void* userdata);
+
+    int sockFd;
+    Handler handler;
+    void* userdata;
+
+    int ringFd = -1;
+    sd_event_source* source = nullptr;
+    bool dispatching = false;
+    bool holding = false;
+    bool rearm = false;
+    /* Sizes of the address and control areas of the receive */
+    msghdr recvMsg{};
+
+    void* queues = nullptr;
+    size_t queuesSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned sqEntries = 0;
+    unsigned sqTail = 0;
+    unsigned* sqHeadPtr = nullptr;
+    unsigned* sqTailPtr = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHeadPtr = nullptr;
+    unsigned* cqTailPtr = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    io_uring_buf_ring* bufRing = nullptr;
+    size_t bufRingSize = 0;
+    uint16_t bufTail = 0;
+    std::vector<uint8_t> buffers;
+};
+
+} // namespace udp
+} // namespace slp
@@ -1,17 +1,74 @@
 #include "sock_channel.hpp"
 
+#include "slp_log.hpp"
+
 #include <errno.h>
 #include <netinet/in.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-#include <iostream>
 #include <string>
 
 namespace udpsocket
 {
 
+bool isMulticastDestination(msghdr& msg)
+{
+    bool multicast = false;
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+        {
+            in_pktinfo info;
+            memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+            multicast = IN_MULTICAST(ntohl(info.ipi_addr.s_addr));
+        }
+        else if (cmsg->cmsg_level == IPPROTO_IPV6 &&
+                 cmsg->cmsg_type == IPV6_PKTINFO)
+        {
+            in6_pktinfo info;
+            memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+            multicast = IN6_IS_ADDR_MULTICAST(&info.ipi6_addr);
+        }
+    }
+    return multicast;
+}
+
+timespec receiveTimestamp(msghdr& msg)
+{
+    timespec ts{};
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        }
+    }
+    return ts;
+}
+
+uint32_t receiveOverflow(msghdr& msg)
+{
+    uint32_t overflow = 0;
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+            memcpy(&overflow, CMSG_DATA(cmsg), sizeof(overflow));
+        }
+    }
+    return overflow;
+}
+
 std::string Channel::getRemoteAddress() const
 {
     char tmp[INET_ADDRSTRLEN] = {0};
@@ -28,8 +85,8 @@ std::tuple<int, buffer> Channel::read()
 
     if (ioctl(sockfd, FIONREAD, &readSize) < 0)
     {
-        std::cerr << "Channel::Read : ioctl failed with errno = " << errno;
         rc = -errno;
+        SLP_LOG_ERROR("Channel::Read : ioctl failed with errno = %d", -rc);
         return std::make_tuple(rc, std::move(outBuffer));
     }
 
@@ -39,14 +96,25 @@ std::tuple<int, buffer> Channel::read()
 
     address.addrSize = static_cast<socklen_t>(sizeof(address.inAddr));
 
+    iovec iov{outputPtr, bufferSize};
+    // Room for the packet info of either address family, the receive
+    // time and the drop count
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(in6_pktinfo)) +
+                                     CMSG_SPACE(sizeof(in_pktinfo)) +
+                                     CMSG_SPACE(sizeof(timespec)) +
+                                     CMSG_SPACE(sizeof(uint32_t))];
+
     do
     {
-        readDataLen = recvfrom(sockfd,             // File Descriptor
-                               outputPtr,          // Buffer
-                               bufferSize,         // Bytes requested
-                               0,                  // Flags
-                               &address.sockAddr,  // Address
-                               &address.addrSize); // Address Length
+        msghdr msg{};
+        msg.msg_name = &address.sockAddr;
+        msg.msg_namelen = address.addrSize;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        readDataLen = recvmsg(sockfd, &msg, MSG_DONTWAIT);
 
         if (readDataLen == 0) // Peer has performed an orderly shutdown
         {
@@ -56,14 +124,24 @@ std::tuple<int, buffer> Channel::read()
         else if (readDataLen < 0) // Error
         {
             rc = -errno;
-            std::cerr << "Channel::Read : Receive Error Fd[" << sockfd << "]"
-                      << "errno = " << rc << "\n";
+            if (rc != -EAGAIN && rc != -EWOULDBLOCK)
+            {
+                SLP_LOG_ERROR("Channel::Read : Receive Error Fd[%d]errno = %d",
+                              sockfd, rc);
+            }
             outBuffer.resize(0);
         }
+        else
+        {
+            address.addrSize = msg.msg_namelen;
+            multicastDest = isMulticastDestination(msg);
+            timestamp = receiveTimestamp(msg);
+            overflow = receiveOverflow(msg);
+        }
     } while ((readDataLen < 0) && (-(rc) == EINTR));
 
     // Resize the vector to the actual data read from the socket
-    outBuffer.resize(readDataLen);
+    outBuffer.resize(readDataLen > 0 ? readDataLen : 0);
     return std::make_tuple(rc, std::move(outBuffer));
 }
 
@@ -105,22 +183,21 @@ int Channel::write(buffer& inBuffer)
                     if (writeDataLen < 0)
                     {
                         rc = -errno;
-                        std::cerr
-                            << "Channel::Write: Write failed with errno:" << rc
-                            << "\n";
+                        SLP_LOG_ERROR(
+                            "Channel::Write: Write failed with errno:%d", rc);
                     }
                     else if (static_cast<size_t>(writeDataLen) < bufferSize)
                     {
                         rc = -1;
-                        std::cerr << "Channel::Write: Complete data not written"
-                                     " to the socket\n";
+                        SLP_LOG_ERROR("Channel::Write: Complete data not "
+                                      "written to the socket");
                     }
                 } while ((writeDataLen < 0) && (-(rc) == EINTR));
             }
             else
             {
                 // Spurious wake up
-                std::cerr << "Spurious wake up on select (writeset)\n";
+                SLP_LOG_ERROR("Spurious wake up on select (writeset)");
                 spuriousWakeup = true;
             }
         }
@@ -130,14 +207,13 @@ int Channel::write(buffer& inBuffer)
             {
                 // Timed out
                 rc = -1;
-                std::cerr << "We timed out on select call (writeset)\n";
+                SLP_LOG_ERROR("We timed out on select call (writeset)");
             }
             else
             {
                 // Error
                 rc = -errno;
-                std::cerr << "select call (writeset) had an error : " << rc
-                          << "\n";
+                SLP_LOG_ERROR("select call (writeset) had an error : %d", rc);
             }
         }
     } while (spuriousWakeup);
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -11,6 +15,37 @@ namespace udpsocket
 {
 
 using buffer = std::vector<uint8_t>;
+
+/**
+ * @brief Check the packet info of a received message for a multicast
+ *        destination
+ *
+ * @param [in] msg - The received message with its control data
+ *
+ * @return true if the destination address was a multicast address
+ */
+bool isMulticastDestination(msghdr& msg);
+
+/**
+ * @brief Get the kernel receive time of a message
+ *
+ * @param [in] msg - The received message with its control data
+ *
+ * @return The receive time on CLOCK_REALTIME, zero when the socket
+ *         does not have SO_TIMESTAMPNS enabled
+ */
+timespec receiveTimestamp(msghdr& msg);
+
+/**
+ * @brief Get the count of datagrams dropped by the socket of a message
+ *
+ * @param [in] msg - The received message with its control data
+ *
+ * @return The drops so far, zero when there were none or the socket
+ *         does not have SO_RXQ_OVFL enabled
+ */
+uint32_t receiveOverflow(msghdr& msg);
+
 /** @class Channel
  *
  *  @brief Provides encapsulation for UDP socket operations like Read, Peek,
@@ -45,6 +80,23 @@ class Channel
         timeout = inTimeout;
     }
 
+    /**
+     * @brief Constructor for a peer known from a packet read elsewhere
+     *
+     * @param [in] File Descriptor for the socket
+     * @param [in] Timeout parameter for the select call
+     * @param [in] Address of the remote peer
+     * @param [in] Size of the address
+     *
+     * @return None
+     */
+    Channel(int insockfd, timeval& inTimeout, const sockaddr* peer,
+            socklen_t peerLen) : Channel(insockfd, inTimeout)
+    {
+        address.addrSize = std::min<socklen_t>(peerLen, sizeof(address.inAddr));
+        memcpy(&address.sockAddr, peer, address.addrSize);
+    }
+
     /**
      * @brief Fetch the IP address of the remote peer
      *
@@ -68,16 +120,65 @@ class Channel
         return address.inAddr.sin6_port;
     }
 
+    /**
+     * @brief Fetch the socket address of the remote peer
+     *
+     * @return Address of the remote peer of the last packet read
+     */
+    const SockAddr_t& getPeer() const
+    {
+        return address;
+    }
+
+    /**
+     * @brief Check if the last packet was sent to a multicast group
+     *
+     * Needs IP_PKTINFO/IPV6_RECVPKTINFO to be enabled on the socket,
+     * without it the destination is unknown and false is returned.
+     *
+     * @return true if the destination address was a multicast address
+     */
+    bool isMulticast() const
+    {
+        return multicastDest;
+    }
+
+    /**
+     * @brief Fetch the kernel receive time of the last packet
+     *
+     * Needs SO_TIMESTAMPNS to be enabled on the socket, without it
+     * zero is returned.
+     *
+     * @return The receive time on CLOCK_REALTIME
+     */
+    timespec getTimestamp() const
+    {
+        return timestamp;
+    }
+
+    /**
+     * @brief Fetch the drop count of the socket at the last packet
+     *
+     * Needs SO_RXQ_OVFL to be enabled on the socket, without it zero is
+     * returned.
+     *
+     * @return The datagrams the socket dropped so far
+     */
+    uint32_t getOverflow() const
+    {
+        return overflow;
+    }
+
     /**
      * @brief Read the incoming packet
      *
-     * Reads the data available on the socket
+     * Reads the data available on the socket, without waiting for it
      *
      * @return A tuple with return code and vector with the buffer
      *         In case of success, the vector is populated with the data
      *         available on the socket and return code is 0.
      *         In case of error, the return code is < 0 and vector is set
-     *         to size 0.
+     *         to size 0, -EAGAIN when no packet is waiting.
      */
     std::tuple<int, buffer> read();
 
@@ -111,6 +212,9 @@ class Channel
     int sockfd;
     SockAddr_t address;
     timeval timeout;
+    bool multicastDest = false;
+    timespec timestamp{};
+    uint32_t overflow = 0;
 };
 
 } // namespace udpsocket
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+# Report the binary size and steady-state memory use of slpd.
+#
+# slpd is started with a socket passed the same way systemd socket
+# activation does, so no privileged port is needed. After a burst of
+# requests the resident memory is read from /proc and both figures are
+# printed and checked against the budgets given in KiB, 0 means no check.
+
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+SRVTYPERQST = (
+    b"\x02\x09\x00\x00\x1d\x00\x00\x00\x00\x00\x74\xe2\x00\x02\x65\x6e"
+    + b"\x00\x00\xff\xff\x00\x07\x44\x45\x46\x41\x55\x4c\x54"
+)
+
+
+def loaded_size(path):
+    """Size of the sections loaded into memory, debug info excluded."""
+    with open(path, "rb") as f:
+        data = f.read()
+    is64 = data[4] == 2
+    endian = "<" if data[5] == 1 else ">"
+    if is64:
+        shoff, shentsize, shnum = (
+            struct.unpack_from(endian + "Q", data, 0x28)[0],
+            struct.unpack_from(endian + "H", data, 0x3A)[0],
+            struct.unpack_from(endian + "H", data, 0x3C)[0],
+        )
+        fmt, flags_off, size_off = "Q", 8, 32
+    else:
+        shoff, shentsize, shnum = (
+            struct.unpack_from(endian + "I", data, 0x20)[0],
+            struct.unpack_from(endian + "H", data, 0x2E)[0],
+            struct.unpack_from(endian + "H", data, 0x30)[0],
+        )
+        fmt, flags_off, size_off = "I", 8, 20
+    SHF_ALLOC = 0x2
+    total = 0
+    for i in range(shnum):
+        base = shoff + i * shentsize
+        flags = struct.unpack_from(endian + fmt, data, base + flags_off)[0]
+        size = struct.unpack_from(endian + fmt, data, base + size_off)[0]
+        if flags & SHF_ALLOC:
+            total += size
+    return total
+
+
+def memory_kib(pid):
+    fields = {}
+    with open("/proc/%d/status" % pid) as f:
+        for line in f:
+            key, _, value = line.partition(":")
+            if key in ("VmRSS", "RssAnon"):
+                fields[key] = int(value.split()[0])
+    return fields
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("slpd")
+    parser.add_argument("--max-size", type=int, default=0)
+    parser.add_argument("--max-rss", type=int, default=0)
+    parser.add_argument("--requests", type=int, default=1000)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+    sock.bind(("::1", 0))
+    port = sock.getsockname()[1]
+
+    proc = subprocess.Popen(
+        ["sh", "-c", 'LISTEN_FDS=1 LISTEN_PID=$$ exec "$0"', args.slpd],
+        pass_fds=(sock.fileno(),),
+        preexec_fn=lambda: os.dup2(sock.fileno(), 3),
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.DEVNULL,
+    )
+
+    client = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+    client.settimeout(1)
+    try:
+        for _ in range(args.requests):
+            client.sendto(SRVTYPERQST, ("::1", port))
+            try:
+                client.recvfrom(2048)
+            except socket.timeout:
+                pass
+        time.sleep(0.2)
+        if proc.poll() is not None:
+            print("slpd exited early: %d" % proc.returncode)
+            return 1
+        mem = memory_kib(proc.pid)
+    finally:
+        proc.terminate()
+        proc.wait()
+
+    size = (loaded_size(args.slpd) + 1023) // 1024
+    print("binary_size_kib %d" % size)
+    print("rss_kib %d" % mem["VmRSS"])
+    print("rss_anon_kib %d" % mem["RssAnon"])
+
+    rc = 0
+    if args.max_size and size > args.max_size:
+        print("binary size over budget: %d / %d KiB" % (size, args.max_size))
+        rc = 1
+    if args.max_rss and mem["RssAnon"] > args.max_rss:
+        print(
+            "anonymous RSS over budget: %d / %d KiB"
+            % (mem["RssAnon"], args.max_rss)
+        )
+        rc = 1
+    return rc
+
+
+if __name__ == "__main__":
+    sys.exit(main())
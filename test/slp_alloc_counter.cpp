@@ -0,0 +1,63 @@
+#include "slp_alloc_counter.hpp"
+
+#include <stdlib.h>
+
+#include <new>
+
+/* Replaces the global operator new of the test binaries it is linked in,
+ * the array and nothrow forms forward to it. malloc is not counted,
+ * slpd itself only allocates through the C++ containers. */
+
+namespace
+{
+
+bool counting = false;
+slp::test::Allocations counted;
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    if (counting)
+    {
+        counted.count++;
+        counted.bytes += size;
+    }
+
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept
+{
+    free(ptr);
+}
+
+namespace slp
+{
+namespace test
+{
+
+void startCounting()
+{
+    counted = {};
+    counting = true;
+}
+
+Allocations stopCounting()
+{
+    counting = false;
+    return counted;
+}
+
+} // namespace test
+} // namespace slp
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace slp
+{
+namespace test
+{
+
+/** Heap traffic of a block of code */
+struct Allocations
+{
+    size_t count = 0;
+    size_t bytes = 0;
+};
+
+/** @brief Start counting the allocations made through operator new,
+ *         slp_alloc_counter.cpp replaces it in the binaries it is
+ *         linked in.
+ */
+void startCounting();
+
+/** @brief Stop counting, returns what was allocated since the start */
+Allocations stopCounting();
+
+/** @brief The allocations made by f */
+template <typename F>
+Allocations countAllocations(F&& f)
+{
+    startCounting();
+    f();
+    return stopCounting();
+}
+
+} // namespace test
+} // namespace slp
@@ -0,0 +1,137 @@
+#include "slp.hpp"
+#include "slp_alloc_counter.hpp"
+#include "slp_cache.hpp"
+#include "slp_meta.hpp"
+
+#include <gtest/gtest.h>
+
+/* Heap allocation budgets of the request path, counted through the
+ * operator new of slp_alloc_counter.cpp. A change that allocates more
+ * per request has to raise a budget here. */
+
+namespace
+{
+
+// "slptool findsrvs service:obmc_console"
+const slp::buffer srvRequest{
+    0x02, 0x01, 0x00, 0x00, 0x35, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe5,
+    0xc2, 0x00, 0x02, 'e',  'n',  0x00, 0x00, 0x00, 0x14, 's',  'e',
+    'r',  'v',  'i',  'c',  'e',  ':',  'o',  'b',  'm',  'c',  '_',
+    'c',  'o',  'n',  's',  'o',  'l',  'e',  0x00, 0x07, 'D',  'E',
+    'F',  'A',  'U',  'L',  'T',  0x00, 0x00, 0x00, 0x00};
+
+// "slptool findsrvtypes"
+const slp::buffer srvTypeRequest{
+    0x02, 0x09, 0x00, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x5f, 0x31, 0x00, 0x02, 'e',  'n',  0x00, 0x00, 0xff, 0xff,
+    0x00, 0x07, 'D',  'E',  'F',  'A',  'U',  'L',  'T'};
+
+class AllocTest : public ::testing::Test
+{
+  protected:
+    static void SetUpTestSuite()
+    {
+        slp::ConfigData svc;
+        ASSERT_TRUE(svc.parse("obmc_console ssh 2200"));
+        svc.name = "service:" + svc.name;
+        slp::handler::internal::publishServiceRegistry(
+            slp::handler::internal::makeServiceRegistry({svc},
+                                                        {"10.0.0.1"}));
+        // The cache entries are allocated once on first use, not per request
+        slp::cache::responses();
+    }
+
+    /* Count the allocations of f, and report them with the test */
+    template <typename F>
+    slp::test::Allocations count(const char* call, F&& f)
+    {
+        auto allocations = slp::test::countAllocations(std::forward<F>(f));
+        RecordProperty(std::string(call) + "_allocations",
+                       std::to_string(allocations.count));
+        RecordProperty(std::string(call) + "_bytes",
+                       std::to_string(allocations.bytes));
+        return allocations;
+    }
+};
+
+} // namespace
+
+TEST_F(AllocTest, SrvRequest)
+{
+    slp::Message req;
+    int rc = slp::SUCCESS;
+
+    // Only the strings too long to be stored inline, the service type
+    auto parse = count("parseBuffer", [&] {
+        std::tie(rc, req) = slp::parser::parseBuffer(srvRequest);
+    });
+    ASSERT_EQ(rc, 0);
+    EXPECT_LE(parse.count, 1);
+
+    // The reply buffer, allocated once for the largest reply
+    slp::buffer resp;
+    auto process = count("processRequest", [&] {
+        std::tie(rc, resp) = slp::handler::processRequest(req);
+    });
+    ASSERT_EQ(rc, 0);
+    EXPECT_LE(process.count, 1);
+    EXPECT_LE(process.bytes, slp::MAX_LEN);
+
+    bool multicast = false;
+    auto serve = count("serveRequest", [&] {
+        slp::handler::serveRequest(srvRequest, false, resp, multicast);
+    });
+    EXPECT_LE(serve.count, parse.count + process.count);
+
+    // Served again from the cache, the reply is all that is allocated
+    resp = {};
+    auto cached = count("serveRequest_cached", [&] {
+        slp::handler::serveRequest(srvRequest, false, resp, multicast);
+    });
+    EXPECT_LE(cached.count, 1);
+    EXPECT_LE(cached.bytes, slp::MAX_LEN);
+}
+
+TEST_F(AllocTest, SrvTypeRequest)
+{
+    slp::Message req;
+    int rc = slp::SUCCESS;
+
+    auto parse = count("parseBuffer", [&] {
+        std::tie(rc, req) = slp::parser::parseBuffer(srvTypeRequest);
+    });
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(parse.count, 0);
+
+    slp::buffer resp;
+    auto process = count("processRequest", [&] {
+        std::tie(rc, resp) = slp::handler::processRequest(req);
+    });
+    ASSERT_EQ(rc, 0);
+    EXPECT_LE(process.count, 1);
+}
+
+TEST_F(AllocTest, Error)
+{
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::parseBuffer(srvTypeRequest);
+    ASSERT_EQ(rc, 0);
+
+    slp::buffer resp;
+    auto error = count("processError", [&] {
+        resp = slp::handler::processError(
+            req, static_cast<uint8_t>(slp::Error::PARSE_ERROR));
+    });
+    EXPECT_LE(error.count, 1);
+
+    // A request for a type that is not offered fails without allocating
+    // more than its error reply
+    req.body.srvrqst.srvType = "service:unknown";
+    req.header.functionID = (uint8_t)slp::FunctionType::SRVRQST;
+    auto unknown = count("processRequest", [&] {
+        std::tie(rc, resp) = slp::handler::processRequest(req);
+    });
+    EXPECT_NE(rc, 0);
+    EXPECT_EQ(unknown.count, 0);
+}
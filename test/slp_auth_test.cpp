@@ -0,0 +1,197 @@
+#include "endian.hpp"
+#include "slp.hpp"
+#include "slp_auth.hpp"
+#include "slp_meta.hpp"
+
+#include <openssl/pem.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using PKey = slp::deleted_unique_ptr<EVP_PKEY, EVP_PKEY_free>;
+using PKeyCtx = slp::deleted_unique_ptr<EVP_PKEY_CTX, EVP_PKEY_CTX_free>;
+
+PKey generateDSA()
+{
+    EVP_PKEY* params = nullptr;
+    EVP_PKEY* key = nullptr;
+
+    PKeyCtx paramCtx(EVP_PKEY_CTX_new_from_name(nullptr, "DSA", nullptr));
+    if (!paramCtx || EVP_PKEY_paramgen_init(paramCtx.get()) != 1 ||
+        EVP_PKEY_CTX_set_dsa_paramgen_bits(paramCtx.get(), 1024) != 1 ||
+        EVP_PKEY_paramgen(paramCtx.get(), &params) != 1)
+    {
+        return nullptr;
+    }
+    PKey paramKey(params);
+
+    PKeyCtx keyCtx(EVP_PKEY_CTX_new_from_pkey(nullptr, params, nullptr));
+    if (!keyCtx || EVP_PKEY_keygen_init(keyCtx.get()) != 1 ||
+        EVP_PKEY_keygen(keyCtx.get(), &key) != 1)
+    {
+        return nullptr;
+    }
+    return PKey(key);
+}
+
+void writeKey(const std::string& path, EVP_PKEY* key)
+{
+    slp::deleted_unique_ptr<FILE, fclose> file(fopen(path.c_str(), "we"));
+    ASSERT_TRUE(file);
+    ASSERT_EQ(PEM_write_PrivateKey(file.get(), key, nullptr, nullptr, 0,
+                                   nullptr, nullptr),
+              1);
+}
+
+bool verify(EVP_PKEY* key, const slp::buffer& data,
+            std::span<const uint8_t> signature)
+{
+    slp::deleted_unique_ptr<EVP_MD_CTX, EVP_MD_CTX_free> ctx(
+        EVP_MD_CTX_new());
+    return EVP_DigestVerifyInit(ctx.get(), nullptr, EVP_sha1(), nullptr,
+                                key) == 1 &&
+           EVP_DigestVerify(ctx.get(), signature.data(), signature.size(),
+                            data.data(), data.size()) == 1;
+}
+
+uint16_t read16(std::span<const uint8_t> data, size_t pos)
+{
+    return (data[pos] << 8) | data[pos + 1];
+}
+
+uint32_t read32(std::span<const uint8_t> data, size_t pos)
+{
+    return (read16(data, pos) << 16) | read16(data, pos + 2);
+}
+
+/* Check an authentication block signs the URL, returns its length */
+size_t checkAuthBlock(EVP_PKEY* key, std::span<const uint8_t> block,
+                      std::string_view spi, std::string_view url)
+{
+    EXPECT_GE(block.size(), 10);
+    EXPECT_EQ(read16(block, 0), slp::auth::BSD_DSA_SHA1);
+    size_t length = read16(block, 2);
+    EXPECT_LE(length, block.size());
+    uint32_t timestamp = read32(block, 4);
+    EXPECT_EQ(read16(block, 8), spi.size());
+    EXPECT_EQ(std::string_view((const char*)&block[10], spi.size()), spi);
+
+    size_t offset = 10 + spi.size();
+    EXPECT_TRUE(verify(key, slp::auth::urlSignedData(spi, url, timestamp),
+                       block.subspan(offset, length - offset)));
+    return length;
+}
+
+class AuthTest : public ::testing::Test
+{
+  protected:
+    static void SetUpTestSuite()
+    {
+        key = generateDSA().release();
+        ASSERT_NE(key, nullptr);
+
+        char tmpl[] = "/tmp/slp-keys-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir = tmpl;
+
+        writeKey(dir + "/site.pem", key);
+        PKey ec(EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256"));
+        writeKey(dir + "/ec.pem", ec.get());
+        slp::deleted_unique_ptr<FILE, fclose> readme(
+            fopen((dir + "/README").c_str(), "we"));
+    }
+
+    static void TearDownTestSuite()
+    {
+        std::filesystem::remove_all(dir);
+        EVP_PKEY_free(key);
+        slp::auth::setKeys({});
+    }
+
+    static inline EVP_PKEY* key = nullptr;
+    static inline std::string dir;
+};
+
+slp::Message srvRequest(std::string spistr)
+{
+    slp::Message req;
+    req.header.version = slp::VERSION_2;
+    req.header.functionID = (uint8_t)slp::FunctionType::SRVRQST;
+    req.header.langtag = "en";
+    req.body.srvrqst.srvType = "service:obmc_console";
+    req.body.srvrqst.spistr = std::move(spistr);
+    return req;
+}
+
+} // namespace
+
+TEST_F(AuthTest, OnlyDSAKeysLoaded)
+{
+    auto keys = slp::auth::loadKeys(dir.c_str());
+    ASSERT_EQ(keys.size(), 1);
+    EXPECT_EQ(keys[0].spi(), "site");
+
+    EXPECT_TRUE(slp::auth::loadKeys("/nonexistent").empty());
+}
+
+TEST_F(AuthTest, URLAuthBlock)
+{
+    auto [rc, site] = slp::auth::Key::load((dir + "/site.pem").c_str(), "site");
+    ASSERT_EQ(rc, 0);
+
+    std::string url = "service:obmc_console:ssh//10.0.0.1,2200";
+    auto [r, block] = slp::auth::urlAuthBlock(site, url, 1234567);
+    ASSERT_EQ(r, 0);
+    EXPECT_EQ(read32(block, 4), 1234567);
+    EXPECT_EQ(checkAuthBlock(key, block, "site", url), block.size());
+}
+
+TEST_F(AuthTest, SignedServiceReply)
+{
+    slp::auth::setKeys(slp::auth::loadKeys(dir.c_str()));
+
+    slp::ConfigData svc;
+    ASSERT_TRUE(svc.parse("obmc_console ssh 2200"));
+    svc.name = "service:" + svc.name;
+    auto registry = slp::handler::internal::makeServiceRegistry(
+        {svc}, {"10.0.0.1"});
+    slp::handler::internal::signServiceRegistry(*registry);
+    EXPECT_GT(registry->authExpiry, time(nullptr));
+    slp::handler::internal::publishServiceRegistry(std::move(registry));
+
+    // The first SPI with a local key signs
+    auto [rc, resp] =
+        slp::handler::internal::processSrvRequest(srvRequest("other, site"));
+    ASSERT_EQ(rc, 0);
+
+    std::string url = "service:obmc_console:ssh//10.0.0.1,2200";
+    // Header with the "en" tag, error code and URL count
+    size_t pos = slp::header::MIN_LEN + 2 + 4;
+    EXPECT_EQ(read16(resp, pos - 2), 1);
+    EXPECT_EQ(read16(resp, pos + 3), url.size());
+    pos += 5;
+    EXPECT_EQ(std::string_view((const char*)&resp[pos], url.size()), url);
+    pos += url.size();
+    EXPECT_EQ(resp[pos], 1);
+    pos++;
+    pos += checkAuthBlock(key, std::span(resp).subspan(pos), "site", url);
+    EXPECT_EQ(pos, resp.size());
+    EXPECT_EQ(resp[slp::header::OFFSET_LENGTH], resp.size());
+
+    // No SPI, no authentication block
+    std::tie(rc, resp) =
+        slp::handler::internal::processSrvRequest(srvRequest(""));
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(resp.back(), 0);
+
+    std::tie(rc, resp) =
+        slp::handler::internal::processSrvRequest(srvRequest("other"));
+    EXPECT_EQ(rc, (int)slp::Error::AUTHENTICATION_UNKNOWN);
+}
@@ -0,0 +1,79 @@
+#include "slp_builtin.hpp"
+
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+constexpr auto table = slp::builtin::compile([] {
+    return std::string_view("obmc_console ssh 2200 600;"
+                            "obmc_redfish https 443;;"
+                            "OBMC_Console ssh 2200;"
+                            "printer:lpr tcp 515;"
+                            "printer:ipp tcp 631 ");
+});
+constexpr auto services = table.registry();
+
+/* The names of the services of a type, in order */
+constexpr std::string_view names(std::string_view folded, size_t match)
+{
+    auto positions = services.find(folded);
+    return match < positions.size()
+               ? services.string(services.service(positions[match]).name)
+               : std::string_view();
+}
+
+// Duplicates are dropped and the services sorted by folded type
+static_assert(services.size() == 4);
+static_assert(services.typeList() ==
+              "service:obmc_console,service:obmc_redfish,service:printer:ipp,"
+              "service:printer:lpr");
+
+// Concrete types are found under their abstract type too
+static_assert(names("service:obmc_console", 0) == "service:obmc_console");
+static_assert(names("service:printer", 0) == "service:printer:ipp");
+static_assert(names("service:printer", 1) == "service:printer:lpr");
+static_assert(names("service:printer:lpr", 0) == "service:printer:lpr");
+static_assert(services.find("service:printer:lpr").size() == 1);
+static_assert(services.find("service:printer:ipx").empty());
+static_assert(services.find("service:obmc").empty());
+static_assert(services.find("").empty());
+
+static_assert(services.service(0).lifetime == 600);
+static_assert(services.service(1).lifetime == slp::LIFETIME);
+static_assert(services.string(services.service(1).urlPrefix) ==
+              "service:obmc_redfish:https//");
+static_assert(services.string(services.service(1).urlSuffix) == ",443");
+
+constexpr auto empty =
+    slp::builtin::compile([] { return std::string_view(""); });
+static_assert(empty.registry().size() == 0);
+static_assert(empty.registry().typeList().empty());
+static_assert(empty.registry().find("service:obmc_console").empty());
+
+} // namespace
+
+TEST(BuiltinRegistry, TypeListEntry)
+{
+    auto entry = services.typeListEntry();
+    auto list = services.typeList();
+    ASSERT_EQ(entry.size(), list.size() + 2);
+    EXPECT_EQ((entry[0] << 8) | entry[1], list.size());
+    EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(&entry[2]),
+                               list.size()),
+              list);
+    EXPECT_EQ(empty.registry().typeListEntry().size(), 2);
+}
+
+TEST(BuiltinRegistry, Find)
+{
+    // Every key sits in the slot its hash picks
+    for (std::string_view type :
+         {"service:obmc_console", "service:obmc_redfish", "service:printer",
+          "service:printer:ipp", "service:printer:lpr"})
+    {
+        EXPECT_FALSE(services.find(type).empty()) << type;
+    }
+}
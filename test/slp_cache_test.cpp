@@ -0,0 +1,117 @@
+#include "slp_cache.hpp"
+#include "slp_meta.hpp"
+
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+/* A SrvRqst for a service type, with a XID */
+std::vector<uint8_t> request(char type, uint16_t xid)
+{
+    std::vector<uint8_t> buff{
+        0x02, 0x01, 0x00, 0x00, 0x1d, 0x00, 0x00,       0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 'e',        'n',
+        0x00, 0x00, 0x00, 0x09, 's',  'e',  'r',        'v',
+        'i',  'c',  'e',  ':',  (uint8_t)type};
+    buff[slp::header::OFFSET_XID] = xid >> 8;
+    buff[slp::header::OFFSET_XID + 1] = xid & 0xff;
+    return buff;
+}
+
+slp::cache::Reply reply(uint8_t tag)
+{
+    return {{0x02, 0x02, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+             0x00, 0x00, 0x02, 'e', 'n', 0x00, tag},
+            0,
+            0};
+}
+
+} // namespace
+
+TEST(ResponseCache, Fingerprint)
+{
+    using slp::cache::ResponseCache;
+    auto hash = ResponseCache::fingerprint(request('a', 1), 0, false);
+
+    // Only the XID does not count
+    EXPECT_EQ(ResponseCache::fingerprint(request('a', 0xbeef), 0, false),
+              hash);
+    EXPECT_NE(ResponseCache::fingerprint(request('b', 1), 0, false), hash);
+    EXPECT_NE(ResponseCache::fingerprint(request('a', 1), 1, false), hash);
+    EXPECT_NE(ResponseCache::fingerprint(request('a', 1), 0, true), hash);
+}
+
+TEST(ResponseCache, HitsAndGenerations)
+{
+    std::array<slp::cache::Entry, 8> storage;
+    slp::cache::ResponseCache cache(storage);
+
+    EXPECT_EQ(cache.find(request('a', 1), 0, false, 1), nullptr);
+    cache.insert(request('a', 1), 0, false, 1, true, false, reply(7));
+    cache.insert(request('b', 1), 0, true, 1, false, true, reply(8));
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.bytes(), sizeof(storage));
+
+    const auto* entry = cache.find(request('a', 2), 0, false, 1);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_TRUE(entry->answered);
+    EXPECT_FALSE(entry->multicast);
+    EXPECT_EQ(entry->message().size(), reply(7).message.size());
+    EXPECT_EQ(entry->message().back(), 7);
+
+    // Unanswered requests are remembered as such
+    entry = cache.find(request('b', 3), 0, true, 1);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_FALSE(entry->answered);
+    EXPECT_TRUE(entry->multicast);
+    EXPECT_TRUE(entry->message().empty());
+
+    // Neither in another namespace, nor sent another way
+    EXPECT_EQ(cache.find(request('a', 1), 1, false, 1), nullptr);
+    EXPECT_EQ(cache.find(request('b', 1), 0, false, 1), nullptr);
+
+    // A new registry leaves the replies to be replaced
+    EXPECT_EQ(cache.find(request('a', 1), 0, false, 2), nullptr);
+    EXPECT_EQ(cache.hits(), 2);
+    EXPECT_EQ(cache.misses(), 4);
+}
+
+TEST(ResponseCache, Replacement)
+{
+    std::array<slp::cache::Entry, 2> storage;
+    slp::cache::ResponseCache cache(storage);
+
+    // All requests share the one pair, the least recently used goes
+    cache.insert(request('a', 1), 0, false, 1, true, false, reply(1));
+    cache.insert(request('b', 1), 0, false, 1, true, false, reply(2));
+    EXPECT_NE(cache.find(request('a', 1), 0, false, 1), nullptr);
+    cache.insert(request('c', 1), 0, false, 1, true, false, reply(3));
+    EXPECT_NE(cache.find(request('a', 1), 0, false, 1), nullptr);
+    EXPECT_EQ(cache.find(request('b', 1), 0, false, 1), nullptr);
+    EXPECT_NE(cache.find(request('c', 1), 0, false, 1), nullptr);
+
+    // A reply of an older registry goes first
+    cache.insert(request('b', 1), 0, false, 2, true, false, reply(2));
+    cache.insert(request('d', 1), 0, false, 2, true, false, reply(4));
+    EXPECT_NE(cache.find(request('b', 1), 0, false, 2), nullptr);
+    EXPECT_NE(cache.find(request('d', 1), 0, false, 2), nullptr);
+
+    // Too long to be kept
+    slp::cache::Reply large{std::vector<uint8_t>(slp::MAX_LEN + 1), 0, 0};
+    cache.insert(request('e', 1), 0, false, 2, true, false, large);
+    EXPECT_EQ(cache.find(request('e', 1), 0, false, 2), nullptr);
+}
+
+TEST(ResponseCache, Disabled)
+{
+    slp::cache::ResponseCache cache({});
+
+    cache.insert(request('a', 1), 0, false, 1, true, false, reply(1));
+    EXPECT_EQ(cache.find(request('a', 1), 0, false, 1), nullptr);
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.bytes(), 0);
+}
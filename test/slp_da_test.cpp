@@ -0,0 +1,352 @@
+#include "slp.hpp"
+#include "slp_da.hpp"
+#include "slp_meta.hpp"
+#include "slp_timer_wheel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+slp::request::ServiceRegistration makeReg(const std::string& url,
+                                          const std::string& type,
+                                          uint16_t lifetime = 300,
+                                          const std::string& scopes = "",
+                                          const std::string& attrs = "")
+{
+    slp::request::ServiceRegistration reg;
+    reg.urlEntry.lifetime = lifetime;
+    reg.urlEntry.url = url;
+    reg.srvType = type;
+    reg.scopeList = scopes;
+    reg.attrList = attrs;
+    return reg;
+}
+
+std::vector<std::string>
+    urls(const std::vector<const slp::da::RegistrationStore::Registration*>& r)
+{
+    std::vector<std::string> list;
+    for (const auto* reg : r)
+    {
+        list.push_back(reg->url);
+    }
+    std::sort(list.begin(), list.end());
+    return list;
+}
+
+} // namespace
+
+TEST(TimerWheel, ExpiresOnTime)
+{
+    slp::TimerWheel wheel(100);
+    std::map<uint32_t, uint64_t> expiries{
+        {0, 101}, {1, 163}, {2, 164}, {3, 5000}, {4, 100 + (1 << 18) + 7}};
+    for (auto [id, expiry] : expiries)
+    {
+        wheel.schedule(id, expiry);
+    }
+    EXPECT_EQ(wheel.size(), expiries.size());
+
+    std::map<uint32_t, uint64_t> fired;
+    for (uint64_t t = 101; t <= 100 + (1 << 18) + 10; t++)
+    {
+        wheel.advance(t, [&](uint32_t id) { fired[id] = t; });
+    }
+
+    EXPECT_EQ(fired, expiries);
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheel, RandomExpiries)
+{
+    slp::TimerWheel wheel(0);
+    std::minstd_rand generator(1);
+    std::uniform_int_distribution<uint64_t> delay(1, 20000);
+    std::vector<uint64_t> expiries(1000);
+
+    for (uint32_t id = 0; id < expiries.size(); id++)
+    {
+        expiries[id] = delay(generator);
+        wheel.schedule(id, expiries[id]);
+    }
+
+    // Big jumps must still fire each entry at or after its expiry
+    size_t count = 0;
+    for (uint64_t t = 0; t <= 20000; t += 37)
+    {
+        wheel.advance(t, [&](uint32_t id) {
+            EXPECT_LE(expiries[id], t);
+            EXPECT_GT(expiries[id], t - 37);
+            count++;
+        });
+    }
+    wheel.advance(20037, [&](uint32_t) { count++; });
+    EXPECT_EQ(count, expiries.size());
+}
+
+TEST(TimerWheel, CancelAndReschedule)
+{
+    slp::TimerWheel wheel(0);
+    wheel.schedule(1, 10);
+    wheel.schedule(2, 10);
+    wheel.schedule(2, 100);
+    wheel.cancel(1);
+    wheel.cancel(7);
+
+    EXPECT_FALSE(wheel.scheduled(1));
+    EXPECT_TRUE(wheel.scheduled(2));
+
+    std::vector<uint32_t> fired;
+    wheel.advance(99, [&](uint32_t id) { fired.push_back(id); });
+    EXPECT_TRUE(fired.empty());
+    wheel.advance(100, [&](uint32_t id) { fired.push_back(id); });
+    EXPECT_EQ(fired, std::vector<uint32_t>{2});
+}
+
+TEST(RegistrationStore, AddFindAndCaseFolding)
+{
+    slp::da::RegistrationStore store;
+    std::vector<const slp::da::RegistrationStore::Registration*> found;
+
+    EXPECT_EQ(store.add(makeReg("service:printer:lpr://a",
+                                "service:printer:lpr"),
+                        true, 0),
+              0);
+    EXPECT_EQ(store.add(makeReg("service:printer:ipp://b",
+                                "Service:Printer:IPP", 300, "default"),
+                        true, 0),
+              0);
+    EXPECT_EQ(store.size(), 2);
+
+    // Concrete types match themselves, in any case
+    EXPECT_EQ(store.find("SERVICE:PRINTER:LPR", "", found), 0);
+    EXPECT_EQ(urls(found),
+              std::vector<std::string>{"service:printer:lpr://a"});
+
+    // Abstract types match all of their concrete types
+    EXPECT_EQ(store.find("service:printer", "DEFAULT", found), 0);
+    EXPECT_EQ(urls(found), (std::vector<std::string>{
+                               "service:printer:ipp://b",
+                               "service:printer:lpr://a"}));
+
+    EXPECT_EQ(store.find("service:scanner", "", found), 0);
+    EXPECT_TRUE(found.empty());
+
+    std::vector<std::string> types;
+    EXPECT_EQ(store.findTypes("", "", types), 0);
+    EXPECT_EQ(types, (std::vector<std::string>{"service:printer:ipp",
+                                               "service:printer:lpr"}));
+}
+
+TEST(RegistrationStore, Scopes)
+{
+    slp::da::RegistrationStore store("a,B", 0);
+    std::vector<const slp::da::RegistrationStore::Registration*> found;
+
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:x", 300, "c"), true,
+                        0),
+              (int)slp::Error::SCOPE_NOT_SUPPORTED);
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:x", 300, "A,b"),
+                        true, 0),
+              0);
+    EXPECT_EQ(store.add(makeReg("service:x://2", "service:x", 300, "b"), true,
+                        0),
+              0);
+
+    EXPECT_EQ(store.find("service:x", "a", found), 0);
+    EXPECT_EQ(urls(found), std::vector<std::string>{"service:x://1"});
+
+    // Listed once even though it is in both scopes
+    EXPECT_EQ(store.find("service:x", "a,b", found), 0);
+    EXPECT_EQ(urls(found),
+              (std::vector<std::string>{"service:x://1", "service:x://2"}));
+
+    EXPECT_EQ(store.find("service:x", "c", found),
+              (int)slp::Error::SCOPE_NOT_SUPPORTED);
+}
+
+TEST(RegistrationStore, UpdateAndDeregister)
+{
+    slp::da::RegistrationStore store;
+    std::vector<const slp::da::RegistrationStore::Registration*> found;
+
+    // Incremental update of something not registered
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:x"), false, 0),
+              (int)slp::Error::INVALID_UPDATE);
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:x"), true, 0),
+              0);
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:x", 300, "",
+                                "(a=1),(b=2)"),
+                        true, 0),
+              0);
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:x", 300, "",
+                                "(b=3),c"),
+                        false, 0),
+              0);
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:y"), false, 0),
+              (int)slp::Error::INVALID_UPDATE);
+
+    EXPECT_EQ(store.find("service:x", "", found), 0);
+    ASSERT_EQ(found.size(), 1);
+    EXPECT_EQ(found[0]->attrList, "(a=1),(b=3),c");
+
+    // A tag list only drops those attributes
+    slp::request::ServiceDeregistration dereg;
+    dereg.urlEntry.url = "service:x://1";
+    dereg.tagList = "B";
+    EXPECT_EQ(store.remove(dereg), 0);
+    EXPECT_EQ(store.find("service:x", "", found), 0);
+    ASSERT_EQ(found.size(), 1);
+    EXPECT_EQ(found[0]->attrList, "(a=1),c");
+
+    dereg.tagList.clear();
+    EXPECT_EQ(store.remove(dereg), 0);
+    EXPECT_EQ(store.size(), 0);
+    EXPECT_EQ(store.remove(dereg), (int)slp::Error::INVALID_REGISTRATION);
+
+    EXPECT_EQ(store.find("service:x", "", found), 0);
+    EXPECT_TRUE(found.empty());
+    std::vector<std::string> types;
+    EXPECT_EQ(store.findTypes("", "", types), 0);
+    EXPECT_TRUE(types.empty());
+}
+
+TEST(RegistrationStore, ChurnKeepsNoEmptyBuckets)
+{
+    slp::da::RegistrationStore store;
+    std::vector<const slp::da::RegistrationStore::Registration*> found;
+    slp::request::ServiceDeregistration dereg;
+
+    // Distinct types come and go, the index only holds the ones left
+    ASSERT_EQ(store.add(makeReg("service:kept:a://1", "service:kept:a"),
+                        true, 0),
+              0);
+    for (int i = 0; i < 100; i++)
+    {
+        auto type = "service:churn:t" + std::to_string(i);
+        ASSERT_EQ(store.add(makeReg(type + "://1", type), true, 0), 0);
+        dereg.urlEntry.url = type + "://1";
+        ASSERT_EQ(store.remove(dereg), 0);
+    }
+    EXPECT_EQ(store.bucketCount(), 2);
+
+    EXPECT_EQ(store.find("service:kept", "", found), 0);
+    ASSERT_EQ(found.size(), 1);
+    dereg.urlEntry.url = "service:kept:a://1";
+    ASSERT_EQ(store.remove(dereg), 0);
+    EXPECT_EQ(store.bucketCount(), 0);
+}
+
+TEST(RegistrationStore, Expiry)
+{
+    slp::da::RegistrationStore store("DEFAULT", 1000);
+    std::vector<const slp::da::RegistrationStore::Registration*> found;
+
+    EXPECT_EQ(store.add(makeReg("service:x://1", "service:x", 10), true, 1000),
+              0);
+    EXPECT_EQ(store.add(makeReg("service:x://2", "service:x", 20), true, 1000),
+              0);
+
+    store.expire(1009);
+    EXPECT_EQ(store.size(), 2);
+
+    store.expire(1010);
+    EXPECT_EQ(store.size(), 1);
+    EXPECT_EQ(store.find("service:x", "", found), 0);
+    EXPECT_EQ(urls(found), std::vector<std::string>{"service:x://2"});
+
+    // Re-registering extends the lifetime
+    EXPECT_EQ(store.add(makeReg("service:x://2", "service:x", 100), true,
+                        1015),
+              0);
+    store.expire(1100);
+    EXPECT_EQ(store.size(), 1);
+    store.expire(1115);
+    EXPECT_EQ(store.size(), 0);
+}
+
+TEST(RegistrationStore, ManyRegistrations)
+{
+    constexpr size_t count = 100000;
+    constexpr size_t types = 1000;
+    slp::da::RegistrationStore store;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto type = "service:t" + std::to_string(i % types) + ":x";
+        auto url = type + "://" + std::to_string(i);
+        ASSERT_EQ(store.add(makeReg(url, type, 60 + i % 500), true, 0), 0);
+    }
+    EXPECT_EQ(store.size(), count);
+
+    // Lookups only touch the matching bucket
+    std::vector<const slp::da::RegistrationStore::Registration*> found;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < types; i++)
+    {
+        ASSERT_EQ(store.find("service:t" + std::to_string(i), "", found), 0);
+        ASSERT_EQ(found.size(), count / types);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+
+    store.expire(60 + 249);
+    EXPECT_EQ(store.size(), count / 2);
+    store.expire(60 + 500);
+    EXPECT_EQ(store.size(), 0);
+}
+
+TEST(processRequest, SrvRegAcknowledged)
+{
+    slp::da::enable("DEFAULT");
+
+    slp::Message req;
+    req.header.version = slp::VERSION_2;
+    req.header.functionID = (uint8_t)slp::FunctionType::SRVREG;
+    req.header.flags = slp::header::FLAG_FRESH;
+    req.header.langtag = "en";
+    req.body.srvreg = makeReg("service:x://1", "service:x");
+
+    int rc = slp::SUCCESS;
+    slp::buffer resp;
+    std::tie(rc, resp) = slp::handler::processRequest(req);
+    EXPECT_EQ(rc, 0);
+    ASSERT_EQ(resp.size(),
+              slp::header::MIN_LEN + 2 + slp::response::SIZE_ERROR);
+    EXPECT_EQ(resp[slp::header::OFFSET_FUNCTION],
+              (uint8_t)slp::FunctionType::SRVACK);
+    EXPECT_EQ(resp[slp::header::OFFSET_LENGTH], resp.size());
+    EXPECT_EQ(slp::da::store().size(), 1);
+
+    // Errors on registrations are acknowledged as well
+    auto error = slp::handler::processError(
+        req, (uint8_t)slp::Error::INVALID_REGISTRATION);
+    EXPECT_EQ(error[slp::header::OFFSET_FUNCTION],
+              (uint8_t)slp::FunctionType::SRVACK);
+
+    req.header.functionID = (uint8_t)slp::FunctionType::SRVRQST;
+    req.body.srvrqst.srvType = "service:x";
+    std::tie(rc, resp) = slp::handler::processRequest(req);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(resp[slp::header::OFFSET_FUNCTION],
+              (uint8_t)slp::FunctionType::SRVRPLY);
+    // Error code, one URL entry and the URL
+    EXPECT_EQ(resp.size(), slp::header::MIN_LEN + 2 +
+                               slp::response::SIZE_ERROR +
+                               slp::response::SIZE_URL_COUNT +
+                               slp::response::SIZE_URL_ENTRY + 13);
+
+    req.body.srvrqst.srvType = "service:directory-agent";
+    std::tie(rc, resp) = slp::handler::processRequest(req);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(resp[slp::header::OFFSET_FUNCTION],
+              (uint8_t)slp::FunctionType::DAADVERT);
+}
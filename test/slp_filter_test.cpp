@@ -0,0 +1,138 @@
+#include "slp_filter.hpp"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+/* A SrvTypeRqst with an empty naming authority and scope list */
+std::vector<uint8_t> request()
+{
+    return {0x02, 0x09, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x01, 0x00, 0x02, 'e',  'n',  0x00, 0x00, 0x00, 0x00};
+}
+
+class FilterTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        server = bindLoopback();
+        client = bindLoopback();
+        ASSERT_GE(server, 0);
+        ASSERT_GE(client, 0);
+
+        timeval tv{0, 100000};
+        setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        socklen_t len = sizeof(serverAddr);
+        getsockname(server, (sockaddr*)&serverAddr, &len);
+
+        int r = 0;
+        std::tie(r, filter) = slp::udp::Filter::attach(server);
+        ASSERT_EQ(r, 0);
+    }
+
+    void TearDown() override
+    {
+        filter.reset();
+        close(client);
+        close(server);
+    }
+
+    static int bindLoopback()
+    {
+        int fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_loopback;
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            return -1;
+        }
+        return fd;
+    }
+
+    /* Send a datagram and tell whether it got through the filter */
+    bool passes(const std::vector<uint8_t>& data)
+    {
+        sendto(client, data.data(), data.size(), 0, (sockaddr*)&serverAddr,
+               sizeof(serverAddr));
+
+        uint8_t buf[512];
+        return recv(server, buf, sizeof(buf), 0) == (ssize_t)data.size();
+    }
+
+    int server = -1;
+    int client = -1;
+    sockaddr_in6 serverAddr{};
+    std::unique_ptr<slp::udp::Filter> filter;
+};
+
+} // namespace
+
+TEST_F(FilterTest, ValidRequestPasses)
+{
+    EXPECT_TRUE(passes(request()));
+}
+
+TEST_F(FilterTest, MalformedDropped)
+{
+    auto runt = request();
+    runt.resize(13);
+    EXPECT_FALSE(passes(runt));
+
+    auto oversize = request();
+    oversize.resize(256);
+    EXPECT_FALSE(passes(oversize));
+
+    auto largest = request();
+    largest.resize(255);
+    EXPECT_TRUE(passes(largest));
+
+    auto version = request();
+    version[0] = 1;
+    EXPECT_FALSE(passes(version));
+
+    auto function = request();
+    function[1] = 0;
+    EXPECT_FALSE(passes(function));
+    function[1] = 12;
+    EXPECT_FALSE(passes(function));
+    function[1] = 11;
+    EXPECT_TRUE(passes(function));
+}
+
+TEST_F(FilterTest, DropsCounted)
+{
+    auto [rc, drops] = filter->drops();
+    if (rc == -EOPNOTSUPP)
+    {
+        GTEST_SKIP() << "eBPF not allowed, the classic filter counts nothing";
+    }
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(drops, slp::udp::Filter::Drops{});
+
+    auto version = request();
+    version[0] = 1;
+    EXPECT_FALSE(passes(version));
+    EXPECT_FALSE(passes(version));
+    auto runt = request();
+    runt.resize(2);
+    EXPECT_FALSE(passes(runt));
+    EXPECT_TRUE(passes(request()));
+
+    std::tie(rc, drops) = filter->drops();
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(drops[(size_t)slp::udp::Filter::Reason::VERSION], 2);
+    EXPECT_EQ(drops[(size_t)slp::udp::Filter::Reason::RUNT], 1);
+    EXPECT_EQ(drops[(size_t)slp::udp::Filter::Reason::OVERSIZE], 0);
+    EXPECT_EQ(drops[(size_t)slp::udp::Filter::Reason::FUNCTION], 0);
+}
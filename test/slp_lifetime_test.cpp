@@ -0,0 +1,123 @@
+#include "slp_lifetime.hpp"
+#include "slp_meta.hpp"
+#include "slp_service_info.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+/* Count queries at a steady rate for a while, from start */
+time_t query(slp::lifetime::Policy& policy, time_t start, unsigned perSecond,
+             time_t seconds)
+{
+    for (time_t now = start; now < start + seconds; now++)
+    {
+        for (unsigned i = 0; i < perSecond; i++)
+        {
+            policy.countQuery(now);
+        }
+    }
+    return start + seconds;
+}
+
+} // namespace
+
+TEST(ConfigData, Lifetime)
+{
+    slp::ConfigData svc;
+    ASSERT_TRUE(svc.parse("obmc_console ssh 2200"));
+    EXPECT_EQ(svc.lifetime, slp::LIFETIME);
+    ASSERT_TRUE(svc.parse("obmc_console ssh 2200 600"));
+    EXPECT_EQ(svc.port, "2200");
+    EXPECT_EQ(svc.lifetime, 600);
+
+    EXPECT_FALSE(svc.parse("obmc_console ssh 2200 0"));
+    EXPECT_FALSE(svc.parse("obmc_console ssh 2200 65536"));
+    EXPECT_FALSE(svc.parse("obmc_console ssh 2200 10m"));
+}
+
+TEST(Policy, Configured)
+{
+    slp::lifetime::Policy policy;
+    time_t now = query(policy, 1000, 1, 60);
+
+    EXPECT_EQ(policy.scale(), 1);
+    EXPECT_EQ(policy.advertised(slp::LIFETIME, now), slp::LIFETIME);
+    EXPECT_EQ(policy.advertised(600, now), 600);
+}
+
+TEST(Policy, ScaledByQueryRate)
+{
+    slp::lifetime::Policy policy;
+    time_t now = query(policy, 1000, 50, 300);
+
+    // Doubled on every busy window, up to LIFETIME_MAX
+    EXPECT_GE(policy.scale() * slp::LIFETIME, slp::LIFETIME_MAX);
+    EXPECT_EQ(policy.advertised(slp::LIFETIME, now), slp::LIFETIME_MAX);
+    EXPECT_EQ(policy.advertised(7200, now), 7200);
+
+    // The clients query less, which keeps the scale
+    unsigned scale = policy.scale();
+    now = query(policy, now, 1, 60);
+    EXPECT_EQ(policy.scale(), scale);
+
+    // Quiet, lowered once the lifetimes it raised have passed
+    now += slp::LIFETIME_MAX;
+    policy.countQuery(now);
+    EXPECT_EQ(policy.scale(), scale / 2);
+    auto lifetime = policy.advertised(slp::LIFETIME, now);
+    EXPECT_EQ(lifetime, slp::LIFETIME * scale / 2);
+
+    now += slp::RATE_WINDOW;
+    policy.countQuery(now);
+    EXPECT_EQ(policy.scale(), scale / 2);
+    now += lifetime;
+    policy.countQuery(now);
+    EXPECT_EQ(policy.scale(), scale / 4);
+}
+
+TEST(Policy, PlannedChange)
+{
+    slp::lifetime::Policy policy;
+    time_t now = query(policy, 1000, 50, 300);
+
+    policy.planChange(now + 60);
+    EXPECT_EQ(policy.advertised(slp::LIFETIME, now), 60);
+    EXPECT_EQ(policy.advertised(slp::LIFETIME, now + 58), 2);
+    EXPECT_EQ(policy.advertised(slp::LIFETIME, now + 59), 1);
+    EXPECT_EQ(policy.advertised(slp::LIFETIME, now + 60), slp::LIFETIME_MAX);
+
+    // Ended by the expiry of a signature too
+    policy.planChange(0);
+    EXPECT_EQ(policy.advertised(slp::LIFETIME, now, now + 100), 100);
+}
+
+TEST(Policy, ReadPlannedChange)
+{
+    char tmpl[] = "/tmp/slp_planned_change_XXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    slp::lifetime::Policy policy;
+    std::ofstream(tmpl) << "1700000000\n";
+    EXPECT_EQ(slp::lifetime::readPlannedChange(policy, tmpl), 0);
+    EXPECT_EQ(policy.plannedChange(), 1700000000);
+
+    std::ofstream(tmpl) << "tomorrow\n";
+    EXPECT_EQ(slp::lifetime::readPlannedChange(policy, tmpl), -EBADMSG);
+    EXPECT_EQ(policy.plannedChange(), 1700000000);
+
+    unlink(tmpl);
+    EXPECT_EQ(slp::lifetime::readPlannedChange(policy, tmpl), 0);
+    EXPECT_EQ(policy.plannedChange(), 0);
+}
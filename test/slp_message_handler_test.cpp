@@ -1,4 +1,6 @@
 #include "slp.hpp"
+#include "slp_cache.hpp"
+#include "slp_lifetime.hpp"
 #include "slp_meta.hpp"
 
 #include <gtest/gtest.h>
@@ -99,3 +101,230 @@ TEST(processError, InvalidEverything)
     EXPECT_EQ(resp[slp::header::MIN_LEN + 1],
               static_cast<uint8_t>(slp::Error::MSG_NOT_SUPPORTED));
 }
+
+namespace
+{
+
+/* A SrvTypeRqst for all naming authorities in DEFAULT */
+slp::buffer srvTypeRequest(std::string_view prList)
+{
+    slp::buffer buff{0x02, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00,
+                     0x00, 0x00, 0x00, 0x12, 0x34, 0x00, 0x02,
+                     'e',  'n',  0x00, (uint8_t)prList.size()};
+    buff.insert(buff.end(), prList.begin(), prList.end());
+    for (uint8_t byte : {0xff, 0xff, 0x00, 0x07})
+    {
+        buff.push_back(byte);
+    }
+    std::string_view scope = "DEFAULT";
+    buff.insert(buff.end(), scope.begin(), scope.end());
+    buff[slp::header::OFFSET_LENGTH] = buff.size();
+    return buff;
+}
+
+// "slptool findsrvs service:obmc_console"
+const slp::buffer srvRequest{
+    0x02, 0x01, 0x00, 0x00, 0x35, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe5,
+    0xc2, 0x00, 0x02, 'e',  'n',  0x00, 0x00, 0x00, 0x14, 's',  'e',
+    'r',  'v',  'i',  'c',  'e',  ':',  'o',  'b',  'm',  'c',  '_',
+    'c',  'o',  'n',  's',  'o',  'l',  'e',  0x00, 0x07, 'D',  'E',
+    'F',  'A',  'U',  'L',  'T',  0x00, 0x00, 0x00, 0x00};
+
+/* Lifetime of the first URL entry of a SrvRply in "en" */
+uint16_t firstLifetime(const slp::buffer& resp)
+{
+    size_t pos = slp::header::MIN_LEN + 2 + slp::response::SIZE_ERROR +
+                 slp::response::SIZE_URL_COUNT + slp::response::SIZE_RESERVED;
+    return (resp[pos] << 8) | resp[pos + 1];
+}
+
+} // namespace
+
+TEST(serveRequest, PreviousResponder)
+{
+    slp::ConfigData svc;
+    ASSERT_TRUE(svc.parse("obmc_console ssh 2200"));
+    svc.name = "service:" + svc.name;
+    slp::handler::internal::publishServiceRegistry(
+        slp::handler::internal::makeServiceRegistry(
+            {svc}, {"192.168.1.20", "10.0.0.1"}));
+
+    slp::buffer resp;
+    bool multicast = false;
+    EXPECT_TRUE(slp::handler::serveRequest(srvTypeRequest(""), true, resp,
+                                           multicast));
+    EXPECT_TRUE(slp::handler::serveRequest(
+        srvTypeRequest("10.0.0.2,10.0.0.10"), true, resp, multicast));
+
+    // Listed as a previous responder, on any of the addresses
+    resp.clear();
+    EXPECT_FALSE(slp::handler::serveRequest(
+        srvTypeRequest("10.0.0.2, 10.0.0.1"), true, resp, multicast));
+    EXPECT_TRUE(resp.empty());
+    EXPECT_FALSE(slp::handler::serveRequest(srvTypeRequest("192.168.1.20"),
+                                            false, resp, multicast));
+}
+
+TEST(serveRequest, EmptyDatagram)
+{
+    slp::buffer resp;
+    bool multicast = false;
+
+    EXPECT_TRUE(slp::handler::serveRequest({}, false, resp, multicast));
+    EXPECT_EQ(resp[slp::header::MIN_LEN + 1],
+              static_cast<uint8_t>(slp::Error::PARSE_ERROR));
+    EXPECT_FALSE(slp::handler::serveRequest({}, true, resp, multicast));
+}
+
+TEST(serveRequest, NetworkNamespaces)
+{
+    slp::ConfigData svc;
+    ASSERT_TRUE(svc.parse("obmc_console ssh 2200"));
+    svc.name = "service:" + svc.name;
+    auto registry =
+        slp::handler::internal::makeServiceRegistry({svc}, {"10.0.0.1"});
+    slp::handler::internal::addAddressTable(*registry, {"172.16.0.1"});
+    slp::handler::internal::publishServiceRegistry(std::move(registry));
+
+    // Each namespace is its own responder
+    slp::buffer resp;
+    bool multicast = false;
+    EXPECT_FALSE(slp::handler::serveRequest(srvTypeRequest("10.0.0.1"), true,
+                                            resp, multicast, 0));
+    EXPECT_TRUE(slp::handler::serveRequest(srvTypeRequest("10.0.0.1"), true,
+                                           resp, multicast, 1));
+    EXPECT_FALSE(slp::handler::serveRequest(srvTypeRequest("172.16.0.1"),
+                                            true, resp, multicast, 1));
+
+    // Only the namespace's own addresses are offered
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::parseBuffer(srvRequest);
+    ASSERT_EQ(rc, 0);
+    for (auto [ns, address] : {std::pair{0, "10.0.0.1"},
+                               std::pair{1, "172.16.0.1"},
+                               std::pair{7, "10.0.0.1"}})
+    {
+        req.ns = ns;
+        std::tie(rc, resp) = slp::handler::processRequest(req);
+        ASSERT_EQ(rc, 0);
+        std::string reply(resp.begin(), resp.end());
+        EXPECT_NE(reply.find(address), std::string::npos) << ns;
+    }
+}
+
+TEST(processRequest, Lifetimes)
+{
+    slp::ConfigData console;
+    ASSERT_TRUE(console.parse("obmc_console ssh 2200 600"));
+    console.name = "service:" + console.name;
+    slp::handler::internal::publishServiceRegistry(
+        slp::handler::internal::makeServiceRegistry({console}, {"10.0.0.1"}));
+
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::parseBuffer(srvRequest);
+    ASSERT_EQ(rc, 0);
+
+    slp::buffer resp;
+    std::tie(rc, resp) = slp::handler::processRequest(req);
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(firstLifetime(resp), 600);
+
+    // Cut short ahead of a planned registry change
+    auto& policy = slp::lifetime::policy();
+    policy.planChange(time(nullptr) + 30);
+    std::tie(rc, resp) = slp::handler::processRequest(req);
+    policy.planChange(0);
+    ASSERT_EQ(rc, 0);
+    EXPECT_LE(firstLifetime(resp), 30);
+    EXPECT_GE(firstLifetime(resp), 28);
+}
+
+TEST(serveRequest, Cache)
+{
+    slp::ConfigData console;
+    ASSERT_TRUE(console.parse("obmc_console ssh 2200 600"));
+    console.name = "service:" + console.name;
+    slp::handler::internal::publishServiceRegistry(
+        slp::handler::internal::makeServiceRegistry({console}, {"10.0.0.1"}));
+
+    const auto& cache = slp::cache::responses();
+    slp::buffer first;
+    bool multicast = false;
+    ASSERT_TRUE(
+        slp::handler::serveRequest(srvRequest, false, first, multicast));
+
+    // The same query with another XID is answered from the cache
+    auto hits = cache.hits();
+    auto request = srvRequest;
+    request[slp::header::OFFSET_XID] = 0x42;
+    slp::buffer resp;
+    ASSERT_TRUE(slp::handler::serveRequest(request, false, resp, multicast));
+    EXPECT_EQ(cache.hits(), hits + 1);
+    EXPECT_EQ(resp[slp::header::OFFSET_XID], 0x42);
+    resp[slp::header::OFFSET_XID] = first[slp::header::OFFSET_XID];
+    EXPECT_EQ(resp, first);
+
+    // The lifetimes are still advertised when the reply is sent
+    auto& policy = slp::lifetime::policy();
+    policy.planChange(time(nullptr) + 30);
+    ASSERT_TRUE(slp::handler::serveRequest(request, false, resp, multicast));
+    policy.planChange(0);
+    EXPECT_EQ(cache.hits(), hits + 2);
+    EXPECT_LE(firstLifetime(resp), 30);
+
+    // A new registry is not answered from the older replies
+    slp::handler::internal::publishServiceRegistry(
+        slp::handler::internal::makeServiceRegistry({console},
+                                                    {"10.0.0.2"}));
+    ASSERT_TRUE(slp::handler::serveRequest(request, false, resp, multicast));
+    EXPECT_EQ(cache.hits(), hits + 2);
+    std::string reply(resp.begin(), resp.end());
+    EXPECT_NE(reply.find("10.0.0.2"), std::string::npos);
+
+    // Requests left unanswered are cached too, per namespace
+    EXPECT_FALSE(slp::handler::serveRequest(srvTypeRequest("10.0.0.2"), true,
+                                            resp, multicast));
+    EXPECT_FALSE(slp::handler::serveRequest(srvTypeRequest("10.0.0.2"), true,
+                                            resp, multicast));
+    EXPECT_EQ(cache.hits(), hits + 3);
+    EXPECT_FALSE(slp::handler::serveRequest(srvTypeRequest("10.0.0.2"), true,
+                                            resp, multicast, 1));
+    EXPECT_EQ(cache.hits(), hits + 3);
+}
+
+TEST(processRequest, BuiltinTable)
+{
+    static constexpr auto table = slp::builtin::compile([] {
+        return std::string_view("obmc_console ssh 2200 600;"
+                                "obmc_redfish https 443");
+    });
+    static constexpr auto builtin = table.registry();
+    auto registry =
+        std::make_unique<slp::handler::internal::ServiceRegistry>();
+    registry->builtin = &builtin;
+    slp::handler::internal::addAddressTable(*registry, {"10.0.0.1"});
+    slp::handler::internal::publishServiceRegistry(std::move(registry));
+
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::parseBuffer(srvRequest);
+    ASSERT_EQ(rc, 0);
+
+    slp::buffer resp;
+    std::tie(rc, resp) = slp::handler::processRequest(req);
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(firstLifetime(resp), 600);
+    std::string reply(resp.begin(), resp.end());
+    EXPECT_NE(reply.find("service:obmc_console:ssh//10.0.0.1,2200"),
+              std::string::npos);
+
+    std::tie(rc, req) = slp::parser::parseBuffer(srvTypeRequest(""));
+    ASSERT_EQ(rc, 0);
+    std::tie(rc, resp) = slp::handler::processRequest(req);
+    ASSERT_EQ(rc, 0);
+    reply.assign(resp.begin(), resp.end());
+    EXPECT_NE(reply.find("service:obmc_console,service:obmc_redfish"),
+              std::string::npos);
+}
@@ -0,0 +1,31 @@
+#include "slp_netns.hpp"
+
+#include <errno.h>
+
+#include <gtest/gtest.h>
+
+TEST(netns, OwnNamespaceOnly)
+{
+    EXPECT_EQ(slp::netns::open({}), 0);
+    EXPECT_EQ(slp::netns::count(), 1);
+    EXPECT_TRUE(slp::netns::name(0).empty());
+
+    slp::netns::Enter own(0);
+    EXPECT_EQ(own.error(), 0);
+
+    slp::netns::Enter unknown(1);
+    EXPECT_EQ(unknown.error(), -EINVAL);
+}
+
+TEST(netns, InvalidNames)
+{
+    EXPECT_EQ(slp::netns::open({""}), -EINVAL);
+    EXPECT_EQ(slp::netns::open({"../self"}), -EINVAL);
+    EXPECT_EQ(slp::netns::count(), 1);
+}
+
+TEST(netns, MissingNamespace)
+{
+    EXPECT_LT(slp::netns::open({"slpd-test-missing"}), 0);
+    EXPECT_EQ(slp::netns::count(), 1);
+}
@@ -256,6 +256,55 @@ TEST(parseSrvRqst, GoodPathMatchSlptoolFindSrvs)
     EXPECT_EQ(req.body.srvrqst.scopeList, "DEFAULT");
 }
 
+TEST(parseBuffer, InvalidUTF8)
+{
+    // "slptool findsrvs service:obmc_console" with a latin-1 scope
+    slp::buffer testData{0x02, 0x01, 0x00, 0x00, 0x35, 0x00, 0x00, 0x00,
+                         0x00, 0x00, 0xe5, 0xc2, 0x00, 0x02, /* Lang Length */
+                         'e',  'n',  0x00, 0x00,             /* PR list length*/
+                         0x00, 0x14, /* Service length */
+                         's',  'e',  'r',  'v',  'i',  'c',  'e',  ':',
+                         'o',  'b',  'm',  'c',  '_',  'c',  'o',  'n',
+                         's',  'o',  'l',  'e',  0x00, 0x07, /* Scope length*/
+                         'D',  0xc9, 'F',  'A',  'U',  'L',  'T',  0x00,
+                         0x00,        /* Predicate length */
+                         0x00, 0x00}; /* SLP SPI length*/
+
+    auto [rc, req] = slp::parser::parseBuffer(testData);
+    EXPECT_EQ(rc, (int)slp::Error::PARSE_ERROR);
+
+    // The same scope in UTF-8
+    testData[0x2b] = 'E';
+    std::tie(rc, req) = slp::parser::parseBuffer(testData);
+    EXPECT_EQ(rc, 0);
+}
+
+TEST(parseBuffer, Dispatch)
+{
+    // A header with the "en" tag and nothing after it
+    slp::buffer testData{0x02, 0x06, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00,
+                         0x00, 0x00, 0x12, 0x34, 0x00, 0x02, 'e',  'n'};
+
+    // AttrRqst has no parser, unknown ids are rejected with the header
+    auto [rc, req] = slp::parser::parseBuffer(testData);
+    EXPECT_EQ(rc, (int)slp::Error::MSG_NOT_SUPPORTED);
+    testData[slp::header::OFFSET_FUNCTION] = 0xff;
+    std::tie(rc, req) = slp::parser::parseBuffer(testData);
+    EXPECT_EQ(rc, (int)slp::Error::PARSE_ERROR);
+
+    // Every supported type has a minimum length
+    for (auto function :
+         {slp::FunctionType::SRVRQST, slp::FunctionType::SRVREG,
+          slp::FunctionType::SRVDEREG, slp::FunctionType::SRVTYPERQST,
+          slp::FunctionType::DAADVERT, slp::FunctionType::SRVACK})
+    {
+        testData[slp::header::OFFSET_FUNCTION] = (uint8_t)function;
+        std::tie(rc, req) = slp::parser::parseBuffer(testData);
+        EXPECT_EQ(rc, (int)slp::Error::PARSE_ERROR);
+        EXPECT_EQ(req.header.functionID, (uint8_t)function);
+    }
+}
+
 TEST(parseSrvRqst, BadPathSizes)
 {
     // Basic buffer with invalid PRlist size
@@ -308,3 +357,193 @@ TEST(parseSrvRqst, BadPathSizes)
     rc = slp::parser::internal::parseSrvRqst(testData, req);
     EXPECT_EQ(rc, 0);
 }
+
+/*  0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |         Service Location header (function = SrvReg = 3)       |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |                          <URL-Entry>                          \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   | length of service type string |        <service-type>         \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |     length of <scope-list>    |         <scope-list>          \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |  length of attr-list string   |          <attr-list>          \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |# of AttrAuths |(if present) Attribute Authentication Blocks...\
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+*/
+
+TEST(parseSrvReg, GoodPathWithData)
+{
+    slp::buffer testData{
+        0x02, 0x03, 0x00, 0x00, 0x00, 0x40, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, /* Lang Length */
+        'e',  'n',  0x00, 0x01, 0x2C, 0x00, 0x05, /* URL entry */
+        'U',  'R',  'L',  ':',  '1',  0x00,       /* URL auths */
+        0x00, 0x04,                               /* Service type length */
+        'T',  'Y',  'P',  'E',  0x00, 0x05,       /* Scope length */
+        'S',  'C',  'O',  'P',  'E',  0x00, 0x03, /* Attr length */
+        'A',  '=',  '1',  0x00};                  /* Attr auths */
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::internal::parseHeader(testData);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(req.header.flags, slp::header::FLAG_FRESH);
+
+    rc = slp::parser::internal::parseSrvReg(testData, req);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(req.body.srvreg.urlEntry.lifetime, 300);
+    EXPECT_EQ(req.body.srvreg.urlEntry.url, "URL:1");
+    EXPECT_EQ(req.body.srvreg.srvType, "TYPE");
+    EXPECT_EQ(req.body.srvreg.scopeList, "SCOPE");
+    EXPECT_EQ(req.body.srvreg.attrList, "A=1");
+}
+
+TEST(parseSrvReg, BadPathSizes)
+{
+    slp::buffer testData{
+        0x02, 0x03, 0x00, 0x00, 0x00, 0x40, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, /* Lang Length */
+        'e',  'n',  0x00, 0x01, 0x2C, 0x00, 0x06, /* URL entry */
+        'U',  'R',  'L',  ':',  '1',  0x00,       /* URL auths */
+        0x00, 0x04,                               /* Service type length */
+        'T',  'Y',  'P',  'E',  0x00, 0x05,       /* Scope length */
+        'S',  'C',  'O',  'P',  'E',  0x00, 0x03, /* Attr length */
+        'A',  '=',  '1',  0x00};                  /* Attr auths */
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::internal::parseHeader(testData);
+    EXPECT_EQ(rc, 0);
+
+    // URL runs into the service type
+    rc = slp::parser::internal::parseSrvReg(testData, req);
+    EXPECT_NE(rc, 0);
+
+    // Fix URL, claim an attribute auth block that is not there
+    testData[20] = 5;
+    testData[45] = 1;
+    rc = slp::parser::internal::parseSrvReg(testData, req);
+    EXPECT_NE(rc, 0);
+
+    // Drop the attribute auth count altogether
+    testData.pop_back();
+    rc = slp::parser::internal::parseSrvReg(testData, req);
+    EXPECT_NE(rc, 0);
+
+    testData.push_back(0x00);
+    rc = slp::parser::internal::parseSrvReg(testData, req);
+    EXPECT_EQ(rc, 0);
+}
+
+/*  0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |         Service Location header (function = SrvDeReg = 4)     |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |    Length of <scope-list>     |         <scope-list>          \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |                           URL Entry                           \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |      Length of <tag-list>     |            <tag-list>         \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+*/
+
+TEST(parseSrvDeReg, GoodPathWithData)
+{
+    slp::buffer testData{
+        0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, /* Lang Length */
+        'e',  'n',  0x00, 0x05,                   /* Scope length */
+        'S',  'C',  'O',  'P',  'E',  0x00, 0x00, /* URL entry */
+        0x00, 0x00, 0x05, 'U',  'R',  'L',  ':',
+        '1',  0x00,                               /* URL auths */
+        0x00, 0x01,                               /* Tag length */
+        'A'};
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::internal::parseHeader(testData);
+    EXPECT_EQ(rc, 0);
+
+    rc = slp::parser::internal::parseSrvDeReg(testData, req);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(req.body.srvdereg.scopeList, "SCOPE");
+    EXPECT_EQ(req.body.srvdereg.urlEntry.url, "URL:1");
+    EXPECT_EQ(req.body.srvdereg.tagList, "A");
+
+    // Tag list runs past the end
+    testData[35] = 2;
+    rc = slp::parser::internal::parseSrvDeReg(testData, req);
+    EXPECT_NE(rc, 0);
+}
+
+/*  0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |        Service Location header (function = DAAdvert = 8)      |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |          Error Code           |  DA Stateless Boot Timestamp  |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |DA Stateless Boot Time,, contd.|         Length of URL         |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   \                              URL                              \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |     Length of <scope-list>    |         <scope-list>          \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |     Length of <attr-list>     |          <attr-list>          \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |    Length of <SLP SPI List>   |     <SLP SPI List> String     \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   | # Auth Blocks |         Authentication block (if any)         \
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+*/
+
+TEST(parseDAAdvert, GoodPathWithData)
+{
+    slp::buffer testData{
+        0x02, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, /* Lang Length */
+        'e',  'n',  0x00, 0x00, 0x00, 0x00,       /* Boot timestamp */
+        0x01, 0x2C, 0x00, 0x05,                   /* URL length */
+        'U',  'R',  'L',  ':',  '1',  0x00, 0x05, /* Scope length */
+        'S',  'C',  'O',  'P',  'E',  0x00, 0x03, /* Attr length */
+        'A',  '=',  '1',  0x00, 0x00,             /* SPI length */
+        0x00};                                    /* Auths */
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::internal::parseHeader(testData);
+    EXPECT_EQ(rc, 0);
+
+    rc = slp::parser::internal::parseDAAdvert(testData, req);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(req.body.daadvert.errorCode, 0);
+    EXPECT_EQ(req.body.daadvert.bootTimestamp, 300);
+    EXPECT_EQ(req.body.daadvert.url, "URL:1");
+    EXPECT_EQ(req.body.daadvert.scopeList, "SCOPE");
+    EXPECT_EQ(req.body.daadvert.attrList, "A=1");
+    EXPECT_EQ(req.body.daadvert.spiList, "");
+
+    // No auth block count
+    testData.pop_back();
+    rc = slp::parser::internal::parseDAAdvert(testData, req);
+    EXPECT_NE(rc, 0);
+
+    // Boot timestamp cut short
+    testData.resize(18);
+    rc = slp::parser::internal::parseDAAdvert(testData, req);
+    EXPECT_NE(rc, 0);
+}
+
+TEST(parseSrvAck, GoodPathWithData)
+{
+    slp::buffer testData{0x02, 0x05, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00, 0x00,
+                         0x00, 0x12, 0x34, 0x00, 0x02, 'e',  'n',  0x00, 0x0B};
+    slp::Message req;
+    int rc = slp::SUCCESS;
+    std::tie(rc, req) = slp::parser::parseBuffer(testData);
+    EXPECT_EQ(rc, 0);
+    EXPECT_EQ(req.header.xid, 0x1234);
+    EXPECT_EQ(req.body.srvack.errorCode, (int)slp::Error::DA_BUSY_NOW);
+
+    testData.pop_back();
+    rc = slp::parser::internal::parseSrvAck(testData, req);
+    EXPECT_NE(rc, 0);
+}
@@ -0,0 +1,232 @@
+#include "slp_pcap.hpp"
+
+#include <errno.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using Bytes = std::vector<uint8_t>;
+
+const Bytes PAYLOAD = {0x02, 0x09, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00,
+                       0x00, 0x00, 0x12, 0x34, 0x00, 0x02, 'e',  'n'};
+
+void put16(Bytes& out, uint16_t value, bool swap = false)
+{
+    if (swap)
+    {
+        out.push_back(value >> 8);
+        out.push_back(value);
+        return;
+    }
+    out.push_back(value);
+    out.push_back(value >> 8);
+}
+
+void put32(Bytes& out, uint32_t value, bool swap = false)
+{
+    if (swap)
+    {
+        put16(out, value >> 16, true);
+        put16(out, value, true);
+        return;
+    }
+    put16(out, value);
+    put16(out, value >> 16);
+}
+
+Bytes udp(uint16_t src, uint16_t dst, const Bytes& payload)
+{
+    Bytes out;
+    put16(out, src, true);
+    put16(out, dst, true);
+    put16(out, payload.size() + 8, true);
+    put16(out, 0);
+    out.insert(out.end(), payload.begin(), payload.end());
+    return out;
+}
+
+Bytes ipv4(const Bytes& udp, uint8_t lastOctet, uint16_t fragment = 0)
+{
+    Bytes out = {0x45, 0, 0, 0, 0, 0, 0, 0, 64, 17, 0, 0,
+                 10,   0, 0, 1, 10, 0, 0, lastOctet};
+    out[2] = (20 + udp.size()) >> 8;
+    out[3] = 20 + udp.size();
+    out[6] = fragment >> 8;
+    out[7] = fragment;
+    out.insert(out.end(), udp.begin(), udp.end());
+    return out;
+}
+
+Bytes ipv6(const Bytes& udp)
+{
+    Bytes out = {0x60, 0, 0, 0, 0, 0, 17, 64};
+    out[4] = udp.size() >> 8;
+    out[5] = udp.size();
+    Bytes src(16, 0);
+    src[15] = 1;
+    Bytes dst = {0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x16};
+    out.insert(out.end(), src.begin(), src.end());
+    out.insert(out.end(), dst.begin(), dst.end());
+    out.insert(out.end(), udp.begin(), udp.end());
+    return out;
+}
+
+Bytes ethernet(const Bytes& ip, uint16_t etherType, bool vlan = false)
+{
+    Bytes out(12, 0xaa);
+    if (vlan)
+    {
+        put16(out, 0x8100, true);
+        put16(out, 5, true);
+    }
+    put16(out, etherType, true);
+    out.insert(out.end(), ip.begin(), ip.end());
+    return out;
+}
+
+Bytes pcap(const std::vector<Bytes>& frames, bool swap = false)
+{
+    Bytes out;
+    put32(out, 0xa1b2c3d4, swap);
+    put16(out, 2, swap);
+    put16(out, 4, swap);
+    put32(out, 0, swap);
+    put32(out, 0, swap);
+    put32(out, 65535, swap);
+    put32(out, 1, swap);
+    for (const auto& frame : frames)
+    {
+        put32(out, 7, swap);
+        put32(out, 250, swap);
+        put32(out, frame.size(), swap);
+        put32(out, frame.size(), swap);
+        out.insert(out.end(), frame.begin(), frame.end());
+    }
+    return out;
+}
+
+void ngBlock(Bytes& out, uint32_t type, const Bytes& body)
+{
+    uint32_t length = 12 + ((body.size() + 3) & ~3);
+    put32(out, type);
+    put32(out, length);
+    out.insert(out.end(), body.begin(), body.end());
+    out.resize(out.size() + ((4 - body.size() % 4) % 4));
+    put32(out, length);
+}
+
+Bytes pcapng(const Bytes& frame)
+{
+    Bytes out;
+
+    Bytes section;
+    put32(section, 0x1a2b3c4d);
+    put16(section, 1);
+    put16(section, 0);
+    put32(section, 0xffffffff);
+    put32(section, 0xffffffff);
+    ngBlock(out, 0x0a0d0d0a, section);
+
+    // Nanosecond timestamps
+    Bytes iface;
+    put16(iface, 1);
+    put16(iface, 0);
+    put32(iface, 0);
+    put16(iface, 9);
+    put16(iface, 1);
+    iface.insert(iface.end(), {9, 0, 0, 0});
+    put16(iface, 0);
+    put16(iface, 0);
+    ngBlock(out, 1, iface);
+
+    Bytes packet;
+    put32(packet, 0);
+    put32(packet, 0);
+    put32(packet, 1500);
+    put32(packet, frame.size());
+    put32(packet, frame.size());
+    packet.insert(packet.end(), frame.begin(), frame.end());
+    ngBlock(out, 6, packet);
+
+    return out;
+}
+
+} // namespace
+
+TEST(PcapTest, EthernetIPv4)
+{
+    auto capture = pcap({ethernet(ipv4(udp(40000, 427, PAYLOAD), 2), 0x0800)});
+    auto [rc, datagrams] = slp::pcap::parseCapture(capture);
+
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(datagrams.size(), 1);
+    EXPECT_EQ(datagrams[0].src, "10.0.0.1");
+    EXPECT_EQ(datagrams[0].dst, "10.0.0.2");
+    EXPECT_EQ(datagrams[0].srcPort, 40000);
+    EXPECT_EQ(datagrams[0].dstPort, 427);
+    EXPECT_FALSE(datagrams[0].multicast);
+    EXPECT_EQ(datagrams[0].timestamp, 7000250000ULL);
+    EXPECT_EQ(datagrams[0].payload, PAYLOAD);
+}
+
+TEST(PcapTest, VlanAndSwappedByteOrder)
+{
+    auto capture =
+        pcap({ethernet(ipv4(udp(427, 40000, PAYLOAD), 2), 0x0800, true)},
+             true);
+    auto [rc, datagrams] = slp::pcap::parseCapture(capture);
+
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(datagrams.size(), 1);
+    EXPECT_EQ(datagrams[0].srcPort, 427);
+    EXPECT_EQ(datagrams[0].timestamp, 7000250000ULL);
+    EXPECT_EQ(datagrams[0].payload, PAYLOAD);
+}
+
+TEST(PcapTest, PcapngIPv6Multicast)
+{
+    auto capture = pcapng(ethernet(ipv6(udp(40000, 427, PAYLOAD)), 0x86dd));
+    auto [rc, datagrams] = slp::pcap::parseCapture(capture);
+
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(datagrams.size(), 1);
+    EXPECT_EQ(datagrams[0].src, "::1");
+    EXPECT_EQ(datagrams[0].dst, "ff02::116");
+    EXPECT_TRUE(datagrams[0].multicast);
+    EXPECT_EQ(datagrams[0].payload, PAYLOAD);
+}
+
+TEST(PcapTest, FragmentsSkipped)
+{
+    auto capture = pcap({
+        ethernet(ipv4(udp(40000, 427, PAYLOAD), 2, 0x2000), 0x0800),
+        ethernet(ipv4(udp(40001, 427, PAYLOAD), 2), 0x0800),
+    });
+    auto [rc, datagrams] = slp::pcap::parseCapture(capture);
+
+    ASSERT_EQ(rc, 0);
+    ASSERT_EQ(datagrams.size(), 1);
+    EXPECT_EQ(datagrams[0].srcPort, 40001);
+}
+
+TEST(PcapTest, TruncatedCapture)
+{
+    auto frame = ethernet(ipv4(udp(40000, 427, PAYLOAD), 2), 0x0800);
+    auto capture = pcap({frame, frame});
+    capture.resize(capture.size() - 5);
+    auto [rc, datagrams] = slp::pcap::parseCapture(capture);
+
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(datagrams.size(), 1);
+}
+
+TEST(PcapTest, NotACapture)
+{
+    Bytes junk(64, 0x5a);
+    EXPECT_EQ(std::get<0>(slp::pcap::parseCapture(junk)), -EBADMSG);
+    EXPECT_EQ(std::get<0>(slp::pcap::parseCapture(Bytes{})), -EBADMSG);
+}
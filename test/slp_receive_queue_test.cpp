@@ -0,0 +1,225 @@
+#include "slp_receive_queue.hpp"
+#include "sock_channel.hpp"
+
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using namespace std::chrono_literals;
+using slp::udp::ReceiveQueue;
+
+/* A UDP socket bound to a loopback port */
+int loopbackSocket(sockaddr_in& addr)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    EXPECT_GE(fd, 0);
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    EXPECT_EQ(bind(fd, (sockaddr*)&addr, len), 0);
+    EXPECT_EQ(getsockname(fd, (sockaddr*)&addr, &len), 0);
+    return fd;
+}
+
+} // namespace
+
+TEST(ReceiveQueue, Drops)
+{
+    sockaddr_in addr;
+    int fd = loopbackSocket(addr);
+    ReceiveQueue queue(fd, 0);
+    auto now = std::chrono::steady_clock::time_point{} + 1h;
+
+    EXPECT_EQ(queue.received(0, 0, now), 0);
+    EXPECT_EQ(queue.received(3, 0, now + 1s), 3);
+    EXPECT_EQ(queue.received(3, 0, now + 2s), 0);
+    EXPECT_EQ(queue.drops(), 3);
+    EXPECT_EQ(queue.overflowCount(), 3);
+
+    // The datagrams the socket filter rejected are no overflow
+    EXPECT_EQ(queue.received(10, 5, now + 3s), 2);
+    EXPECT_EQ(queue.received(10, 0, now + 4s), 0);
+    EXPECT_EQ(queue.received(12, 5, now + 5s), 2);
+
+    // The count wraps around
+    ReceiveQueue wrapping(fd, 0);
+    wrapping.received(UINT32_MAX - 1, 0, now);
+    EXPECT_EQ(wrapping.received(1, 0, now + 1s), 3);
+    close(fd);
+}
+
+TEST(ReceiveQueue, UncountedFilter)
+{
+    sockaddr_in addr;
+    int fd = loopbackSocket(addr);
+    size_t initial = slp::udp::bufferSize(fd);
+    ReceiveQueue queue(fd, 1024 * 1024);
+    auto now = std::chrono::steady_clock::time_point{} + 1h;
+    auto uncounted = ReceiveQueue::UNCOUNTED;
+
+    // Drops the filter may account for are neither warned of nor grow
+    // the buffers
+    EXPECT_EQ(queue.received(0, uncounted, now), 0);
+    EXPECT_EQ(queue.received(500, uncounted, now + 1ms), 0);
+    EXPECT_EQ(queue.drops(), 0);
+    EXPECT_EQ(queue.unknownDrops(), 500);
+    EXPECT_EQ(queue.overflowCount(), 500);
+    EXPECT_EQ(queue.warnDrops(now + 1s), 0);
+    EXPECT_EQ(queue.peakBurst(), 2);
+    EXPECT_EQ(queue.bufferSize(), initial);
+    close(fd);
+}
+
+TEST(ReceiveQueue, Warnings)
+{
+    sockaddr_in addr;
+    int fd = loopbackSocket(addr);
+    ReceiveQueue queue(fd, 0);
+    auto now = std::chrono::steady_clock::time_point{} + 1h;
+
+    EXPECT_EQ(queue.warnDrops(now), 0);
+    queue.received(4, 0, now);
+    EXPECT_EQ(queue.warnDrops(now), 4);
+
+    // Later drops wait for the interval to pass
+    queue.received(6, 0, now + 1s);
+    queue.received(7, 0, now + 2s);
+    EXPECT_EQ(queue.warnDrops(now + 2s), 0);
+    EXPECT_EQ(queue.warnDrops(now + ReceiveQueue::WARN_INTERVAL), 3);
+    EXPECT_EQ(queue.warnDrops(now + 2 * ReceiveQueue::WARN_INTERVAL), 0);
+    close(fd);
+}
+
+TEST(ReceiveQueue, Bursts)
+{
+    sockaddr_in addr;
+    int fd = loopbackSocket(addr);
+    size_t initial = slp::udp::bufferSize(fd);
+    ReceiveQueue queue(fd, 1024 * 1024);
+    EXPECT_EQ(queue.bufferSize(), initial);
+    auto now = std::chrono::steady_clock::time_point{} + 1h;
+
+    for (int i = 0; i < 10; i++)
+    {
+        queue.received(0, 0, now + i * 1ms);
+    }
+    EXPECT_EQ(queue.peakBurst(), 10);
+
+    // A pause ends the burst, the drops meanwhile count in the next
+    now += 1s;
+    queue.received(0, 0, now);
+    queue.received(5, 0, now + 1ms);
+    EXPECT_EQ(queue.peakBurst(), 10);
+    queue.received(400, 0, now + 2ms);
+    EXPECT_EQ(queue.peakBurst(), 403);
+
+    // Grown as far as the sysctl limits let it without CAP_NET_ADMIN
+    EXPECT_GE(queue.bufferSize(), initial);
+    EXPECT_EQ(queue.bufferSize(), slp::udp::bufferSize(fd));
+    close(fd);
+}
+
+TEST(ReceiveQueue, Overflow)
+{
+    sockaddr_in addr;
+    int fd = loopbackSocket(addr);
+    ASSERT_EQ(slp::udp::enableDropCount(fd), 0);
+    int size = 0;
+    ASSERT_EQ(setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)), 0);
+
+    // Far more than the smallest buffer holds
+    int sender = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ASSERT_GE(sender, 0);
+    uint8_t datagram[64]{};
+    for (int i = 0; i < 256; i++)
+    {
+        ASSERT_EQ(sendto(sender, datagram, sizeof(datagram), 0,
+                         (sockaddr*)&addr, sizeof(addr)),
+                  sizeof(datagram));
+    }
+
+    // A datagram carries the count as it was when it was queued
+    while (recv(fd, datagram, sizeof(datagram), MSG_DONTWAIT) > 0)
+    {}
+    ASSERT_EQ(sendto(sender, datagram, sizeof(datagram), 0, (sockaddr*)&addr,
+                     sizeof(addr)),
+              sizeof(datagram));
+
+    iovec iov{datagram, sizeof(datagram)};
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(uint32_t))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ASSERT_EQ(recvmsg(fd, &msg, MSG_DONTWAIT), sizeof(datagram));
+    EXPECT_GT(udpsocket::receiveOverflow(msg), 0);
+    close(sender);
+    close(fd);
+}
+
+TEST(ReceiveQueue, ClassicFilterJunk)
+{
+    sockaddr_in addr;
+    int fd = loopbackSocket(addr);
+    ASSERT_EQ(slp::udp::enableDropCount(fd), 0);
+    size_t initial = slp::udp::bufferSize(fd);
+    ReceiveQueue queue(fd, 1024 * 1024);
+
+    // A classic filter rejecting datagrams shorter than 16 bytes, it
+    // keeps no counts
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 16, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xffff),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    sock_fprog prog{sizeof(code) / sizeof(code[0]), code};
+    ASSERT_EQ(setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog,
+                         sizeof(prog)),
+              0);
+
+    int sender = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ASSERT_GE(sender, 0);
+    uint8_t junk[4]{};
+    uint8_t datagram[64]{};
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_EQ(sendto(sender, junk, sizeof(junk), 0, (sockaddr*)&addr,
+                         sizeof(addr)),
+                  sizeof(junk));
+    }
+    ASSERT_EQ(sendto(sender, datagram, sizeof(datagram), 0, (sockaddr*)&addr,
+                     sizeof(addr)),
+              sizeof(datagram));
+
+    iovec iov{datagram, sizeof(datagram)};
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(uint32_t))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ASSERT_EQ(recvmsg(fd, &msg, MSG_DONTWAIT), sizeof(datagram));
+
+    // The kernel counts the rejected junk as drops
+    uint32_t overflow = udpsocket::receiveOverflow(msg);
+    EXPECT_EQ(overflow, 100);
+
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(queue.received(overflow, ReceiveQueue::UNCOUNTED, now), 0);
+    EXPECT_EQ(queue.drops(), 0);
+    EXPECT_EQ(queue.unknownDrops(), 100);
+    EXPECT_EQ(queue.warnDrops(now), 0);
+    EXPECT_EQ(queue.bufferSize(), initial);
+    EXPECT_EQ(slp::udp::bufferSize(fd), initial);
+    close(sender);
+    close(fd);
+}
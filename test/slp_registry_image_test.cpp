@@ -0,0 +1,180 @@
+#include "slp_registry_image.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+std::vector<slp::ConfigData> makeServices()
+{
+    // Sorted by folded name the way readSLPServiceInfo leaves them
+    return {
+        {"service:management-hardware.IBM:baseboard-management-controller",
+         "https", "443"},
+        {"service:management-hardware.IBM:chassis", "https", "8443"},
+        {"service:obmc_console", "ssh", "2200"},
+        {"service:OBMC_Console", "ssh", "2201"},
+        {"service:web", "https", "443", 600},
+    };
+}
+
+std::vector<uint32_t> positions(std::span<const uint32_t> found)
+{
+    return {found.begin(), found.end()};
+}
+
+class RegistryImageTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/slp_registry_image_XXXXXX";
+        int fd = mkstemp(tmpl);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path = tmpl;
+    }
+
+    void TearDown() override
+    {
+        unlink(path.c_str());
+    }
+
+    void writeBytes(const std::vector<uint8_t>& bytes)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write((const char*)bytes.data(), bytes.size());
+    }
+
+    std::string path;
+};
+
+} // namespace
+
+TEST_F(RegistryImageTest, WriteAndOpen)
+{
+    ASSERT_EQ(slp::RegistryImage::write(makeServices(), path.c_str()), 0);
+
+    auto [rc, image] = slp::RegistryImage::open(path.c_str());
+    ASSERT_EQ(rc, 0);
+    ASSERT_NE(image, nullptr);
+    EXPECT_EQ(image->size(), 5);
+
+    const auto& svc = image->service(3);
+    EXPECT_EQ(image->string(svc.name), "service:OBMC_Console");
+    EXPECT_EQ(image->string(svc.type), "ssh");
+    EXPECT_EQ(image->string(svc.port), "2201");
+    EXPECT_EQ(image->string(svc.urlPrefix), "service:OBMC_Console:ssh//");
+    EXPECT_EQ(image->string(svc.urlSuffix), ",2201");
+    EXPECT_EQ(svc.lifetime, slp::LIFETIME);
+    EXPECT_EQ(image->service(4).lifetime, 600);
+}
+
+TEST_F(RegistryImageTest, FindFoldedAndAbstract)
+{
+    ASSERT_EQ(slp::RegistryImage::write(makeServices(), path.c_str()), 0);
+    auto [rc, image] = slp::RegistryImage::open(path.c_str());
+    ASSERT_EQ(rc, 0);
+
+    EXPECT_EQ(positions(image->find("service:obmc_console")),
+              (std::vector<uint32_t>{2, 3}));
+    EXPECT_EQ(positions(image->find("service:web")),
+              std::vector<uint32_t>{4});
+    EXPECT_EQ(positions(image->find("service:management-hardware.ibm")),
+              (std::vector<uint32_t>{0, 1}));
+    EXPECT_TRUE(image->find("service:printer").empty());
+}
+
+TEST_F(RegistryImageTest, TypeList)
+{
+    ASSERT_EQ(slp::RegistryImage::write(makeServices(), path.c_str()), 0);
+    auto [rc, image] = slp::RegistryImage::open(path.c_str());
+    ASSERT_EQ(rc, 0);
+
+    std::string list =
+        "service:management-hardware.IBM:baseboard-management-controller,"
+        "service:management-hardware.IBM:chassis,"
+        "service:obmc_console,service:web";
+    EXPECT_EQ(image->typeList(), list);
+
+    auto entry = image->typeListEntry();
+    ASSERT_EQ(entry.size(), list.size() + 2);
+    EXPECT_EQ((entry[0] << 8) | entry[1], list.size());
+    EXPECT_EQ(std::string((const char*)entry.data() + 2, list.size()), list);
+}
+
+TEST_F(RegistryImageTest, Empty)
+{
+    ASSERT_EQ(slp::RegistryImage::write({}, path.c_str()), 0);
+    auto [rc, image] = slp::RegistryImage::open(path.c_str());
+    ASSERT_EQ(rc, 0);
+    EXPECT_EQ(image->size(), 0);
+    EXPECT_TRUE(image->find("service:web").empty());
+    EXPECT_EQ(image->typeList(), "");
+}
+
+TEST_F(RegistryImageTest, Missing)
+{
+    auto [rc, image] =
+        slp::RegistryImage::open("/tmp/slp_registry_image_missing");
+    EXPECT_EQ(rc, -ENOENT);
+    EXPECT_EQ(image, nullptr);
+}
+
+TEST_F(RegistryImageTest, Truncated)
+{
+    auto bytes = slp::RegistryImage::compile(makeServices());
+    bytes.resize(bytes.size() - 1);
+    writeBytes(bytes);
+
+    auto [rc, image] = slp::RegistryImage::open(path.c_str());
+    EXPECT_EQ(rc, -EBADMSG);
+    EXPECT_EQ(image, nullptr);
+
+    writeBytes({'S', 'L', 'P'});
+    std::tie(rc, image) = slp::RegistryImage::open(path.c_str());
+    EXPECT_EQ(rc, -EBADMSG);
+}
+
+TEST_F(RegistryImageTest, Corrupted)
+{
+    auto good = slp::RegistryImage::compile(makeServices());
+
+    auto bytes = good;
+    bytes[0] = 'X';
+    writeBytes(bytes);
+    EXPECT_EQ(std::get<0>(slp::RegistryImage::open(path.c_str())), -EBADMSG);
+
+    // A string reference of the first service past the pool
+    bytes = good;
+    auto* svc = reinterpret_cast<slp::RegistryImage::Service*>(
+        bytes.data() + sizeof(slp::RegistryImage::Header));
+    svc->name.length = 0xffffffff;
+    writeBytes(bytes);
+    EXPECT_EQ(std::get<0>(slp::RegistryImage::open(path.c_str())), -EBADMSG);
+
+    // A type matching a service that is not in the image
+    bytes = good;
+    auto* header =
+        reinterpret_cast<slp::RegistryImage::Header*>(bytes.data());
+    auto* match = reinterpret_cast<uint32_t*>(
+        bytes.data() + sizeof(slp::RegistryImage::Header) +
+        header->serviceCount * sizeof(slp::RegistryImage::Service) +
+        header->typeCount * sizeof(slp::RegistryImage::Type));
+    *match = header->serviceCount;
+    writeBytes(bytes);
+    EXPECT_EQ(std::get<0>(slp::RegistryImage::open(path.c_str())), -EBADMSG);
+
+    // The untouched image still loads
+    writeBytes(good);
+    EXPECT_EQ(std::get<0>(slp::RegistryImage::open(path.c_str())), 0);
+}
@@ -0,0 +1,376 @@
+#include "slp.hpp"
+#include "slp_da.hpp"
+#include "slp_meta.hpp"
+#include "slp_sa.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+std::vector<slp::request::ServiceRegistration>
+    makeServices(size_t count, const std::string& scopes = "DEFAULT")
+{
+    std::vector<slp::request::ServiceRegistration> services(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        services[i].urlEntry.url = "obmc_console:ssh//192.0.2.10," +
+                                   std::to_string(2200 + i);
+        services[i].srvType = "obmc_console";
+        services[i].scopeList = scopes;
+    }
+    return services;
+}
+
+slp::request::DirectoryAgentAdvert
+    makeAdvert(uint32_t bootTimestamp, const std::string& scopes = "DEFAULT",
+               const std::string& url = "service:directory-agent://192.0.2.1")
+{
+    slp::request::DirectoryAgentAdvert advert;
+    advert.bootTimestamp = bootTimestamp;
+    advert.url = url;
+    advert.scopeList = scopes;
+    return advert;
+}
+
+/* A directory agent standing in for the real one: slpd's own directory
+ * agent mode, serving the SrvRegs as it would from the network */
+struct StandInDA
+{
+    StandInDA()
+    {
+        slp::da::enable("DEFAULT");
+    }
+
+    /* Serve a SrvReg and hand the SrvAck back to the registrar */
+    void serve(slp::sa::Registrar& registrar,
+               const slp::sa::Registrar::Outgoing& reg, uint64_t now)
+    {
+        slp::buffer ack;
+        bool multicast = false;
+        ASSERT_TRUE(slp::handler::serveRequest(reg.message, false, ack,
+                                               multicast, reg.ns));
+
+        auto [rc, msg] = slp::parser::parseBuffer(ack);
+        ASSERT_EQ(rc, 0);
+        ASSERT_EQ(msg.header.functionID, (uint8_t)slp::FunctionType::SRVACK);
+        registrar.acknowledged(reg.ns, msg.header.xid,
+                               msg.body.srvack.errorCode, now);
+    }
+};
+
+uint16_t xidOf(const slp::buffer& message)
+{
+    return (message[slp::header::OFFSET_XID] << 8) |
+           message[slp::header::OFFSET_XID + 1];
+}
+
+} // namespace
+
+TEST(Registrar, RegistersWithStandInDA)
+{
+    slp::sa::Registrar registrar(1);
+    StandInDA da;
+    size_t before = slp::da::store().size();
+
+    registrar.setServices(0, makeServices(3), 0);
+    EXPECT_EQ(registrar.next(), slp::sa::Registrar::NEVER);
+
+    registrar.heard(0, makeAdvert(100), 0);
+    EXPECT_EQ(registrar.agents(), 1);
+    auto start = registrar.next();
+    EXPECT_LE(start, slp::sa::Registrar::START_WAIT);
+
+    auto out = registrar.due(start);
+    ASSERT_EQ(out.size(), 3);
+    for (const auto& reg : out)
+    {
+        char addr[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, &reg.addr.sin6_addr, addr, sizeof(addr));
+        EXPECT_STREQ(addr, "::ffff:192.0.2.1");
+        EXPECT_EQ(ntohs(reg.addr.sin6_port), slp::PORT);
+
+        auto [rc, msg] = slp::parser::parseBuffer(reg.message);
+        ASSERT_EQ(rc, 0);
+        EXPECT_EQ(msg.header.flags, slp::header::FLAG_FRESH);
+        EXPECT_EQ(msg.body.srvreg.urlEntry.lifetime, slp::REG_LIFETIME);
+        EXPECT_EQ(msg.body.srvreg.srvType, "obmc_console");
+        da.serve(registrar, reg, start + 10);
+    }
+    EXPECT_EQ(registrar.registered(), 3);
+    EXPECT_EQ(slp::da::store().size(), before + 3);
+
+    // Refreshed as one batch, between half and three quarters of the
+    // lifetime
+    auto refresh = registrar.next();
+    EXPECT_GE(refresh, start + 10 + slp::REG_LIFETIME * 500);
+    EXPECT_LE(refresh, start + 10 + slp::REG_LIFETIME * 750);
+    EXPECT_TRUE(registrar.due(refresh - 1).empty());
+    EXPECT_EQ(registrar.due(refresh).size(), 3);
+}
+
+TEST(Registrar, RetransmitsWithBackoff)
+{
+    slp::sa::Registrar registrar(2);
+    registrar.setServices(0, makeServices(1), 0);
+    registrar.heard(0, makeAdvert(100), 0);
+
+    // The DA does not answer: RETRY, doubled up to RETRY_MAX
+    std::vector<uint64_t> sent;
+    std::set<uint16_t> xids;
+    for (uint64_t at = registrar.next(); sent.size() < 10;
+         at = registrar.next())
+    {
+        auto out = registrar.due(at);
+        if (out.empty())
+        {
+            break;
+        }
+        sent.push_back(at);
+        xids.insert(xidOf(out[0].message));
+    }
+    ASSERT_EQ(sent.size(), slp::sa::Registrar::ATTEMPTS);
+    EXPECT_EQ(sent[1] - sent[0], slp::sa::Registrar::RETRY);
+    EXPECT_EQ(sent[2] - sent[1], slp::sa::Registrar::RETRY * 2);
+    EXPECT_EQ(sent[3] - sent[2], slp::sa::Registrar::RETRY * 4);
+    // Retransmissions keep the XID
+    EXPECT_EQ(xids.size(), 1);
+    EXPECT_EQ(registrar.registered(), 0);
+
+    // The round is given up after the last timeout and tried again
+    // after a randomized backoff
+    auto givenUp = sent[3] + slp::sa::Registrar::RETRY_MAX;
+    auto retry = registrar.next();
+    EXPECT_GE(retry, givenUp + slp::sa::Registrar::BACKOFF / 2);
+    EXPECT_LE(retry, givenUp + slp::sa::Registrar::BACKOFF);
+
+    // And the backoff doubles while the DA stays silent
+    uint64_t round = retry;
+    for (unsigned i = 0; i < slp::sa::Registrar::ATTEMPTS; i++)
+    {
+        ASSERT_EQ(registrar.due(round).size(), 1);
+        round = registrar.next();
+    }
+    EXPECT_TRUE(registrar.due(round).empty());
+    EXPECT_GE(registrar.next(), round + slp::sa::Registrar::BACKOFF);
+    EXPECT_LE(registrar.next(), round + slp::sa::Registrar::BACKOFF * 2);
+}
+
+TEST(Registrar, Batches)
+{
+    slp::sa::Registrar registrar(3);
+    registrar.setServices(0, makeServices(20), 0);
+    registrar.heard(0, makeAdvert(100), 0);
+
+    auto at = registrar.next();
+    EXPECT_EQ(registrar.due(at).size(), slp::sa::Registrar::BATCH);
+    EXPECT_TRUE(registrar.due(at).empty());
+    EXPECT_EQ(registrar.next(), at + slp::sa::Registrar::PACE);
+    EXPECT_EQ(registrar.due(at + slp::sa::Registrar::PACE).size(),
+              slp::sa::Registrar::BATCH);
+    EXPECT_EQ(registrar.due(at + 2 * slp::sa::Registrar::PACE).size(), 4);
+    EXPECT_EQ(registrar.next(), at + slp::sa::Registrar::RETRY);
+}
+
+TEST(Registrar, RebootAndShutdown)
+{
+    slp::sa::Registrar registrar(4);
+    StandInDA da;
+    registrar.setServices(0, makeServices(2), 0);
+    registrar.heard(0, makeAdvert(100), 0);
+
+    auto at = registrar.next();
+    for (const auto& reg : registrar.due(at))
+    {
+        da.serve(registrar, reg, at);
+    }
+    EXPECT_EQ(registrar.registered(), 2);
+    auto refresh = registrar.next();
+
+    // The periodic DAAdvert changes nothing
+    registrar.heard(0, makeAdvert(100), at + 1000);
+    EXPECT_EQ(registrar.next(), refresh);
+
+    // A rebooted DA lost the registrations
+    registrar.heard(0, makeAdvert(200), at + 1000);
+    EXPECT_EQ(registrar.registered(), 0);
+    EXPECT_LE(registrar.next(), at + 1000 + slp::sa::Registrar::START_WAIT);
+
+    // A changed registry is registered again
+    at = registrar.next();
+    for (const auto& reg : registrar.due(at))
+    {
+        da.serve(registrar, reg, at);
+    }
+    at += slp::sa::Registrar::PACE;
+    registrar.setServices(0, makeServices(2), at);
+    EXPECT_GT(registrar.next(), at + slp::sa::Registrar::START_WAIT);
+    registrar.setServices(0, makeServices(3), at);
+    EXPECT_LE(registrar.next(), at + slp::sa::Registrar::START_WAIT);
+    EXPECT_EQ(registrar.due(registrar.next()).size(), 3);
+
+    // Going down, zero boot timestamp
+    registrar.heard(0, makeAdvert(0), at);
+    EXPECT_EQ(registrar.agents(), 0);
+    EXPECT_EQ(registrar.next(), slp::sa::Registrar::NEVER);
+}
+
+TEST(Registrar, ScopesAndAddresses)
+{
+    slp::sa::Registrar registrar(5);
+    registrar.setServices(0, makeServices(2), 0);
+    registrar.setServices(1, makeServices(1, "lab"), 0);
+
+    // Only agents serving the scopes of a service get it
+    registrar.heard(0, makeAdvert(100, "OTHER"), 0);
+    registrar.heard(1, makeAdvert(100, "LAB,other",
+                                  "SERVICE:Directory-Agent://[2001:db8::1]"),
+                    0);
+    EXPECT_EQ(registrar.agents(), 2);
+
+    auto out = registrar.due(slp::sa::Registrar::START_WAIT);
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_EQ(out[0].ns, 1);
+    char addr[INET6_ADDRSTRLEN];
+    inet_ntop(AF_INET6, &out[0].addr.sin6_addr, addr, sizeof(addr));
+    EXPECT_STREQ(addr, "2001:db8::1");
+
+    // Not a DA URL, or an error
+    registrar.heard(0, makeAdvert(100, "DEFAULT", "service:x://192.0.2.2"),
+                    0);
+    registrar.heard(0, makeAdvert(100, "DEFAULT",
+                                  "service:directory-agent://da.example"),
+                    0);
+    auto failed = makeAdvert(100, "DEFAULT",
+                             "service:directory-agent://192.0.2.3:427");
+    failed.errorCode = (uint16_t)slp::Error::SCOPE_NOT_SUPPORTED;
+    registrar.heard(0, failed, 0);
+    EXPECT_EQ(registrar.agents(), 2);
+    failed.errorCode = 0;
+    registrar.heard(0, failed, 0);
+    EXPECT_EQ(registrar.agents(), 3);
+
+    // Registrations that do not fit a message are left out
+    slp::sa::Registrar oversized(7);
+    auto services = makeServices(2);
+    services[0].attrList.assign(slp::MAX_LEN, 'a');
+    oversized.setServices(0, services, 0);
+    oversized.heard(0, makeAdvert(100), 0);
+    EXPECT_EQ(oversized.due(slp::sa::Registrar::START_WAIT).size(), 1);
+}
+
+TEST(Registrar, BusyAndRejected)
+{
+    slp::sa::Registrar registrar(6);
+    registrar.setServices(0, makeServices(2), 0);
+    registrar.heard(0, makeAdvert(100), 0);
+
+    auto at = registrar.next();
+    auto out = registrar.due(at);
+    ASSERT_EQ(out.size(), 2);
+
+    // Busy, sent again once the retransmission is due
+    registrar.acknowledged(0, xidOf(out[0].message),
+                           (uint16_t)slp::Error::DA_BUSY_NOW, at + 10);
+    // Rejected, not sent again in this round
+    registrar.acknowledged(0, xidOf(out[1].message),
+                           (uint16_t)slp::Error::INVALID_REGISTRATION,
+                           at + 10);
+    // Unknown XIDs are ignored
+    registrar.acknowledged(0, xidOf(out[0].message) + 1000, 0, at + 10);
+    registrar.acknowledged(1, xidOf(out[0].message), 0, at + 10);
+
+    auto retry = registrar.due(at + slp::sa::Registrar::RETRY);
+    ASSERT_EQ(retry.size(), 1);
+    EXPECT_EQ(xidOf(retry[0].message), xidOf(out[0].message));
+    registrar.acknowledged(0, xidOf(retry[0].message), 0,
+                           at + slp::sa::Registrar::RETRY);
+    EXPECT_EQ(registrar.registered(), 1);
+
+    // A rejection is not a failure, the round is refreshed as usual
+    EXPECT_GE(registrar.next(), at + slp::REG_LIFETIME * 500);
+}
+
+TEST(Registrar, SpreadsAFleet)
+{
+    constexpr size_t fleet = 200;
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> refreshes;
+
+    for (uint32_t seed = 0; seed < fleet; seed++)
+    {
+        slp::sa::Registrar registrar(seed);
+        registrar.setServices(0, makeServices(1), 0);
+        registrar.heard(0, makeAdvert(100), 0);
+
+        auto at = registrar.next();
+        starts.push_back(at);
+        auto out = registrar.due(at);
+        ASSERT_EQ(out.size(), 1);
+        registrar.acknowledged(0, xidOf(out[0].message), 0, at);
+        refreshes.push_back(registrar.next() - at);
+    }
+
+    // All of a fleet hearing a DA at once does not register at once
+    std::sort(starts.begin(), starts.end());
+    EXPECT_LE(starts.back(), slp::sa::Registrar::START_WAIT);
+    EXPECT_GE(starts.back() - starts.front(),
+              slp::sa::Registrar::START_WAIT * 9 / 10);
+    EXPECT_GT(std::set<uint64_t>(starts.begin(), starts.end()).size(),
+              fleet * 9 / 10);
+
+    // Nor does it refresh at once
+    auto [low, high] = std::minmax_element(refreshes.begin(), refreshes.end());
+    EXPECT_GE(*low, slp::REG_LIFETIME * 500);
+    EXPECT_LE(*high, slp::REG_LIFETIME * 750);
+    EXPECT_GE(*high - *low, slp::REG_LIFETIME * 200);
+}
+
+TEST(serveRequest, RepliesNotAnswered)
+{
+    slp::sa::enable();
+
+    // A DAAdvert, as multicast by a DA
+    slp::buffer advert{0x02, 0x08, 0x00, 0x00, 0x00, 0x20, 0x00,
+                       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, /* Lang */
+                       'e',  'n',  0x00, 0x00,                   /* Error */
+                       0x00, 0x00, 0x00, 0x64};                  /* Boot */
+    for (std::string_view list :
+         {"service:directory-agent://192.0.2.1", "DEFAULT", "", ""})
+    {
+        advert.push_back(0);
+        advert.push_back(list.size());
+        advert.insert(advert.end(), list.begin(), list.end());
+    }
+    advert.push_back(0); // auth blocks
+    advert[slp::header::OFFSET_LENGTH] = advert.size();
+
+    slp::buffer resp;
+    bool multicast = false;
+    auto agents = slp::sa::registrar().agents();
+    EXPECT_FALSE(
+        slp::handler::serveRequest(advert, false, resp, multicast, 0));
+    EXPECT_EQ(slp::sa::registrar().agents(), agents + 1);
+
+    // A SrvAck nobody waits for is dropped as well
+    slp::buffer ack{0x02, 0x05, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00, 0x00,
+                    0x00, 0x12, 0x34, 0x00, 0x02, 'e',  'n',  0x00, 0x00};
+    EXPECT_FALSE(slp::handler::serveRequest(ack, false, resp, multicast, 0));
+
+    // The DA discovery request is answered by a DA
+    slp::da::enable("DEFAULT");
+    auto discovery = slp::sa::prepareDADiscovery(0x4321);
+    EXPECT_TRUE(
+        slp::handler::serveRequest(discovery, false, resp, multicast, 0));
+    EXPECT_TRUE(multicast);
+    EXPECT_EQ(resp[slp::header::OFFSET_FUNCTION],
+              (uint8_t)slp::FunctionType::DAADVERT);
+    EXPECT_EQ(xidOf(resp), 0x4321);
+}
@@ -0,0 +1,155 @@
+#include "slp_scheduler.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using Scheduler = slp::udp::Scheduler;
+using Class = Scheduler::Class;
+
+/* The address of a peer as the dual stack socket reports it */
+sockaddr_in6 peer(const char* address)
+{
+    sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    EXPECT_EQ(inet_pton(AF_INET6, address, &addr.sin6_addr), 1);
+    return addr;
+}
+
+Scheduler::Request request(uint8_t tag)
+{
+    Scheduler::Request req;
+    req.data = {tag};
+    return req;
+}
+
+} // namespace
+
+TEST(Scheduler, Classify)
+{
+    Scheduler scheduler;
+    ASSERT_EQ(scheduler.setManagementSubnets({"10.1.0.0/16", "fd00::/8"}), 0);
+
+    auto addr = peer("::ffff:192.168.1.2");
+    EXPECT_EQ(scheduler.classify((sockaddr*)&addr, false), Class::URGENT);
+    EXPECT_EQ(scheduler.classify((sockaddr*)&addr, true), Class::BULK);
+
+    addr = peer("::ffff:10.1.200.3");
+    EXPECT_EQ(scheduler.classify((sockaddr*)&addr, true), Class::URGENT);
+    addr = peer("::ffff:10.2.0.3");
+    EXPECT_EQ(scheduler.classify((sockaddr*)&addr, true), Class::BULK);
+    addr = peer("fd12::1");
+    EXPECT_EQ(scheduler.classify((sockaddr*)&addr, true), Class::URGENT);
+
+    // A socket passed by systemd may be IPv4 only
+    sockaddr_in v4{};
+    v4.sin_family = AF_INET;
+    inet_pton(AF_INET, "10.1.0.9", &v4.sin_addr);
+    EXPECT_EQ(scheduler.classify((sockaddr*)&v4, true), Class::URGENT);
+}
+
+TEST(Scheduler, InvalidSubnets)
+{
+    Scheduler scheduler;
+    ASSERT_EQ(scheduler.setManagementSubnets({"10.1.0.0/16"}), 0);
+
+    EXPECT_EQ(scheduler.setManagementSubnets({"10.1.0.0/33"}), -EINVAL);
+    EXPECT_EQ(scheduler.setManagementSubnets({"10.1.0.0/"}), -EINVAL);
+    EXPECT_EQ(scheduler.setManagementSubnets({"bmc.example"}), -EINVAL);
+
+    // Left as they were
+    auto addr = peer("::ffff:10.1.0.1");
+    EXPECT_EQ(scheduler.classify((sockaddr*)&addr, true), Class::URGENT);
+}
+
+TEST(Scheduler, Weighted)
+{
+    Scheduler scheduler;
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(scheduler.push(Class::BULK, request(100 + i)));
+    }
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        ASSERT_TRUE(scheduler.push(Class::URGENT, request(i)));
+    }
+
+    std::vector<uint8_t> order;
+    Scheduler::Request req;
+    while (scheduler.pop(req, {}))
+    {
+        order.push_back(req.data[0]);
+    }
+    EXPECT_EQ(order, (std::vector<uint8_t>{0, 1, 2, 3, 100, 4, 5, 6, 7, 101,
+                                           8, 9, 102}));
+    EXPECT_TRUE(scheduler.empty());
+}
+
+TEST(Scheduler, ShedBulkFirst)
+{
+    Scheduler scheduler;
+
+    // A full bulk queue sheds its oldest request
+    for (size_t i = 0; i <= Scheduler::BULK_LIMIT; i++)
+    {
+        EXPECT_TRUE(scheduler.push(Class::BULK, request(i)));
+    }
+    EXPECT_EQ(scheduler.size(Class::BULK), Scheduler::BULK_LIMIT);
+    EXPECT_EQ(scheduler.shed(Class::BULK), 1);
+
+    Scheduler::Request req;
+    ASSERT_TRUE(scheduler.pop(req, {}));
+    EXPECT_EQ(req.data[0], 1);
+
+    // No new bulk work while urgent work piles up
+    for (size_t i = 0; i <= Scheduler::URGENT_LIMIT / 2; i++)
+    {
+        ASSERT_TRUE(scheduler.push(Class::URGENT, request(i)));
+    }
+    EXPECT_FALSE(scheduler.push(Class::BULK, request(0)));
+    EXPECT_EQ(scheduler.shed(Class::BULK), 2);
+
+    // Urgent requests are only shed when their own queue is full
+    while (scheduler.size(Class::URGENT) < Scheduler::URGENT_LIMIT)
+    {
+        ASSERT_TRUE(scheduler.push(Class::URGENT, request(0)));
+    }
+    EXPECT_FALSE(scheduler.push(Class::URGENT, request(0)));
+    EXPECT_EQ(scheduler.shed(Class::URGENT), 1);
+}
+
+TEST(Scheduler, MaxAge)
+{
+    using namespace std::chrono_literals;
+    Scheduler scheduler;
+    scheduler.maxAge = 2s;
+
+    std::chrono::steady_clock::time_point start{};
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        auto req = request(i);
+        req.received = start + i * 1s;
+        ASSERT_TRUE(scheduler.push(Class::URGENT, std::move(req)));
+    }
+    auto req = request(100);
+    req.received = start;
+    ASSERT_TRUE(scheduler.push(Class::BULK, std::move(req)));
+
+    // Those received over two seconds before are dropped unserved
+    ASSERT_TRUE(scheduler.pop(req, start + 3500ms));
+    EXPECT_EQ(req.data[0], 2);
+    EXPECT_EQ(scheduler.stale(Class::URGENT), 2);
+    ASSERT_TRUE(scheduler.pop(req, start + 3500ms));
+    EXPECT_EQ(req.data[0], 3);
+    EXPECT_FALSE(scheduler.pop(req, start + 3500ms));
+    EXPECT_EQ(scheduler.stale(Class::BULK), 1);
+    EXPECT_TRUE(scheduler.empty());
+
+    const auto& delays = scheduler.queueDelay(Class::URGENT);
+    EXPECT_EQ(delays.count(), 4);
+    EXPECT_EQ(delays.max(), 3500000000);
+}
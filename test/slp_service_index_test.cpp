@@ -0,0 +1,95 @@
+#include "slp_service_index.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+std::vector<slp::ConfigData> makeServices()
+{
+    // Sorted by folded name the way readSLPServiceInfo leaves them
+    return {
+        {"service:management-hardware.IBM:baseboard-management-controller",
+         "https", "443"},
+        {"service:management-hardware.IBM:chassis", "https", "8443"},
+        {"service:obmc_console", "ssh", "2200"},
+        {"service:OBMC_Console", "ssh", "2201"},
+        {"service:web", "https", "443"},
+    };
+}
+
+} // namespace
+
+TEST(fold, LowerCaseAndTrim)
+{
+    EXPECT_EQ(slp::fold("  Service:Printer:LPR "), "service:printer:lpr");
+    EXPECT_EQ(slp::fold("   "), "");
+    EXPECT_EQ(slp::fold(""), "");
+
+    std::array<char, 32> buf;
+    EXPECT_EQ(slp::fold(" DEFAULT", buf), "default");
+    EXPECT_EQ(slp::fold(" DEFAULT", buf).data(), buf.data());
+}
+
+TEST(abstractType, ConcreteAndAbstract)
+{
+    EXPECT_EQ(slp::abstractType("service:printer:lpr"), "service:printer");
+    EXPECT_EQ(slp::abstractType("service:printer"), "");
+    EXPECT_EQ(slp::abstractType("printer:lpr"), "");
+}
+
+TEST(ServiceIndex, CaseInsensitiveInstances)
+{
+    slp::ServiceIndex index;
+    index.build(makeServices());
+
+    const auto* found = index.find("SERVICE:obmc_console");
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, (std::vector<uint32_t>{2, 3}));
+
+    found = index.find("service:web");
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, std::vector<uint32_t>{4});
+}
+
+TEST(ServiceIndex, AbstractType)
+{
+    slp::ServiceIndex index;
+    index.build(makeServices());
+
+    const auto* found = index.find("service:management-hardware.ibm");
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, (std::vector<uint32_t>{0, 1}));
+
+    found = index.find("service:management-hardware.IBM:chassis");
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, std::vector<uint32_t>{1});
+}
+
+TEST(ServiceIndex, UnknownTypes)
+{
+    slp::ServiceIndex index;
+    EXPECT_EQ(index.find("service:web"), nullptr);
+    EXPECT_FALSE(index.mayContain("service:web"));
+
+    index.build(makeServices());
+    EXPECT_TRUE(index.mayContain("service:web"));
+    EXPECT_EQ(index.find("service:printer"), nullptr);
+    EXPECT_EQ(index.find("service:web:x"), nullptr);
+
+    // The filter turns most of the unknown types away on its own
+    size_t rejected = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        rejected += !index.mayContain("service:unknown" + std::to_string(i));
+    }
+    EXPECT_GT(rejected, 900);
+
+    // Rebuilding drops what is no longer there
+    index.build({});
+    EXPECT_EQ(index.find("service:web"), nullptr);
+}
@@ -0,0 +1,108 @@
+#include "slp_snapshot.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+constexpr uint32_t ALIVE = 0x600dcafe;
+
+/* Marks itself dead on destruction so that a use after free shows */
+struct Value
+{
+    explicit Value(uint64_t generation) : generation(generation) {}
+    ~Value()
+    {
+        magic = 0;
+    }
+
+    uint32_t magic = ALIVE;
+    uint64_t generation;
+};
+
+} // namespace
+
+TEST(Snapshot, EmptyUntilPublished)
+{
+    slp::Snapshot<Value> snapshot;
+    EXPECT_FALSE(snapshot.read());
+
+    snapshot.publish(std::make_unique<const Value>(1));
+    auto reader = snapshot.read();
+    ASSERT_TRUE(reader);
+    EXPECT_EQ(reader->generation, 1);
+}
+
+TEST(Snapshot, ReaderKeepsItsValue)
+{
+    slp::Snapshot<Value> snapshot;
+    snapshot.publish(std::make_unique<const Value>(1));
+
+    std::atomic<bool> published = false;
+    std::thread writer;
+    {
+        auto reader = snapshot.read();
+
+        // The publish has to wait for this reader to go away
+        writer = std::thread([&] {
+            snapshot.publish(std::make_unique<const Value>(2));
+            published = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        EXPECT_FALSE(published);
+        EXPECT_EQ(reader->magic, ALIVE);
+        EXPECT_EQ(reader->generation, 1);
+    }
+    writer.join();
+
+    EXPECT_TRUE(published);
+    EXPECT_EQ(snapshot.read()->generation, 2);
+}
+
+TEST(Snapshot, ConcurrentReadersAndWriter)
+{
+    constexpr uint64_t generations = 2000;
+    slp::Snapshot<Value> snapshot;
+    snapshot.publish(std::make_unique<const Value>(0));
+
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    std::atomic<uint64_t> failures = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        readers.emplace_back([&] {
+            uint64_t last = 0;
+            while (!done)
+            {
+                auto reader = snapshot.read();
+                // Never freed under a reader, never going back in time
+                if (reader->magic != ALIVE || reader->generation < last)
+                {
+                    failures++;
+                }
+                last = reader->generation;
+            }
+        });
+    }
+
+    for (uint64_t generation = 1; generation <= generations; generation++)
+    {
+        snapshot.publish(std::make_unique<const Value>(generation));
+    }
+    done = true;
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(snapshot.read()->generation, generations);
+}
@@ -0,0 +1,264 @@
+#include "slp_task.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using slp::task::FramePool;
+
+/* Record the order the tasks finish in */
+slp::task::Task sleeper(sd_event* event, uint64_t usec, int id,
+                        std::vector<int>& done)
+{
+    int rc = co_await slp::task::sleep(event, usec);
+    EXPECT_EQ(rc, 0);
+    done.push_back(id);
+}
+
+slp::task::Task reader(sd_event* event, int fd, int& revents)
+{
+    revents = co_await slp::task::readable(event, fd);
+}
+
+/* The outcome of a D-Bus call made by a task */
+struct CallResult
+{
+    bool done = false;
+    int rc = 0;
+    std::string text;
+};
+
+slp::task::Task caller(sd_bus* bus, const char* member, uint64_t usec,
+                       CallResult& result)
+{
+    sd_bus_message* message = nullptr;
+    EXPECT_GE(sd_bus_message_new_method_call(bus, &message, nullptr, "/test",
+                                             "org.openbmc.Test", member),
+              0);
+
+    auto [rc, reply] = co_await slp::task::call(bus, message, usec);
+    sd_bus_message_unref(message);
+
+    result.rc = rc;
+    const char* text = nullptr;
+    if (reply && sd_bus_message_read(reply.get(), "s", &text) >= 0)
+    {
+        result.text = text;
+    }
+    result.done = true;
+}
+
+/* Serves /test: Echo replies, Fail returns an error, Hang never replies */
+int serveTest(sd_bus_message* message, void* /*userdata*/,
+              sd_bus_error* /*error*/)
+{
+    std::string member = sd_bus_message_get_member(message);
+    if (member == "Echo")
+    {
+        return sd_bus_reply_method_return(message, "s", "pong");
+    }
+    if (member == "Fail")
+    {
+        return sd_bus_reply_method_errorf(
+            message, "org.freedesktop.DBus.Error.AccessDenied", "denied");
+    }
+    return 1;
+}
+
+/* A client connected to a server serving /test, both on one loop */
+class BusPair : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        ASSERT_GE(sd_event_new(&event), 0);
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+
+        sd_id128_t id{};
+        id.bytes[0] = 1;
+        ASSERT_GE(sd_bus_new(&server), 0);
+        ASSERT_GE(sd_bus_set_fd(server, fds[0], fds[0]), 0);
+        ASSERT_GE(sd_bus_set_server(server, 1, id), 0);
+        ASSERT_GE(sd_bus_add_object(server, nullptr, "/test", serveTest,
+                                    nullptr),
+                  0);
+        ASSERT_GE(sd_bus_start(server), 0);
+        ASSERT_GE(sd_bus_attach_event(server, event, 0), 0);
+
+        ASSERT_GE(sd_bus_new(&client), 0);
+        ASSERT_GE(sd_bus_set_fd(client, fds[1], fds[1]), 0);
+        ASSERT_GE(sd_bus_start(client), 0);
+        ASSERT_GE(sd_bus_attach_event(client, event, 0), 0);
+    }
+
+    void TearDown() override
+    {
+        sd_bus_flush_close_unref(client);
+        sd_bus_flush_close_unref(server);
+        sd_event_unref(event);
+    }
+
+    /* Run the loop until the call is done */
+    void runUntil(const CallResult& result)
+    {
+        for (int i = 0; i < 100 && !result.done; i++)
+        {
+            ASSERT_GE(sd_event_run(event, 100000), 0);
+        }
+    }
+
+    sd_event* event = nullptr;
+    sd_bus* server = nullptr;
+    sd_bus* client = nullptr;
+};
+
+/* Run the loop until the tasks are done */
+void runUntil(sd_event* event, const std::vector<int>& done, size_t count)
+{
+    for (int i = 0; i < 100 && done.size() < count; i++)
+    {
+        ASSERT_GE(sd_event_run(event, 100000), 0);
+    }
+}
+
+} // namespace
+
+TEST(FramePool, Blocks)
+{
+    std::array<FramePool::Block, 2> storage;
+    FramePool pool(storage);
+    EXPECT_EQ(pool.capacity(), 2);
+
+    void* first = pool.allocate(100);
+    void* second = pool.allocate(FramePool::BLOCK_SIZE);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(pool.inUse(), 2);
+    EXPECT_EQ(pool.heapFrames(), 0);
+
+    // A freed block is the next one handed out
+    pool.deallocate(first, 100);
+    EXPECT_EQ(pool.allocate(200), first);
+
+    pool.deallocate(first, 200);
+    pool.deallocate(second, FramePool::BLOCK_SIZE);
+    EXPECT_EQ(pool.inUse(), 0);
+    EXPECT_EQ(pool.peak(), 2);
+}
+
+TEST(FramePool, Heap)
+{
+    std::array<FramePool::Block, 1> storage;
+    FramePool pool(storage);
+
+    // Too large for a block
+    void* large = pool.allocate(FramePool::BLOCK_SIZE + 1);
+    EXPECT_EQ(pool.heapFrames(), 1);
+
+    // Beyond the blocks there are
+    void* block = pool.allocate(10);
+    void* extra = pool.allocate(10);
+    EXPECT_EQ(pool.heapFrames(), 2);
+    EXPECT_EQ(pool.inUse(), 3);
+
+    pool.deallocate(large, FramePool::BLOCK_SIZE + 1);
+    pool.deallocate(extra, 10);
+    pool.deallocate(block, 10);
+    EXPECT_EQ(pool.inUse(), 0);
+
+    // The block went back on the free list, the heap frames did not
+    EXPECT_EQ(pool.allocate(10), block);
+    pool.deallocate(block, 10);
+
+    // Without blocks every frame comes from the heap
+    FramePool empty({});
+    void* frame = empty.allocate(10);
+    EXPECT_EQ(empty.heapFrames(), 1);
+    empty.deallocate(frame, 10);
+}
+
+TEST(Task, Sleep)
+{
+    sd_event* event = nullptr;
+    ASSERT_GE(sd_event_new(&event), 0);
+    std::vector<int> done;
+
+    // Both wait at once, the shorter delay finishes first
+    sleeper(event, 20000, 1, done);
+    sleeper(event, 10000, 2, done);
+    EXPECT_TRUE(done.empty());
+    EXPECT_EQ(slp::task::frames().inUse(), 2);
+
+    runUntil(event, done, 2);
+    EXPECT_EQ(done, (std::vector<int>{2, 1}));
+    EXPECT_EQ(slp::task::frames().inUse(), 0);
+    sd_event_unref(event);
+}
+
+TEST(Task, Readable)
+{
+    sd_event* event = nullptr;
+    ASSERT_GE(sd_event_new(&event), 0);
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds), 0);
+
+    int revents = 0;
+    reader(event, fds[0], revents);
+    ASSERT_GE(sd_event_run(event, 0), 0);
+    EXPECT_EQ(revents, 0);
+    EXPECT_EQ(slp::task::frames().inUse(), 1);
+
+    ASSERT_EQ(write(fds[1], "x", 1), 1);
+    for (int i = 0; i < 10 && revents == 0; i++)
+    {
+        ASSERT_GE(sd_event_run(event, 100000), 0);
+    }
+    EXPECT_TRUE(revents & EPOLLIN);
+    EXPECT_EQ(slp::task::frames().inUse(), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    sd_event_unref(event);
+}
+
+TEST_F(BusPair, Reply)
+{
+    CallResult result;
+    caller(client, "Echo", 0, result);
+    EXPECT_FALSE(result.done);
+    EXPECT_EQ(slp::task::frames().inUse(), 1);
+
+    runUntil(result);
+    EXPECT_TRUE(result.done);
+    EXPECT_EQ(result.rc, 0);
+    EXPECT_EQ(result.text, "pong");
+    EXPECT_EQ(slp::task::frames().inUse(), 0);
+}
+
+TEST_F(BusPair, ErrorReply)
+{
+    CallResult result;
+    caller(client, "Fail", 0, result);
+    runUntil(result);
+    EXPECT_TRUE(result.done);
+    EXPECT_EQ(result.rc, -EACCES);
+    EXPECT_TRUE(result.text.empty());
+}
+
+TEST_F(BusPair, Timeout)
+{
+    CallResult result;
+    caller(client, "Hang", 20000, result);
+    runUntil(result);
+    EXPECT_TRUE(result.done);
+    EXPECT_EQ(result.rc, -ETIMEDOUT);
+    EXPECT_EQ(slp::task::frames().inUse(), 0);
+}
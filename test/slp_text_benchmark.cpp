@@ -0,0 +1,108 @@
+#include "slp_alloc_counter.hpp"
+#include "slp_text.hpp"
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+/* The string scanning kernels against their scalar versions, on strings
+ * as long as a message allows, with their heap allocations per call */
+
+namespace
+{
+
+/* Report the allocations counted since startCounting, per iteration */
+void reportAllocations(benchmark::State& state)
+{
+    auto allocations = slp::test::stopCounting();
+    state.counters["allocs"] = benchmark::Counter(
+        allocations.count, benchmark::Counter::kAvgIterations);
+    state.counters["alloc_bytes"] = benchmark::Counter(
+        allocations.bytes, benchmark::Counter::kAvgIterations);
+}
+
+const std::string ascii = [] {
+    std::string str;
+    while (str.size() < 240)
+    {
+        str += "scope-" + std::to_string(str.size()) + ",";
+    }
+    return str;
+}();
+
+const std::string mixed = [] {
+    std::string str;
+    while (str.size() < 240)
+    {
+        str += "caf\xc3\xa9-r\xc3\xa9seau,";
+    }
+    return str;
+}();
+
+const std::string escaped = [] {
+    std::string str;
+    while (str.size() < 240)
+    {
+        str += "printer\\2Cfloor-2,";
+    }
+    return str;
+}();
+
+void validUTF8(benchmark::State& state, bool (*valid)(std::string_view),
+               const std::string* str)
+{
+    slp::test::startCounting();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(valid(*str));
+    }
+    reportAllocations(state);
+    state.SetBytesProcessed(state.iterations() * str->size());
+}
+
+void splitList(benchmark::State& state,
+               size_t (*find)(std::string_view, char, size_t))
+{
+    slp::test::startCounting();
+    for (auto _ : state)
+    {
+        size_t items = 0;
+        size_t pos = 0;
+        while ((pos = find(ascii, ',', pos)) != std::string_view::npos)
+        {
+            items++;
+            pos++;
+        }
+        benchmark::DoNotOptimize(items);
+    }
+    reportAllocations(state);
+    state.SetBytesProcessed(state.iterations() * ascii.size());
+}
+
+void unescape(benchmark::State& state,
+              bool (*unescape)(std::string_view, std::string&))
+{
+    std::string out;
+    slp::test::startCounting();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(unescape(escaped, out));
+    }
+    reportAllocations(state);
+    state.SetBytesProcessed(state.iterations() * escaped.size());
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(validUTF8, ascii, slp::text::validUTF8, &ascii);
+BENCHMARK_CAPTURE(validUTF8, ascii_scalar, slp::text::scalar::validUTF8,
+                  &ascii);
+BENCHMARK_CAPTURE(validUTF8, mixed, slp::text::validUTF8, &mixed);
+BENCHMARK_CAPTURE(validUTF8, mixed_scalar, slp::text::scalar::validUTF8,
+                  &mixed);
+BENCHMARK_CAPTURE(splitList, kernel, slp::text::find);
+BENCHMARK_CAPTURE(splitList, scalar, slp::text::scalar::find);
+BENCHMARK_CAPTURE(unescape, kernel, slp::text::unescape);
+BENCHMARK_CAPTURE(unescape, scalar, slp::text::scalar::unescape);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,95 @@
+#include "slp_text.hpp"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std::string_literals;
+
+TEST(validUTF8, Valid)
+{
+    for (auto str : {""s, "DEFAULT"s, "service:obmc_console:ssh"s,
+                     "caf\xc3\xa9"s, "\xe2\x82\xac"s, "\xf0\x9f\x98\x80"s,
+                     "\xf4\x8f\xbf\xbf"s, std::string(300, 'a')})
+    {
+        EXPECT_TRUE(slp::text::validUTF8(str)) << str;
+        EXPECT_TRUE(slp::text::scalar::validUTF8(str)) << str;
+    }
+}
+
+TEST(validUTF8, Invalid)
+{
+    for (auto str : {"\xc0\xaf"s, "\xe0\x80\xaf"s, "\xed\xa0\x80"s,
+                     "\xf4\x90\x80\x80"s, "\xc3"s, "\xe2\x82"s, "\x80"s,
+                     "\xc3\x28"s, "\xff"s, "\xf8\x88\x80\x80\x80"s})
+    {
+        EXPECT_FALSE(slp::text::validUTF8(str));
+        EXPECT_FALSE(slp::text::scalar::validUTF8(str));
+    }
+}
+
+TEST(validUTF8, EveryOffset)
+{
+    // The vector path has to find the sequence wherever it starts
+    for (size_t pos = 0; pos < 40; pos++)
+    {
+        std::string good(48, 'x');
+        good.replace(pos, 2, "\xc3\xa9");
+        EXPECT_TRUE(slp::text::validUTF8(good)) << pos;
+
+        std::string bad(48, 'x');
+        bad[pos] = '\xc3';
+        EXPECT_FALSE(slp::text::validUTF8(bad)) << pos;
+    }
+}
+
+TEST(find, MatchesScalar)
+{
+    std::string str = "scope1,scope2,a-long-scope-name,x,another-one,";
+    for (size_t pos = 0; pos <= str.size() + 1; pos++)
+    {
+        EXPECT_EQ(slp::text::find(str, ',', pos),
+                  slp::text::scalar::find(str, ',', pos))
+            << pos;
+    }
+    EXPECT_EQ(slp::text::find(str, '!'), std::string_view::npos);
+    EXPECT_EQ(slp::text::find("", ','), std::string_view::npos);
+}
+
+TEST(unescape, Decodes)
+{
+    std::string out;
+    EXPECT_TRUE(slp::text::unescape("plain", out));
+    EXPECT_EQ(out, "plain");
+
+    EXPECT_TRUE(slp::text::unescape("a\\2Cb\\2c", out));
+    EXPECT_EQ(out, "a,b,");
+
+    std::string longer = std::string(20, 'x') + "\\5C" + std::string(20, 'y');
+    EXPECT_TRUE(slp::text::unescape(longer, out));
+    EXPECT_EQ(out, std::string(20, 'x') + "\\" + std::string(20, 'y'));
+
+    for (auto bad : {"\\", "a\\2", "\\zz", "\\2G"})
+    {
+        EXPECT_FALSE(slp::text::unescape(bad, out)) << bad;
+        EXPECT_FALSE(slp::text::scalar::unescape(bad, out)) << bad;
+    }
+}
+
+TEST(splitList, Items)
+{
+    auto split = [](std::string_view list) {
+        std::vector<std::string> items;
+        slp::text::splitList(list, [&items](std::string_view item) {
+            items.emplace_back(item);
+        });
+        return items;
+    };
+
+    EXPECT_TRUE(split("").empty());
+    EXPECT_EQ(split("DEFAULT"), std::vector<std::string>{"DEFAULT"});
+    EXPECT_EQ(split("a,b,,c"), (std::vector<std::string>{"a", "b", "", "c"}));
+    EXPECT_EQ(split("a\\2Cb,c,"),
+              (std::vector<std::string>{"a\\2Cb", "c", ""}));
+}
@@ -0,0 +1,64 @@
+#include "slp_trace.hpp"
+
+#include <gtest/gtest.h>
+
+using slp::trace::Histogram;
+using slp::trace::Stage;
+
+TEST(HistogramTest, Empty)
+{
+    Histogram h;
+    EXPECT_EQ(h.count(), 0);
+    EXPECT_EQ(h.percentile(0.5), 0);
+    EXPECT_EQ(h.max(), 0);
+}
+
+TEST(HistogramTest, Percentiles)
+{
+    Histogram h;
+    // 98 fast samples in the 512-1023ns bucket and two slow ones
+    for (int i = 0; i < 98; i++)
+    {
+        h.record(600);
+    }
+    h.record(5000);
+    h.record(70000);
+
+    EXPECT_EQ(h.count(), 100);
+    EXPECT_EQ(h.percentile(0.5), 1023);
+    EXPECT_EQ(h.percentile(0.99), 8191);
+    EXPECT_EQ(h.percentile(1.0), 70000);
+    EXPECT_EQ(h.max(), 70000);
+}
+
+TEST(SamplerTest, EveryNthRequest)
+{
+    auto stages = [] {
+        return slp::trace::histogram(Stage::PARSE).count();
+    };
+    auto before = stages();
+
+    slp::trace::setSampleInterval(0);
+    for (int i = 0; i < 10; i++)
+    {
+        slp::trace::begin();
+        slp::trace::mark(Stage::PARSE);
+        slp::trace::end();
+    }
+    EXPECT_EQ(stages(), before);
+
+    slp::trace::setSampleInterval(4);
+    for (int i = 0; i < 12; i++)
+    {
+        slp::trace::begin();
+        slp::trace::mark(Stage::PARSE);
+        slp::trace::end();
+    }
+    EXPECT_EQ(stages(), before + 3);
+
+    // Marks after the end of a sampled request are not recorded
+    slp::trace::mark(Stage::PARSE);
+    EXPECT_EQ(stages(), before + 3);
+
+    slp::trace::setSampleInterval(0);
+}
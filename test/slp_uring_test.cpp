@@ -0,0 +1,187 @@
+#include "slp_uring.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+
+struct Received
+{
+    size_t count = 0;
+    bool peerMatches = true;
+    bool multicast = false;
+    sockaddr_in6 client{};
+};
+
+/* Answers every datagram with its bytes reversed */
+void echo(slp::udp::Ring& ring, const slp::udp::Ring::Packet& packet,
+          void* userdata)
+{
+    auto received = static_cast<Received*>(userdata);
+    auto peer = reinterpret_cast<const sockaddr_in6*>(packet.peer);
+
+    received->count++;
+    received->multicast |= packet.multicast;
+    received->peerMatches &= packet.peerLen == sizeof(sockaddr_in6) &&
+                             peer->sin6_port == received->client.sin6_port;
+
+    std::vector<uint8_t> reply(packet.data.rbegin(), packet.data.rend());
+    EXPECT_EQ(ring.send(packet.peer, packet.peerLen, std::move(reply)), 0);
+}
+
+class RingTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        ASSERT_GE(sd_event_new(&event), 0);
+
+        server = bindLoopback();
+        client = bindLoopback();
+        ASSERT_GE(server, 0);
+        ASSERT_GE(client, 0);
+
+        timeval tv{0, 100000};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        socklen_t len = sizeof(serverAddr);
+        getsockname(server, (sockaddr*)&serverAddr, &len);
+        len = sizeof(received.client);
+        getsockname(client, (sockaddr*)&received.client, &len);
+
+        int r = 0;
+        std::tie(r, ring) =
+            slp::udp::Ring::create(event, server, echo, &received);
+        if (r == -ENOSYS || r == -EPERM || r == -EINVAL || r == -EOPNOTSUPP)
+        {
+            GTEST_SKIP() << "io_uring unavailable: " << strerror(-r);
+        }
+        ASSERT_EQ(r, 0);
+    }
+
+    void TearDown() override
+    {
+        ring.reset();
+        close(client);
+        close(server);
+        sd_event_unref(event);
+    }
+
+    static int bindLoopback()
+    {
+        int fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_loopback;
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            return -1;
+        }
+        return fd;
+    }
+
+    void sendRequest(uint8_t first)
+    {
+        uint8_t data[] = {first, 2, 3};
+        ASSERT_EQ(sendto(client, data, sizeof(data), 0,
+                         (sockaddr*)&serverAddr, sizeof(serverAddr)),
+                  (ssize_t)sizeof(data));
+    }
+
+    /* Run the loop until the ring handled count datagrams */
+    void runUntil(size_t count)
+    {
+        for (int i = 0; i < 100 && received.count < count; i++)
+        {
+            ASSERT_GE(sd_event_run(event, 10000), 0);
+        }
+    }
+
+    sd_event* event = nullptr;
+    int server = -1;
+    int client = -1;
+    sockaddr_in6 serverAddr{};
+    Received received;
+    std::unique_ptr<slp::udp::Ring> ring;
+};
+
+} // namespace
+
+TEST_F(RingTest, ReceiveAndReply)
+{
+    sendRequest(1);
+    runUntil(1);
+
+    EXPECT_EQ(received.count, 1);
+    EXPECT_TRUE(received.peerMatches);
+    EXPECT_FALSE(received.multicast);
+
+    // The reply went out with the completions handled
+    uint8_t reply[16];
+    ASSERT_EQ(recv(client, reply, sizeof(reply), 0), 3);
+    EXPECT_EQ(reply[0], 3);
+    EXPECT_EQ(reply[2], 1);
+}
+
+TEST_F(RingTest, BurstLargerThanBuffers)
+{
+    // More datagrams than provided buffers ends the multishot receive,
+    // the ring has to queue it again to get the rest
+    constexpr size_t burst = 100;
+    for (size_t i = 0; i < burst; i++)
+    {
+        sendRequest(i);
+    }
+    runUntil(burst);
+    EXPECT_EQ(received.count, burst);
+    EXPECT_TRUE(received.peerMatches);
+
+    size_t replies = 0;
+    uint8_t reply[16];
+    while (recv(client, reply, sizeof(reply), 0) == 3)
+    {
+        replies++;
+    }
+    EXPECT_EQ(replies, burst);
+}
+
+TEST_F(RingTest, SendOutsideHandler)
+{
+    std::vector<uint8_t> data{7, 8};
+    sockaddr_in6 peer = received.client;
+    EXPECT_EQ(ring->send((sockaddr*)&peer, sizeof(peer), data), 0);
+
+    uint8_t reply[16];
+    ASSERT_EQ(recv(client, reply, sizeof(reply), 0), 2);
+    EXPECT_EQ(reply[0], 7);
+}
+
+TEST_F(RingTest, HeldSendsGoOutOnFlush)
+{
+    std::vector<uint8_t> data{7, 8};
+    sockaddr_in6 peer = received.client;
+    EXPECT_TRUE(ring->hold());
+    EXPECT_FALSE(ring->hold());
+    EXPECT_EQ(ring->send((sockaddr*)&peer, sizeof(peer), data), 0);
+    EXPECT_EQ(ring->send((sockaddr*)&peer, sizeof(peer), data), 0);
+
+    uint8_t reply[16];
+    EXPECT_LT(recv(client, reply, sizeof(reply), MSG_DONTWAIT), 0);
+
+    EXPECT_EQ(ring->flush(), 0);
+    ASSERT_EQ(recv(client, reply, sizeof(reply), 0), 2);
+    ASSERT_EQ(recv(client, reply, sizeof(reply), 0), 2);
+
+    // Sends go out at once again
+    EXPECT_EQ(ring->send((sockaddr*)&peer, sizeof(peer), data), 0);
+    ASSERT_EQ(recv(client, reply, sizeof(reply), 0), 2);
+}